@@ -44,6 +44,7 @@
  * \defgroup pico_async_context pico_async_context
  * \defgroup pico_multicore pico_multicore
  * \defgroup pico_i2c_slave pico_i2c_slave
+ * \defgroup pico_log pico_log
  * \defgroup pico_rand pico_rand
  * \defgroup pico_stdlib pico_stdlib
  * \defgroup pico_sync pico_sync
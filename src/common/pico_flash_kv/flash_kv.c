@@ -0,0 +1,536 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "pico/flash_kv.h"
+#include "hardware/sync.h"
+
+static_assert(PICO_FLASH_KV_MAX_SECTORS >= 2 && PICO_FLASH_KV_MAX_SECTORS <= 127, "PICO_FLASH_KV_MAX_SECTORS invalid");
+static_assert(!(PICO_FLASH_KV_INDEX_SIZE & (PICO_FLASH_KV_INDEX_SIZE - 1)), "PICO_FLASH_KV_INDEX_SIZE must be a power of 2");
+static_assert(PICO_FLASH_KV_MAX_KEY_SIZE >= 1 && PICO_FLASH_KV_MAX_KEY_SIZE <= 255, "PICO_FLASH_KV_MAX_KEY_SIZE invalid");
+static_assert(PICO_FLASH_KV_MAX_VALUE_SIZE <= 3800, "PICO_FLASH_KV_MAX_VALUE_SIZE too big");
+
+// Flash layout
+//
+// Each sector starts with a sector_header_t, followed by records, each a record_header_t then the key and the value,
+// padded to a multiple of 4 bytes. The free space after the last record is erased (0xff). A record is appended by
+// programming it with the commit word left erased, then programming the commit word to zero.
+
+#define SECTOR_MAGIC 0x31564b50u // "PKV1"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t erase_count;
+    uint32_t erase_count_check; // ~erase_count
+    uint32_t reserved;
+} sector_header_t;
+
+#define RECORD_COMMITTED 0u
+#define RECORD_FLAGS_VALUE 0xffu
+#define RECORD_FLAGS_TOMBSTONE 0xfeu
+
+typedef struct {
+    uint32_t commit;
+    uint32_t seq;
+    uint8_t key_len;
+    uint8_t flags;
+    uint16_t value_len;
+    uint32_t crc;       // CRC32 of seq through value_len, the key and the value
+} record_header_t;
+
+#define SECTOR_HEADER_SIZE ((uint32_t)sizeof(sector_header_t))
+#define RECORD_HEADER_SIZE ((uint32_t)sizeof(record_header_t))
+#define SECTOR_DATA_SIZE (FLASH_SECTOR_SIZE - SECTOR_HEADER_SIZE)
+#define INDEX_MASK (PICO_FLASH_KV_INDEX_SIZE - 1)
+
+static_assert(sizeof(record_header_t) == 16, "");
+
+static inline uint32_t record_size(uint key_len, uint value_len) {
+    return (RECORD_HEADER_SIZE + key_len + value_len + 3u) & ~3u;
+}
+
+static inline const uint8_t *flash_ptr(const flash_kv_t *kv, uint32_t offs) {
+#if PICO_NO_HARDWARE
+    return flash_host_get_contents() + kv->flash_offs + offs;
+#else
+    return (const uint8_t *)(XIP_BASE + kv->flash_offs + offs);
+#endif
+}
+
+static inline void read_record_header(const flash_kv_t *kv, uint32_t offs, record_header_t *h) {
+    memcpy(h, flash_ptr(kv, offs), sizeof(*h));
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+    static const uint32_t table[16] = {
+            0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+            0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0xfu] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0xfu] ^ (crc >> 4);
+    }
+    return crc;
+}
+
+static uint32_t record_crc(const record_header_t *h, const uint8_t *key, const uint8_t *value) {
+    uint32_t crc = crc32_update(0xffffffffu, (const uint8_t *)&h->seq, offsetof(record_header_t, crc) - offsetof(record_header_t, seq));
+    crc = crc32_update(crc, key, h->key_len);
+    return ~crc32_update(crc, value, h->value_len);
+}
+
+static uint32_t key_hash(const uint8_t *key, uint key_len) {
+    // FNV-1a
+    uint32_t hash = 0x811c9dc5u;
+    for (uint i = 0; i < key_len; i++) hash = (hash ^ key[i]) * 0x01000193u;
+    return hash;
+}
+
+// ----------------------------------------------------------------------------
+// flash access
+
+static void program_page(flash_kv_t *kv, uint32_t offs, const uint8_t *page) {
+    uint32_t save = save_and_disable_interrupts();
+    flash_range_program(kv->flash_offs + offs, page, FLASH_PAGE_SIZE);
+    restore_interrupts(save);
+    kv->stats.pages_programmed++;
+}
+
+// Program data made of several parts to consecutive (erased) flash, a page at a time. The rest of each page is left
+// erased, so the parts of a page not written here may be programmed later.
+static void program_parts(flash_kv_t *kv, uint32_t offs, const void *const *parts, const size_t *lens, uint count) {
+    uint8_t page[FLASH_PAGE_SIZE];
+    uint32_t page_offs = offs & ~(FLASH_PAGE_SIZE - 1);
+    memset(page, 0xff, sizeof(page));
+    for (uint i = 0; i < count; i++) {
+        const uint8_t *p = (const uint8_t *)parts[i];
+        size_t len = lens[i];
+        while (len) {
+            uint32_t o = offs - page_offs;
+            size_t n = MIN(len, FLASH_PAGE_SIZE - o);
+            memcpy(page + o, p, n);
+            offs += n;
+            p += n;
+            len -= n;
+            if (offs - page_offs == FLASH_PAGE_SIZE) {
+                program_page(kv, page_offs, page);
+                page_offs += FLASH_PAGE_SIZE;
+                memset(page, 0xff, sizeof(page));
+            }
+        }
+    }
+    if (offs != page_offs) program_page(kv, page_offs, page);
+}
+
+static void format_sector(flash_kv_t *kv, uint sector, uint32_t erase_count) {
+    sector_header_t header = {
+            .magic = SECTOR_MAGIC,
+            .erase_count = erase_count,
+            .erase_count_check = ~erase_count,
+            .reserved = 0xffffffffu,
+    };
+    const void *parts[] = {&header};
+    size_t lens[] = {sizeof(header)};
+    program_parts(kv, sector * FLASH_SECTOR_SIZE, parts, lens, 1);
+    kv->sector_end[sector] = SECTOR_HEADER_SIZE;
+    kv->sector_live[sector] = 0;
+    kv->sector_erase_count[sector] = erase_count;
+}
+
+static void erase_sector(flash_kv_t *kv, uint sector, uint32_t erase_count) {
+    uint32_t save = save_and_disable_interrupts();
+    flash_range_erase(kv->flash_offs + sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+    restore_interrupts(save);
+    kv->stats.sectors_erased++;
+    format_sector(kv, sector, erase_count);
+}
+
+// Append a record (with the given header, whose commit word is erased) to the active sector, returning its offset
+static uint32_t append_record(flash_kv_t *kv, const record_header_t *h, const void *key, const void *value) {
+    uint sector = (uint)kv->active_sector;
+    uint32_t offs = sector * FLASH_SECTOR_SIZE + kv->sector_end[sector];
+    const void *parts[] = {h, key, value};
+    size_t lens[] = {sizeof(*h), h->key_len, h->value_len};
+    program_parts(kv, offs, parts, lens, 3);
+    // the record only counts once this is programmed
+    uint32_t commit = RECORD_COMMITTED;
+    const void *commit_parts[] = {&commit};
+    size_t commit_lens[] = {sizeof(commit)};
+    program_parts(kv, offs, commit_parts, commit_lens, 1);
+    uint32_t size = record_size(h->key_len, h->value_len);
+    kv->sector_end[sector] = (uint16_t)(kv->sector_end[sector] + size);
+    kv->stats.bytes_appended += size;
+    return offs;
+}
+
+// ----------------------------------------------------------------------------
+// index
+
+static bool record_has_key(const flash_kv_t *kv, uint32_t offs, const uint8_t *key, uint key_len) {
+    const uint8_t *p = flash_ptr(kv, offs);
+    return p[offsetof(record_header_t, key_len)] == key_len && !memcmp(p + RECORD_HEADER_SIZE, key, key_len);
+}
+
+static int index_find(const flash_kv_t *kv, const uint8_t *key, uint key_len, uint32_t hash) {
+    for (uint i = hash & INDEX_MASK; kv->index[i].offset; i = (i + 1) & INDEX_MASK) {
+        if (kv->index[i].hash == hash && record_has_key(kv, kv->index[i].offset, key, key_len)) return (int)i;
+    }
+    return -1;
+}
+
+static void index_remove(flash_kv_t *kv, uint slot) {
+    // backward shift deletion, so that no entry is separated from its home slot by a free one
+    uint i = slot;
+    for (uint j = (i + 1) & INDEX_MASK; kv->index[j].offset; j = (j + 1) & INDEX_MASK) {
+        uint home = kv->index[j].hash & INDEX_MASK;
+        // can the entry at j move back to i, i.e. is its home not cyclically in (i, j]?
+        if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+            kv->index[i] = kv->index[j];
+            i = j;
+        }
+    }
+    kv->index[i].offset = 0;
+    kv->index_used--;
+}
+
+static bool is_tombstone(const flash_kv_t *kv, uint32_t offs) {
+    return flash_ptr(kv, offs)[offsetof(record_header_t, flags)] == RECORD_FLAGS_TOMBSTONE;
+}
+
+// Make the index refer to the record at offs if it is newer than the one it has for the key. Returns false if the
+// index is full
+static bool index_apply(flash_kv_t *kv, uint32_t offs, const record_header_t *h, const uint8_t *key) {
+    uint32_t hash = key_hash(key, h->key_len);
+    int slot = index_find(kv, key, h->key_len, hash);
+    bool tombstone = h->flags == RECORD_FLAGS_TOMBSTONE;
+    if (slot >= 0) {
+        uint32_t old_offs = kv->index[slot].offset;
+        record_header_t old;
+        read_record_header(kv, old_offs, &old);
+        // an older record, or a copy made by an interrupted garbage collection
+        if (h->seq <= old.seq) return true;
+        kv->sector_live[old_offs / FLASH_SECTOR_SIZE] -= (uint16_t)record_size(old.key_len, old.value_len);
+        if (old.flags == RECORD_FLAGS_TOMBSTONE) kv->count++;
+    } else {
+        if (kv->index_used + 1u >= PICO_FLASH_KV_INDEX_SIZE) return false;
+        slot = (int)(hash & INDEX_MASK);
+        while (kv->index[slot].offset) slot = (slot + 1) & INDEX_MASK;
+        kv->index[slot].hash = hash;
+        kv->index_used++;
+        kv->count++;
+    }
+    if (tombstone) kv->count--;
+    kv->index[slot].offset = offs;
+    kv->sector_live[offs / FLASH_SECTOR_SIZE] += (uint16_t)record_size(h->key_len, h->value_len);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// garbage collection
+
+// Check a record found while scanning a sector (whose records end before limit), returning its size, or 0 if there is
+// no (valid, committed) record
+static uint32_t check_record(const flash_kv_t *kv, uint32_t offs, uint32_t limit, record_header_t *h) {
+    if (limit - offs < RECORD_HEADER_SIZE) return 0;
+    read_record_header(kv, offs, h);
+    if (h->commit != RECORD_COMMITTED || !h->key_len) return 0;
+    if (h->flags != RECORD_FLAGS_VALUE && h->flags != RECORD_FLAGS_TOMBSTONE) return 0;
+    uint32_t size = record_size(h->key_len, h->value_len);
+    if (size > limit - offs) return 0;
+    const uint8_t *key = flash_ptr(kv, offs + RECORD_HEADER_SIZE);
+    if (record_crc(h, key, key + h->key_len) != h->crc) return 0;
+    return size;
+}
+
+// Is there a record for the key (with the given sequence number, or any if seq is 0) in any sector but the given one?
+static bool key_in_other_sectors(const flash_kv_t *kv, uint exclude_sector, const uint8_t *key, uint key_len,
+                                 uint32_t seq) {
+    for (uint s = 0; s < kv->sector_count; s++) {
+        if (s == exclude_sector) continue;
+        uint32_t base = s * FLASH_SECTOR_SIZE;
+        record_header_t h;
+        uint32_t size;
+        for (uint32_t offs = base + SECTOR_HEADER_SIZE;
+             (size = check_record(kv, offs, base + kv->sector_end[s], &h)); offs += size) {
+            if ((!seq || h.seq == seq) && record_has_key(kv, offs, key, key_len)) return true;
+        }
+    }
+    return false;
+}
+
+static bool is_free(const flash_kv_t *kv, uint sector) {
+    return kv->sector_end[sector] == SECTOR_HEADER_SIZE && (int)sector != kv->active_sector;
+}
+
+static int pick_free_sector(const flash_kv_t *kv, uint *free_count) {
+    int best = -1;
+    *free_count = 0;
+    for (uint s = 0; s < kv->sector_count; s++) {
+        if (!is_free(kv, s)) continue;
+        (*free_count)++;
+        if (best < 0 || kv->sector_erase_count[s] < kv->sector_erase_count[best]) best = (int)s;
+    }
+    return best;
+}
+
+static int pick_victim(const flash_kv_t *kv, bool wear_level) {
+    int best = -1;
+    uint32_t max_erase_count = 0;
+    for (uint s = 0; s < kv->sector_count; s++) {
+        max_erase_count = MAX(max_erase_count, kv->sector_erase_count[s]);
+        if (is_free(kv, s) || (int)s == kv->active_sector) continue;
+        if (best < 0 ||
+            (wear_level ? kv->sector_erase_count[s] < kv->sector_erase_count[best]
+                        : kv->sector_live[s] < kv->sector_live[best])) {
+            best = (int)s;
+        }
+    }
+    if (wear_level && best >= 0 && max_erase_count - kv->sector_erase_count[best] < PICO_FLASH_KV_WEAR_LEVEL_THRESHOLD) {
+        return -1;
+    }
+    return best;
+}
+
+// Copy the live records of the victim to the spare sector (which becomes the active one), then erase the victim
+static void collect_sector(flash_kv_t *kv, uint victim, uint spare) {
+    kv->active_sector = (int8_t)spare;
+    uint32_t base = victim * FLASH_SECTOR_SIZE;
+    record_header_t h;
+    uint32_t size;
+    for (uint32_t offs = base + SECTOR_HEADER_SIZE;
+         (size = check_record(kv, offs, base + kv->sector_end[victim], &h)); offs += size) {
+        const uint8_t *key = flash_ptr(kv, offs + RECORD_HEADER_SIZE);
+        int slot = index_find(kv, key, h.key_len, key_hash(key, h.key_len));
+        if (slot < 0 || kv->index[slot].offset != offs) continue;
+        // a tombstone is only needed while there are older records for the key
+        if (h.flags == RECORD_FLAGS_TOMBSTONE && !key_in_other_sectors(kv, victim, key, h.key_len, 0)) {
+            index_remove(kv, (uint)slot);
+            continue;
+        }
+        // the copy keeps the sequence number, so it is equivalent to the original
+        h.commit = 0xffffffffu;
+        kv->index[slot].offset = append_record(kv, &h, key, key + h.key_len);
+        kv->sector_live[spare] += (uint16_t)size;
+        kv->stats.records_copied++;
+    }
+    erase_sector(kv, victim, kv->sector_erase_count[victim] + 1);
+    kv->stats.gc_count++;
+}
+
+// Make sure the active sector has space for a record of the given size
+static int make_space(flash_kv_t *kv, uint32_t size) {
+    bool wear_levelled = false;
+    for (uint attempt = 0; attempt <= kv->sector_count; attempt++) {
+        if (kv->active_sector >= 0 && FLASH_SECTOR_SIZE - kv->sector_end[kv->active_sector] >= size) return PICO_OK;
+        uint free_count;
+        int spare = pick_free_sector(kv, &free_count);
+        if (spare < 0) break;
+        if (free_count > 1) {
+            kv->active_sector = (int8_t)spare;
+            continue;
+        }
+        // only the spare is left; the active sector (if any) is now just another candidate for collection
+        kv->active_sector = -1;
+        int victim = -1;
+        if (!wear_levelled) {
+            wear_levelled = true;
+            victim = pick_victim(kv, true);
+        }
+        if (victim < 0) {
+            victim = pick_victim(kv, false);
+            // collecting a sector leaves the space it doesn't need for its live records
+            if (victim < 0 || SECTOR_DATA_SIZE - kv->sector_live[victim] < size) break;
+        }
+        collect_sector(kv, (uint)victim, (uint)spare);
+    }
+    return PICO_ERROR_INSUFFICIENT_RESOURCES;
+}
+
+// ----------------------------------------------------------------------------
+// public API
+
+static bool is_erased(const uint8_t *p, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        if (p[i] != 0xff) return false;
+    }
+    return true;
+}
+
+// Could the sector be erased without losing anything? This is the case for both the victim and the spare of a garbage
+// collection which was interrupted after it started copying: each live record of the sector either has a copy (with
+// the same sequence number) in another sector, or is a tombstone which the collection drops
+static bool is_redundant(const flash_kv_t *kv, uint sector) {
+    uint32_t base = sector * FLASH_SECTOR_SIZE;
+    record_header_t h;
+    uint32_t size;
+    for (uint32_t offs = base + SECTOR_HEADER_SIZE;
+         (size = check_record(kv, offs, base + kv->sector_end[sector], &h)); offs += size) {
+        const uint8_t *key = flash_ptr(kv, offs + RECORD_HEADER_SIZE);
+        int slot = index_find(kv, key, h.key_len, key_hash(key, h.key_len));
+        if (slot < 0 || kv->index[slot].offset != offs) continue;
+        bool dropped = h.flags == RECORD_FLAGS_TOMBSTONE && !key_in_other_sectors(kv, sector, key, h.key_len, 0);
+        if (!dropped && !key_in_other_sectors(kv, sector, key, h.key_len, h.seq)) return false;
+    }
+    return true;
+}
+
+// Build the index and the state of the sectors from the flash, erasing any sectors which need it
+static int load(flash_kv_t *kv) {
+    uint sector_count = kv->sector_count;
+    memset(kv->index, 0, sizeof(kv->index));
+    kv->index_used = 0;
+    kv->count = 0;
+    kv->active_sector = -1;
+    int rc = PICO_OK;
+    uint32_t max_seq = 0;
+    uint32_t sector_max_seq[PICO_FLASH_KV_MAX_SECTORS] = {0};
+    bool sector_clean[PICO_FLASH_KV_MAX_SECTORS];
+    for (uint s = 0; s < sector_count; s++) {
+        uint32_t base = s * FLASH_SECTOR_SIZE;
+        kv->sector_live[s] = 0;
+        sector_header_t header;
+        memcpy(&header, flash_ptr(kv, base), sizeof(header));
+        if (header.magic != SECTOR_MAGIC || header.erase_count != ~header.erase_count_check) {
+            // not a sector of the store (or one whose erase was interrupted); marked for erasing unless it is blank
+            kv->sector_end[s] = 0;
+            kv->sector_erase_count[s] = 0;
+            sector_clean[s] = is_erased(flash_ptr(kv, base), FLASH_SECTOR_SIZE);
+            continue;
+        }
+        kv->sector_erase_count[s] = header.erase_count;
+        record_header_t h;
+        uint32_t offs = base + SECTOR_HEADER_SIZE;
+        uint32_t size;
+        while ((size = check_record(kv, offs, base + FLASH_SECTOR_SIZE, &h))) {
+            if (!index_apply(kv, offs, &h, flash_ptr(kv, offs + RECORD_HEADER_SIZE))) rc = PICO_ERROR_INSUFFICIENT_RESOURCES;
+            sector_max_seq[s] = MAX(sector_max_seq[s], h.seq);
+            offs += size;
+        }
+        max_seq = MAX(max_seq, sector_max_seq[s]);
+        kv->sector_end[s] = (uint16_t)(offs - base);
+        // anything after the records (e.g. an interrupted append) means no more can be appended to the sector
+        sector_clean[s] = is_erased(flash_ptr(kv, offs), base + FLASH_SECTOR_SIZE - offs);
+    }
+    kv->next_seq = max_seq + 1;
+    for (uint s = 0; s < sector_count; s++) {
+        if (!kv->sector_end[s]) {
+            if (sector_clean[s]) {
+                format_sector(kv, s, 0);
+            } else {
+                erase_sector(kv, s, 0);
+            }
+        } else if (kv->sector_end[s] == SECTOR_HEADER_SIZE && !sector_clean[s]) {
+            erase_sector(kv, s, kv->sector_erase_count[s] + 1);
+        } else if (sector_clean[s] && sector_max_seq[s] &&
+                   (kv->active_sector < 0 || sector_max_seq[s] > sector_max_seq[kv->active_sector])) {
+            // carry on appending to the sector with the most recent records
+            kv->active_sector = (int8_t)s;
+        }
+    }
+    return rc;
+}
+
+int flash_kv_init(flash_kv_t *kv, uint32_t flash_offs, uint sector_count) {
+    if ((flash_offs & (FLASH_SECTOR_SIZE - 1)) || sector_count < 2 || sector_count > PICO_FLASH_KV_MAX_SECTORS ||
+        flash_offs + sector_count * FLASH_SECTOR_SIZE > PICO_FLASH_SIZE_BYTES) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    memset(kv, 0, sizeof(*kv));
+    kv->flash_offs = flash_offs;
+    kv->sector_count = (uint8_t)sector_count;
+    int rc = load(kv);
+    // there is always a spare sector, except after a garbage collection was interrupted between copying the records
+    // and erasing the victim; erasing either sector undoes or completes the collection
+    uint free_count;
+    pick_free_sector(kv, &free_count);
+    for (uint s = 0; s < sector_count && !free_count; s++) {
+        if (is_redundant(kv, s)) {
+            erase_sector(kv, s, kv->sector_erase_count[s] + 1);
+            // the index may refer to records in the erased sector rather than their copies
+            rc = load(kv);
+            break;
+        }
+    }
+    return rc;
+}
+
+static int write_record(flash_kv_t *kv, const char *key, const void *value, size_t value_len, bool tombstone) {
+    size_t key_len = strlen(key);
+    if (!key_len || key_len > PICO_FLASH_KV_MAX_KEY_SIZE || value_len > PICO_FLASH_KV_MAX_VALUE_SIZE) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    const uint8_t *k = (const uint8_t *)key;
+    int slot = index_find(kv, k, (uint)key_len, key_hash(k, (uint)key_len));
+    if (tombstone) {
+        if (slot < 0 || is_tombstone(kv, kv->index[slot].offset)) return PICO_ERROR_NO_DATA;
+    } else if (slot >= 0) {
+        // skip rewriting an unchanged value
+        record_header_t old;
+        uint32_t offs = kv->index[slot].offset;
+        read_record_header(kv, offs, &old);
+        if (old.flags == RECORD_FLAGS_VALUE && old.value_len == value_len &&
+            (!value_len || !memcmp(flash_ptr(kv, offs + RECORD_HEADER_SIZE + key_len), value, value_len))) {
+            return PICO_OK;
+        }
+    } else if (kv->index_used + 1u >= PICO_FLASH_KV_INDEX_SIZE) {
+        return PICO_ERROR_INSUFFICIENT_RESOURCES;
+    }
+    int rc = make_space(kv, record_size((uint)key_len, (uint)value_len));
+    if (rc) return rc;
+    record_header_t h = {
+            .commit = 0xffffffffu,
+            .seq = kv->next_seq++,
+            .key_len = (uint8_t)key_len,
+            .flags = tombstone ? RECORD_FLAGS_TOMBSTONE : RECORD_FLAGS_VALUE,
+            .value_len = (uint16_t)value_len,
+    };
+    h.crc = record_crc(&h, k, (const uint8_t *)value);
+    uint32_t offs = append_record(kv, &h, k, value);
+    // garbage collection may have dropped the key's tombstone, but there is always room in the index for the key
+    __unused bool ok = index_apply(kv, offs, &h, k);
+    hard_assert(ok);
+    if (!tombstone) kv->stats.user_bytes_written += (uint32_t)(key_len + value_len);
+    return PICO_OK;
+}
+
+int flash_kv_set(flash_kv_t *kv, const char *key, const void *value, size_t len) {
+    return write_record(kv, key, value, len, false);
+}
+
+int flash_kv_delete(flash_kv_t *kv, const char *key) {
+    return write_record(kv, key, NULL, 0, true);
+}
+
+const void *flash_kv_get_ptr(flash_kv_t *kv, const char *key, size_t *len) {
+    size_t key_len = strlen(key);
+    const uint8_t *k = (const uint8_t *)key;
+    int slot = index_find(kv, k, (uint)key_len, key_hash(k, (uint)key_len));
+    if (slot < 0) return NULL;
+    record_header_t h;
+    uint32_t offs = kv->index[slot].offset;
+    read_record_header(kv, offs, &h);
+    if (h.flags == RECORD_FLAGS_TOMBSTONE) return NULL;
+    *len = h.value_len;
+    return flash_ptr(kv, offs + RECORD_HEADER_SIZE + h.key_len);
+}
+
+int flash_kv_get(flash_kv_t *kv, const char *key, void *value, size_t max_len) {
+    size_t len;
+    const void *p = flash_kv_get_ptr(kv, key, &len);
+    if (!p) return PICO_ERROR_NO_DATA;
+    memcpy(value, p, MIN(len, max_len));
+    return (int)len;
+}
+
+void flash_kv_get_stats(const flash_kv_t *kv, flash_kv_stats_t *stats) {
+    *stats = kv->stats;
+    stats->min_erase_count = 0xffffffffu;
+    stats->max_erase_count = 0;
+    for (uint s = 0; s < kv->sector_count; s++) {
+        stats->min_erase_count = MIN(stats->min_erase_count, kv->sector_erase_count[s]);
+        stats->max_erase_count = MAX(stats->max_erase_count, kv->sector_erase_count[s]);
+    }
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_FLASH_KV_H
+#define _PICO_FLASH_KV_H
+
+#include "pico.h"
+#include "hardware/flash.h"
+
+/** \file flash_kv.h
+ *  \defgroup pico_flash_kv pico_flash_kv
+ *
+ * Log structured, wear levelled key value store in flash
+ *
+ * The store occupies a range of whole flash sectors. Each \ref flash_kv_set or \ref flash_kv_delete appends a record
+ * (holding the key, the value and a sequence number) to the erased space of the current sector, so a small update
+ * costs a couple of page programs rather than the read-modify-write or erase of a whole page or sector. The most
+ * recent record for each key is found through a hash index held in RAM, built when the store is initialized, so
+ * lookups don't search the flash.
+ *
+ * When the space runs out, the sector holding the least live data is garbage collected: its live records are copied
+ * to the spare sector, which is always kept erased for the purpose, and it is then erased to become the new spare.
+ * Sectors are used in order of their erase counts (stored in their headers), and if the erase counts of the sectors
+ * drift more than PICO_FLASH_KV_WEAR_LEVEL_THRESHOLD apart, the least erased sector is collected instead to move its
+ * (presumably cold) data, so the wear is spread over all the sectors.
+ *
+ * Updates are power-fail safe: a record only counts once its commit word has been programmed (after the rest of the
+ * record), and records are checked with a CRC32. Following a power failure during an update, \ref flash_kv_init finds
+ * either the old or the new value. As records are ordered by their sequence numbers rather than their positions,
+ * an interrupted garbage collection at worst leaves duplicate copies of records in the victim and the spare sector;
+ * \ref flash_kv_init then erases one of the two, so there is a spare sector again.
+ *
+ * The flash functions are called with interrupts disabled; as with \ref hardware_flash, the other core must not be
+ * executing from flash at the time (see \ref multicore_lockout). Values are read from flash through the XIP window, so
+ * \ref flash_kv_get_ptr can return a pointer to a value without copying it.
+ *
+ * On the host the flash is emulated by hardware_flash, which counts the sector erases, can be backed by a file and can
+ * simulate power failures.
+ *
+ * \note The functions are not thread safe; the caller must serialize access to a store.
+ */
+
+// PICO_CONFIG: PARAM_ASSERTIONS_ENABLED_FLASH_KV, Enable/disable assertions in the pico_flash_kv module, type=bool, default=0, group=pico_flash_kv
+#ifndef PARAM_ASSERTIONS_ENABLED_FLASH_KV
+#define PARAM_ASSERTIONS_ENABLED_FLASH_KV 0
+#endif
+
+// PICO_CONFIG: PICO_FLASH_KV_MAX_SECTORS, Maximum number of flash sectors used by a key value store, min=2, max=255, default=16, group=pico_flash_kv
+#ifndef PICO_FLASH_KV_MAX_SECTORS
+#define PICO_FLASH_KV_MAX_SECTORS 16
+#endif
+
+// PICO_CONFIG: PICO_FLASH_KV_INDEX_SIZE, Number of entries in the RAM index of a key value store which must be a power of two; the number of keys (including recently deleted ones) must be less than this, min=4, default=128, group=pico_flash_kv
+#ifndef PICO_FLASH_KV_INDEX_SIZE
+#define PICO_FLASH_KV_INDEX_SIZE 128
+#endif
+
+// PICO_CONFIG: PICO_FLASH_KV_MAX_VALUE_SIZE, Maximum size in bytes of a value in a key value store, max=3800, default=1024, group=pico_flash_kv
+#ifndef PICO_FLASH_KV_MAX_VALUE_SIZE
+#define PICO_FLASH_KV_MAX_VALUE_SIZE 1024
+#endif
+
+// PICO_CONFIG: PICO_FLASH_KV_MAX_KEY_SIZE, Maximum length of a key in a key value store, min=1, max=255, default=32, group=pico_flash_kv
+#ifndef PICO_FLASH_KV_MAX_KEY_SIZE
+#define PICO_FLASH_KV_MAX_KEY_SIZE 32
+#endif
+
+// PICO_CONFIG: PICO_FLASH_KV_WEAR_LEVEL_THRESHOLD, Difference between the highest and lowest sector erase counts of a key value store at which cold data is moved, min=1, default=16, group=pico_flash_kv
+#ifndef PICO_FLASH_KV_WEAR_LEVEL_THRESHOLD
+#define PICO_FLASH_KV_WEAR_LEVEL_THRESHOLD 16
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief Statistics of a key value store
+ *  \ingroup pico_flash_kv
+ */
+typedef struct flash_kv_stats {
+    uint32_t user_bytes_written;  ///< key and value bytes passed to \ref flash_kv_set
+    uint32_t bytes_appended;      ///< bytes of records appended, including those copied by garbage collection
+    uint32_t pages_programmed;    ///< flash pages programmed
+    uint32_t sectors_erased;      ///< flash sectors erased
+    uint32_t gc_count;            ///< sectors garbage collected
+    uint32_t records_copied;      ///< live records copied by garbage collection
+    uint32_t min_erase_count;     ///< the lowest erase count of any sector of the store
+    uint32_t max_erase_count;     ///< the highest erase count of any sector of the store
+} flash_kv_stats_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t offset;    // of the latest record for the key, relative to the start of the store; 0 if the entry is free
+} flash_kv_index_entry_t;
+
+/*! \brief A key value store
+ *  \ingroup pico_flash_kv
+ *
+ * The members are private
+ */
+typedef struct flash_kv {
+    uint32_t flash_offs;
+    uint32_t next_seq;
+    uint16_t count;
+    uint16_t index_used;            // including deleted keys whose tombstones are still needed
+    uint8_t sector_count;
+    int8_t active_sector;           // the sector records are appended to, or -1
+    uint16_t sector_end[PICO_FLASH_KV_MAX_SECTORS];     // offset of the free space in each sector
+    uint16_t sector_live[PICO_FLASH_KV_MAX_SECTORS];    // bytes of live records in each sector
+    uint32_t sector_erase_count[PICO_FLASH_KV_MAX_SECTORS];
+    flash_kv_index_entry_t index[PICO_FLASH_KV_INDEX_SIZE];
+    flash_kv_stats_t stats;
+} flash_kv_t;
+
+/*! \brief Initialize a key value store, loading the existing contents of its flash
+ *  \ingroup pico_flash_kv
+ *
+ * Any sector of the range which does not hold a valid store sector (e.g. on first use) is erased, as is one of the
+ * two sectors left holding copies of the same records by an interrupted garbage collection.
+ *
+ * \param kv The store
+ * \param flash_offs Offset into flash of the first sector. Must be a multiple of FLASH_SECTOR_SIZE
+ * \param sector_count Number of sectors, from 2 to PICO_FLASH_KV_MAX_SECTORS. One is kept as a spare
+ * \return PICO_OK, PICO_ERROR_INVALID_ARG if the range is invalid, or PICO_ERROR_INSUFFICIENT_RESOURCES if the store
+ *         holds more keys than fit in the index
+ */
+int flash_kv_init(flash_kv_t *kv, uint32_t flash_offs, uint sector_count);
+
+/*! \brief Set the value of a key
+ *  \ingroup pico_flash_kv
+ *
+ * \param kv The store
+ * \param key The key, a nul terminated string of 1 to PICO_FLASH_KV_MAX_KEY_SIZE characters
+ * \param value The value
+ * \param len The length of the value, up to PICO_FLASH_KV_MAX_VALUE_SIZE bytes
+ * \return PICO_OK, PICO_ERROR_INVALID_ARG, or PICO_ERROR_INSUFFICIENT_RESOURCES if the store or its index is full
+ */
+int flash_kv_set(flash_kv_t *kv, const char *key, const void *value, size_t len);
+
+/*! \brief Get the value of a key
+ *  \ingroup pico_flash_kv
+ *
+ * \param kv The store
+ * \param key The key
+ * \param value Buffer for the value
+ * \param max_len The size of the buffer; a longer value is truncated
+ * \return The length of the value (which may be more than max_len), or PICO_ERROR_NO_DATA if the key is not set
+ */
+int flash_kv_get(flash_kv_t *kv, const char *key, void *value, size_t max_len);
+
+/*! \brief Get a pointer to the value of a key in flash
+ *  \ingroup pico_flash_kv
+ *
+ * \param kv The store
+ * \param key The key
+ * \param len Receives the length of the value
+ * \return The value, which remains valid until the next call to \ref flash_kv_set or \ref flash_kv_delete, or NULL if
+ *         the key is not set
+ */
+const void *flash_kv_get_ptr(flash_kv_t *kv, const char *key, size_t *len);
+
+/*! \brief Delete a key
+ *  \ingroup pico_flash_kv
+ *
+ * \param kv The store
+ * \param key The key
+ * \return PICO_OK, PICO_ERROR_NO_DATA if the key is not set, or PICO_ERROR_INSUFFICIENT_RESOURCES if the store is full
+ */
+int flash_kv_delete(flash_kv_t *kv, const char *key);
+
+/*! \brief Get the number of keys set
+ *  \ingroup pico_flash_kv
+ */
+static inline uint flash_kv_count(const flash_kv_t *kv) {
+    return kv->count;
+}
+
+/*! \brief Get the statistics of a key value store
+ *  \ingroup pico_flash_kv
+ *
+ * \param kv The store
+ * \param stats Receives the statistics (counted since \ref flash_kv_init; the erase counts are those stored in flash)
+ */
+void flash_kv_get_stats(const flash_kv_t *kv, flash_kv_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
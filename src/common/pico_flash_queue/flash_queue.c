@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "pico/flash_queue.h"
+#include "pico/time.h"
+#include "hardware/sync.h"
+#if LIB_PICO_MULTICORE && !PICO_NO_HARDWARE
+#include "pico/multicore.h"
+#endif
+
+#define NUM_SECTORS (PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE)
+
+static inline const uint8_t *flash_ptr(uint32_t flash_offs) {
+#if PICO_NO_HARDWARE
+    return flash_host_get_contents() + flash_offs;
+#else
+    return (const uint8_t *)(XIP_BASE + flash_offs);
+#endif
+}
+
+static inline bool is_erase_pending(const flash_queue_t *q, uint sector) {
+    return q->erase_pending[sector / 32] & (1u << (sector % 32));
+}
+
+static bool range_valid(uint32_t flash_offs, size_t count) {
+    return flash_offs <= PICO_FLASH_SIZE_BYTES && count <= PICO_FLASH_SIZE_BYTES - flash_offs;
+}
+
+// Index of the first pending page at or after the given offset
+static uint find_page(const flash_queue_t *q, uint32_t page_offs) {
+    uint lo = 0, hi = q->page_count;
+    while (lo < hi) {
+        uint mid = (lo + hi) / 2;
+        if (q->page_offset[mid] < page_offs) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void remove_pages(flash_queue_t *q, uint first, uint count) {
+    uint rest = q->page_count - first - count;
+    memmove(&q->page_offset[first], &q->page_offset[first + count], rest * sizeof(q->page_offset[0]));
+    memmove(q->page_data[first], q->page_data[first + count], rest * FLASH_PAGE_SIZE);
+    q->page_count -= count;
+}
+
+void flash_queue_init(flash_queue_t *q, const flash_queue_config_t *config) {
+    memset(q, 0, sizeof(*q));
+    q->config = config ? *config : flash_queue_get_default_config();
+}
+
+int flash_queue_write(flash_queue_t *q, uint32_t flash_offs, const void *data, size_t count) {
+    if (!range_valid(flash_offs, count)) return PICO_ERROR_INVALID_ARG;
+    if (!count) return PICO_OK;
+    uint32_t first_page = flash_offs & ~(FLASH_PAGE_SIZE - 1);
+    uint32_t end_page = (uint32_t)(flash_offs + count + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1);
+    // check there are buffers for all the pages not already pending before changing anything
+    uint needed = 0;
+    uint i = find_page(q, first_page);
+    for (uint32_t page = first_page; page < end_page; page += FLASH_PAGE_SIZE) {
+        if (i < q->page_count && q->page_offset[i] == page) {
+            i++;
+        } else {
+            needed++;
+        }
+    }
+    if (q->page_count + needed > PICO_FLASH_QUEUE_MAX_PAGES) return PICO_ERROR_INSUFFICIENT_RESOURCES;
+    const uint8_t *src = (const uint8_t *)data;
+    i = find_page(q, first_page);
+    for (uint32_t page = first_page; page < end_page; page += FLASH_PAGE_SIZE, i++) {
+        if (i == q->page_count || q->page_offset[i] != page) {
+            // insert a new (erased) buffer, keeping the pages in order
+            uint rest = q->page_count - i;
+            memmove(&q->page_offset[i + 1], &q->page_offset[i], rest * sizeof(q->page_offset[0]));
+            memmove(q->page_data[i + 1], q->page_data[i], rest * FLASH_PAGE_SIZE);
+            q->page_offset[i] = page;
+            memset(q->page_data[i], 0xff, FLASH_PAGE_SIZE);
+            q->page_count++;
+        }
+        uint32_t start = MAX(page, flash_offs);
+        uint32_t end = MIN(page + FLASH_PAGE_SIZE, (uint32_t)(flash_offs + count));
+        // as in the flash itself, programming the same byte twice can only clear bits
+        uint8_t *dst = q->page_data[i] + (start - page);
+        for (uint32_t j = start; j < end; j++) *dst++ &= src[j - flash_offs];
+    }
+    q->stats.writes++;
+    q->stats.pages_requested += (end_page - first_page) / FLASH_PAGE_SIZE;
+    return PICO_OK;
+}
+
+int flash_queue_erase(flash_queue_t *q, uint32_t flash_offs, size_t count) {
+    if ((flash_offs & (FLASH_SECTOR_SIZE - 1)) || (count & (FLASH_SECTOR_SIZE - 1)) || !range_valid(flash_offs, count)) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    if (!count) return PICO_OK;
+    for (uint sector = flash_offs / FLASH_SECTOR_SIZE; sector < (flash_offs + count) / FLASH_SECTOR_SIZE; sector++) {
+        if (!is_erase_pending(q, sector)) {
+            q->erase_pending[sector / 32] |= 1u << (sector % 32);
+            q->erase_count++;
+        }
+    }
+    // the erase makes any data queued for these sectors irrelevant
+    uint first = find_page(q, flash_offs);
+    uint end = find_page(q, (uint32_t)(flash_offs + count));
+    remove_pages(q, first, end - first);
+    q->stats.erases++;
+    q->stats.sectors_requested += count / FLASH_SECTOR_SIZE;
+    return PICO_OK;
+}
+
+// Run a slice, returning its duration
+static uint32_t run_slice(flash_queue_t *q, uint32_t flash_offs, const uint8_t *data, size_t count) {
+#if LIB_PICO_MULTICORE && !PICO_NO_HARDWARE
+    if (q->config.multicore_lockout) multicore_lockout_start_blocking();
+#endif
+    uint32_t save = save_and_disable_interrupts();
+    uint64_t t0 = time_us_64();
+    if (data) {
+        flash_range_program(flash_offs, data, count);
+    } else {
+        flash_range_erase(flash_offs, count);
+    }
+    uint32_t us = (uint32_t)(time_us_64() - t0);
+    restore_interrupts(save);
+#if LIB_PICO_MULTICORE && !PICO_NO_HARDWARE
+    if (q->config.multicore_lockout) multicore_lockout_end_blocking();
+#endif
+    q->stats.slices++;
+    q->stats.max_blackout_us = MAX(q->stats.max_blackout_us, us);
+    return us;
+}
+
+static uint first_pending_sector(const flash_queue_t *q) {
+    uint word = 0;
+    while (!q->erase_pending[word]) word++;
+    return word * 32 + (uint)__builtin_ctz(q->erase_pending[word]);
+}
+
+bool flash_queue_run(flash_queue_t *q, uint32_t budget_us) {
+    const flash_queue_config_t *c = &q->config;
+    uint64_t start = time_us_64();
+    while (!flash_queue_is_empty(q)) {
+        uint64_t elapsed = time_us_64() - start;
+        uint64_t remaining = budget_us > elapsed ? budget_us - elapsed : 0;
+        if (q->erase_count) {
+            // erases first, as the pending pages of erased sectors were all queued after their erase
+            uint first = first_pending_sector(q);
+            uint n = 1;
+            while (first + n < NUM_SECTORS && is_erase_pending(q, first + n) &&
+                   c->call_us + (n + 1) * c->sector_erase_us <= c->max_slice_us) {
+                n++;
+            }
+            if (c->call_us + n * c->sector_erase_us > remaining) break;
+            q->stats.erase_us += run_slice(q, first * FLASH_SECTOR_SIZE, NULL, n * FLASH_SECTOR_SIZE);
+            for (uint s = first; s < first + n; s++) q->erase_pending[s / 32] &= ~(1u << (s % 32));
+            q->erase_count -= n;
+            q->stats.sectors_erased += n;
+            q->erase_calls++;
+        } else {
+            uint n = 1;
+            while (n < q->page_count && q->page_offset[n] == q->page_offset[0] + n * FLASH_PAGE_SIZE &&
+                   c->call_us + (n + 1) * c->page_program_us <= c->max_slice_us) {
+                n++;
+            }
+            if (c->call_us + n * c->page_program_us > remaining) break;
+            q->stats.program_us += run_slice(q, q->page_offset[0], q->page_data[0], n * FLASH_PAGE_SIZE);
+            remove_pages(q, 0, n);
+            q->stats.pages_programmed += n;
+            q->program_calls++;
+        }
+    }
+    return flash_queue_is_empty(q);
+}
+
+void flash_queue_flush(flash_queue_t *q) {
+    while (!flash_queue_run(q, UINT32_MAX)) {
+        tight_loop_contents();
+    }
+}
+
+void flash_queue_read(const flash_queue_t *q, uint32_t flash_offs, void *data, size_t count) {
+    invalid_params_if(FLASH, !range_valid(flash_offs, count));
+    uint8_t *dst = (uint8_t *)data;
+    uint i = find_page(q, flash_offs & ~(FLASH_PAGE_SIZE - 1));
+    for (uint32_t offs = flash_offs; offs < flash_offs + count; offs++) {
+        uint8_t b = is_erase_pending(q, offs / FLASH_SECTOR_SIZE) ? 0xff : *flash_ptr(offs);
+        uint32_t page = offs & ~(FLASH_PAGE_SIZE - 1);
+        while (i < q->page_count && q->page_offset[i] < page) i++;
+        // programming can only clear bits
+        if (i < q->page_count && q->page_offset[i] == page) b &= q->page_data[i][offs - page];
+        *dst++ = b;
+    }
+}
+
+void flash_queue_get_stats(const flash_queue_t *q, flash_queue_stats_t *stats) {
+    *stats = q->stats;
+    const flash_queue_config_t *c = &q->config;
+    // average times for a page or sector (without the call overhead), measured if possible
+    uint64_t page_us = c->page_program_us;
+    if (q->stats.pages_programmed) {
+        uint64_t overhead = (uint64_t)q->program_calls * c->call_us;
+        page_us = q->stats.program_us > overhead ? (q->stats.program_us - overhead) / q->stats.pages_programmed : 0;
+    }
+    uint64_t sector_us = c->sector_erase_us;
+    if (q->stats.sectors_erased) {
+        uint64_t overhead = (uint64_t)q->erase_calls * c->call_us;
+        sector_us = q->stats.erase_us > overhead ? (q->stats.erase_us - overhead) / q->stats.sectors_erased : 0;
+    }
+    uint64_t unqueued = (uint64_t)(q->stats.writes + q->stats.erases) * c->call_us +
+                        q->stats.pages_requested * page_us + q->stats.sectors_requested * sector_us;
+    uint64_t actual = q->stats.program_us + q->stats.erase_us;
+    stats->blackout_us_saved = unqueued > actual ? unqueued - actual : 0;
+}
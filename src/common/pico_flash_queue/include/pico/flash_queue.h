@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_FLASH_QUEUE_H
+#define _PICO_FLASH_QUEUE_H
+
+#include "pico.h"
+#include "hardware/flash.h"
+
+/** \file flash_queue.h
+ *  \defgroup pico_flash_queue pico_flash_queue
+ *
+ * Write coalescing flash programming queue
+ *
+ * Flash can only be programmed or erased with XIP disabled, so each \ref flash_range_program or
+ * \ref flash_range_erase call is a window in which interrupts must be disabled (and the other core kept out of flash).
+ * Issuing many small writes as they happen leads to many such windows, each paying the cost of leaving and
+ * re-entering XIP mode, and programming the same page several times.
+ *
+ * A flash queue instead holds pending writes in RAM, a page buffer per flash page written: writes to the same page
+ * (adjacent or overlapping) are merged into its buffer, overlapping bytes being combined just as the flash would if
+ * they were programmed separately (programming can only clear bits).
+ * Pending erases are held as a set of sectors, and an erase discards any data queued earlier for the erased sectors.
+ *
+ * The queued operations are carried out when the application chooses, by \ref flash_queue_run (e.g. from the
+ * main loop when there is time to spare) or \ref flash_queue_flush. They are executed in slices, each a single call
+ * with interrupts disabled (and, if configured, the other core locked out with \ref multicore_lockout): all pending
+ * erases first, merging runs of adjacent sectors, then the page programs, merging runs of adjacent pages. The length
+ * of each slice is limited using estimates of the time taken per page and sector, so that no interrupt blackout
+ * exceeds the configured maximum (unless a single operation takes longer).
+ *
+ * The time spent with interrupts disabled is measured, and \ref flash_queue_get_stats reports it along with an
+ * estimate of the blackout time saved compared with carrying out each write and erase as it was requested.
+ *
+ * \note The queue does not read the flash (except in \ref flash_queue_read), so writes are assumed to be to erased
+ * flash, or to rely on programming only clearing bits, just as with \ref flash_range_program.
+ *
+ * \note The functions are not thread safe; the caller must serialize access to a queue.
+ */
+
+// PICO_CONFIG: PICO_FLASH_QUEUE_MAX_PAGES, Number of page buffers in a flash queue (each FLASH_PAGE_SIZE bytes), min=1, default=16, group=pico_flash_queue
+#ifndef PICO_FLASH_QUEUE_MAX_PAGES
+#define PICO_FLASH_QUEUE_MAX_PAGES 16
+#endif
+
+// PICO_CONFIG: PICO_FLASH_QUEUE_DEFAULT_MAX_SLICE_US, Default maximum duration of an interrupt blackout when running a flash queue, default=2000, group=pico_flash_queue
+#ifndef PICO_FLASH_QUEUE_DEFAULT_MAX_SLICE_US
+#define PICO_FLASH_QUEUE_DEFAULT_MAX_SLICE_US 2000
+#endif
+
+// PICO_CONFIG: PICO_FLASH_QUEUE_DEFAULT_CALL_US, Default estimate of the overhead of a flash operation (leaving and re-entering XIP mode), default=50, group=pico_flash_queue
+#ifndef PICO_FLASH_QUEUE_DEFAULT_CALL_US
+#define PICO_FLASH_QUEUE_DEFAULT_CALL_US 50
+#endif
+
+// PICO_CONFIG: PICO_FLASH_QUEUE_DEFAULT_PAGE_PROGRAM_US, Default estimate of the time to program a flash page, default=400, group=pico_flash_queue
+#ifndef PICO_FLASH_QUEUE_DEFAULT_PAGE_PROGRAM_US
+#define PICO_FLASH_QUEUE_DEFAULT_PAGE_PROGRAM_US 400
+#endif
+
+// PICO_CONFIG: PICO_FLASH_QUEUE_DEFAULT_SECTOR_ERASE_US, Default estimate of the time to erase a flash sector, default=45000, group=pico_flash_queue
+#ifndef PICO_FLASH_QUEUE_DEFAULT_SECTOR_ERASE_US
+#define PICO_FLASH_QUEUE_DEFAULT_SECTOR_ERASE_US 45000
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief Configuration of a flash queue
+ *  \ingroup pico_flash_queue
+ */
+typedef struct flash_queue_config {
+    uint32_t max_slice_us;      ///< the longest interrupt blackout to plan for
+    uint32_t call_us;           ///< estimated overhead of each flash operation
+    uint32_t page_program_us;   ///< estimated time to program a page
+    uint32_t sector_erase_us;   ///< estimated time to erase a sector
+    bool multicore_lockout;     ///< lock out the other core during each slice (requires pico_multicore and \ref multicore_lockout_victim_init on the other core)
+} flash_queue_config_t;
+
+/*! \brief Statistics of a flash queue
+ *  \ingroup pico_flash_queue
+ */
+typedef struct flash_queue_stats {
+    uint32_t writes;                ///< calls to \ref flash_queue_write
+    uint32_t erases;                ///< calls to \ref flash_queue_erase
+    uint32_t pages_requested;       ///< flash pages touched by the writes (counted per call)
+    uint32_t sectors_requested;     ///< flash sectors covered by the erases (counted per call)
+    uint32_t pages_programmed;      ///< pages actually programmed
+    uint32_t sectors_erased;        ///< sectors actually erased
+    uint32_t slices;                ///< interrupt blackouts
+    uint32_t max_blackout_us;       ///< the longest blackout
+    uint64_t program_us;            ///< total time spent programming, with interrupts disabled
+    uint64_t erase_us;              ///< total time spent erasing, with interrupts disabled
+    uint64_t blackout_us_saved;     ///< estimated blackout time saved (see \ref flash_queue_get_stats)
+} flash_queue_stats_t;
+
+/*! \brief A flash queue
+ *  \ingroup pico_flash_queue
+ *
+ * The members are private
+ */
+typedef struct flash_queue {
+    flash_queue_config_t config;
+    uint page_count;
+    uint erase_count;
+    // pending pages, in order of flash offset, so runs of adjacent pages can be programmed from the buffers directly
+    uint32_t page_offset[PICO_FLASH_QUEUE_MAX_PAGES];
+    uint8_t page_data[PICO_FLASH_QUEUE_MAX_PAGES][FLASH_PAGE_SIZE];
+    uint32_t erase_pending[(PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE + 31) / 32];
+    uint32_t program_calls;
+    uint32_t erase_calls;
+    flash_queue_stats_t stats;
+} flash_queue_t;
+
+/*! \brief Get the default configuration of a flash queue
+ *  \ingroup pico_flash_queue
+ *
+ * The estimates are typical values for the flash devices used with the RP2040
+ */
+static inline flash_queue_config_t flash_queue_get_default_config(void) {
+    flash_queue_config_t config = {
+            .max_slice_us = PICO_FLASH_QUEUE_DEFAULT_MAX_SLICE_US,
+            .call_us = PICO_FLASH_QUEUE_DEFAULT_CALL_US,
+            .page_program_us = PICO_FLASH_QUEUE_DEFAULT_PAGE_PROGRAM_US,
+            .sector_erase_us = PICO_FLASH_QUEUE_DEFAULT_SECTOR_ERASE_US,
+            .multicore_lockout = false,
+    };
+    return config;
+}
+
+/*! \brief Initialize a flash queue
+ *  \ingroup pico_flash_queue
+ *
+ * \param q The queue
+ * \param config The configuration, or NULL for the default
+ */
+void flash_queue_init(flash_queue_t *q, const flash_queue_config_t *config);
+
+/*! \brief Queue a write to flash
+ *  \ingroup pico_flash_queue
+ *
+ * The data is copied, and merged with any data already queued for the same pages.
+ *
+ * \param q The queue
+ * \param flash_offs Offset into flash of the first byte to write; any alignment
+ * \param data The data
+ * \param count The number of bytes
+ * \return PICO_OK, PICO_ERROR_INVALID_ARG if the range is not within flash, or PICO_ERROR_INSUFFICIENT_RESOURCES
+ *         (having queued nothing) if there are not enough free page buffers, in which case the queue should be run
+ *         or flushed first
+ */
+int flash_queue_write(flash_queue_t *q, uint32_t flash_offs, const void *data, size_t count);
+
+/*! \brief Queue an erase of flash
+ *  \ingroup pico_flash_queue
+ *
+ * Any data already queued for the sectors is discarded.
+ *
+ * \param q The queue
+ * \param flash_offs Offset into flash of the first sector. Must be a multiple of FLASH_SECTOR_SIZE
+ * \param count Number of bytes to erase. Must be a multiple of FLASH_SECTOR_SIZE
+ * \return PICO_OK or PICO_ERROR_INVALID_ARG
+ */
+int flash_queue_erase(flash_queue_t *q, uint32_t flash_offs, size_t count);
+
+/*! \brief Carry out queued operations for up to a given time
+ *  \ingroup pico_flash_queue
+ *
+ * Slices are executed while the estimated time of the next one fits within the remaining budget.
+ *
+ * \param q The queue
+ * \param budget_us The time available
+ * \return true if the queue is now empty
+ */
+bool flash_queue_run(flash_queue_t *q, uint32_t budget_us);
+
+/*! \brief Carry out all queued operations
+ *  \ingroup pico_flash_queue
+ *
+ * \param q The queue
+ */
+void flash_queue_flush(flash_queue_t *q);
+
+/*! \brief Check whether a flash queue has no pending operations
+ *  \ingroup pico_flash_queue
+ */
+static inline bool flash_queue_is_empty(const flash_queue_t *q) {
+    return !q->page_count && !q->erase_count;
+}
+
+/*! \brief Read flash as it will be once the queued operations have been carried out
+ *  \ingroup pico_flash_queue
+ *
+ * \param q The queue
+ * \param flash_offs Offset into flash of the first byte to read
+ * \param data Buffer for the data
+ * \param count The number of bytes
+ */
+void flash_queue_read(const flash_queue_t *q, uint32_t flash_offs, void *data, size_t count);
+
+/*! \brief Get the statistics of a flash queue
+ *  \ingroup pico_flash_queue
+ *
+ * The blackout time saved is estimated as the time which would have been spent programming each page touched by each
+ * write, and erasing each sector of each erase, in a separate call (using the average times measured for programming
+ * and erasing a page or sector, and the configured call overhead), less the time actually spent.
+ *
+ * \param q The queue
+ * \param stats Receives the statistics
+ */
+void flash_queue_get_stats(const flash_queue_t *q, flash_queue_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_LOG_H
+#define _PICO_LOG_H
+
+#include "pico.h"
+#include "pico/log_format.h"
+
+/** \file log.h
+ *  \defgroup pico_log pico_log
+ *
+ * Binary logging with deferred formatting
+ *
+ * A \ref pico_log call does not format anything. Each call site has a static pico_log_site_t (holding the format
+ * string, and the types of the arguments worked out at compile time) placed in its own ELF section, and at runtime the
+ * call only copies a reference to the site, a time_us_64() timestamp and the raw argument values into a ring buffer
+ * belonging to the calling core. This costs tens of cycles rather than the thousands spent parsing the format and
+ * converting the values in printf.
+ *
+ * The buffered records can later be formatted on the device by \ref pico_log_drain_text (e.g. from a low priority
+ * task or the main loop), or sent as is by \ref pico_log_drain_binary over a UART or USB, and decoded offline by the
+ * host `pico_log_decode` tool, which reads the format strings from the ELF file.
+ *
+ * Supported arguments are integers and pointers (of up to 64 bits), float/double, and strings (`char *`), which are
+ * copied into the record, truncated to PICO_LOG_MAX_STRING_LENGTH characters. `long double` is not supported.
+ *
+ * \note \ref pico_log is only available from C, as it relies on `_Generic` to identify the argument types.
+ */
+
+// PICO_CONFIG: PARAM_ASSERTIONS_ENABLED_PICO_LOG, Enable/disable assertions in the pico_log module, type=bool, default=0, group=pico_log
+#ifndef PARAM_ASSERTIONS_ENABLED_PICO_LOG
+#define PARAM_ASSERTIONS_ENABLED_PICO_LOG 0
+#endif
+
+// PICO_CONFIG: PICO_LOG_BUFFER_SIZE, Size in bytes of each core's log ring buffer which must be a power of two, min=64, default=1024, group=pico_log
+#ifndef PICO_LOG_BUFFER_SIZE
+#define PICO_LOG_BUFFER_SIZE 1024
+#endif
+
+// PICO_CONFIG: PICO_LOG_MAX_STRING_LENGTH, Maximum number of characters of a string argument copied into a log record, min=1, max=255, default=24, group=pico_log
+#ifndef PICO_LOG_MAX_STRING_LENGTH
+#define PICO_LOG_MAX_STRING_LENGTH 24
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef __cplusplus
+#define __pico_log_arg_type(x) _Generic((x), \
+    float: PICO_LOG_ARG_DOUBLE, \
+    double: PICO_LOG_ARG_DOUBLE, \
+    char *: PICO_LOG_ARG_STRING, \
+    const char *: PICO_LOG_ARG_STRING, \
+    default: (sizeof(x) > 4 ? PICO_LOG_ARG_INT64 : PICO_LOG_ARG_INT32))
+
+#define __PICO_LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define __PICO_LOG_NARGS(...) __PICO_LOG_NARGS_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#define __PICO_LOG_TYPES_0()
+#define __PICO_LOG_TYPES_1(a) __pico_log_arg_type(a)
+#define __PICO_LOG_TYPES_2(a, ...) __pico_log_arg_type(a), __PICO_LOG_TYPES_1(__VA_ARGS__)
+#define __PICO_LOG_TYPES_3(a, ...) __pico_log_arg_type(a), __PICO_LOG_TYPES_2(__VA_ARGS__)
+#define __PICO_LOG_TYPES_4(a, ...) __pico_log_arg_type(a), __PICO_LOG_TYPES_3(__VA_ARGS__)
+#define __PICO_LOG_TYPES_5(a, ...) __pico_log_arg_type(a), __PICO_LOG_TYPES_4(__VA_ARGS__)
+#define __PICO_LOG_TYPES_6(a, ...) __pico_log_arg_type(a), __PICO_LOG_TYPES_5(__VA_ARGS__)
+#define __PICO_LOG_TYPES_7(a, ...) __pico_log_arg_type(a), __PICO_LOG_TYPES_6(__VA_ARGS__)
+#define __PICO_LOG_TYPES_8(a, ...) __pico_log_arg_type(a), __PICO_LOG_TYPES_7(__VA_ARGS__)
+#define __PICO_LOG_TYPES__(n, ...) __PICO_LOG_TYPES_ ## n(__VA_ARGS__)
+#define __PICO_LOG_TYPES_(n, ...) __PICO_LOG_TYPES__(n, ##__VA_ARGS__)
+#define __PICO_LOG_TYPES(...) __PICO_LOG_TYPES_(__PICO_LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__)
+
+/*! \brief Log a message, deferring the formatting
+ *  \ingroup pico_log
+ *
+ * Records the arguments to a printf style format in the calling core's log buffer. If there is not enough space in
+ * the buffer the record is dropped (see \ref pico_log_get_dropped). This function may be called from IRQ handlers.
+ *
+ * \param fmt The format, which must be a string literal, and use at most 8 arguments
+ */
+#define pico_log(fmt, ...) do { \
+    static const pico_log_site_t __attribute__((section(PICO_LOG_SITES_SECTION_NAME), used, aligned(4))) __pico_log_site = { \
+        .line = __LINE__, \
+        .arg_count = __PICO_LOG_NARGS(__VA_ARGS__), \
+        .arg_types = { __PICO_LOG_TYPES(__VA_ARGS__) }, \
+        .format = fmt, \
+    }; \
+    __pico_log_write(&__pico_log_site, ##__VA_ARGS__); \
+} while (0)
+#endif
+
+void __pico_log_write(const pico_log_site_t *site, ...);
+
+/*! \brief Callback used to output drained log data
+ *  \ingroup pico_log
+ *
+ * \param data The data to output
+ * \param len The length of the data in bytes
+ * \param param The param passed to the drain function
+ */
+typedef void (*pico_log_output_fn)(const void *data, uint len, void *param);
+
+/*! \brief Format the buffered log records as text
+ *  \ingroup pico_log
+ *
+ * Removes all records currently buffered by either core, in timestamp order, passing each as a line of text
+ * "[<time_us>] <core>: <message>\n" to the output function.
+ *
+ * \note Only one drain may be in progress at a time.
+ *
+ * \param output The function to call with each line
+ * \param param Passed to the output function
+ * \return the number of records drained
+ */
+uint pico_log_drain_text(pico_log_output_fn output, void *param);
+
+/*! \brief Output the buffered log records in binary form
+ *  \ingroup pico_log
+ *
+ * Removes all records currently buffered by either core, in timestamp order, passing each (prefixed by the 3 byte frame
+ * header described in log_format.h) to the output function. Nothing is formatted; the resulting stream can be decoded
+ * by the host `pico_log_decode` tool given the ELF file for the binary.
+ *
+ * \note Only one drain may be in progress at a time.
+ *
+ * \param output The function to call with each frame
+ * \param param Passed to the output function
+ * \return the number of records drained
+ */
+uint pico_log_drain_binary(pico_log_output_fn output, void *param);
+
+/*! \brief Return the number of log records dropped because a core's log buffer was full
+ *  \ingroup pico_log
+ *
+ * \param core The core number
+ * \return the number of records dropped by that core
+ */
+uint32_t pico_log_get_dropped(uint core);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
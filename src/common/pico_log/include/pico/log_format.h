@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_LOG_FORMAT_H
+#define _PICO_LOG_FORMAT_H
+
+// NOTE: This file is also used by the host pico_log_decode tool, so does not use SDK includes
+
+// NOTE: ALL CHANGES MUST BE BACKWARDS COMPATIBLE (or must change PICO_LOG_STREAM_VERSION)
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef __packed
+#define __packed __attribute__((packed))
+#endif
+
+// version of the site, record and frame layouts below
+#define PICO_LOG_STREAM_VERSION 1
+
+// name of the ELF section holding the pico_log_site_t for every log call
+#define PICO_LOG_SITES_SECTION_NAME "pico_log_sites"
+
+#define PICO_LOG_ARG_INT32  1
+#define PICO_LOG_ARG_INT64  2
+#define PICO_LOG_ARG_DOUBLE 3
+#define PICO_LOG_ARG_STRING 4
+
+// maximum number of arguments to a single log call
+#define PICO_LOG_MAX_ARGS 8
+
+/*
+ * Static description of a log call, placed in the PICO_LOG_SITES_SECTION_NAME section. Records refer to their site
+ * by its offset from the start of that section, so the host tool can find it in the ELF file.
+ */
+typedef struct __packed pico_log_site {
+    uint32_t line;
+    uint8_t arg_count;
+    uint8_t arg_types[PICO_LOG_MAX_ARGS];
+    char format[];
+} pico_log_site_t;
+
+/*
+ * A record is (all little endian)
+ *
+ *   uint16_t length       total length of the record in bytes
+ *   uint32_t site_offset  offset of the pico_log_site_t from the start of PICO_LOG_SITES_SECTION_NAME
+ *   uint64_t time_us      time_us_64() when the record was written
+ *   arguments             per the site arg_types; 4 bytes for PICO_LOG_ARG_INT32, 8 bytes for PICO_LOG_ARG_INT64 and
+ *                         PICO_LOG_ARG_DOUBLE (the bits of the double), or a uint8_t length followed by that many
+ *                         characters for PICO_LOG_ARG_STRING
+ *
+ * In a binary dump each record is preceded by the two sync bytes below, and a byte holding the core number.
+ */
+#define PICO_LOG_RECORD_HEADER_SIZE 14
+#define PICO_LOG_FRAME_SYNC0 'P'
+#define PICO_LOG_FRAME_SYNC1 'L'
+#define PICO_LOG_FRAME_HEADER_SIZE 3
+
+static inline uint32_t pico_log_get_le(const uint8_t *p, unsigned int bytes) {
+    uint32_t v = 0;
+    for (unsigned int i = bytes; i--;) v = (v << 8) | p[i];
+    return v;
+}
+
+static inline uint64_t pico_log_record_time_us(const uint8_t *record) {
+    return pico_log_get_le(record + 6, 4) | ((uint64_t)pico_log_get_le(record + 10, 4) << 32);
+}
+
+/*
+ * Format the message of a record (i.e. the site's format string applied to the record's arguments) into buf, which
+ * is always null terminated.
+ *
+ * Returns the length of the formatted message (excluding the terminator and any truncation), or -1 if the record
+ * arguments do not match the site.
+ */
+int pico_log_format_message(char *buf, size_t size, const pico_log_site_t *site, const uint8_t *record, size_t record_len);
+
+/*
+ * Format a record as a line of text "[<time_us>] <core>: <message>\n" into buf, which is always null terminated.
+ *
+ * Returns the length of the line, or -1 if the record arguments do not match the site.
+ */
+int pico_log_format_line(char *buf, size_t size, unsigned int core, const pico_log_site_t *site, const uint8_t *record, size_t record_len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "pico/log.h"
+#include "pico/time.h"
+#include "pico/util/ring_buffer.h"
+#include "pico/binary_info.h"
+#include "hardware/sync.h"
+
+static_assert(PICO_LOG_BUFFER_SIZE && !(PICO_LOG_BUFFER_SIZE & (PICO_LOG_BUFFER_SIZE - 1)), "PICO_LOG_BUFFER_SIZE must be a power of two");
+static_assert(PICO_LOG_MAX_STRING_LENGTH > 0 && PICO_LOG_MAX_STRING_LENGTH < 256, "");
+
+#define MAX_ARG_SIZE MAX(8, 1 + PICO_LOG_MAX_STRING_LENGTH)
+#define MAX_RECORD_SIZE (PICO_LOG_RECORD_HEADER_SIZE + PICO_LOG_MAX_ARGS * MAX_ARG_SIZE)
+#define MAX_LINE_LENGTH 256
+
+bi_decl(bi_int(BINARY_INFO_TAG_RASPBERRY_PI, BINARY_INFO_ID_RP_LOG_STREAM_VERSION, PICO_LOG_STREAM_VERSION))
+
+// provided by the linker for the section holding the call sites (weak in case there are none)
+extern const uint8_t __start_pico_log_sites[] __attribute__((weak));
+
+static uint8_t log_storage[NUM_CORES][PICO_LOG_BUFFER_SIZE];
+
+// each core is the only producer for its own ring buffer (with IRQs disabled while writing), and the drain is
+// the only consumer
+static ring_buffer_t log_buffers[NUM_CORES] = {
+        RING_BUFFER_STATIC_INIT(log_storage[0], PICO_LOG_BUFFER_SIZE),
+#if NUM_CORES > 1
+        RING_BUFFER_STATIC_INIT(log_storage[1], PICO_LOG_BUFFER_SIZE),
+#endif
+};
+
+static uint32_t log_dropped[NUM_CORES];
+
+void __pico_log_write(const pico_log_site_t *site, ...) {
+    uint8_t record[MAX_RECORD_SIZE];
+    uint32_t site_offset = (uint32_t)((const uint8_t *)site - __start_pico_log_sites);
+    memcpy(record + 2, &site_offset, 4);
+    uint len = PICO_LOG_RECORD_HEADER_SIZE;
+    va_list args;
+    va_start(args, site);
+    for (uint i = 0; i < site->arg_count; i++) {
+        switch (site->arg_types[i]) {
+            case PICO_LOG_ARG_INT32: {
+                uint32_t v = va_arg(args, uint32_t);
+                memcpy(record + len, &v, 4);
+                len += 4;
+                break;
+            }
+            case PICO_LOG_ARG_INT64: {
+                uint64_t v = va_arg(args, uint64_t);
+                memcpy(record + len, &v, 8);
+                len += 8;
+                break;
+            }
+            case PICO_LOG_ARG_DOUBLE: {
+                double v = va_arg(args, double);
+                memcpy(record + len, &v, 8);
+                len += 8;
+                break;
+            }
+            default: {
+                const char *s = va_arg(args, const char *);
+                if (!s) s = "(null)";
+                uint n = 0;
+                while (n < PICO_LOG_MAX_STRING_LENGTH && s[n]) n++;
+                record[len] = (uint8_t)n;
+                memcpy(record + len + 1, s, n);
+                len += 1 + n;
+                break;
+            }
+        }
+    }
+    va_end(args);
+    record[0] = (uint8_t)len;
+    record[1] = (uint8_t)(len >> 8);
+    // only an IRQ on this core can interleave with us
+    uint32_t save = save_and_disable_interrupts();
+    uint64_t now = time_us_64();
+    memcpy(record + 6, &now, 8);
+    uint core = get_core_num();
+    ring_buffer_t *rb = &log_buffers[core];
+    if (ring_buffer_get_free(rb) >= len) {
+        ring_buffer_try_write(rb, record, len);
+    } else {
+        log_dropped[core]++;
+    }
+    restore_interrupts(save);
+}
+
+uint32_t pico_log_get_dropped(uint core) {
+    invalid_params_if(PICO_LOG, core >= NUM_CORES);
+    return log_dropped[core];
+}
+
+static struct {
+    uint8_t frame[NUM_CORES][PICO_LOG_FRAME_HEADER_SIZE + MAX_RECORD_SIZE];
+    bool staged[NUM_CORES];
+} drain;
+
+// move the next record for the core (if any, and within budget) into its frame buffer
+static void stage_record(uint core, uint *budget) {
+    if (drain.staged[core] || budget[core] < 2) return;
+    uint8_t *frame = drain.frame[core];
+    uint8_t *record = frame + PICO_LOG_FRAME_HEADER_SIZE;
+    // a record is written with a single update of the write pointer, so is either entirely present or absent
+    ring_buffer_try_read(&log_buffers[core], record, 2);
+    uint len = record[0] | (record[1] << 8u);
+    ring_buffer_try_read(&log_buffers[core], record + 2, len - 2);
+    budget[core] -= len;
+    frame[0] = PICO_LOG_FRAME_SYNC0;
+    frame[1] = PICO_LOG_FRAME_SYNC1;
+    frame[2] = (uint8_t)core;
+    drain.staged[core] = true;
+}
+
+typedef void (*drain_record_fn)(uint core, const uint8_t *frame, pico_log_output_fn output, void *param);
+
+static uint drain_records(drain_record_fn fn, pico_log_output_fn output, void *param) {
+    // only drain what is present now, so a busy producer cannot keep us here forever
+    uint budget[NUM_CORES];
+    for (uint core = 0; core < NUM_CORES; core++) {
+        budget[core] = ring_buffer_get_level(&log_buffers[core]);
+    }
+    uint count = 0;
+    while (true) {
+        int next = -1;
+        uint64_t next_time = 0;
+        for (uint core = 0; core < NUM_CORES; core++) {
+            stage_record(core, budget);
+            if (drain.staged[core]) {
+                uint64_t t = pico_log_record_time_us(drain.frame[core] + PICO_LOG_FRAME_HEADER_SIZE);
+                if (next < 0 || t < next_time) {
+                    next = (int)core;
+                    next_time = t;
+                }
+            }
+        }
+        if (next < 0) break;
+        fn((uint)next, drain.frame[next], output, param);
+        drain.staged[next] = false;
+        count++;
+    }
+    return count;
+}
+
+static void drain_binary_record(uint core, const uint8_t *frame, pico_log_output_fn output, void *param) {
+    (void)core;
+    const uint8_t *record = frame + PICO_LOG_FRAME_HEADER_SIZE;
+    output(frame, PICO_LOG_FRAME_HEADER_SIZE + (record[0] | (record[1] << 8u)), param);
+}
+
+static void drain_text_record(uint core, const uint8_t *frame, pico_log_output_fn output, void *param) {
+    const uint8_t *record = frame + PICO_LOG_FRAME_HEADER_SIZE;
+    uint len = record[0] | (record[1] << 8u);
+    const pico_log_site_t *site = (const pico_log_site_t *)(__start_pico_log_sites + pico_log_get_le(record + 2, 4));
+    char line[MAX_LINE_LENGTH];
+    int n = pico_log_format_line(line, sizeof(line), core, site, record, len);
+    if (n < 0) {
+        n = snprintf(line, sizeof(line), "<bad log record for \"%s\">\n", site->format);
+        n = MIN(n, (int)sizeof(line) - 1);
+    }
+    output(line, (uint)n, param);
+}
+
+uint pico_log_drain_binary(pico_log_output_fn output, void *param) {
+    return drain_records(drain_binary_record, output, param);
+}
+
+uint pico_log_drain_text(pico_log_output_fn output, void *param) {
+    return drain_records(drain_text_record, output, param);
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// NOTE: This file is also built into the host pico_log_decode tool, so does not use SDK includes
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/log_format.h"
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t pos;
+} format_output_t;
+
+static void out_str(format_output_t *out, const char *s, size_t len) {
+    if (out->pos + 1 < out->size) {
+        size_t n = out->size - 1 - out->pos;
+        if (len < n) n = len;
+        memcpy(out->buf + out->pos, s, n);
+        out->buf[out->pos + n] = 0;
+    }
+    out->pos += len;
+}
+
+static void out_formatted(format_output_t *out, int len) {
+    // snprintf has already written (a possibly truncated copy of) the output at out->pos
+    if (len > 0) out->pos += (size_t)len;
+}
+
+static size_t remaining(const format_output_t *out) {
+    return out->pos < out->size ? out->size - out->pos : 0;
+}
+
+static char *out_ptr(format_output_t *out) {
+    static char dummy[1];
+    return out->pos < out->size ? out->buf + out->pos : dummy;
+}
+
+int pico_log_format_message(char *buf, size_t size, const pico_log_site_t *site, const uint8_t *record, size_t record_len) {
+    format_output_t out = {buf, size, 0};
+    if (size) buf[0] = 0;
+    size_t pos = PICO_LOG_RECORD_HEADER_SIZE;
+    unsigned int arg = 0;
+    const char *f = site->format;
+    if (site->arg_count > PICO_LOG_MAX_ARGS) return -1;
+    while (*f) {
+        const char *lit = f;
+        while (*f && *f != '%') f++;
+        if (f != lit) out_str(&out, lit, (size_t)(f - lit));
+        if (!*f) break;
+        if (f[1] == '%') {
+            out_str(&out, "%", 1);
+            f += 2;
+            continue;
+        }
+        // rebuild the conversion specification with a length modifier to match the recorded argument
+        char spec[24];
+        size_t n = 0;
+        spec[n++] = *f++;
+        while (*f && strchr("-+ #0", *f) && n < 8) spec[n++] = *f++;
+        while (*f >= '0' && *f <= '9' && n < 12) spec[n++] = *f++;
+        if (*f == '.') {
+            spec[n++] = *f++;
+            while (*f >= '0' && *f <= '9' && n < 16) spec[n++] = *f++;
+        }
+        while (*f && strchr("hlLjzt", *f)) f++;
+        char conv = *f;
+        if (!conv) break;
+        f++;
+        if (arg >= site->arg_count) return -1;
+        uint8_t type = site->arg_types[arg++];
+        uint64_t value = 0;
+        const char *str = NULL;
+        size_t str_len = 0;
+        switch (type) {
+            case PICO_LOG_ARG_INT32:
+                if (pos + 4 > record_len) return -1;
+                value = pico_log_get_le(record + pos, 4);
+                pos += 4;
+                break;
+            case PICO_LOG_ARG_INT64:
+            case PICO_LOG_ARG_DOUBLE:
+                if (pos + 8 > record_len) return -1;
+                value = pico_log_get_le(record + pos, 4) | ((uint64_t)pico_log_get_le(record + pos + 4, 4) << 32);
+                pos += 8;
+                break;
+            case PICO_LOG_ARG_STRING:
+                if (pos + 1 > record_len || pos + 1 + record[pos] > record_len) return -1;
+                str_len = record[pos];
+                str = (const char *)record + pos + 1;
+                pos += 1 + str_len;
+                break;
+            default:
+                return -1;
+        }
+        int len = -1;
+        if (strchr("diouxXc", conv) && (type == PICO_LOG_ARG_INT32 || type == PICO_LOG_ARG_INT64)) {
+            if (type == PICO_LOG_ARG_INT64) {
+                spec[n++] = 'l';
+                spec[n++] = 'l';
+                spec[n++] = conv;
+                spec[n] = 0;
+                if (conv == 'd' || conv == 'i') {
+                    len = snprintf(out_ptr(&out), remaining(&out), spec, (long long)value);
+                } else {
+                    len = snprintf(out_ptr(&out), remaining(&out), spec, (unsigned long long)value);
+                }
+            } else {
+                spec[n++] = conv;
+                spec[n] = 0;
+                if (conv == 'd' || conv == 'i' || conv == 'c') {
+                    len = snprintf(out_ptr(&out), remaining(&out), spec, (int)(int32_t)value);
+                } else {
+                    len = snprintf(out_ptr(&out), remaining(&out), spec, (unsigned int)value);
+                }
+            }
+        } else if (strchr("fFeEgGaA", conv) && type == PICO_LOG_ARG_DOUBLE) {
+            double d;
+            memcpy(&d, &value, sizeof(d));
+            spec[n++] = conv;
+            spec[n] = 0;
+            len = snprintf(out_ptr(&out), remaining(&out), spec, d);
+        } else if (conv == 'p' && (type == PICO_LOG_ARG_INT32 || type == PICO_LOG_ARG_INT64)) {
+            // the pointer may be from a different (e.g. 32 bit) address space to ours
+            len = snprintf(out_ptr(&out), remaining(&out), "0x%" PRIx64, value);
+        } else if (conv == 's' && type == PICO_LOG_ARG_STRING) {
+            char s[256];
+            memcpy(s, str, str_len);
+            s[str_len] = 0;
+            spec[n++] = conv;
+            spec[n] = 0;
+            len = snprintf(out_ptr(&out), remaining(&out), spec, s);
+        } else {
+            out_str(&out, "<?>", 3);
+        }
+        out_formatted(&out, len);
+    }
+    if (out.pos >= size && size) out.pos = size - 1;
+    return (int)out.pos;
+}
+
+int pico_log_format_line(char *buf, size_t size, unsigned int core, const pico_log_site_t *site, const uint8_t *record, size_t record_len) {
+    int prefix = snprintf(buf, size, "[%12" PRIu64 "] %u: ", pico_log_record_time_us(record), core);
+    if (prefix < 0 || (size_t)prefix + 2 > size) return -1;
+    int len = pico_log_format_message(buf + prefix, size - (size_t)prefix - 1, site, record, record_len);
+    if (len < 0) return -1;
+    len += prefix;
+    buf[len++] = '\n';
+    buf[len] = 0;
+    return len;
+}
@@ -343,6 +343,33 @@ bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp);
 #define PICO_TIME_DEFAULT_ALARM_POOL_MAX_TIMERS 16
 #endif
 
+// PICO_CONFIG: PICO_TIME_ALARM_POOL_STATS, Enable collection of per alarm pool statistics (pending alarm counts and latency histograms), type=bool, default=0, advanced=true, group=pico_time
+#ifndef PICO_TIME_ALARM_POOL_STATS
+/*!
+ * \brief If 1 then each alarm pool keeps statistics about its alarms, which can be retrieved with alarm_pool_get_stats()
+ *
+ * This adds a small overhead to adding, cancelling and dispatching alarms (the latter includes reading the timer
+ * before and after each callback), and about 200 bytes to each pool.
+ *
+ * \ingroup alarm
+ * \sa alarm_pool_get_stats()
+ */
+#define PICO_TIME_ALARM_POOL_STATS 0
+#endif
+
+// PICO_CONFIG: PICO_TIME_ALARM_POOL_STATS_HISTOGRAM_BUCKETS, Number of buckets in the alarm pool statistics histograms, min=2, max=64, default=21, advanced=true, group=pico_time
+#ifndef PICO_TIME_ALARM_POOL_STATS_HISTOGRAM_BUCKETS
+/*!
+ * \brief Number of log2 buckets in the alarm pool statistics histograms
+ *
+ * Bucket 0 counts times of 0us, bucket n counts times in the range [2^(n-1), 2^n) us, and the last bucket also counts
+ * everything longer. The default of 21 covers up to about half a second.
+ *
+ * \ingroup alarm
+ */
+#define PICO_TIME_ALARM_POOL_STATS_HISTOGRAM_BUCKETS 21
+#endif
+
 /**
  * \brief The identifier for an alarm
  *
@@ -427,6 +454,43 @@ alarm_pool_t *alarm_pool_create(uint hardware_alarm_num, uint max_timers);
  */
 alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(uint max_timers);
 
+/**
+ * \brief Create an alarm pool which keeps its alarms in a hierarchical timing wheel
+ *
+ * This behaves exactly like an alarm pool created with alarm_pool_create(), however adding and cancelling alarms
+ * are O(1) operations (rather than O(log n) for the pairing heap used by default), and many more alarms may be pending
+ * at once. This makes it a better choice when there are hundreds or thousands of alarms (e.g. protocol timeouts)
+ * most of which are cancelled before they fire.
+ *
+ * The trade off is that the pool is larger (a fixed overhead of about 1K for the wheel itself), and the alarm IRQ
+ * may occasionally fire before the next alarm is due, in order to move the wheel on.
+ *
+ * \note This method will hard assert if the hardware alarm is already claimed.
+ *
+ * \ingroup alarm
+ * \param hardware_alarm_num the hardware alarm to use to back this pool
+ * \param max_timers the maximum number of timers
+ *        \note This is limited to TIMER_WHEEL_MAX_NODES (65534)
+ * \sa alarm_pool_create()
+ * \sa util_timer_wheel
+ */
+alarm_pool_t *alarm_pool_create_timer_wheel(uint hardware_alarm_num, uint max_timers);
+
+/**
+ * \brief Create an alarm pool which keeps its alarms in a hierarchical timing wheel, claiming an unused hardware alarm to back it.
+ *
+ * See alarm_pool_create_timer_wheel() for the differences from a regular alarm pool.
+ *
+ * \note This method will hard assert if the there is no free hardware to claim.
+ *
+ * \ingroup alarm
+ * \param max_timers the maximum number of timers
+ *        \note This is limited to TIMER_WHEEL_MAX_NODES (65534)
+ * \sa alarm_pool_create_with_unused_hardware_alarm()
+ * \sa util_timer_wheel
+ */
+alarm_pool_t *alarm_pool_create_timer_wheel_with_unused_hardware_alarm(uint max_timers);
+
 /**
  * \brief Return the hardware alarm used by an alarm pool
  * \ingroup alarm
@@ -451,6 +515,51 @@ uint alarm_pool_core_num(alarm_pool_t *pool);
  */
 void alarm_pool_destroy(alarm_pool_t *pool);
 
+#if PICO_TIME_ALARM_POOL_STATS
+/**
+ * \brief Statistics collected by an alarm pool when PICO_TIME_ALARM_POOL_STATS is 1
+ * \ingroup alarm
+ *
+ * The histograms are log2 based; see PICO_TIME_ALARM_POOL_STATS_HISTOGRAM_BUCKETS
+ *
+ * \sa alarm_pool_get_stats()
+ */
+typedef struct alarm_pool_stats {
+    uint32_t pending;       ///< the number of alarms currently pending
+    uint32_t peak_pending;  ///< the maximum number of alarms that have been pending at once
+    uint32_t fired;         ///< the number of alarm callbacks called from the alarm IRQ
+    uint32_t missed;        ///< the number of alarms whose time had already passed when they were added or rescheduled
+    uint32_t rescheduled;   ///< the number of times an alarm was rescheduled by its callback returning non zero
+    uint32_t fire_latency_histogram[PICO_TIME_ALARM_POOL_STATS_HISTOGRAM_BUCKETS]; ///< time from the alarm's target to its callback being called
+    uint32_t callback_time_histogram[PICO_TIME_ALARM_POOL_STATS_HISTOGRAM_BUCKETS]; ///< time taken by each callback
+} alarm_pool_stats_t;
+
+/**
+ * \brief Retrieve a consistent snapshot of the statistics for an alarm pool
+ * \ingroup alarm
+ * \param pool the pool
+ * \param stats the structure to fill in
+ */
+void alarm_pool_get_stats(alarm_pool_t *pool, alarm_pool_stats_t *stats);
+
+/**
+ * \brief Reset the statistics for an alarm pool
+ * \ingroup alarm
+ *
+ * All the counts and histograms are cleared, except the number of pending alarms, which also becomes the new peak.
+ *
+ * \param pool the pool
+ */
+void alarm_pool_reset_stats(alarm_pool_t *pool);
+
+/**
+ * \brief Print the statistics for an alarm pool using printf
+ * \ingroup alarm
+ * \param pool the pool
+ */
+void alarm_pool_print_stats(alarm_pool_t *pool);
+#endif
+
 /*!
  * \brief Add an alarm callback to be called at a specific time
  * \ingroup alarm
@@ -476,6 +585,36 @@ void alarm_pool_destroy(alarm_pool_t *pool);
  */
 alarm_id_t alarm_pool_add_alarm_at(alarm_pool_t *pool, absolute_time_t time, alarm_callback_t callback, void *user_data, bool fire_if_past);
 
+/*!
+ * \brief Add an alarm callback to be called at some point within a window starting at a specific time
+ * \ingroup alarm
+ *
+ * This is the same as \ref alarm_pool_add_alarm_at, except that the callback may be called at any point up to \p slack_us
+ * after \p time. The pool uses this freedom to batch alarms whose windows overlap, so that they are all called back from
+ * a single alarm IRQ, rather than taking (and reprogramming the hardware alarm for) an IRQ each. This can greatly reduce the
+ * IRQ rate when there are many alarms (e.g. repeating timers with similar periods) which don't need to fire at an exact time.
+ *
+ * The callback is never called before \p time. If the callback returns a value to reschedule the alarm, the slack
+ * applies to the rescheduled alarm too.
+ *
+ * \note It is safe to call this method from an IRQ handler (including alarm callbacks), and from either core.
+ *
+ * @param pool the alarm pool to use for scheduling the callback (this determines which hardware alarm is used, and which core calls the callback)
+ * @param time the timestamp when (after which) the callback should fire
+ * @param slack_us the maximum time after \p time that the callback may be delayed to share an IRQ with other alarms
+ * @param callback the callback function
+ * @param user_data user data to pass to the callback function
+ * @param fire_if_past if true, and the end of the window falls before or during this call before the alarm can be set,
+ *                     then the callback should be called during (by) this function instead
+ * @return >0 the alarm id for an active (at the time of return) alarm
+ * @return 0 if the end of the window passed before or during the call AND there is no active alarm to return the id of.
+ *           The latter can either happen because fire_if_past was false (i.e. no timer was ever created),
+ *           or if the callback <i>was</i> called during this method but the callback cancelled itself by returning 0
+ * @return -1 if there were no alarm slots available
+ */
+alarm_id_t alarm_pool_add_alarm_at_with_slack(alarm_pool_t *pool, absolute_time_t time, uint32_t slack_us,
+                                              alarm_callback_t callback, void *user_data, bool fire_if_past);
+
 /*!
  * \brief Add an alarm callback to be called at or after a specific time
  * \ingroup alarm
@@ -549,6 +688,30 @@ static inline alarm_id_t alarm_pool_add_alarm_in_ms(alarm_pool_t *pool, uint32_t
     return alarm_pool_add_alarm_at(pool, delayed_by_ms(get_absolute_time(), ms), callback, user_data, fire_if_past);
 }
 
+/*!
+ * \brief Add an alarm callback to be called at some point within a window starting after a delay specified in microseconds
+ * \ingroup alarm
+ *
+ * See \ref alarm_pool_add_alarm_at_with_slack for details of how the slack is used.
+ *
+ * \note It is safe to call this method from an IRQ handler (including alarm callbacks), and from either core.
+ *
+ * @param pool the alarm pool to use for scheduling the callback (this determines which hardware alarm is used, and which core calls the callback)
+ * @param us the delay (from now) in microseconds when (after which) the callback should fire
+ * @param slack_us the maximum time after that the callback may be delayed to share an IRQ with other alarms
+ * @param callback the callback function
+ * @param user_data user data to pass to the callback function
+ * @param fire_if_past if true, and the end of the window falls during this call before the alarm can be set,
+ *                     then the callback should be called during (by) this function instead
+ * @return >0 the alarm id
+ * @return 0 if the end of the window passed before or during the call AND there is no active alarm to return the id of.
+ * @return -1 if there were no alarm slots available
+ */
+static inline alarm_id_t alarm_pool_add_alarm_in_us_with_slack(alarm_pool_t *pool, uint64_t us, uint32_t slack_us,
+                                                               alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    return alarm_pool_add_alarm_at_with_slack(pool, delayed_by_us(get_absolute_time(), us), slack_us, callback, user_data, fire_if_past);
+}
+
 /*!
  * \brief Cancel an alarm
  * \ingroup alarm
@@ -637,6 +800,29 @@ static inline alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback,
 static inline alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past) {
     return alarm_pool_add_alarm_in_ms(alarm_pool_get_default(), ms, callback, user_data, fire_if_past);
 }
+
+/*!
+ * \brief Add an alarm callback to be called at some point within a window starting after a delay specified in microseconds
+ * \ingroup alarm
+ *
+ * See \ref alarm_pool_add_alarm_at_with_slack for details of how the slack is used. The callback is called from an IRQ
+ * handler on the core of the default alarm pool (generally core 0).
+ *
+ * \note It is safe to call this method from an IRQ handler (including alarm callbacks), and from either core.
+ *
+ * @param us the delay (from now) in microseconds when (after which) the callback should fire
+ * @param slack_us the maximum time after that the callback may be delayed to share an IRQ with other alarms
+ * @param callback the callback function
+ * @param user_data user data to pass to the callback function
+ * @param fire_if_past if true, and the end of the window falls during this call before the alarm can be set,
+ *                     then the callback should be called during (by) this function instead
+ * @return >0 the alarm id
+ * @return 0 if the end of the window passed before or during the call AND there is no active alarm to return the id of.
+ * @return -1 if there were no alarm slots available
+ */
+static inline alarm_id_t add_alarm_in_us_with_slack(uint64_t us, uint32_t slack_us, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    return alarm_pool_add_alarm_in_us_with_slack(alarm_pool_get_default(), us, slack_us, callback, user_data, fire_if_past);
+}
 /*!
  * \brief Cancel an alarm from the default alarm pool
  * \ingroup alarm
@@ -703,6 +889,27 @@ struct repeating_timer {
  */
 bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out);
 
+/*!
+ * \brief Add a repeating timer that is called repeatedly at the specified interval in microseconds, allowing each callback to be
+ * delayed by up to \p slack_us so that it can share an alarm IRQ with other alarms
+ * \ingroup repeating_timer
+ *
+ * See \ref alarm_pool_add_alarm_at_with_slack for details of how the slack is used. If \p delay_us is negative, the slack
+ * does not accumulate; each callback is due a fixed interval after the previous one was due, not after it was called.
+ *
+ * \note It is safe to call this method from an IRQ handler (including alarm callbacks), and from either core.
+ *
+ * @param pool the alarm pool to use for scheduling the repeating timer (this determines which hardware alarm is used, and which core calls the callback)
+ * @param delay_us the repeat delay in microseconds; if >0 then this is the delay between one callback ending and the next starting; if <0 then this is the negative of the time between the starts of the callbacks. The value of 0 is treated as 1
+ * @param slack_us the maximum time each callback may be delayed to share an IRQ with other alarms
+ * @param callback the repeating timer callback function
+ * @param user_data user data to pass to store in the repeating_timer structure for use by the callback.
+ * @param out the pointer to the user owned structure to store the repeating timer info in. BEWARE this storage location must outlive the repeating timer, so be careful of using stack space
+ * @return false if there were no alarm slots available to create the timer, true otherwise.
+ */
+bool alarm_pool_add_repeating_timer_us_with_slack(alarm_pool_t *pool, int64_t delay_us, uint32_t slack_us,
+                                                  repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out);
+
 /*!
  * \brief Add a repeating timer that is called repeatedly at the specified interval in milliseconds
  * \ingroup repeating_timer
@@ -747,6 +954,25 @@ static inline bool add_repeating_timer_us(int64_t delay_us, repeating_timer_call
     return alarm_pool_add_repeating_timer_us(alarm_pool_get_default(), delay_us, callback, user_data, out);
 }
 
+/*!
+ * \brief Add a repeating timer on the default alarm pool that is called repeatedly at the specified interval in microseconds,
+ * allowing each callback to be delayed by up to \p slack_us so that it can share an alarm IRQ with other alarms
+ * \ingroup repeating_timer
+ *
+ * \note It is safe to call this method from an IRQ handler (including alarm callbacks), and from either core.
+ *
+ * @param delay_us the repeat delay in microseconds; if >0 then this is the delay between one callback ending and the next starting; if <0 then this is the negative of the time between the starts of the callbacks. The value of 0 is treated as 1
+ * @param slack_us the maximum time each callback may be delayed to share an IRQ with other alarms
+ * @param callback the repeating timer callback function
+ * @param user_data user data to pass to store in the repeating_timer structure for use by the callback.
+ * @param out the pointer to the user owned structure to store the repeating timer info in. BEWARE this storage location must outlive the repeating timer, so be careful of using stack space
+ * @return false if there were no alarm slots available to create the timer, true otherwise.
+ * \sa alarm_pool_add_repeating_timer_us_with_slack()
+ */
+static inline bool add_repeating_timer_us_with_slack(int64_t delay_us, uint32_t slack_us, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out) {
+    return alarm_pool_add_repeating_timer_us_with_slack(alarm_pool_get_default(), delay_us, slack_us, callback, user_data, out);
+}
+
 /*!
  * \brief Add a repeating timer that is called repeatedly at the specified interval in milliseconds
  * \ingroup repeating_timer
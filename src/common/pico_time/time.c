@@ -8,9 +8,11 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "pico.h"
 #include "pico/time.h"
 #include "pico/util/pheap.h"
+#include "pico/util/timer_wheel.h"
 #include "pico/sync.h"
 
 const absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(nil_time, 0);
@@ -20,20 +22,277 @@ typedef struct alarm_pool_entry {
     absolute_time_t target;
     alarm_callback_t callback;
     void *user_data;
+    // the alarm may fire up to this long after target, so that it can share an IRQ with other alarms
+    uint32_t slack_us;
 } alarm_pool_entry_t;
 
+typedef struct alarm_pool_engine alarm_pool_engine_t;
+
 typedef struct alarm_pool {
-    pheap_t *heap;
+    const alarm_pool_engine_t *engine;
+    union {
+        pheap_t *heap;
+        timer_wheel_t *wheel;
+    };
     spin_lock_t *lock;
     alarm_pool_entry_t *entries;
     // one byte per entry, used to provide more longevity to public IDs than heap node ids do
     // (this is increment every time the heap node id is re-used)
     uint8_t *entry_ids_high;
     alarm_id_t alarm_in_progress; // this is set during a callback from the IRQ handler... it can be cleared by alarm_cancel to prevent repeats
+    uint16_t max_timers;
     uint8_t hardware_alarm_num;
     uint8_t core_num;
+#if PICO_TIME_ALARM_POOL_STATS
+    alarm_pool_stats_t stats;
+#endif
 } alarm_pool_t;
 
+// The data structure which orders the pending alarms in a pool. All methods are called with the pool lock held.
+// Ids are in the range 1 to max_timers, and index the pool's entries
+struct alarm_pool_engine {
+    void (*create)(alarm_pool_t *pool, uint max_timers);
+    void (*destroy)(alarm_pool_t *pool);
+    // return a new id (not yet inserted), or 0 if there is no space
+    uint (*new_id)(alarm_pool_t *pool);
+    // free an id which is not currently inserted
+    void (*free_id)(alarm_pool_t *pool, uint id);
+    // insert an id whose entry target is already set; return true if the hardware alarm needs setting to that target
+    bool (*insert)(alarm_pool_t *pool, uint id);
+    bool (*contains)(alarm_pool_t *pool, uint id);
+    bool (*remove_and_free)(alarm_pool_t *pool, uint id);
+    // remove (but don't free) an id whose target is <= now, or return 0 and set *next_us to the time the hardware
+    // alarm should be set to (UINT64_MAX if there are no alarms pending)
+    uint (*remove_due)(alarm_pool_t *pool, uint64_t now_us, uint64_t *next_us);
+    void (*dump)(alarm_pool_t *pool);
+    // the number of bits used for the id in the public alarm_id_t
+    uint8_t id_bits;
+};
+
+static inline alarm_pool_entry_t *get_entry(alarm_pool_t *pool, uint id) {
+    assert(id && id <= pool->max_timers);
+    return pool->entries + id - 1;
+}
+
+static inline uint8_t *get_entry_id_high(alarm_pool_t *pool, uint id) {
+    assert(id && id <= pool->max_timers);
+    return pool->entry_ids_high + id - 1;
+}
+
+// Alarms are ordered by the time the hardware alarm will be set for them. For an alarm with slack, this is the time
+// within [target, target + slack] with the most trailing zero bits, so that alarms whose windows overlap tend to
+// be given the same fire time, and hence share an IRQ
+static inline uint64_t get_fire_time_us(alarm_pool_entry_t *entry) {
+    uint64_t target_us = to_us_since_boot(entry->target);
+    if (!entry->slack_us) return target_us;
+    uint64_t limit_us = target_us + entry->slack_us;
+    uint bit = 63u - (uint)__builtin_clzll(target_us ^ limit_us);
+    return limit_us & ~((1ull << bit) - 1u);
+}
+
+static inline alarm_id_t make_public_id(alarm_pool_t *pool, uint8_t id_high, uint id) {
+    return (alarm_id_t)(((uint)id_high << pool->engine->id_bits) | id);
+}
+
+static inline void stats_alarm_added(__unused alarm_pool_t *pool) {
+#if PICO_TIME_ALARM_POOL_STATS
+    if (++pool->stats.pending > pool->stats.peak_pending) pool->stats.peak_pending = pool->stats.pending;
+#endif
+}
+
+static inline void stats_alarm_removed(__unused alarm_pool_t *pool) {
+#if PICO_TIME_ALARM_POOL_STATS
+    pool->stats.pending--;
+#endif
+}
+
+// count an alarm (re)added with its target already passed, whether or not it became the next to fire; hardware_missed
+// is the result of setting the hardware alarm for it, if that was done
+static inline void stats_alarm_check_missed(__unused alarm_pool_t *pool, __unused absolute_time_t target,
+                                            __unused bool hardware_missed) {
+#if PICO_TIME_ALARM_POOL_STATS
+    if (hardware_missed || time_reached(target)) pool->stats.missed++;
+#endif
+}
+
+static inline void stats_alarm_rescheduled(__unused alarm_pool_t *pool) {
+#if PICO_TIME_ALARM_POOL_STATS
+    pool->stats.rescheduled++;
+#endif
+}
+
+#if PICO_TIME_ALARM_POOL_STATS
+static inline uint stats_histogram_bucket(uint64_t us) {
+    uint bucket = us ? 64u - (uint)__builtin_clzll(us) : 0;
+    return MIN(bucket, PICO_TIME_ALARM_POOL_STATS_HISTOGRAM_BUCKETS - 1u);
+}
+
+static void stats_alarm_fired(alarm_pool_t *pool, uint64_t target_us, uint64_t start_us, uint64_t end_us) {
+    pool->stats.fired++;
+    pool->stats.fire_latency_histogram[stats_histogram_bucket(start_us > target_us ? start_us - target_us : 0)]++;
+    pool->stats.callback_time_histogram[stats_histogram_bucket(end_us - start_us)]++;
+}
+#endif
+
+static void alarm_pool_dump_key(uint id, void *user_data) {
+    alarm_pool_t *pool = (alarm_pool_t *)user_data;
+#if PICO_ON_DEVICE
+    printf("%lld (hi %02x)", to_us_since_boot(get_entry(pool, id)->target), *get_entry_id_high(pool, id));
+#else
+    printf("%"PRIu64, to_us_since_boot(get_entry(pool, id)->target));
+#endif
+}
+
+bool timer_pool_entry_comparator(void *user_data, pheap_node_id_t a, pheap_node_id_t b) {
+    alarm_pool_t *pool = (alarm_pool_t *)user_data;
+    return get_fire_time_us(get_entry(pool, a)) < get_fire_time_us(get_entry(pool, b));
+}
+
+#if PICO_PHEAP_INLINE_KEY
+// the heap nodes hold the fire time, so the heap can order them itself without calling back into the pool
+#define ALARM_POOL_HEAP_COMPARATOR NULL
+#else
+#define ALARM_POOL_HEAP_COMPARATOR timer_pool_entry_comparator
+#endif
+
+static void heap_engine_create(alarm_pool_t *pool, uint max_timers) {
+    pool->heap = ph_create(max_timers, ALARM_POOL_HEAP_COMPARATOR, pool);
+}
+
+static void heap_engine_destroy(alarm_pool_t *pool) {
+    ph_destroy(pool->heap);
+}
+
+static uint heap_engine_new_id(alarm_pool_t *pool) {
+    return ph_new_node(pool->heap);
+}
+
+static void heap_engine_free_id(alarm_pool_t *pool, uint id) {
+    ph_free_node(pool->heap, (pheap_node_id_t)id);
+}
+
+static bool heap_engine_insert(alarm_pool_t *pool, uint id) {
+#if PICO_PHEAP_INLINE_KEY
+    ph_set_key(pool->heap, (pheap_node_id_t)id, get_fire_time_us(get_entry(pool, id)));
+#endif
+    return id == ph_insert_node(pool->heap, (pheap_node_id_t)id);
+}
+
+static bool heap_engine_contains(alarm_pool_t *pool, uint id) {
+    return ph_contains_node(pool->heap, (pheap_node_id_t)id);
+}
+
+static bool heap_engine_remove_and_free(alarm_pool_t *pool, uint id) {
+    return ph_remove_and_free_node(pool->heap, (pheap_node_id_t)id);
+}
+
+static uint heap_engine_remove_due(alarm_pool_t *pool, uint64_t now_us, uint64_t *next_us) {
+    pheap_node_id_t id = ph_peek_head(pool->heap);
+    if (!id) {
+        *next_us = UINT64_MAX;
+        return 0;
+    }
+    alarm_pool_entry_t *entry = get_entry(pool, id);
+#if PICO_PHEAP_INLINE_KEY
+    uint64_t fire_us = ph_get_key(pool->heap, id);
+#else
+    uint64_t fire_us = get_fire_time_us(entry);
+#endif
+    // an alarm whose slack window has already opened is dispatched now, rather than waiting for its own IRQ
+    if (fire_us > now_us && to_us_since_boot(entry->target) > now_us) {
+        *next_us = fire_us;
+        return 0;
+    }
+    // we don't free the id in case we need to re-add the timer
+    pheap_node_id_t __unused removed_id = ph_remove_head(pool->heap, false);
+    assert(removed_id == id); // will be true under lock
+    return id;
+}
+
+static void heap_engine_dump_key(pheap_node_id_t id, void *user_data) {
+    alarm_pool_dump_key(id, user_data);
+}
+
+static void heap_engine_dump(alarm_pool_t *pool) {
+    ph_dump(pool->heap, heap_engine_dump_key, pool);
+}
+
+static const alarm_pool_engine_t heap_engine = {
+        .create = heap_engine_create,
+        .destroy = heap_engine_destroy,
+        .new_id = heap_engine_new_id,
+        .free_id = heap_engine_free_id,
+        .insert = heap_engine_insert,
+        .contains = heap_engine_contains,
+        .remove_and_free = heap_engine_remove_and_free,
+        .remove_due = heap_engine_remove_due,
+        .dump = heap_engine_dump,
+        .id_bits = 8u * sizeof(pheap_node_id_t),
+};
+
+static void wheel_engine_create(alarm_pool_t *pool, uint max_timers) {
+    pool->wheel = tw_create(max_timers, time_us_64());
+}
+
+static void wheel_engine_destroy(alarm_pool_t *pool) {
+    tw_destroy(pool->wheel);
+}
+
+static uint wheel_engine_new_id(alarm_pool_t *pool) {
+    return tw_new_node(pool->wheel);
+}
+
+static void wheel_engine_free_id(alarm_pool_t *pool, uint id) {
+    tw_free_node(pool->wheel, (tw_node_id_t)id);
+}
+
+static bool wheel_engine_insert(alarm_pool_t *pool, uint id) {
+    // the hardware alarm is always set to (at or before) the lower bound of the wheel, so it only needs
+    // updating if the new alarm comes before that
+    uint64_t bound = tw_next_key_bound(pool->wheel);
+    uint64_t fire_us = get_fire_time_us(get_entry(pool, id));
+    tw_insert_node(pool->wheel, (tw_node_id_t)id, fire_us);
+    return fire_us < bound;
+}
+
+static bool wheel_engine_contains(alarm_pool_t *pool, uint id) {
+    return tw_contains_node(pool->wheel, (tw_node_id_t)id);
+}
+
+static bool wheel_engine_remove_and_free(alarm_pool_t *pool, uint id) {
+    return tw_remove_and_free_node(pool->wheel, (tw_node_id_t)id);
+}
+
+static uint wheel_engine_remove_due(alarm_pool_t *pool, uint64_t now_us, uint64_t *next_us) {
+    tw_advance(pool->wheel, now_us);
+    // we don't free the id in case we need to re-add the timer
+    uint id = tw_remove_expired(pool->wheel, false);
+    // note the bound may be earlier than the next alarm, in which case the IRQ will just move the wheel on
+    if (!id) *next_us = tw_next_key_bound(pool->wheel);
+    return id;
+}
+
+static void wheel_engine_dump_key(tw_node_id_t id, void *user_data) {
+    alarm_pool_dump_key(id, user_data);
+}
+
+static void wheel_engine_dump(alarm_pool_t *pool) {
+    tw_dump(pool->wheel, wheel_engine_dump_key, pool);
+}
+
+static const alarm_pool_engine_t wheel_engine = {
+        .create = wheel_engine_create,
+        .destroy = wheel_engine_destroy,
+        .new_id = wheel_engine_new_id,
+        .free_id = wheel_engine_free_id,
+        .insert = wheel_engine_insert,
+        .contains = wheel_engine_contains,
+        .remove_and_free = wheel_engine_remove_and_free,
+        .remove_due = wheel_engine_remove_due,
+        .dump = wheel_engine_dump,
+        .id_bits = 8u * sizeof(tw_node_id_t),
+};
+
 #if !PICO_TIME_DEFAULT_ALARM_POOL_DISABLED
 // To avoid bringing in calloc, we statically allocate the arrays and the heap
 PHEAP_DEFINE_STATIC(default_alarm_pool_heap, PICO_TIME_DEFAULT_ALARM_POOL_MAX_TIMERS);
@@ -42,9 +301,11 @@ static uint8_t default_alarm_pool_entry_ids_high[PICO_TIME_DEFAULT_ALARM_POOL_MA
 static lock_core_t sleep_notifier;
 
 static alarm_pool_t default_alarm_pool = {
+        .engine = &heap_engine,
         .heap = &default_alarm_pool_heap,
         .entries = default_alarm_pool_entries,
         .entry_ids_high = default_alarm_pool_entry_ids_high,
+        .max_timers = PICO_TIME_DEFAULT_ALARM_POOL_MAX_TIMERS,
 };
 
 static inline bool default_alarm_pool_initialized(void) {
@@ -55,32 +316,12 @@ static inline bool default_alarm_pool_initialized(void) {
 static alarm_pool_t *pools[NUM_TIMERS];
 static void alarm_pool_post_alloc_init(alarm_pool_t *pool, uint hardware_alarm_num);
 
-
-static inline alarm_pool_entry_t *get_entry(alarm_pool_t *pool, pheap_node_id_t id) {
-    assert(id && id <= pool->heap->max_nodes);
-    return pool->entries + id - 1;
-}
-
-static inline uint8_t *get_entry_id_high(alarm_pool_t *pool, pheap_node_id_t id) {
-    assert(id && id <= pool->heap->max_nodes);
-    return pool->entry_ids_high + id - 1;
-}
-
-bool timer_pool_entry_comparator(void *user_data, pheap_node_id_t a, pheap_node_id_t b) {
-    alarm_pool_t *pool = (alarm_pool_t *)user_data;
-    return to_us_since_boot(get_entry(pool, a)->target) < to_us_since_boot(get_entry(pool, b)->target);
-}
-
-static inline alarm_id_t make_public_id(uint8_t id_high, pheap_node_id_t id) {
-    return (alarm_id_t)(((uint)id_high << 8u * sizeof(id)) | id);
-}
-
 void alarm_pool_init_default() {
 #if !PICO_TIME_DEFAULT_ALARM_POOL_DISABLED
     // allow multiple calls for ease of use from host tests
     if (!default_alarm_pool_initialized()) {
         ph_post_alloc_init(default_alarm_pool.heap, PICO_TIME_DEFAULT_ALARM_POOL_MAX_TIMERS,
-                           timer_pool_entry_comparator, &default_alarm_pool);
+                           ALARM_POOL_HEAP_COMPARATOR, &default_alarm_pool);
         hardware_alarm_claim(PICO_TIME_DEFAULT_ALARM_POOL_HARDWARE_ALARM_NUM);
         alarm_pool_post_alloc_init(&default_alarm_pool,
                                    PICO_TIME_DEFAULT_ALARM_POOL_HARDWARE_ALARM_NUM);
@@ -89,6 +330,13 @@ void alarm_pool_init_default() {
 #endif
 }
 
+#if !PICO_TIME_DEFAULT_ALARM_POOL_DISABLED && PICO_HOST_TIMER_ALARM_THREAD
+// there is no runtime initialization on the host, so make sure the default alarm pool exists before main
+static void __attribute__((constructor)) host_alarm_pool_init_default(void) {
+    alarm_pool_init_default();
+}
+#endif
+
 #if !PICO_TIME_DEFAULT_ALARM_POOL_DISABLED
 alarm_pool_t *alarm_pool_get_default() {
     assert(default_alarm_pool_initialized());
@@ -96,31 +344,48 @@ alarm_pool_t *alarm_pool_get_default() {
 }
 #endif
 
-static pheap_node_id_t add_alarm_under_lock(alarm_pool_t *pool, absolute_time_t time, alarm_callback_t callback,
-                                       void *user_data, pheap_node_id_t reuse_id, bool create_if_past, bool *missed) {
-    pheap_node_id_t id;
-    if (reuse_id) {
-        assert(!ph_contains_node(pool->heap, reuse_id));
-        id = reuse_id;
-    } else {
-        id = ph_new_node(pool->heap);
-    }
+static uint add_alarm_under_lock(alarm_pool_t *pool, absolute_time_t time, uint32_t slack_us, alarm_callback_t callback,
+                                 void *user_data, bool create_if_past, bool *missed) {
+    uint id = pool->engine->new_id(pool);
     if (id) {
         alarm_pool_entry_t *entry = get_entry(pool, id);
         entry->target = time;
         entry->callback = callback;
         entry->user_data = user_data;
-        if (id == ph_insert_node(pool->heap, id)) {
-            bool is_missed = hardware_alarm_set_target(pool->hardware_alarm_num, time);
-            if (is_missed && !create_if_past) {
-                ph_remove_and_free_node(pool->heap, id);
+        entry->slack_us = slack_us;
+        stats_alarm_added(pool);
+        bool is_missed = false;
+        if (pool->engine->insert(pool, id)) {
+            absolute_time_t fire_time;
+            update_us_since_boot(&fire_time, get_fire_time_us(entry));
+            is_missed = hardware_alarm_set_target(pool->hardware_alarm_num, fire_time);
+            stats_alarm_check_missed(pool, time, is_missed);
+            if (is_missed) {
+                if (!create_if_past) {
+                    pool->engine->remove_and_free(pool, id);
+                    stats_alarm_removed(pool);
+                }
             }
-            if (missed) *missed = is_missed;
+        } else {
+            // behind an earlier alarm; the IRQ handler will fire it even if its time has already passed
+            stats_alarm_check_missed(pool, time, false);
         }
+        if (missed) *missed = is_missed;
     }
     return id;
 }
 
+// re-insert an alarm (whose id was kept) from the IRQ handler; the entry's callback and user_data are unchanged,
+// and there is no need to touch the hardware alarm, as the IRQ handler will set it before returning anyway
+static inline void reschedule_alarm_under_lock(alarm_pool_t *pool, uint id, absolute_time_t time) {
+    assert(!pool->engine->contains(pool, id));
+    get_entry(pool, id)->target = time;
+    pool->engine->insert(pool, id);
+    stats_alarm_added(pool);
+    stats_alarm_rescheduled(pool);
+    stats_alarm_check_missed(pool, time, false);
+}
+
 static void alarm_pool_alarm_callback(uint alarm_num) {
     // note this is called from timer IRQ handler
     alarm_pool_t *pool = pools[alarm_num];
@@ -131,42 +396,49 @@ static void alarm_pool_alarm_callback(uint alarm_num) {
         absolute_time_t target = nil_time;
         void *user_data = NULL;
         uint8_t id_high;
+        uint64_t next_us;
         again = false;
         uint32_t save = spin_lock_blocking(pool->lock);
-        pheap_node_id_t next_id = ph_peek_head(pool->heap);
+        uint next_id = pool->engine->remove_due(pool, to_us_since_boot(now), &next_us);
         if (next_id) {
+            stats_alarm_removed(pool);
             alarm_pool_entry_t *entry = get_entry(pool, next_id);
-            if (absolute_time_diff_us(now, entry->target) <= 0) {
-                // we don't free the id in case we need to re-add the timer
-                pheap_node_id_t __unused removed_id = ph_remove_head(pool->heap, false);
-                assert(removed_id == next_id); // will be true under lock
-                target = entry->target;
-                callback = entry->callback;
-                user_data = entry->user_data;
-                assert(callback);
-                id_high = *get_entry_id_high(pool, next_id);
-                pool->alarm_in_progress = make_public_id(id_high, removed_id);
-            } else {
-                if (hardware_alarm_set_target(alarm_num, entry->target)) {
-                    again = true;
-                }
+            target = entry->target;
+            callback = entry->callback;
+            user_data = entry->user_data;
+            assert(callback);
+            id_high = *get_entry_id_high(pool, next_id);
+            pool->alarm_in_progress = make_public_id(pool, id_high, next_id);
+        } else if (next_us != UINT64_MAX) {
+            absolute_time_t next;
+            update_us_since_boot(&next, next_us);
+            if (hardware_alarm_set_target(alarm_num, next)) {
+                again = true;
             }
         }
         spin_unlock(pool->lock, save);
         if (callback) {
-            int64_t repeat = callback(make_public_id(id_high, next_id), user_data);
+#if PICO_TIME_ALARM_POOL_STATS
+            uint64_t start_us = time_us_64();
+#endif
+            int64_t repeat = callback(make_public_id(pool, id_high, next_id), user_data);
+#if PICO_TIME_ALARM_POOL_STATS
+            uint64_t end_us = time_us_64();
+#endif
             save = spin_lock_blocking(pool->lock);
+#if PICO_TIME_ALARM_POOL_STATS
+            stats_alarm_fired(pool, to_us_since_boot(target), start_us, end_us);
+#endif
             // todo think more about whether we want to keep calling
             if (repeat < 0 && pool->alarm_in_progress) {
-                assert(pool->alarm_in_progress == make_public_id(id_high, next_id));
-                add_alarm_under_lock(pool, delayed_by_us(target, (uint64_t)-repeat), callback, user_data, next_id, true, NULL);
+                assert(pool->alarm_in_progress == make_public_id(pool, id_high, next_id));
+                reschedule_alarm_under_lock(pool, next_id, delayed_by_us(target, (uint64_t)-repeat));
             } else if (repeat > 0 && pool->alarm_in_progress) {
-                assert(pool->alarm_in_progress == make_public_id(id_high, next_id));
-                add_alarm_under_lock(pool, delayed_by_us(get_absolute_time(), (uint64_t)repeat), callback, user_data, next_id,
-                                     true, NULL);
+                assert(pool->alarm_in_progress == make_public_id(pool, id_high, next_id));
+                reschedule_alarm_under_lock(pool, next_id, delayed_by_us(get_absolute_time(), (uint64_t)repeat));
             } else {
                 // need to return the id to the heap
-                ph_free_node(pool->heap, next_id);
+                pool->engine->free_id(pool, next_id);
                 (*get_entry_id_high(pool, next_id))++; // we bump it for next use of id
             }
             pool->alarm_in_progress = 0;
@@ -176,22 +448,43 @@ static void alarm_pool_alarm_callback(uint alarm_num) {
     } while (again);
 }
 
-// note the timer is create with IRQs on this core
-alarm_pool_t *alarm_pool_create(uint hardware_alarm_num, uint max_timers) {
+static alarm_pool_t *alarm_pool_alloc(const alarm_pool_engine_t *engine, uint max_timers) {
     alarm_pool_t *pool = (alarm_pool_t *) malloc(sizeof(alarm_pool_t));
-    pool->heap = ph_create(max_timers, timer_pool_entry_comparator, pool);
+    pool->engine = engine;
+    engine->create(pool, max_timers);
     pool->entries = (alarm_pool_entry_t *)calloc(max_timers, sizeof(alarm_pool_entry_t));
     pool->entry_ids_high = (uint8_t *)calloc(max_timers, sizeof(uint8_t));
+    pool->alarm_in_progress = 0;
+    pool->max_timers = (uint16_t)max_timers;
+#if PICO_TIME_ALARM_POOL_STATS
+    memset(&pool->stats, 0, sizeof(pool->stats));
+#endif
+    return pool;
+}
+
+// note the timer is create with IRQs on this core
+alarm_pool_t *alarm_pool_create(uint hardware_alarm_num, uint max_timers) {
+    alarm_pool_t *pool = alarm_pool_alloc(&heap_engine, max_timers);
     hardware_alarm_claim(hardware_alarm_num);
     alarm_pool_post_alloc_init(pool, hardware_alarm_num);
     return pool;
 }
 
 alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(uint max_timers) {
-    alarm_pool_t *pool = (alarm_pool_t *) malloc(sizeof(alarm_pool_t));
-    pool->heap = ph_create(max_timers, timer_pool_entry_comparator, pool);
-    pool->entries = (alarm_pool_entry_t *)calloc(max_timers, sizeof(alarm_pool_entry_t));
-    pool->entry_ids_high = (uint8_t *)calloc(max_timers, sizeof(uint8_t));
+    alarm_pool_t *pool = alarm_pool_alloc(&heap_engine, max_timers);
+    alarm_pool_post_alloc_init(pool, (uint)hardware_alarm_claim_unused(true));
+    return pool;
+}
+
+alarm_pool_t *alarm_pool_create_timer_wheel(uint hardware_alarm_num, uint max_timers) {
+    alarm_pool_t *pool = alarm_pool_alloc(&wheel_engine, max_timers);
+    hardware_alarm_claim(hardware_alarm_num);
+    alarm_pool_post_alloc_init(pool, hardware_alarm_num);
+    return pool;
+}
+
+alarm_pool_t *alarm_pool_create_timer_wheel_with_unused_hardware_alarm(uint max_timers) {
+    alarm_pool_t *pool = alarm_pool_alloc(&wheel_engine, max_timers);
     alarm_pool_post_alloc_init(pool, (uint)hardware_alarm_claim_unused(true));
     return pool;
 }
@@ -215,7 +508,7 @@ void alarm_pool_destroy(alarm_pool_t *pool) {
     assert(pools[pool->hardware_alarm_num] == pool);
     pools[pool->hardware_alarm_num] = NULL;
     // todo clear out timers
-    ph_destroy(pool->heap);
+    pool->engine->destroy(pool);
     hardware_alarm_set_callback(pool->hardware_alarm_num, NULL);
     hardware_alarm_unclaim(pool->hardware_alarm_num);
     free(pool->entry_ids_high);
@@ -223,8 +516,8 @@ void alarm_pool_destroy(alarm_pool_t *pool) {
     free(pool);
 }
 
-alarm_id_t alarm_pool_add_alarm_at(alarm_pool_t *pool, absolute_time_t time, alarm_callback_t callback,
-                                   void *user_data, bool fire_if_past) {
+alarm_id_t alarm_pool_add_alarm_at_with_slack(alarm_pool_t *pool, absolute_time_t time, uint32_t slack_us,
+                                              alarm_callback_t callback, void *user_data, bool fire_if_past) {
     bool missed = false;
 
     alarm_id_t public_id;
@@ -232,7 +525,7 @@ alarm_id_t alarm_pool_add_alarm_at(alarm_pool_t *pool, absolute_time_t time, ala
         uint8_t id_high = 0;
         uint32_t save = spin_lock_blocking(pool->lock);
 
-        pheap_node_id_t id = add_alarm_under_lock(pool, time, callback, user_data, 0, false, &missed);
+        uint id = add_alarm_under_lock(pool, time, slack_us, callback, user_data, false, &missed);
         if (id) id_high = *get_entry_id_high(pool, id);
 
         spin_unlock(pool->lock, save);
@@ -244,7 +537,7 @@ alarm_id_t alarm_pool_add_alarm_at(alarm_pool_t *pool, absolute_time_t time, ala
 
         // note that if missed was true, then the id was never added to the pheap (because we
         // passed false for create_if_past arg above)
-        public_id = missed ? 0 : make_public_id(id_high, id);
+        public_id = missed ? 0 : make_public_id(pool, id_high, id);
         if (missed && fire_if_past) {
             // ... so if fire_if_past == true we call the callback
             int64_t repeat = callback(public_id, user_data);
@@ -270,6 +563,11 @@ alarm_id_t alarm_pool_add_alarm_at(alarm_pool_t *pool, absolute_time_t time, ala
     return public_id;
 }
 
+alarm_id_t alarm_pool_add_alarm_at(alarm_pool_t *pool, absolute_time_t time, alarm_callback_t callback,
+                                   void *user_data, bool fire_if_past) {
+    return alarm_pool_add_alarm_at_with_slack(pool, time, 0, callback, user_data, fire_if_past);
+}
+
 alarm_id_t alarm_pool_add_alarm_at_force_in_context(alarm_pool_t *pool, absolute_time_t time, alarm_callback_t callback,
                                                     void *user_data) {
     bool missed = false;
@@ -277,7 +575,7 @@ alarm_id_t alarm_pool_add_alarm_at_force_in_context(alarm_pool_t *pool, absolute
     uint8_t id_high = 0;
     uint32_t save = spin_lock_blocking(pool->lock);
 
-    pheap_node_id_t id = add_alarm_under_lock(pool, time, callback, user_data, 0, true, &missed);
+    uint id = add_alarm_under_lock(pool, time, 0, callback, user_data, true, &missed);
     if (id) id_high = *get_entry_id_high(pool, id);
     spin_unlock(pool->lock, save);
     if (!id) return -1;
@@ -287,19 +585,20 @@ alarm_id_t alarm_pool_add_alarm_at_force_in_context(alarm_pool_t *pool, absolute
         // wake up one time too many, we just need to make sure it does wake up
         hardware_alarm_force_irq(pool->hardware_alarm_num);
     }
-    return make_public_id(id_high, id);
+    return make_public_id(pool, id_high, id);
 }
 
 bool alarm_pool_cancel_alarm(alarm_pool_t *pool, alarm_id_t alarm_id) {
     bool rc = false;
     uint32_t save = spin_lock_blocking(pool->lock);
-    pheap_node_id_t id = (pheap_node_id_t) alarm_id;
-    if (ph_contains_node(pool->heap, id)) {
+    uint id = (uint)alarm_id & ((1u << pool->engine->id_bits) - 1u);
+    if (id && id <= pool->max_timers && pool->engine->contains(pool, id)) {
         assert(alarm_id != pool->alarm_in_progress); // it shouldn't be in the heap if it is in progress
         // check we have the right high value
-        uint8_t id_high = (uint8_t)((uint)alarm_id >> 8u * sizeof(pheap_node_id_t));
+        uint8_t id_high = (uint8_t)((uint)alarm_id >> pool->engine->id_bits);
         if (id_high == *get_entry_id_high(pool, id)) {
-            rc = ph_remove_and_free_node(pool->heap, id);
+            rc = pool->engine->remove_and_free(pool, id);
+            stats_alarm_removed(pool);
             // note we don't bother to remove the actual hardware alarm timeout...
             // it will either do callbacks or not depending on other alarms, and reset the next timeout itself
             assert(rc);
@@ -322,15 +621,6 @@ uint alarm_pool_core_num(alarm_pool_t *pool) {
     return pool->core_num;
 }
 
-static void alarm_pool_dump_key(pheap_node_id_t id, void *user_data) {
-    alarm_pool_t *pool = (alarm_pool_t *)user_data;
-#if PICO_ON_DEVICE
-    printf("%lld (hi %02x)", to_us_since_boot(get_entry(pool, id)->target), *get_entry_id_high(pool, id));
-#else
-    printf("%"PRIu64, to_us_since_boot(get_entry(pool, id)->target));
-#endif
-}
-
 static int64_t repeating_timer_callback(__unused alarm_id_t id, void *user_data) {
     repeating_timer_t *rt = (repeating_timer_t *)user_data;
     assert(rt->alarm_id == id);
@@ -342,19 +632,25 @@ static int64_t repeating_timer_callback(__unused alarm_id_t id, void *user_data)
     }
 }
 
-bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out) {
+bool alarm_pool_add_repeating_timer_us_with_slack(alarm_pool_t *pool, int64_t delay_us, uint32_t slack_us,
+                                                  repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out) {
     if (!delay_us) delay_us = 1;
     out->pool = pool;
     out->callback = callback;
     out->delay_us = delay_us;
     out->user_data = user_data;
-    out->alarm_id = alarm_pool_add_alarm_at(pool, make_timeout_time_us((uint64_t)(delay_us >= 0 ? delay_us : -delay_us)),
-                                            repeating_timer_callback, out, true);
+    // note the slack is kept with the alarm, so applies to every repeat
+    out->alarm_id = alarm_pool_add_alarm_at_with_slack(pool, make_timeout_time_us((uint64_t)(delay_us >= 0 ? delay_us : -delay_us)),
+                                                       slack_us, repeating_timer_callback, out, true);
     // note that if out->alarm_id is 0, then the callback was called during the above call (fire_if_past == true)
     // and then the callback removed itself.
     return out->alarm_id >= 0;
 }
 
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out) {
+    return alarm_pool_add_repeating_timer_us_with_slack(pool, delay_us, 0, callback, user_data, out);
+}
+
 bool cancel_repeating_timer(repeating_timer_t *timer) {
     bool rc = false;
     if (timer->alarm_id) {
@@ -366,10 +662,48 @@ bool cancel_repeating_timer(repeating_timer_t *timer) {
 
 void alarm_pool_dump(alarm_pool_t *pool) {
     uint32_t save = spin_lock_blocking(pool->lock);
-    ph_dump(pool->heap, alarm_pool_dump_key, pool);
+    pool->engine->dump(pool);
+    spin_unlock(pool->lock, save);
+}
+
+#if PICO_TIME_ALARM_POOL_STATS
+void alarm_pool_get_stats(alarm_pool_t *pool, alarm_pool_stats_t *stats) {
+    uint32_t save = spin_lock_blocking(pool->lock);
+    *stats = pool->stats;
+    spin_unlock(pool->lock, save);
+}
+
+void alarm_pool_reset_stats(alarm_pool_t *pool) {
+    uint32_t save = spin_lock_blocking(pool->lock);
+    uint32_t pending = pool->stats.pending;
+    memset(&pool->stats, 0, sizeof(pool->stats));
+    pool->stats.pending = pool->stats.peak_pending = pending;
     spin_unlock(pool->lock, save);
 }
 
+void alarm_pool_print_stats(alarm_pool_t *pool) {
+    // take a copy, so we don't hold the lock while printing
+    alarm_pool_stats_t stats;
+    alarm_pool_get_stats(pool, &stats);
+    printf("alarm pool (hardware alarm %d, core %d): pending %u (peak %u of %u), fired %u, missed %u, rescheduled %u\n",
+           pool->hardware_alarm_num, pool->core_num, (uint)stats.pending, (uint)stats.peak_pending, pool->max_timers,
+           (uint)stats.fired, (uint)stats.missed, (uint)stats.rescheduled);
+    printf("  %-16s %10s %10s\n", "time (us)", "latency", "callback");
+    for (uint i = 0; i < PICO_TIME_ALARM_POOL_STATS_HISTOGRAM_BUCKETS; i++) {
+        if (!stats.fire_latency_histogram[i] && !stats.callback_time_histogram[i]) continue;
+        char range[24];
+        if (!i) {
+            snprintf(range, sizeof(range), "0");
+        } else if (i == PICO_TIME_ALARM_POOL_STATS_HISTOGRAM_BUCKETS - 1) {
+            snprintf(range, sizeof(range), ">= %"PRIu64, (uint64_t)1 << (i - 1));
+        } else {
+            snprintf(range, sizeof(range), "%"PRIu64"-%"PRIu64, (uint64_t)1 << (i - 1), ((uint64_t)1 << i) - 1);
+        }
+        printf("  %-16s %10u %10u\n", range, (uint)stats.fire_latency_histogram[i], (uint)stats.callback_time_histogram[i]);
+    }
+}
+#endif
+
 #if !PICO_TIME_DEFAULT_ALARM_POOL_DISABLED
 static int64_t sleep_until_callback(__unused alarm_id_t id, __unused void *user_data) {
     uint32_t save = spin_lock_blocking(sleep_notifier.spin_lock);
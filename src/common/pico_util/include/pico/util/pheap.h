@@ -48,7 +48,15 @@ typedef uint16_t pheap_node_id_t;
 #error invalid PICO_PHEAP_MAX_ENTRIES
 #endif
 
+// PICO_CONFIG: PICO_PHEAP_INLINE_KEY, Store a 64 bit key in each pheap node alongside the links so heaps can be ordered without a comparator callback, type=bool, default=0, group=pico_util
+#ifndef PICO_PHEAP_INLINE_KEY
+#define PICO_PHEAP_INLINE_KEY 0
+#endif
+
 typedef struct pheap_node {
+#if PICO_PHEAP_INLINE_KEY
+    uint64_t key;
+#endif
     pheap_node_id_t child, sibling, parent;
 } pheap_node_t;
 
@@ -56,6 +64,10 @@ typedef struct pheap_node {
  * A user comparator function for nodes in a pairing heap.
  *
  * \return true if a < b in natural order. Note this relative ordering must be stable from call to call.
+ *
+ * \note If PICO_PHEAP_INLINE_KEY is set, a heap may instead be created with a NULL comparator, in which case
+ * nodes are ordered by the key set with ph_set_key(). This avoids a function call and an indirection into the
+ * user's companion array for every comparison.
  */
 typedef bool (*pheap_comparator)(void *user_data, pheap_node_id_t a, pheap_node_id_t b);
 
@@ -79,7 +91,7 @@ typedef struct pheap {
  * \param max_nodes the maximum number of nodes that may be in the heap (this is bounded by
  *                  PICO_PHEAP_MAX_ENTRIES which defaults to 255 to be able to store indexes
  *                  in a single byte).
- * \param comparator the node comparison function
+ * \param comparator the node comparison function (or NULL to order by inline key if PICO_PHEAP_INLINE_KEY is set)
  * \param user_data a user data pointer associated with the heap that is provided in callbacks
  * \return a newly allocated and initialized heap
  */
@@ -105,6 +117,39 @@ static inline pheap_node_t *ph_get_node(pheap_t *heap, pheap_node_id_t id) {
     return heap->nodes + id - 1;
 }
 
+#if PICO_PHEAP_INLINE_KEY
+/**
+ * Set the inline key of a node. This must be done before the node is inserted into the heap (or
+ * before calling ph_decrease_key())
+ *
+ * \param heap the heap
+ * \param id the id of the node
+ * \param key the key
+ */
+static inline void ph_set_key(pheap_t *heap, pheap_node_id_t id, uint64_t key) {
+    ph_get_node(heap, id)->key = key;
+}
+
+/**
+ * Get the inline key of a node
+ *
+ * \param heap the heap
+ * \param id the id of the node
+ * \return the key
+ */
+static inline uint64_t ph_get_key(pheap_t *heap, pheap_node_id_t id) {
+    return ph_get_node(heap, id)->key;
+}
+#endif
+
+// internal method
+static inline bool ph_node_less(pheap_t *heap, pheap_node_id_t a, pheap_node_id_t b) {
+#if PICO_PHEAP_INLINE_KEY
+    if (!heap->comparator) return ph_get_node(heap, a)->key < ph_get_node(heap, b)->key;
+#endif
+    return heap->comparator(heap->user_data, a, b);
+}
+
 // internal method
 static void ph_add_child_node(pheap_t *heap, pheap_node_id_t parent_id, pheap_node_id_t child_id) {
     pheap_node_t *n = ph_get_node(heap, parent_id);
@@ -125,7 +170,7 @@ static void ph_add_child_node(pheap_t *heap, pheap_node_id_t parent_id, pheap_no
 static pheap_node_id_t ph_merge_nodes(pheap_t *heap, pheap_node_id_t a, pheap_node_id_t b) {
     if (!a) return b;
     if (!b) return a;
-    if (heap->comparator(heap->user_data, a, b)) {
+    if (ph_node_less(heap, a, b)) {
         ph_add_child_node(heap, a, b);
         return a;
     } else {
@@ -169,6 +214,33 @@ static inline pheap_node_id_t ph_insert_node(pheap_t *heap, pheap_node_id_t id)
     return heap->root_id;
 }
 
+/**
+ * Inserts a number of nodes into the heap.
+ *
+ * This is equivalent to calling ph_insert_node() for each node, but the new nodes are first
+ * paired up amongst themselves, which leaves a better balanced heap (and so makes subsequent removals
+ * cheaper) than inserting them one by one.
+ *
+ * \param heap the heap
+ * \param ids the ids of the nodes to insert (previously allocated by ph_new_node())
+ * \param count the number of nodes to insert
+ * \return the id of the new head of the pairing heap (i.e. node that compares first)
+ */
+pheap_node_id_t ph_insert_batch(pheap_t *heap, const pheap_node_id_t *ids, uint count);
+
+/**
+ * Restore the heap ordering after a node's key has been decreased (i.e. after the node's ordering has changed
+ * such that it compares earlier than it did before)
+ *
+ * This is considerably cheaper than removing the node and re-inserting it, as the node's subtree is simply
+ * cut from its parent and merged with the root.
+ *
+ * \param heap the heap
+ * \param id the id of the node whose key has decreased (which must be in the heap)
+ * \return the id of the new head of the pairing heap (i.e. node that compares first)
+ */
+pheap_node_id_t ph_decrease_key(pheap_t *heap, pheap_node_id_t id);
+
 /**
  * Returns the head node in the heap, i.e. the node
  * which compares first, but without removing it from the heap.
@@ -189,6 +189,32 @@ bool queue_try_remove(queue_t *q, void *data);
  */
 bool queue_try_peek(queue_t *q, void *data);
 
+/*! \brief Non-blocking add of multiple values to the queue
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \param data Pointer to an array of values to be copied into the queue
+ * \param count Number of values in the array
+ * \return the number of values that were added, which may be less than count (or zero) if the queue fills up
+ *
+ * The values that fit are copied into the queue (in order) under a single acquisition of the queue's spin lock,
+ * with a single notification of any waiters.
+ */
+uint queue_try_add_n(queue_t *q, const void *data, uint count);
+
+/*! \brief Non-blocking removal of multiple entries from the queue
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \param data Pointer to an array to receive the removed values
+ * \param count Maximum number of values to remove
+ * \return the number of values that were removed, which may be less than count (or zero) if the queue empties
+ *
+ * The values are copied out of the queue (in order) under a single acquisition of the queue's spin lock,
+ * with a single notification of any waiters.
+ */
+uint queue_try_remove_n(queue_t *q, void *data, uint count);
+
 // blocking queue access functions:
 
 /*! \brief Blocking add of value to queue
@@ -221,6 +247,150 @@ void queue_remove_blocking(queue_t *q, void *data);
  */
 void queue_peek_blocking(queue_t *q, void *data);
 
+/*! \brief Blocking add of multiple values to the queue
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \param data Pointer to an array of values to be copied into the queue
+ * \param count Number of values in the array
+ *
+ * As many values as will fit are added at a time; if the queue is full this function will block until
+ * a removal happens on the queue, and continue until all count values have been added.
+ */
+void queue_add_n_blocking(queue_t *q, const void *data, uint count);
+
+/*! \brief Blocking removal of multiple entries from the queue
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \param data Pointer to an array to receive the removed values
+ * \param count Number of values to remove
+ *
+ * As many values as are available are removed at a time; if the queue is empty this function will block until
+ * a value is added, and continue until all count values have been removed.
+ */
+void queue_remove_n_blocking(queue_t *q, void *data, uint count);
+
+// zero-copy queue access functions:
+
+/*! \brief Non-blocking reservation of a contiguous span of free entries in the queue, for the caller to fill in place
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \param ptr Pointer to the location to receive the address of the first reserved entry within the queue's storage
+ * \param max_count Maximum number of entries to reserve
+ * \return the number of contiguous entries available at *ptr, which may be less than max_count (or zero) if the
+ * queue is nearly full, or if the free space wraps around the end of the queue's storage
+ *
+ * The reserved entries do not become visible to consumers until they are committed with \ref queue_commit_n. This
+ * allows the producer (or a DMA channel) to write large values directly into the queue without an intermediate copy.
+ *
+ * \note Only one reservation may be outstanding at a time, and no other values may be added to the queue
+ * until it has been committed.
+ */
+uint queue_try_reserve_span(queue_t *q, void **ptr, uint max_count);
+
+/*! \brief Non-blocking reservation of a single free entry in the queue, for the caller to fill in place
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \return the address of the reserved entry within the queue's storage, or NULL if the queue is full
+ *
+ * \see queue_try_reserve_span
+ */
+static inline void *queue_try_reserve(queue_t *q) {
+    void *ptr;
+    return queue_try_reserve_span(q, &ptr, 1) ? ptr : NULL;
+}
+
+/*! \brief Blocking reservation of a single free entry in the queue, for the caller to fill in place
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \return the address of the reserved entry within the queue's storage
+ *
+ * If the queue is full this function will block, until a removal happens on the queue
+ *
+ * \see queue_try_reserve_span
+ */
+void *queue_reserve_blocking(queue_t *q);
+
+/*! \brief Make previously reserved entries visible to consumers
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \param count Number of reserved entries (starting from the first) that have been filled in, and should be added
+ * to the queue. This must not be more than the number of entries that were reserved
+ */
+void queue_commit_n(queue_t *q, uint count);
+
+/*! \brief Make a previously reserved entry visible to consumers
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ */
+static inline void queue_commit(queue_t *q) {
+    queue_commit_n(q, 1);
+}
+
+/*! \brief Non-blocking access to a contiguous span of entries at the front of the queue, for the caller to read in place
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \param ptr Pointer to the location to receive the address of the first entry within the queue's storage
+ * \param max_count Maximum number of entries to return
+ * \return the number of contiguous entries available at *ptr, which may be less than max_count (or zero) if the
+ * queue contains fewer entries, or if they wrap around the end of the queue's storage
+ *
+ * The entries remain in the queue until they are released with \ref queue_release_n.
+ *
+ * \note Only one peeked span may be outstanding at a time, and no other values may be removed from the queue
+ * until it has been released.
+ */
+uint queue_try_peek_span(queue_t *q, const void **ptr, uint max_count);
+
+/*! \brief Non-blocking access to the entry at the front of the queue, for the caller to read in place
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \return the address of the entry within the queue's storage, or NULL if the queue is empty
+ *
+ * \see queue_try_peek_span
+ */
+static inline const void *queue_try_peek_ptr(queue_t *q) {
+    const void *ptr;
+    return queue_try_peek_span(q, &ptr, 1) ? ptr : NULL;
+}
+
+/*! \brief Blocking access to the entry at the front of the queue, for the caller to read in place
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \return the address of the entry within the queue's storage
+ *
+ * If the queue is empty this function will block until a value is added.
+ *
+ * \see queue_try_peek_span
+ */
+const void *queue_peek_ptr_blocking(queue_t *q);
+
+/*! \brief Remove entries previously accessed via \ref queue_try_peek_span from the queue
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ * \param count Number of entries to remove. This must not be more than the number of entries that were returned
+ */
+void queue_release_n(queue_t *q, uint count);
+
+/*! \brief Remove the entry previously accessed via \ref queue_try_peek_ptr or \ref queue_peek_ptr_blocking from the queue
+ *  \ingroup queue
+ *
+ * \param q Pointer to a queue_t structure, used as a handle
+ */
+static inline void queue_release(queue_t *q) {
+    queue_release_n(q, 1);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_UTIL_RING_BUFFER_H
+#define _PICO_UTIL_RING_BUFFER_H
+
+#include "pico.h"
+#include "hardware/sync.h"
+
+/** \file ring_buffer.h
+ * \defgroup ring_buffer ring_buffer
+ * Lock-free single-producer single-consumer byte ring buffer.
+ *
+ * Unlike \ref spsc_queue, which moves fixed size elements, a ring_buffer moves arbitrary runs of bytes, and the
+ * consumer can access the buffered bytes in place (see \ref ring_buffer_peek_contiguous) to hand them on in large
+ * chunks without copying them first.
+ *
+ * The read and write indices run freely (wrapping at 2^32), and the buffer size must be a power of two, so the
+ * whole buffer can be used, and the level is just the difference of the two indices.
+ *
+ * \note Calling the write functions from more than one producer concurrently, or the read/peek/consume functions
+ * from more than one consumer concurrently, is not safe; the caller must serialize each side itself.
+ * \ingroup pico_util
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t *data;
+    uint32_t mask;
+    // written only by the producer
+    volatile uint32_t wptr;
+    // written only by the consumer
+    volatile uint32_t rptr;
+} ring_buffer_t;
+
+/*! \brief Static initializer for a ring buffer, equivalent to calling \ref ring_buffer_init
+ *  \ingroup ring_buffer
+ *
+ * \param storage The buffer storage, which must remain valid for the lifetime of the ring buffer
+ * \param size The size of the storage in bytes, which must be a power of two
+ */
+#define RING_BUFFER_STATIC_INIT(storage, size) { .data = (storage), .mask = (size) - 1, .wptr = 0, .rptr = 0 }
+
+/*! \brief Initialise a ring buffer
+ *  \ingroup ring_buffer
+ *
+ * \param rb Pointer to a ring_buffer_t structure, used as a handle
+ * \param storage The buffer storage, which must remain valid for the lifetime of the ring buffer
+ * \param size The size of the storage in bytes, which must be a power of two
+ */
+void ring_buffer_init(ring_buffer_t *rb, uint8_t *storage, uint size);
+
+/*! \brief Return the capacity of the ring buffer
+ *  \ingroup ring_buffer
+ *
+ * \param rb Pointer to a ring_buffer_t structure, used as a handle
+ * \return the size of the ring buffer in bytes
+ */
+static inline uint ring_buffer_get_size(const ring_buffer_t *rb) {
+    return rb->mask + 1;
+}
+
+/*! \brief Return the number of bytes in the ring buffer
+ *  \ingroup ring_buffer
+ *
+ * \param rb Pointer to a ring_buffer_t structure, used as a handle
+ * \return Number of bytes in the ring buffer
+ *
+ * The value returned is exact when called from the producer or consumer, though it may be stale
+ * by the time it is used if the other side is concurrently writing or reading.
+ */
+static inline uint ring_buffer_get_level(const ring_buffer_t *rb) {
+    return rb->wptr - rb->rptr;
+}
+
+/*! \brief Return the number of bytes which can currently be written to the ring buffer
+ *  \ingroup ring_buffer
+ *
+ * \param rb Pointer to a ring_buffer_t structure, used as a handle
+ * \return Number of free bytes in the ring buffer
+ */
+static inline uint ring_buffer_get_free(const ring_buffer_t *rb) {
+    return ring_buffer_get_size(rb) - ring_buffer_get_level(rb);
+}
+
+/*! \brief Check if the ring buffer is empty
+ *  \ingroup ring_buffer
+ *
+ * \param rb Pointer to a ring_buffer_t structure, used as a handle
+ * \return true if the ring buffer is empty
+ */
+static inline bool ring_buffer_is_empty(const ring_buffer_t *rb) {
+    return rb->wptr == rb->rptr;
+}
+
+/*! \brief Write as many bytes as will fit to the ring buffer without blocking
+ *  \ingroup ring_buffer
+ *
+ * \param rb Pointer to a ring_buffer_t structure, used as a handle
+ * \param src The bytes to write
+ * \param len The number of bytes to write
+ * \return the number of bytes written, which is less than len if the ring buffer became full
+ */
+uint ring_buffer_try_write(ring_buffer_t *rb, const void *src, uint len);
+
+/*! \brief Read up to len bytes from the ring buffer without blocking
+ *  \ingroup ring_buffer
+ *
+ * \param rb Pointer to a ring_buffer_t structure, used as a handle
+ * \param dst Buffer to copy the bytes to
+ * \param len The maximum number of bytes to read
+ * \return the number of bytes read, which is 0 if the ring buffer was empty
+ */
+uint ring_buffer_try_read(ring_buffer_t *rb, void *dst, uint len);
+
+/*! \brief Access the oldest bytes in the ring buffer in place
+ *  \ingroup ring_buffer
+ *
+ * Returns the longest run of buffered bytes which is contiguous in the storage (i.e. up to the end of the buffered
+ * data, or to the point the data wraps to the start of the storage). The bytes remain in the ring buffer, and
+ * remain valid until they are removed by \ref ring_buffer_consume.
+ *
+ * \param rb Pointer to a ring_buffer_t structure, used as a handle
+ * \param data Set to point to the first buffered byte
+ * \return the number of contiguous bytes available at *data, which is 0 if the ring buffer is empty
+ */
+uint ring_buffer_peek_contiguous(ring_buffer_t *rb, const uint8_t **data);
+
+/*! \brief Remove bytes from the ring buffer
+ *  \ingroup ring_buffer
+ *
+ * \param rb Pointer to a ring_buffer_t structure, used as a handle
+ * \param len The number of bytes to remove, which must not exceed the level of the ring buffer
+ */
+void ring_buffer_consume(ring_buffer_t *rb, uint len);
+
+/*! \brief Write bytes to the ring buffer, blocking until they have all been written
+ *  \ingroup ring_buffer
+ *
+ * \param rb Pointer to a ring_buffer_t structure, used as a handle
+ * \param src The bytes to write
+ * \param len The number of bytes to write
+ */
+void ring_buffer_write_blocking(ring_buffer_t *rb, const void *src, uint len);
+
+/*! \brief Read bytes from the ring buffer, blocking until len bytes have been read
+ *  \ingroup ring_buffer
+ *
+ * \param rb Pointer to a ring_buffer_t structure, used as a handle
+ * \param dst Buffer to copy the bytes to
+ * \param len The number of bytes to read
+ */
+void ring_buffer_read_blocking(ring_buffer_t *rb, void *dst, uint len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_UTIL_SPSC_QUEUE_H
+#define _PICO_UTIL_SPSC_QUEUE_H
+
+#include "pico.h"
+#include "hardware/sync.h"
+#include "pico/util/queue.h"
+
+/** \file spsc_queue.h
+ * \defgroup spsc_queue spsc_queue
+ * Lock-free single-producer single-consumer queue implementation.
+ *
+ * This is a variant of \ref queue for the common case where there is exactly one producer (e.g. an IRQ handler
+ * or one core) and exactly one consumer (e.g. the other core). Because each index is only ever written by one side,
+ * no spin lock is needed; elements are handed off with an acquire/release pair around the index updates.
+ *
+ * As with \ref queue, pushed values are copied into the queue.
+ *
+ * \note Calling the add functions from more than one producer concurrently, or the remove/peek functions
+ * from more than one consumer concurrently, is not safe; use \ref queue in that case.
+ * \ingroup pico_util
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t *data;
+    // written only by the producer
+    volatile uint16_t wptr;
+    // written only by the consumer
+    volatile uint16_t rptr;
+    uint16_t element_size;
+    uint16_t element_count;
+#if PICO_QUEUE_MAX_LEVEL
+    // written only by the producer
+    uint16_t max_level;
+#endif
+} spsc_queue_t;
+
+/*! \brief Initialise a single-producer single-consumer queue
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ * \param element_size Size of each value in the queue
+ * \param element_count Maximum number of entries in the queue
+ */
+void spsc_queue_init(spsc_queue_t *q, uint element_size, uint element_count);
+
+/*! \brief Destroy the specified queue.
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ *
+ * Does not deallocate the spsc_queue_t structure itself.
+ */
+void spsc_queue_free(spsc_queue_t *q);
+
+/*! \brief Check of level of the specified queue.
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ * \return Number of entries in the queue
+ *
+ * The value returned is exact when called from the producer or consumer, though it may be stale
+ * by the time it is used if the other side is concurrently adding or removing entries.
+ */
+static inline uint spsc_queue_get_level(spsc_queue_t *q) {
+    int32_t rc = (int32_t)q->wptr - (int32_t)q->rptr;
+    if (rc < 0) {
+        rc += q->element_count + 1;
+    }
+    return (uint)rc;
+}
+
+#if PICO_QUEUE_MAX_LEVEL
+/*! \brief Returns the highest level reached by the specified queue since it was created
+ *         or since the max level was reset
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ * \return Maximum level of the queue
+ */
+static inline uint spsc_queue_get_max_level(spsc_queue_t *q) {
+    return q->max_level;
+}
+
+/*! \brief Reset the highest level reached of the specified queue.
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ *
+ * This should only be called by the producer.
+ */
+static inline void spsc_queue_reset_max_level(spsc_queue_t *q) {
+    q->max_level = (uint16_t)spsc_queue_get_level(q);
+}
+#endif
+
+/*! \brief Check if queue is empty
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ * \return true if queue is empty, false otherwise
+ */
+static inline bool spsc_queue_is_empty(spsc_queue_t *q) {
+    return q->wptr == q->rptr;
+}
+
+/*! \brief Check if queue is full
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ * \return true if queue is full, false otherwise
+ */
+static inline bool spsc_queue_is_full(spsc_queue_t *q) {
+    return spsc_queue_get_level(q) == q->element_count;
+}
+
+// nonblocking queue access functions:
+
+/*! \brief Non-blocking add value queue if not full
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ * \param data Pointer to value to be copied into the queue
+ * \return true if the value was added
+ *
+ * If the queue is full this function will return immediately with false, otherwise
+ * the data is copied into a new value added to the queue, and this function will return true.
+ *
+ * This function must only be called by the producer.
+ */
+bool spsc_queue_try_add(spsc_queue_t *q, const void *data);
+
+/*! \brief Non-blocking removal of entry from the queue if non empty
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ * \param data Pointer to the location to receive the removed value
+ * \return true if a value was removed
+ *
+ * If the queue is not empty function will copy the removed value into the location provided and return
+ * immediately with true, otherwise the function will return immediately with false.
+ *
+ * This function must only be called by the consumer.
+ */
+bool spsc_queue_try_remove(spsc_queue_t *q, void *data);
+
+/*! \brief Non-blocking peek at the next item to be removed from the queue
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ * \param data Pointer to the location to receive the peeked value
+ * \return true if there was a value to peek
+ *
+ * If the queue is not empty this function will return immediately with true with the peeked entry
+ * copied into the location specified by the data parameter, otherwise the function will return false.
+ *
+ * This function must only be called by the consumer.
+ */
+bool spsc_queue_try_peek(spsc_queue_t *q, void *data);
+
+// blocking queue access functions:
+
+/*! \brief Blocking add of value to queue
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ * \param data Pointer to value to be copied into the queue
+ *
+ * If the queue is full this function will block, until a removal happens on the queue
+ */
+void spsc_queue_add_blocking(spsc_queue_t *q, const void *data);
+
+/*! \brief Blocking remove entry from queue
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ * \param data Pointer to the location to receive the removed value
+ *
+ * If the queue is empty this function will block until a value is added.
+ */
+void spsc_queue_remove_blocking(spsc_queue_t *q, void *data);
+
+/*! \brief Blocking peek at next value to be removed from queue
+ *  \ingroup spsc_queue
+ *
+ * \param q Pointer to a spsc_queue_t structure, used as a handle
+ * \param data Pointer to the location to receive the peeked value
+ *
+ * If the queue is empty function will block until a value is added
+ */
+void spsc_queue_peek_blocking(spsc_queue_t *q, void *data);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
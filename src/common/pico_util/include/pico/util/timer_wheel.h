@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_UTIL_TIMER_WHEEL_H
+#define _PICO_UTIL_TIMER_WHEEL_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// PICO_CONFIG: PARAM_ASSERTIONS_ENABLED_TIMER_WHEEL, Enable/disable assertions in the timer_wheel module, type=bool, default=0, group=pico_util
+#ifndef PARAM_ASSERTIONS_ENABLED_TIMER_WHEEL
+#define PARAM_ASSERTIONS_ENABLED_TIMER_WHEEL 0
+#endif
+
+/**
+ * \file timer_wheel.h
+ * \defgroup util_timer_wheel timer_wheel
+ * Hierarchical Timing Wheel Implementation
+ * \ingroup pico_util
+ *
+ * timer_wheel defines a hierarchical timing wheel, which keeps track of nodes each with a 64 bit key
+ * (typically a time in microseconds), and allows the nodes whose keys have been reached to be retrieved in key order.
+ *
+ * Unlike \ref util_pheap, insertion and removal of arbitrary nodes are O(1) operations, and no comparator callbacks
+ * are made, making it suitable for large numbers of timeouts which are mostly cancelled before they expire.
+ *
+ * Each of the PICO_TIMER_WHEEL_LEVELS levels of the wheel has 64 slots; level 0 slots are 1 key unit wide, and
+ * each subsequent level has slots 64 times wider than the level below. Nodes whose keys are further in the future
+ * than the wheel covers are parked in the top level, and re-filed when it rotates round to them.
+ *
+ * As with pheap, the implementation simply tracks array indexes; it is up to the user to keep any other per-node state
+ * in a companion array.
+ *
+ * NOTE: This class is not safe for concurrent usage. It should be externally protected.
+ */
+
+// PICO_CONFIG: PICO_TIMER_WHEEL_LEVELS, Number of levels in a timer wheel; the wheel covers 64^levels key units before nodes need to be re-filed, min=1, max=10, default=6, group=pico_util
+#ifndef PICO_TIMER_WHEEL_LEVELS
+#define PICO_TIMER_WHEEL_LEVELS 6
+#endif
+
+#define TIMER_WHEEL_SLOT_BITS 6u
+#define TIMER_WHEEL_SLOTS (1u << TIMER_WHEEL_SLOT_BITS)
+
+// public node ids are numbered from 1 (0 means none)
+typedef uint16_t tw_node_id_t;
+
+#define TIMER_WHEEL_MAX_NODES 65534u
+
+// values for tw_node_t::slot which aren't wheel slots
+#define TIMER_WHEEL_SLOT_NONE 0xffffu
+#define TIMER_WHEEL_SLOT_EXPIRED 0xfffeu
+
+typedef struct tw_node {
+    uint64_t key;
+    tw_node_id_t prev, next;
+    // level * TIMER_WHEEL_SLOTS + slot index, or TIMER_WHEEL_SLOT_NONE/TIMER_WHEEL_SLOT_EXPIRED
+    uint16_t slot;
+} tw_node_t;
+
+typedef struct timer_wheel {
+    tw_node_t *nodes;
+    // all nodes with keys before this have been moved to the expired list
+    uint64_t current;
+    // one bit per non-empty slot in each level
+    uint64_t occupied[PICO_TIMER_WHEEL_LEVELS];
+    tw_node_id_t slots[PICO_TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    tw_node_id_t max_nodes;
+    tw_node_id_t free_head_id;
+    tw_node_id_t expired_head_id;
+    tw_node_id_t expired_tail_id;
+} timer_wheel_t;
+
+/**
+ * Create a timer wheel
+ *
+ * \param max_nodes the maximum number of nodes that may be in the wheel (at most TIMER_WHEEL_MAX_NODES)
+ * \param current the initial current key value of the wheel (e.g. the current time)
+ * \return a newly allocated and initialized timer wheel
+ */
+timer_wheel_t *tw_create(uint max_nodes, uint64_t current);
+
+/**
+ * Initialize a statically allocated timer wheel (tw_create() uses the C heap).
+ * The member `nodes` must be allocated of size max_nodes.
+ *
+ * \param tw the timer wheel
+ * \param max_nodes the max number of nodes in the wheel (matching the size of the nodes array)
+ * \param current the initial current key value of the wheel (e.g. the current time)
+ */
+void tw_post_alloc_init(timer_wheel_t *tw, uint max_nodes, uint64_t current);
+
+/**
+ * Removes all nodes from the timer wheel
+ *
+ * \param tw the timer wheel
+ * \param current the new current key value of the wheel
+ */
+void tw_clear(timer_wheel_t *tw, uint64_t current);
+
+/**
+ * De-allocates a timer wheel
+ *
+ * Note this method must *ONLY* be called on timer wheels created by tw_create()
+ * \param tw the timer wheel
+ */
+void tw_destroy(timer_wheel_t *tw);
+
+// internal method
+static inline tw_node_t *tw_get_node(timer_wheel_t *tw, tw_node_id_t id) {
+    assert(id && id <= tw->max_nodes);
+    return tw->nodes + id - 1;
+}
+
+/**
+ * Allocate a new node from the unused space in the timer wheel
+ *
+ * \param tw the timer wheel
+ * \return an identifier for the node, or 0 if the wheel is full
+ */
+static inline tw_node_id_t tw_new_node(timer_wheel_t *tw) {
+    tw_node_id_t id = tw->free_head_id;
+    if (id) {
+        tw_node_t *node = tw_get_node(tw, id);
+        tw->free_head_id = node->next;
+        node->next = node->prev = 0;
+        node->slot = TIMER_WHEEL_SLOT_NONE;
+    }
+    return id;
+}
+
+/**
+ * Determine if the timer wheel contains a given node (either in the wheel itself, or in the expired list).
+ * Note containment refers to whether the node is inserted (tw_insert_node()) vs allocated (tw_new_node())
+ *
+ * \param tw the timer wheel
+ * \param id the id of the node
+ * \return true if the wheel contains a node with the given id, false otherwise.
+ */
+static inline bool tw_contains_node(timer_wheel_t *tw, tw_node_id_t id) {
+    return id && tw_get_node(tw, id)->slot != TIMER_WHEEL_SLOT_NONE;
+}
+
+/**
+ * Free a node that is not currently in the timer wheel, but has been allocated
+ *
+ * \param tw the timer wheel
+ * \param id the id of the node
+ */
+static inline void tw_free_node(timer_wheel_t *tw, tw_node_id_t id) {
+    assert(!tw_contains_node(tw, id));
+    tw_get_node(tw, id)->next = tw->free_head_id;
+    tw->free_head_id = id;
+}
+
+/**
+ * Insert a node (previously allocated by tw_new_node()) into the timer wheel. This is an O(1) operation.
+ *
+ * If the key is before the current key value of the wheel, the node is added directly to the expired list.
+ *
+ * \param tw the timer wheel
+ * \param id the id of the node to insert
+ * \param key the key value
+ */
+void tw_insert_node(timer_wheel_t *tw, tw_node_id_t id, uint64_t key);
+
+/**
+ * Remove an arbitrary node from the timer wheel (or its expired list) without freeing it. This is an O(1) operation.
+ *
+ * \param tw the timer wheel
+ * \param id the id of the node to remove
+ * \return true if the node was in the wheel, false otherwise
+ */
+bool tw_remove_node(timer_wheel_t *tw, tw_node_id_t id);
+
+/**
+ * Remove and free an arbitrary node from the timer wheel (or its expired list). This is an O(1) operation.
+ *
+ * \param tw the timer wheel
+ * \param id the id of the node to remove
+ * \return true if the node was in the wheel, false otherwise
+ */
+static inline bool tw_remove_and_free_node(timer_wheel_t *tw, tw_node_id_t id) {
+    bool rc = tw_remove_node(tw, id);
+    if (rc) tw_free_node(tw, id);
+    return rc;
+}
+
+/**
+ * Return a lower bound for the key of the next node to expire. Advancing the wheel to this value
+ * will either expire some nodes, or allow a new (higher) bound to be calculated.
+ *
+ * \param tw the timer wheel
+ * \return the lower bound, or UINT64_MAX if the wheel (not counting the expired list) is empty
+ */
+uint64_t tw_next_key_bound(timer_wheel_t *tw);
+
+/**
+ * Advance the current key value of the wheel, moving all nodes whose keys are <= the given value to the
+ * expired list (in key order)
+ *
+ * \param tw the timer wheel
+ * \param key the key value to advance to. If this is before the current key value, nothing happens
+ */
+void tw_advance(timer_wheel_t *tw, uint64_t key);
+
+/**
+ * Returns the first node on the expired list without removing it
+ *
+ * \param tw the timer wheel
+ * \return the node id, or 0 if no nodes have expired
+ */
+static inline tw_node_id_t tw_peek_expired(timer_wheel_t *tw) {
+    return tw->expired_head_id;
+}
+
+/**
+ * Remove the first node from the expired list.
+ *
+ * \param tw the timer wheel
+ * \param free true if the id is also to be freed; false if not - useful if the caller
+ *        may wish to re-insert an item with the same id)
+ * \return the node id, or 0 if no nodes have expired
+ */
+tw_node_id_t tw_remove_expired(timer_wheel_t *tw, bool free);
+
+/**
+ * Print a representation of the timer wheel for debugging
+ *
+ * \param tw the timer wheel
+ * \param dump_key a method to print a node value (may be NULL)
+ * \param user_data the user data to pass to the dump_key method
+ */
+void tw_dump(timer_wheel_t *tw, void (*dump_key)(tw_node_id_t id, void *user_data), void *user_data);
+
+/**
+ * Define a statically allocated timer wheel. This must be initialized by tw_post_alloc_init
+ */
+#define TIMER_WHEEL_DEFINE_STATIC(name, _max_nodes) \
+    static_assert(_max_nodes && _max_nodes <= TIMER_WHEEL_MAX_NODES, ""); \
+    static tw_node_t name ## _nodes[_max_nodes]; \
+    static timer_wheel_t name = { \
+            .nodes = name ## _nodes, \
+            .max_nodes = _max_nodes \
+    };
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -40,16 +40,36 @@ void ph_destroy(pheap_t *heap) {
 }
 
 pheap_node_id_t ph_merge_two_pass(pheap_t *heap, pheap_node_id_t id) {
-    if (!id || !ph_get_node(heap, id)->sibling) {
-        return id;
-    } else {
-        pheap_node_id_t a, b, new_node;
-        a = id;
-        b = ph_get_node(heap, id)->sibling;
-        new_node = ph_get_node(heap, b)->sibling;
-        ph_get_node(heap, a)->sibling = ph_get_node(heap, b)->sibling = 0;
-        return ph_merge_nodes(heap, ph_merge_nodes(heap, a, b), ph_merge_two_pass(heap, new_node));
+    // this is done iteratively rather than recursively, as the number of siblings may be large, and we
+    // may be called from an IRQ handler with little stack.
+    //
+    // first pass: merge pairs of siblings from left to right, collecting the results in a list (in reverse order)
+    pheap_node_id_t pairs = 0;
+    while (id) {
+        pheap_node_t *a = ph_get_node(heap, id);
+        pheap_node_id_t b_id = a->sibling;
+        pheap_node_id_t next_id = 0;
+        if (b_id) {
+            pheap_node_t *b = ph_get_node(heap, b_id);
+            next_id = b->sibling;
+            b->sibling = 0;
+        }
+        a->sibling = 0;
+        pheap_node_id_t merged_id = ph_merge_nodes(heap, id, b_id);
+        ph_get_node(heap, merged_id)->sibling = pairs;
+        pairs = merged_id;
+        id = next_id;
     }
+    // second pass: merge the pairs from right to left into a single tree
+    pheap_node_id_t root_id = 0;
+    while (pairs) {
+        pheap_node_t *pair = ph_get_node(heap, pairs);
+        pheap_node_id_t next_id = pair->sibling;
+        pair->sibling = 0;
+        root_id = ph_merge_nodes(heap, pairs, root_id);
+        pairs = next_id;
+    }
+    return root_id;
 }
 
 static pheap_node_id_t ph_remove_any_head(pheap_t *heap, pheap_node_id_t root_id, bool free) {
@@ -79,16 +99,23 @@ pheap_node_id_t ph_remove_head(pheap_t *heap, bool free) {
     return old_root_id;
 }
 
-bool ph_remove_and_free_node(pheap_t *heap, pheap_node_id_t id) {
-    // 1) trivial cases
-    if (!id) return false;
-    if (id == heap->root_id) {
-        ph_remove_and_free_head(heap);
-        return true;
+pheap_node_id_t ph_insert_batch(pheap_t *heap, const pheap_node_id_t *ids, uint count) {
+    // chain the new nodes together as siblings, and let the two pass merge pair them up
+    pheap_node_id_t list = 0;
+    for (uint i = count; i-- > 0; ) {
+        assert(ids[i]);
+        pheap_node_t *hn = ph_get_node(heap, ids[i]);
+        hn->child = hn->parent = 0;
+        hn->sibling = list;
+        list = ids[i];
     }
-    // 2) unlink the node from the tree
+    heap->root_id = ph_merge_nodes(heap, heap->root_id, ph_merge_two_pass(heap, list));
+    return heap->root_id;
+}
+
+// unlink a (non root) node and its subtree from its parent
+static void ph_unlink_node(pheap_t *heap, pheap_node_id_t id) {
     pheap_node_t *node = ph_get_node(heap, id);
-    if (!node->parent) return false; // not in tree
     pheap_node_t *parent = ph_get_node(heap, node->parent);
     if (parent->child == id) {
         parent->child = node->sibling;
@@ -107,6 +134,32 @@ bool ph_remove_and_free_node(pheap_t *heap, pheap_node_id_t id) {
         assert(found);
     }
     node->sibling = node->parent = 0;
+}
+
+pheap_node_id_t ph_decrease_key(pheap_t *heap, pheap_node_id_t id) {
+    assert(ph_contains_node(heap, id));
+    if (id != heap->root_id) {
+        pheap_node_t *node = ph_get_node(heap, id);
+        // the node's children still compare after it, so the heap is only out of order if the node now
+        // compares before its parent
+        if (ph_node_less(heap, id, node->parent)) {
+            ph_unlink_node(heap, id);
+            heap->root_id = ph_merge_nodes(heap, heap->root_id, id);
+        }
+    }
+    return heap->root_id;
+}
+
+bool ph_remove_and_free_node(pheap_t *heap, pheap_node_id_t id) {
+    // 1) trivial cases
+    if (!id) return false;
+    if (id == heap->root_id) {
+        ph_remove_and_free_head(heap);
+        return true;
+    }
+    if (!ph_get_node(heap, id)->parent) return false; // not in tree
+    // 2) unlink the node from the tree
+    ph_unlink_node(heap, id);
 //    ph_dump(heap, NULL, NULL);
     // 3) remove it from the head of its own subtree
     pheap_node_id_t new_sub_tree = ph_remove_any_head(heap, id, true);
@@ -41,6 +41,40 @@ static inline uint16_t inc_index(queue_t *q, uint16_t index) {
     return index;
 }
 
+static inline uint16_t advance_index(queue_t *q, uint16_t index, uint count) {
+    index = (uint16_t)(index + count);
+    if (index > q->element_count) {
+        index = (uint16_t)(index - (q->element_count + 1));
+    }
+
+#if PICO_QUEUE_MAX_LEVEL
+    uint16_t level = queue_get_level_unsafe(q);
+    if (level > q->max_level) {
+        q->max_level = level;
+    }
+#endif
+
+    return index;
+}
+
+// copy count elements into the ring starting at index, using at most two contiguous copies
+static void copy_to_ring(queue_t *q, uint16_t index, const uint8_t *src, uint count) {
+    uint first = MIN(count, (uint)(q->element_count + 1 - index));
+    memcpy(element_ptr(q, index), src, first * q->element_size);
+    if (count > first) {
+        memcpy(q->data, src + first * q->element_size, (count - first) * q->element_size);
+    }
+}
+
+// copy count elements out of the ring starting at index, using at most two contiguous copies
+static void copy_from_ring(queue_t *q, uint16_t index, uint8_t *dst, uint count) {
+    uint first = MIN(count, (uint)(q->element_count + 1 - index));
+    memcpy(dst, element_ptr(q, index), first * q->element_size);
+    if (count > first) {
+        memcpy(dst + first * q->element_size, q->data, (count - first) * q->element_size);
+    }
+}
+
 static bool queue_add_internal(queue_t *q, const void *data, bool block) {
     do {
         uint32_t save = spin_lock_blocking(q->core.spin_lock);
@@ -94,6 +128,50 @@ static bool queue_peek_internal(queue_t *q, void *data, bool block) {
     } while (true);
 }
 
+static uint queue_add_n_internal(queue_t *q, const void *data, uint count, bool block) {
+    const uint8_t *src = (const uint8_t *)data;
+    uint done = 0;
+    while (done < count) {
+        uint32_t save = spin_lock_blocking(q->core.spin_lock);
+        uint n = MIN(count - done, q->element_count - queue_get_level_unsafe(q));
+        if (n) {
+            copy_to_ring(q, q->wptr, src + done * q->element_size, n);
+            q->wptr = advance_index(q, q->wptr, n);
+            done += n;
+            lock_internal_spin_unlock_with_notify(&q->core, save);
+        } else if (block) {
+            lock_internal_spin_unlock_with_wait(&q->core, save);
+        } else {
+            spin_unlock(q->core.spin_lock, save);
+            break;
+        }
+        if (!block) break;
+    }
+    return done;
+}
+
+static uint queue_remove_n_internal(queue_t *q, void *data, uint count, bool block) {
+    uint8_t *dst = (uint8_t *)data;
+    uint done = 0;
+    while (done < count) {
+        uint32_t save = spin_lock_blocking(q->core.spin_lock);
+        uint n = MIN(count - done, queue_get_level_unsafe(q));
+        if (n) {
+            copy_from_ring(q, q->rptr, dst + done * q->element_size, n);
+            q->rptr = advance_index(q, q->rptr, n);
+            done += n;
+            lock_internal_spin_unlock_with_notify(&q->core, save);
+        } else if (block) {
+            lock_internal_spin_unlock_with_wait(&q->core, save);
+        } else {
+            spin_unlock(q->core.spin_lock, save);
+            break;
+        }
+        if (!block) break;
+    }
+    return done;
+}
+
 bool queue_try_add(queue_t *q, const void *data) {
     return queue_add_internal(q, data, false);
 }
@@ -117,3 +195,77 @@ void queue_remove_blocking(queue_t *q, void *data) {
 void queue_peek_blocking(queue_t *q, void *data) {
     queue_peek_internal(q, data, true);
 }
+
+uint queue_try_add_n(queue_t *q, const void *data, uint count) {
+    return queue_add_n_internal(q, data, count, false);
+}
+
+uint queue_try_remove_n(queue_t *q, void *data, uint count) {
+    return queue_remove_n_internal(q, data, count, false);
+}
+
+void queue_add_n_blocking(queue_t *q, const void *data, uint count) {
+    queue_add_n_internal(q, data, count, true);
+}
+
+void queue_remove_n_blocking(queue_t *q, void *data, uint count) {
+    queue_remove_n_internal(q, data, count, true);
+}
+
+uint queue_try_reserve_span(queue_t *q, void **ptr, uint max_count) {
+    uint32_t save = spin_lock_blocking(q->core.spin_lock);
+    uint n = MIN(max_count, q->element_count - queue_get_level_unsafe(q));
+    // don't hand out a span which wraps past the end of the ring
+    n = MIN(n, (uint)(q->element_count + 1 - q->wptr));
+    *ptr = element_ptr(q, q->wptr);
+    spin_unlock(q->core.spin_lock, save);
+    return n;
+}
+
+void *queue_reserve_blocking(queue_t *q) {
+    do {
+        uint32_t save = spin_lock_blocking(q->core.spin_lock);
+        if (queue_get_level_unsafe(q) != q->element_count) {
+            void *ptr = element_ptr(q, q->wptr);
+            spin_unlock(q->core.spin_lock, save);
+            return ptr;
+        }
+        lock_internal_spin_unlock_with_wait(&q->core, save);
+    } while (true);
+}
+
+void queue_commit_n(queue_t *q, uint count) {
+    uint32_t save = spin_lock_blocking(q->core.spin_lock);
+    assert(count <= q->element_count - queue_get_level_unsafe(q));
+    q->wptr = advance_index(q, q->wptr, count);
+    lock_internal_spin_unlock_with_notify(&q->core, save);
+}
+
+uint queue_try_peek_span(queue_t *q, const void **ptr, uint max_count) {
+    uint32_t save = spin_lock_blocking(q->core.spin_lock);
+    uint n = MIN(max_count, queue_get_level_unsafe(q));
+    // don't hand out a span which wraps past the end of the ring
+    n = MIN(n, (uint)(q->element_count + 1 - q->rptr));
+    *ptr = element_ptr(q, q->rptr);
+    spin_unlock(q->core.spin_lock, save);
+    return n;
+}
+
+const void *queue_peek_ptr_blocking(queue_t *q) {
+    do {
+        uint32_t save = spin_lock_blocking(q->core.spin_lock);
+        if (queue_get_level_unsafe(q) != 0) {
+            const void *ptr = element_ptr(q, q->rptr);
+            spin_unlock(q->core.spin_lock, save);
+            return ptr;
+        }
+        lock_internal_spin_unlock_with_wait(&q->core, save);
+    } while (true);
+}
+
+void queue_release_n(queue_t *q, uint count) {
+    uint32_t save = spin_lock_blocking(q->core.spin_lock);
+    assert(count <= queue_get_level_unsafe(q));
+    q->rptr = advance_index(q, q->rptr, count);
+    lock_internal_spin_unlock_with_notify(&q->core, save);
+}
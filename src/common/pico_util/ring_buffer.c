@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "pico/util/ring_buffer.h"
+
+void ring_buffer_init(ring_buffer_t *rb, uint8_t *storage, uint size) {
+    // size must be a power of two
+    assert(size && !(size & (size - 1)));
+    rb->data = storage;
+    rb->mask = size - 1;
+    rb->wptr = 0;
+    rb->rptr = 0;
+}
+
+uint ring_buffer_try_write(ring_buffer_t *rb, const void *src, uint len) {
+    uint32_t wptr = rb->wptr;
+    uint free = ring_buffer_get_size(rb) - (wptr - rb->rptr);
+    if (len > free) len = free;
+    if (!len) return 0;
+    // make sure the consumer has finished reading the space before we overwrite it
+    __mem_fence_acquire();
+    uint offset = wptr & rb->mask;
+    uint first = MIN(len, ring_buffer_get_size(rb) - offset);
+    memcpy(rb->data + offset, src, first);
+    memcpy(rb->data, (const uint8_t *)src + first, len - first);
+    // make sure the bytes are visible before the consumer can see the new write pointer
+    __mem_fence_release();
+    rb->wptr = wptr + len;
+    __sev();
+    return len;
+}
+
+uint ring_buffer_peek_contiguous(ring_buffer_t *rb, const uint8_t **data) {
+    uint32_t rptr = rb->rptr;
+    uint level = rb->wptr - rptr;
+    // make sure we see the bytes written before the write pointer was updated
+    __mem_fence_acquire();
+    uint offset = rptr & rb->mask;
+    *data = rb->data + offset;
+    return MIN(level, ring_buffer_get_size(rb) - offset);
+}
+
+void ring_buffer_consume(ring_buffer_t *rb, uint len) {
+    assert(len <= ring_buffer_get_level(rb));
+    // make sure we have finished reading the bytes before the producer can reuse the space
+    __mem_fence_release();
+    rb->rptr += len;
+    __sev();
+}
+
+uint ring_buffer_try_read(ring_buffer_t *rb, void *dst, uint len) {
+    uint done = 0;
+    const uint8_t *data;
+    uint n;
+    // at most two runs, either side of the wrap
+    while (done < len && (n = ring_buffer_peek_contiguous(rb, &data))) {
+        n = MIN(n, len - done);
+        memcpy((uint8_t *)dst + done, data, n);
+        ring_buffer_consume(rb, n);
+        done += n;
+    }
+    return done;
+}
+
+void ring_buffer_write_blocking(ring_buffer_t *rb, const void *src, uint len) {
+    const uint8_t *p = (const uint8_t *)src;
+    while (len) {
+        uint n = ring_buffer_try_write(rb, p, len);
+        if (!n) {
+            __wfe();
+            continue;
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+void ring_buffer_read_blocking(ring_buffer_t *rb, void *dst, uint len) {
+    uint8_t *p = (uint8_t *)dst;
+    while (len) {
+        uint n = ring_buffer_try_read(rb, p, len);
+        if (!n) {
+            __wfe();
+            continue;
+        }
+        p += n;
+        len -= n;
+    }
+}
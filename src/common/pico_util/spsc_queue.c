@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pico/util/spsc_queue.h"
+
+void spsc_queue_init(spsc_queue_t *q, uint element_size, uint element_count) {
+    q->data = (uint8_t *)calloc(element_count + 1, element_size);
+    q->element_count = (uint16_t)element_count;
+    q->element_size = (uint16_t)element_size;
+    q->wptr = 0;
+    q->rptr = 0;
+#if PICO_QUEUE_MAX_LEVEL
+    q->max_level = 0;
+#endif
+}
+
+void spsc_queue_free(spsc_queue_t *q) {
+    free(q->data);
+}
+
+static inline void *element_ptr(spsc_queue_t *q, uint index) {
+    assert(index <= q->element_count);
+    return q->data + index * q->element_size;
+}
+
+static inline uint16_t inc_index(spsc_queue_t *q, uint16_t index) {
+    if (++index > q->element_count) { // > because we have element_count + 1 elements
+        index = 0;
+    }
+    return index;
+}
+
+bool spsc_queue_try_add(spsc_queue_t *q, const void *data) {
+    uint16_t wptr = q->wptr;
+    uint16_t next = inc_index(q, wptr);
+    if (next == q->rptr) return false;
+    // make sure the consumer has finished reading the slot before we overwrite it
+    __mem_fence_acquire();
+    memcpy(element_ptr(q, wptr), data, q->element_size);
+    // make sure the element is visible before the consumer can see the new write pointer
+    __mem_fence_release();
+    q->wptr = next;
+#if PICO_QUEUE_MAX_LEVEL
+    uint16_t level = (uint16_t)spsc_queue_get_level(q);
+    if (level > q->max_level) {
+        q->max_level = level;
+    }
+#endif
+    __sev();
+    return true;
+}
+
+static bool spsc_queue_read_internal(spsc_queue_t *q, void *data, bool remove) {
+    uint16_t rptr = q->rptr;
+    if (rptr == q->wptr) return false;
+    // make sure we see the element contents written before the write pointer was updated
+    __mem_fence_acquire();
+    memcpy(data, element_ptr(q, rptr), q->element_size);
+    if (remove) {
+        // make sure we have finished reading the element before the producer can reuse the slot
+        __mem_fence_release();
+        q->rptr = inc_index(q, rptr);
+        __sev();
+    }
+    return true;
+}
+
+bool spsc_queue_try_remove(spsc_queue_t *q, void *data) {
+    return spsc_queue_read_internal(q, data, true);
+}
+
+bool spsc_queue_try_peek(spsc_queue_t *q, void *data) {
+    return spsc_queue_read_internal(q, data, false);
+}
+
+void spsc_queue_add_blocking(spsc_queue_t *q, const void *data) {
+    while (!spsc_queue_try_add(q, data)) {
+        __wfe();
+    }
+}
+
+void spsc_queue_remove_blocking(spsc_queue_t *q, void *data) {
+    while (!spsc_queue_read_internal(q, data, true)) {
+        __wfe();
+    }
+}
+
+void spsc_queue_peek_blocking(spsc_queue_t *q, void *data) {
+    while (!spsc_queue_read_internal(q, data, false)) {
+        __wfe();
+    }
+}
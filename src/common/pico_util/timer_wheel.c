@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "pico/util/timer_wheel.h"
+
+static_assert(PICO_TIMER_WHEEL_LEVELS >= 1 && PICO_TIMER_WHEEL_LEVELS <= 10, "");
+
+#define LEVEL_SHIFT(level) ((level) * TIMER_WHEEL_SLOT_BITS)
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1u)
+
+timer_wheel_t *tw_create(uint max_nodes, uint64_t current) {
+    invalid_params_if(TIMER_WHEEL, !max_nodes || max_nodes > TIMER_WHEEL_MAX_NODES);
+    timer_wheel_t *tw = calloc(1, sizeof(timer_wheel_t));
+    tw->nodes = calloc(max_nodes, sizeof(tw_node_t));
+    tw_post_alloc_init(tw, max_nodes, current);
+    return tw;
+}
+
+void tw_post_alloc_init(timer_wheel_t *tw, uint max_nodes, uint64_t current) {
+    invalid_params_if(TIMER_WHEEL, !max_nodes || max_nodes > TIMER_WHEEL_MAX_NODES);
+    tw->max_nodes = (tw_node_id_t) max_nodes;
+    tw_clear(tw, current);
+}
+
+void tw_clear(timer_wheel_t *tw, uint64_t current) {
+    tw->current = current;
+    for (uint level = 0; level < PICO_TIMER_WHEEL_LEVELS; level++) {
+        tw->occupied[level] = 0;
+        for (uint i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+            tw->slots[level][i] = 0;
+        }
+    }
+    tw->expired_head_id = tw->expired_tail_id = 0;
+    tw->free_head_id = 1;
+    for (uint i = 1; i <= tw->max_nodes; i++) {
+        tw_node_t *node = tw_get_node(tw, (tw_node_id_t)i);
+        node->next = (tw_node_id_t)(i < tw->max_nodes ? i + 1 : 0);
+        node->prev = 0;
+        node->slot = TIMER_WHEEL_SLOT_NONE;
+    }
+}
+
+void tw_destroy(timer_wheel_t *tw) {
+    free(tw->nodes);
+    free(tw);
+}
+
+static inline uint64_t rotate_right(uint64_t x, uint n) {
+    return n ? (x >> n) | (x << (64u - n)) : x;
+}
+
+static void link_to_slot(timer_wheel_t *tw, tw_node_id_t id, uint level, uint index) {
+    tw_node_t *node = tw_get_node(tw, id);
+    tw_node_id_t *head = &tw->slots[level][index];
+    node->slot = (uint16_t)(level * TIMER_WHEEL_SLOTS + index);
+    node->prev = 0;
+    node->next = *head;
+    if (*head) tw_get_node(tw, *head)->prev = id;
+    *head = id;
+    tw->occupied[level] |= 1ull << index;
+}
+
+static void link_to_expired(timer_wheel_t *tw, tw_node_id_t id) {
+    tw_node_t *node = tw_get_node(tw, id);
+    node->slot = TIMER_WHEEL_SLOT_EXPIRED;
+    node->next = 0;
+    node->prev = tw->expired_tail_id;
+    if (tw->expired_tail_id) {
+        tw_get_node(tw, tw->expired_tail_id)->next = id;
+    } else {
+        tw->expired_head_id = id;
+    }
+    tw->expired_tail_id = id;
+}
+
+void tw_insert_node(timer_wheel_t *tw, tw_node_id_t id, uint64_t key) {
+    assert(!tw_contains_node(tw, id));
+    tw_get_node(tw, id)->key = key;
+    if (key < tw->current) {
+        link_to_expired(tw, id);
+        return;
+    }
+    // find the lowest level which can hold the key; at level L the slot index is the key's L'th base 64 digit,
+    // which is unique across the next 64 slots of that level
+    for (uint level = 0; level < PICO_TIMER_WHEEL_LEVELS; level++) {
+        uint64_t slot_num = key >> LEVEL_SHIFT(level);
+        if (slot_num - (tw->current >> LEVEL_SHIFT(level)) < TIMER_WHEEL_SLOTS) {
+            link_to_slot(tw, id, level, (uint)slot_num & SLOT_MASK);
+            return;
+        }
+    }
+    // too far in the future; park it in the furthest slot of the top level, and re-file it when we get there
+    uint level = PICO_TIMER_WHEEL_LEVELS - 1;
+    link_to_slot(tw, id, level, (uint)((tw->current >> LEVEL_SHIFT(level)) + SLOT_MASK) & SLOT_MASK);
+}
+
+bool tw_remove_node(timer_wheel_t *tw, tw_node_id_t id) {
+    if (!tw_contains_node(tw, id)) return false;
+    tw_node_t *node = tw_get_node(tw, id);
+    if (node->slot == TIMER_WHEEL_SLOT_EXPIRED) {
+        if (node->prev) tw_get_node(tw, node->prev)->next = node->next;
+        else tw->expired_head_id = node->next;
+        if (node->next) tw_get_node(tw, node->next)->prev = node->prev;
+        else tw->expired_tail_id = node->prev;
+    } else {
+        uint level = node->slot / TIMER_WHEEL_SLOTS;
+        uint index = node->slot & SLOT_MASK;
+        if (node->prev) {
+            tw_get_node(tw, node->prev)->next = node->next;
+        } else {
+            tw->slots[level][index] = node->next;
+            if (!node->next) tw->occupied[level] &= ~(1ull << index);
+        }
+        if (node->next) tw_get_node(tw, node->next)->prev = node->prev;
+    }
+    node->prev = node->next = 0;
+    node->slot = TIMER_WHEEL_SLOT_NONE;
+    return true;
+}
+
+uint64_t tw_next_key_bound(timer_wheel_t *tw) {
+    uint64_t bound = UINT64_MAX;
+    for (uint level = 0; level < PICO_TIMER_WHEEL_LEVELS; level++) {
+        if (!tw->occupied[level]) continue;
+        uint64_t slot_num = tw->current >> LEVEL_SHIFT(level);
+        uint64_t rotated = rotate_right(tw->occupied[level], (uint)slot_num & SLOT_MASK);
+        uint64_t next = (slot_num + (uint)__builtin_ctzll(rotated)) << LEVEL_SHIFT(level);
+        // a slot at a higher level only becomes current once we reach its start (which may be "now")
+        if (next < tw->current) next = tw->current;
+        if (next < bound) bound = next;
+    }
+    return bound;
+}
+
+void tw_advance(timer_wheel_t *tw, uint64_t key) {
+    while (key >= tw->current) {
+        uint64_t next = tw_next_key_bound(tw);
+        if (next > key) {
+            // nothing to do up to key; note that skipping ahead does not cross any slot which needs processing
+            if (key != UINT64_MAX) tw->current = key + 1;
+            break;
+        }
+        tw->current = next;
+        // re-file any higher level slots which are now current (from the top down, so nodes can cascade all the way)
+        for (uint level = PICO_TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            uint index = (uint)(next >> LEVEL_SHIFT(level)) & SLOT_MASK;
+            if (tw->occupied[level] & (1ull << index)) {
+                tw_node_id_t id = tw->slots[level][index];
+                tw->slots[level][index] = 0;
+                tw->occupied[level] &= ~(1ull << index);
+                while (id) {
+                    tw_node_t *node = tw_get_node(tw, id);
+                    tw_node_id_t next_id = node->next;
+                    node->slot = TIMER_WHEEL_SLOT_NONE;
+                    tw_insert_node(tw, id, node->key);
+                    id = next_id;
+                }
+            }
+        }
+        // everything in the current level 0 slot has a key of exactly `next`
+        uint index = (uint)next & SLOT_MASK;
+        if (tw->occupied[0] & (1ull << index)) {
+            tw_node_id_t id = tw->slots[0][index];
+            tw->slots[0][index] = 0;
+            tw->occupied[0] &= ~(1ull << index);
+            while (id) {
+                tw_node_id_t next_id = tw_get_node(tw, id)->next;
+                link_to_expired(tw, id);
+                id = next_id;
+            }
+        }
+        if (next == UINT64_MAX) break;
+        tw->current = next + 1;
+    }
+}
+
+tw_node_id_t tw_remove_expired(timer_wheel_t *tw, bool free) {
+    tw_node_id_t id = tw->expired_head_id;
+    if (id) {
+        tw_remove_node(tw, id);
+        if (free) tw_free_node(tw, id);
+    }
+    return id;
+}
+
+void tw_dump(timer_wheel_t *tw, void (*dump_key)(tw_node_id_t, void *), void *user_data) {
+    uint count = 0;
+    printf("current %"PRIu64"\n", tw->current);
+    for (uint level = 0; level < PICO_TIMER_WHEEL_LEVELS; level++) {
+        for (uint index = 0; index < TIMER_WHEEL_SLOTS; index++) {
+            tw_node_id_t id = tw->slots[level][index];
+            if (!id) continue;
+            printf("level %d slot %d:\n", level, index);
+            for (; id; id = tw_get_node(tw, id)->next) {
+                printf("  %d (key %"PRIu64") ", id, tw_get_node(tw, id)->key);
+                if (dump_key) dump_key(id, user_data);
+                printf("\n");
+                count++;
+            }
+        }
+    }
+    if (tw->expired_head_id) {
+        printf("expired:\n");
+        for (tw_node_id_t id = tw->expired_head_id; id; id = tw_get_node(tw, id)->next) {
+            printf("  %d (key %"PRIu64") ", id, tw_get_node(tw, id)->key);
+            if (dump_key) dump_key(id, user_data);
+            printf("\n");
+            count++;
+        }
+    }
+    printf("node_count %d\n", count);
+}
@@ -0,0 +1,569 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+
+#define DMA_HOST_MAX_PERIPHERALS 4
+
+typedef struct {
+    dma_channel_config config;
+    uintptr_t read_addr;
+    uintptr_t write_addr;
+    uint32_t trans_count;       // the value reloaded on each trigger
+    uint32_t transfers_left;
+    uint32_t timer_credits;     // DMA timer pulses not yet used by a transfer
+    bool busy;
+    dma_host_channel_stats_t stats;
+} dma_channel_state_t;
+
+typedef struct {
+    uint16_t numerator;
+    uint16_t denominator;
+    uint32_t acc;
+} dma_timer_state_t;
+
+static struct {
+    dma_channel_state_t ch[NUM_DMA_CHANNELS];
+    dma_timer_state_t timer[NUM_DMA_TIMERS];
+    uint32_t irq_raw;
+    uint32_t irq_enabled[2];
+    uint next_channel[2];       // round robin position for low/high priority channels
+    struct {
+        bool enabled;
+        uint channel;
+        uint mode;
+        bool bswap;
+        bool out_reverse;
+        bool out_invert;
+        uint32_t acc;
+    } sniff;
+    bool hooked;
+    const dma_host_peripheral_t *peripherals[DMA_HOST_MAX_PERIPHERALS];
+    uint num_peripherals;
+} dma;
+
+static uint16_t claimed;
+static uint8_t timer_claimed;
+
+static void dma_cycle(void);
+
+// all the state is protected by the PIO emulation lock, as it is updated from the PIO emulation clock
+static uint32_t dma_lock(void) {
+    if (!dma.hooked) {
+        pio_host_set_cycle_callback(dma_cycle);
+        dma.hooked = true;
+    }
+    return pio_host_lock();
+}
+
+static void dma_unlock(uint32_t save) {
+    pio_host_unlock(save);
+}
+
+// ----------------------------------------------------------------------------
+// claims
+
+static_assert(NUM_DMA_CHANNELS <= 16, "");
+
+void dma_channel_claim(uint channel) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    bool was_claimed = claimed & (1u << channel);
+    claimed |= (uint16_t)(1u << channel);
+    memset(&dma.ch[channel].stats, 0, sizeof(dma.ch[channel].stats));
+    dma_unlock(save);
+    if (was_claimed) {
+        panic("DMA channel %d is already claimed", channel);
+    }
+}
+
+void dma_claim_mask(uint32_t mask) {
+    for(uint i = 0; mask; i++, mask >>= 1u) {
+        if (mask & 1u) dma_channel_claim(i);
+    }
+}
+
+void dma_channel_unclaim(uint channel) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    claimed &= (uint16_t)~(1u << channel);
+    dma_unlock(save);
+}
+
+void dma_unclaim_mask(uint32_t mask) {
+    for(uint i = 0; mask; i++, mask >>= 1u) {
+        if (mask & 1u) dma_channel_unclaim(i);
+    }
+}
+
+int dma_claim_unused_channel(bool required) {
+    int channel = -1;
+    uint32_t save = dma_lock();
+    for (uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if (!(claimed & (1u << i))) {
+            claimed |= (uint16_t)(1u << i);
+            memset(&dma.ch[i].stats, 0, sizeof(dma.ch[i].stats));
+            channel = (int)i;
+            break;
+        }
+    }
+    dma_unlock(save);
+    if (channel < 0 && required) {
+        panic("No DMA channels are available");
+    }
+    return channel;
+}
+
+bool dma_channel_is_claimed(uint channel) {
+    check_dma_channel_param(channel);
+    return claimed & (1u << channel);
+}
+
+void dma_timer_claim(uint timer) {
+    check_dma_timer_param(timer);
+    uint32_t save = dma_lock();
+    bool was_claimed = timer_claimed & (1u << timer);
+    timer_claimed |= (uint8_t)(1u << timer);
+    dma_unlock(save);
+    if (was_claimed) {
+        panic("DMA timer %d is already claimed", timer);
+    }
+}
+
+void dma_timer_unclaim(uint timer) {
+    check_dma_timer_param(timer);
+    uint32_t save = dma_lock();
+    timer_claimed &= (uint8_t)~(1u << timer);
+    dma_unlock(save);
+}
+
+int dma_claim_unused_timer(bool required) {
+    int timer = -1;
+    uint32_t save = dma_lock();
+    for (uint i = 0; i < NUM_DMA_TIMERS; i++) {
+        if (!(timer_claimed & (1u << i))) {
+            timer_claimed |= (uint8_t)(1u << i);
+            timer = (int)i;
+            break;
+        }
+    }
+    dma_unlock(save);
+    if (timer < 0 && required) {
+        panic("No DMA timers are available");
+    }
+    return timer;
+}
+
+bool dma_timer_is_claimed(uint timer) {
+    check_dma_timer_param(timer);
+    return timer_claimed & (1u << timer);
+}
+
+void dma_timer_set_fraction(uint timer, uint16_t numerator, uint16_t denominator) {
+    check_dma_timer_param(timer);
+    uint32_t save = dma_lock();
+    dma.timer[timer].numerator = numerator;
+    dma.timer[timer].denominator = denominator;
+    dma.timer[timer].acc = 0;
+    dma_unlock(save);
+}
+
+// ----------------------------------------------------------------------------
+// channel control
+
+static void trigger_locked(uint channel) {
+    dma_channel_state_t *ch = &dma.ch[channel];
+    ch->busy = true;
+    ch->transfers_left = ch->trans_count;
+    ch->timer_credits = 0;
+}
+
+dma_channel_config dma_get_channel_config(uint channel) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    dma_channel_config c = dma.ch[channel].config;
+    dma_unlock(save);
+    return c;
+}
+
+void dma_channel_set_config(uint channel, const dma_channel_config *config, bool trigger) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    dma.ch[channel].config = *config;
+    if (trigger) trigger_locked(channel);
+    dma_unlock(save);
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    dma.ch[channel].read_addr = (uintptr_t)read_addr;
+    if (trigger) trigger_locked(channel);
+    dma_unlock(save);
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    dma.ch[channel].write_addr = (uintptr_t)write_addr;
+    if (trigger) trigger_locked(channel);
+    dma_unlock(save);
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    dma.ch[channel].trans_count = trans_count;
+    if (trigger) trigger_locked(channel);
+    dma_unlock(save);
+}
+
+void dma_start_channel_mask(uint32_t chan_mask) {
+    valid_params_if(DMA, chan_mask && chan_mask < (1u << NUM_DMA_CHANNELS));
+    uint32_t save = dma_lock();
+    for (uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if (chan_mask & (1u << i)) trigger_locked(i);
+    }
+    dma_unlock(save);
+}
+
+void dma_channel_abort(uint channel) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    dma.ch[channel].busy = false;
+    dma_unlock(save);
+}
+
+bool dma_channel_is_busy(uint channel) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    if (dma.ch[channel].busy) pio_host_run_cycles_locked(1);
+    bool busy = dma.ch[channel].busy;
+    dma_unlock(save);
+    return busy;
+}
+
+static void set_irq_channel_mask_enabled(uint irq_index, uint32_t channel_mask, bool enabled) {
+    uint32_t save = dma_lock();
+    if (enabled) {
+        dma.irq_enabled[irq_index] |= channel_mask;
+    } else {
+        dma.irq_enabled[irq_index] &= ~channel_mask;
+    }
+    dma_unlock(save);
+}
+
+void dma_set_irq0_channel_mask_enabled(uint32_t channel_mask, bool enabled) {
+    set_irq_channel_mask_enabled(0, channel_mask, enabled);
+}
+
+void dma_set_irq1_channel_mask_enabled(uint32_t channel_mask, bool enabled) {
+    set_irq_channel_mask_enabled(1, channel_mask, enabled);
+}
+
+bool dma_irqn_get_channel_status(uint irq_index, uint channel) {
+    invalid_params_if(DMA, irq_index > 1);
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    bool rc = dma.irq_raw & dma.irq_enabled[irq_index] & (1u << channel);
+    dma_unlock(save);
+    return rc;
+}
+
+void dma_irqn_acknowledge_channel(uint irq_index, uint channel) {
+    invalid_params_if(DMA, irq_index > 1);
+    check_dma_channel_param(channel);
+    // as on the device, the raw status is shared by both IRQs
+    uint32_t save = dma_lock();
+    dma.irq_raw &= ~(1u << channel);
+    dma_unlock(save);
+}
+
+void dma_host_get_channel_stats(uint channel, dma_host_channel_stats_t *stats) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    *stats = dma.ch[channel].stats;
+    dma_unlock(save);
+}
+
+void dma_host_reset_channel_stats(uint channel) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    memset(&dma.ch[channel].stats, 0, sizeof(dma.ch[channel].stats));
+    dma_unlock(save);
+}
+
+void dma_host_add_peripheral(const dma_host_peripheral_t *peripheral) {
+    uint32_t save = dma_lock();
+    bool added = false;
+    for (uint i = 0; i < dma.num_peripherals; i++) {
+        if (dma.peripherals[i] == peripheral) added = true;
+    }
+    if (!added) {
+        hard_assert(dma.num_peripherals < DMA_HOST_MAX_PERIPHERALS);
+        dma.peripherals[dma.num_peripherals++] = peripheral;
+    }
+    dma_unlock(save);
+}
+
+// ----------------------------------------------------------------------------
+// sniffer
+
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable) {
+    check_dma_channel_param(channel);
+    uint32_t save = dma_lock();
+    if (force_channel_enable) dma.ch[channel].config.sniff_enable = true;
+    dma.sniff.enabled = true;
+    dma.sniff.channel = channel;
+    dma.sniff.mode = mode;
+    dma_unlock(save);
+}
+
+void dma_sniffer_set_byte_swap_enabled(bool swap) {
+    uint32_t save = dma_lock();
+    dma.sniff.bswap = swap;
+    dma_unlock(save);
+}
+
+void dma_sniffer_set_output_invert_enabled(bool invert) {
+    uint32_t save = dma_lock();
+    dma.sniff.out_invert = invert;
+    dma_unlock(save);
+}
+
+void dma_sniffer_set_output_reverse_enabled(bool reverse) {
+    uint32_t save = dma_lock();
+    dma.sniff.out_reverse = reverse;
+    dma_unlock(save);
+}
+
+void dma_sniffer_disable(void) {
+    uint32_t save = dma_lock();
+    dma.sniff.enabled = false;
+    dma.sniff.mode = 0;
+    dma.sniff.bswap = dma.sniff.out_reverse = dma.sniff.out_invert = false;
+    dma_unlock(save);
+}
+
+void dma_sniffer_set_data_accumulator(uint32_t seed_value) {
+    uint32_t save = dma_lock();
+    dma.sniff.acc = seed_value;
+    dma_unlock(save);
+}
+
+static uint32_t reverse32(uint32_t v) {
+    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+    v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+    return __builtin_bswap32(v);
+}
+
+uint32_t dma_sniffer_get_data_accumulator(void) {
+    uint32_t save = dma_lock();
+    uint32_t v = dma.sniff.acc;
+    if (dma.sniff.out_reverse) v = reverse32(v);
+    if (dma.sniff.out_invert) v = ~v;
+    dma_unlock(save);
+    return v;
+}
+
+static uint32_t bswap(uint32_t data, uint size) {
+    switch (size) {
+        case 2: return __builtin_bswap16((uint16_t)data);
+        case 4: return __builtin_bswap32(data);
+        default: return data;
+    }
+}
+
+// the CRCs consume the data a byte at a time, least significant (i.e. lowest addressed) byte first
+static void sniff(uint32_t data, uint size) {
+    if (dma.sniff.bswap) data = bswap(data, size);
+    uint32_t acc = dma.sniff.acc;
+    switch (dma.sniff.mode) {
+        case 0x0: // CRC-32 (IEEE802.3)
+        case 0x1: // CRC-32 of bit reversed data
+            for (uint i = 0; i < size; i++) {
+                uint32_t b = (data >> (8 * i)) & 0xffu;
+                if (dma.sniff.mode == 0x1) b = reverse32(b) >> 24;
+                acc ^= b << 24;
+                for (uint j = 0; j < 8; j++) acc = (acc & 0x80000000u) ? (acc << 1) ^ 0x04c11db7u : acc << 1;
+            }
+            break;
+        case 0x2: // CRC-16-CCITT
+        case 0x3: // CRC-16-CCITT of bit reversed data
+            for (uint i = 0; i < size; i++) {
+                uint32_t b = (data >> (8 * i)) & 0xffu;
+                if (dma.sniff.mode == 0x3) b = reverse32(b) >> 24;
+                acc ^= b << 8;
+                for (uint j = 0; j < 8; j++) acc = (acc & 0x8000u) ? (acc << 1) ^ 0x1021u : acc << 1;
+                acc &= 0xffffu;
+            }
+            break;
+        case 0xe: // XOR reduction
+            acc ^= (uint32_t)__builtin_parity(data);
+            break;
+        case 0xf: // 32-bit sum
+            acc += data;
+            break;
+        default:
+            break;
+    }
+    dma.sniff.acc = acc;
+}
+
+// ----------------------------------------------------------------------------
+// emulation
+
+// the PIO FIFO, if any, at an address
+static bool pio_fifo_at(uintptr_t addr, PIO *pio, uint *sm, bool *tx) {
+    for (uint i = 0; i < NUM_PIOS; i++) {
+        uintptr_t txf = (uintptr_t)&pio_host_hw[i].txf[0];
+        uintptr_t rxf = (uintptr_t)&pio_host_hw[i].rxf[0];
+        if (addr - txf < sizeof(pio_host_hw[i].txf) || addr - rxf < sizeof(pio_host_hw[i].rxf)) {
+            *pio = &pio_host_hw[i];
+            *tx = addr - txf < sizeof(pio_host_hw[i].txf);
+            *sm = (uint)((addr - (*tx ? txf : rxf)) / 4);
+            return true;
+        }
+    }
+    return false;
+}
+
+// the emulated peripheral, if any, at an address
+static const dma_host_peripheral_t *peripheral_at(uintptr_t addr) {
+    for (uint i = 0; i < dma.num_peripherals; i++) {
+        if (addr - dma.peripherals[i]->base < dma.peripherals[i]->size) return dma.peripherals[i];
+    }
+    return NULL;
+}
+
+static bool dreq_asserted(dma_channel_state_t *ch) {
+    uint dreq = ch->config.dreq;
+    for (uint i = 0; i < dma.num_peripherals; i++) {
+        const dma_host_peripheral_t *p = dma.peripherals[i];
+        if (dreq - p->first_dreq < p->num_dreqs) return p->dreq_asserted(dreq);
+    }
+    if (dreq < NUM_PIOS * NUM_PIO_STATE_MACHINES * 2) {
+        pio_sim_t *sim = pio_host_get_sim(dreq < NUM_PIO_STATE_MACHINES * 2 ? pio0 : pio1);
+        uint sm = dreq % NUM_PIO_STATE_MACHINES;
+        if (dreq & NUM_PIO_STATE_MACHINES) {
+            return pio_sim_sm_get_rx_level(sim, sm) > 0;
+        } else {
+            return pio_sim_sm_get_tx_level(sim, sm) < pio_sim_sm_get_fifo_capacity(sim, sm, true);
+        }
+    }
+    if (dreq >= DREQ_DMA_TIMER0 && dreq <= DREQ_DMA_TIMER3) {
+        return ch->timer_credits > 0;
+    }
+    // DREQ_FORCE, or a peripheral which is not emulated
+    return true;
+}
+
+static uintptr_t next_addr(const dma_channel_config *c, uintptr_t addr, uint size, bool is_write) {
+    uintptr_t next = addr + size;
+    if (c->ring_size_bits && c->ring_write == is_write) {
+        uintptr_t mask = ((uintptr_t)1 << c->ring_size_bits) - 1;
+        next = (addr & ~mask) | (next & mask);
+    }
+    return next;
+}
+
+static void do_transfer(uint channel) {
+    dma_channel_state_t *ch = &dma.ch[channel];
+    uint size = 1u << ch->config.transfer_data_size;
+    uint lane = 8 * (uint)(ch->read_addr & 3u & ~(size - 1));
+    PIO pio;
+    uint sm;
+    bool tx;
+    uint32_t data = 0;
+    const dma_host_peripheral_t *p;
+    if ((p = peripheral_at(ch->read_addr)) != NULL) {
+        data = p->read(ch->read_addr, size);
+    } else if (pio_fifo_at(ch->read_addr, &pio, &sm, &tx)) {
+        uint32_t word = 0;
+        if (!tx) pio_sim_sm_get(pio_host_get_sim(pio), sm, &word);
+        data = word >> lane;
+        if (size < 4) data &= (1u << (8 * size)) - 1;
+    } else {
+        memcpy(&data, (const void *)ch->read_addr, size);
+    }
+    if (ch->config.bswap) data = bswap(data, size);
+    if ((p = peripheral_at(ch->write_addr)) != NULL) {
+        p->write(ch->write_addr, data, size);
+    } else if (pio_fifo_at(ch->write_addr, &pio, &sm, &tx)) {
+        // narrow writes are replicated across the bus
+        uint32_t word = size == 1 ? data * 0x01010101u : size == 2 ? data * 0x00010001u : data;
+        if (tx) pio_sim_sm_put(pio_host_get_sim(pio), sm, word);
+    } else {
+        memcpy((void *)ch->write_addr, &data, size);
+    }
+    if (dma.sniff.enabled && dma.sniff.channel == channel && ch->config.sniff_enable) sniff(data, size);
+    if (ch->config.read_increment) ch->read_addr = next_addr(&ch->config, ch->read_addr, size, false);
+    if (ch->config.write_increment) ch->write_addr = next_addr(&ch->config, ch->write_addr, size, true);
+    ch->transfers_left--;
+    ch->stats.transfers++;
+    if (ch->timer_credits) ch->timer_credits--;
+}
+
+static void complete(uint channel) {
+    dma_channel_state_t *ch = &dma.ch[channel];
+    ch->busy = false;
+    if (!ch->config.irq_quiet) dma.irq_raw |= 1u << channel;
+    if (ch->config.chain_to != channel) trigger_locked(ch->config.chain_to);
+}
+
+static void dma_cycle(void) {
+    for (uint i = 0; i < dma.num_peripherals; i++) {
+        if (dma.peripherals[i]->cycle) dma.peripherals[i]->cycle();
+    }
+    for (uint i = 0; i < NUM_DMA_TIMERS; i++) {
+        dma_timer_state_t *t = &dma.timer[i];
+        if (!t->denominator) continue;
+        t->acc += t->numerator;
+        if (t->acc >= t->denominator) {
+            t->acc -= t->denominator;
+            for (uint c = 0; c < NUM_DMA_CHANNELS; c++) {
+                if (dma.ch[c].busy && dma.ch[c].config.dreq == DREQ_DMA_TIMER0 + i) dma.ch[c].timer_credits++;
+            }
+        }
+    }
+    uint32_t ready = 0;
+    for (uint c = 0; c < NUM_DMA_CHANNELS; c++) {
+        dma_channel_state_t *ch = &dma.ch[c];
+        if (!ch->busy) continue;
+        if (!ch->transfers_left) {
+            complete(c);
+            continue;
+        }
+        ch->stats.busy_cycles++;
+        if (!ch->config.enable) continue;
+        if (dreq_asserted(ch)) {
+            ready |= 1u << c;
+        } else {
+            ch->stats.dreq_wait_cycles++;
+        }
+    }
+    if (!ready) return;
+    // one transfer per cycle; high priority channels first, round robin within each priority
+    int channel = -1;
+    for (int priority = 1; priority >= 0 && channel < 0; priority--) {
+        for (uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+            uint c = (dma.next_channel[priority] + i) % NUM_DMA_CHANNELS;
+            if ((ready & (1u << c)) && dma.ch[c].config.high_priority == (bool)priority) {
+                channel = (int)c;
+                dma.next_channel[priority] = (c + 1) % NUM_DMA_CHANNELS;
+                break;
+            }
+        }
+    }
+    for (uint c = 0; c < NUM_DMA_CHANNELS; c++) {
+        if ((ready & (1u << c)) && c != (uint)channel) dma.ch[c].stats.arbitration_wait_cycles++;
+    }
+    do_transfer((uint)channel);
+    if (!dma.ch[channel].transfers_left) complete((uint)channel);
+}
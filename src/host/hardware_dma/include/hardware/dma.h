@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_DMA_H
+#define _HARDWARE_DMA_H
+
+#include "pico.h"
+
+#ifndef PARAM_ASSERTIONS_ENABLED_DMA
+#define PARAM_ASSERTIONS_ENABLED_DMA 0
+#endif
+
+/*
+ * Host implementation of hardware_dma, emulating the DMA channels on the same system clock as the host hardware_pio
+ * (i.e. the channels only make progress when the calling code waits on the DMA or the PIO, see hardware/pio.h).
+ *
+ * Reads and writes go to host memory, except for the addresses of the PIO FIFOs (e.g. &pio0->txf[sm]) which access
+ * the emulated PIO blocks, and those of other emulated peripherals added with dma_host_add_peripheral(). At most one
+ * transfer happens per cycle, shared between the channels whose DREQ is asserted (high priority channels first, then
+ * round robin). The PIO DREQs follow the FIFO levels, the DMA timers pace transfers at their fractional rates, those
+ * of emulated peripherals are as they say, and any other DREQ (peripherals which are not emulated) is always asserted.
+ *
+ * Chaining, ring wrapping, byte swapping, IRQ status and the sniffer (all its calculations, including byte swap and
+ * output reverse/invert) are emulated. There is no interrupt controller on the host, so the channel IRQ status must
+ * be polled.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DREQ_DMA_TIMER0 0x3b
+#define DREQ_DMA_TIMER1 0x3c
+#define DREQ_DMA_TIMER2 0x3d
+#define DREQ_DMA_TIMER3 0x3e
+#define DREQ_FORCE      0x3f
+
+static inline void check_dma_channel_param(__unused uint channel) {
+    valid_params_if(DMA, channel < NUM_DMA_CHANNELS);
+}
+
+static inline void check_dma_timer_param(__unused uint timer_num) {
+    valid_params_if(DMA, timer_num < NUM_DMA_TIMERS);
+}
+
+void dma_channel_claim(uint channel);
+void dma_claim_mask(uint32_t channel_mask);
+void dma_channel_unclaim(uint channel);
+void dma_unclaim_mask(uint32_t channel_mask);
+int dma_claim_unused_channel(bool required);
+bool dma_channel_is_claimed(uint channel);
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,    ///< Byte transfer (8 bits)
+    DMA_SIZE_16 = 1,   ///< Half word transfer (16 bits)
+    DMA_SIZE_32 = 2    ///< Word transfer (32 bits)
+};
+
+typedef struct {
+    bool read_increment;
+    bool write_increment;
+    uint8_t dreq;
+    uint8_t chain_to;
+    uint8_t transfer_data_size;
+    bool ring_write;
+    uint8_t ring_size_bits;
+    bool bswap;
+    bool irq_quiet;
+    bool high_priority;
+    bool enable;
+    bool sniff_enable;
+} dma_channel_config;
+
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+    c->read_increment = incr;
+}
+
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+    c->write_increment = incr;
+}
+
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq) {
+    assert(dreq <= DREQ_FORCE);
+    c->dreq = (uint8_t)dreq;
+}
+
+static inline void channel_config_set_chain_to(dma_channel_config *c, uint chain_to) {
+    assert(chain_to < NUM_DMA_CHANNELS);
+    c->chain_to = (uint8_t)chain_to;
+}
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+    assert(size == DMA_SIZE_8 || size == DMA_SIZE_16 || size == DMA_SIZE_32);
+    c->transfer_data_size = (uint8_t)size;
+}
+
+static inline void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits) {
+    assert(size_bits < 32);
+    c->ring_write = write;
+    c->ring_size_bits = (uint8_t)size_bits;
+}
+
+static inline void channel_config_set_bswap(dma_channel_config *c, bool bswap) {
+    c->bswap = bswap;
+}
+
+static inline void channel_config_set_irq_quiet(dma_channel_config *c, bool irq_quiet) {
+    c->irq_quiet = irq_quiet;
+}
+
+static inline void channel_config_set_high_priority(dma_channel_config *c, bool high_priority) {
+    c->high_priority = high_priority;
+}
+
+static inline void channel_config_set_enable(dma_channel_config *c, bool enable) {
+    c->enable = enable;
+}
+
+static inline void channel_config_set_sniff_enable(dma_channel_config *c, bool sniff_enable) {
+    c->sniff_enable = sniff_enable;
+}
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c = {0};
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, DREQ_FORCE);
+    channel_config_set_chain_to(&c, channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_ring(&c, false, 0);
+    channel_config_set_bswap(&c, false);
+    channel_config_set_irq_quiet(&c, false);
+    channel_config_set_enable(&c, true);
+    channel_config_set_sniff_enable(&c, false);
+    channel_config_set_high_priority( &c, false);
+    return c;
+}
+
+dma_channel_config dma_get_channel_config(uint channel);
+
+void dma_channel_set_config(uint channel, const dma_channel_config *config, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger);
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+
+static inline void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                                         const volatile void *read_addr,
+                                         uint transfer_count, bool trigger) {
+    dma_channel_set_read_addr(channel, read_addr, false);
+    dma_channel_set_write_addr(channel, write_addr, false);
+    dma_channel_set_trans_count(channel, transfer_count, false);
+    dma_channel_set_config(channel, config, trigger);
+}
+
+static inline void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr,
+                                                        uint32_t transfer_count) {
+    dma_channel_set_read_addr(channel, read_addr, false);
+    dma_channel_set_trans_count(channel, transfer_count, true);
+}
+
+static inline void dma_channel_transfer_to_buffer_now(uint channel, volatile void *write_addr, uint32_t transfer_count) {
+    dma_channel_set_write_addr(channel, write_addr, false);
+    dma_channel_set_trans_count(channel, transfer_count, true);
+}
+
+void dma_start_channel_mask(uint32_t chan_mask);
+
+static inline void dma_channel_start(uint channel) {
+    check_dma_channel_param(channel);
+    dma_start_channel_mask(1u << channel);
+}
+
+void dma_channel_abort(uint channel);
+
+void dma_set_irq0_channel_mask_enabled(uint32_t channel_mask, bool enabled);
+void dma_set_irq1_channel_mask_enabled(uint32_t channel_mask, bool enabled);
+
+static inline void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+    check_dma_channel_param(channel);
+    dma_set_irq0_channel_mask_enabled(1u << channel, enabled);
+}
+
+static inline void dma_channel_set_irq1_enabled(uint channel, bool enabled) {
+    check_dma_channel_param(channel);
+    dma_set_irq1_channel_mask_enabled(1u << channel, enabled);
+}
+
+static inline void dma_irqn_set_channel_enabled(uint irq_index, uint channel, bool enabled) {
+    invalid_params_if(DMA, irq_index > 1);
+    if (irq_index) {
+        dma_channel_set_irq1_enabled(channel, enabled);
+    } else {
+        dma_channel_set_irq0_enabled(channel, enabled);
+    }
+}
+
+static inline void dma_irqn_set_channel_mask_enabled(uint irq_index, uint32_t channel_mask,  bool enabled) {
+    invalid_params_if(DMA, irq_index > 1);
+    if (irq_index) {
+        dma_set_irq1_channel_mask_enabled(channel_mask, enabled);
+    } else {
+        dma_set_irq0_channel_mask_enabled(channel_mask, enabled);
+    }
+}
+
+bool dma_irqn_get_channel_status(uint irq_index, uint channel);
+void dma_irqn_acknowledge_channel(uint irq_index, uint channel);
+
+static inline bool dma_channel_get_irq0_status(uint channel) {
+    return dma_irqn_get_channel_status(0, channel);
+}
+
+static inline bool dma_channel_get_irq1_status(uint channel) {
+    return dma_irqn_get_channel_status(1, channel);
+}
+
+static inline void dma_channel_acknowledge_irq0(uint channel) {
+    dma_irqn_acknowledge_channel(0, channel);
+}
+
+static inline void dma_channel_acknowledge_irq1(uint channel) {
+    dma_irqn_acknowledge_channel(1, channel);
+}
+
+// As with the PIO FIFO status functions, this runs a cycle (if the channel is busy) so busy-waits make progress
+bool dma_channel_is_busy(uint channel);
+
+static inline void dma_channel_wait_for_finish_blocking(uint channel) {
+    while (dma_channel_is_busy(channel)) tight_loop_contents();
+}
+
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable);
+void dma_sniffer_set_byte_swap_enabled(bool swap);
+void dma_sniffer_set_output_invert_enabled(bool invert);
+void dma_sniffer_set_output_reverse_enabled(bool reverse);
+void dma_sniffer_disable(void);
+void dma_sniffer_set_data_accumulator(uint32_t seed_value);
+uint32_t dma_sniffer_get_data_accumulator(void);
+
+void dma_timer_claim(uint timer);
+void dma_timer_unclaim(uint timer);
+int dma_claim_unused_timer(bool required);
+bool dma_timer_is_claimed(uint timer);
+void dma_timer_set_fraction(uint timer, uint16_t numerator, uint16_t denominator);
+
+static inline uint dma_get_timer_dreq(uint timer_num) {
+    check_dma_timer_param(timer_num);
+    return DREQ_DMA_TIMER0 + timer_num;
+}
+
+// ----------------------------------------------------------------------------
+// Host emulation statistics
+
+typedef struct dma_host_channel_stats {
+    uint64_t transfers;               // transfers completed
+    uint64_t busy_cycles;             // cycles for which the channel was busy
+    uint64_t dreq_wait_cycles;        // busy cycles on which the channel's DREQ was not asserted
+    uint64_t arbitration_wait_cycles; // busy cycles on which the DREQ was asserted, but another channel transferred
+} dma_host_channel_stats_t;
+
+// Get the statistics for a channel (since it was last claimed or the statistics were reset)
+void dma_host_get_channel_stats(uint channel, dma_host_channel_stats_t *stats);
+
+void dma_host_reset_channel_stats(uint channel);
+
+/*
+ * An emulated peripheral which the DMA channels can access (e.g. the host hardware_spi): accesses to addresses in
+ * [base, base + size) go to its read and write functions, its DREQs [first_dreq, first_dreq + num_dreqs) are asserted
+ * when dreq_asserted() says so, and cycle() (if not NULL) is called on every emulated cycle, before the DMA channels
+ * make their transfers, so it runs on the same clock. All are called with the emulation lock (pio_host_lock()) held.
+ */
+typedef struct dma_host_peripheral {
+    uintptr_t base;
+    size_t size;
+    uint first_dreq;
+    uint num_dreqs;
+    bool (*dreq_asserted)(uint dreq);
+    uint32_t (*read)(uintptr_t addr, uint size);
+    void (*write)(uintptr_t addr, uint32_t data, uint size);
+    void (*cycle)(void);
+} dma_host_peripheral_t;
+
+// Add an emulated peripheral, which must remain valid (adding the same one again has no effect)
+void dma_host_add_peripheral(const dma_host_peripheral_t *peripheral);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hardware/flash.h"
+#include "hardware/timer.h"
+
+#define NUM_SECTORS (PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE)
+
+static uint8_t *contents;
+static uint32_t *erase_counts;
+static FILE *backing_file;
+static flash_host_stats_t stats;
+// operations remaining until the power fails, or -1 if it is not going to
+static int32_t power_fail_countdown = -1;
+static bool power_failed;
+static uint32_t timing_call_us, timing_page_program_us, timing_sector_erase_us;
+
+static void check_init(void) {
+    if (!contents) {
+        contents = malloc(PICO_FLASH_SIZE_BYTES);
+        erase_counts = calloc(NUM_SECTORS, sizeof(uint32_t));
+        if (!contents || !erase_counts) panic("Out of memory for the emulated flash");
+        memset(contents, 0xff, PICO_FLASH_SIZE_BYTES);
+    }
+}
+
+static void write_through(uint32_t offs, size_t count) {
+    if (backing_file) {
+        fseek(backing_file, (long)offs, SEEK_SET);
+        fwrite(contents + offs, 1, count, backing_file);
+        fflush(backing_file);
+    }
+}
+
+// returns the number of bytes of an operation on count bytes which actually happen
+static size_t power_check(size_t count) {
+    if (power_failed) return 0;
+    if (power_fail_countdown > 0) {
+        power_fail_countdown--;
+    } else if (!power_fail_countdown) {
+        power_failed = true;
+        return count / 2;
+    }
+    return count;
+}
+
+static void model_duration(uint64_t us) {
+    if (us) busy_wait_us(us);
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    invalid_params_if(FLASH, flash_offs & (FLASH_SECTOR_SIZE - 1));
+    invalid_params_if(FLASH, count & (FLASH_SECTOR_SIZE - 1));
+    invalid_params_if(FLASH, flash_offs + count > PICO_FLASH_SIZE_BYTES);
+    check_init();
+    model_duration(timing_call_us + (uint64_t)timing_sector_erase_us * (count / FLASH_SECTOR_SIZE));
+    for (uint32_t offs = flash_offs; offs < flash_offs + count; offs += FLASH_SECTOR_SIZE) {
+        size_t n = power_check(FLASH_SECTOR_SIZE);
+        if (!n) return;
+        memset(contents + offs, 0xff, n);
+        write_through(offs, n);
+        uint32_t erases = ++erase_counts[offs / FLASH_SECTOR_SIZE];
+        if (erases > stats.max_sector_erase_count) stats.max_sector_erase_count = erases;
+        stats.sectors_erased++;
+    }
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    invalid_params_if(FLASH, flash_offs & (FLASH_PAGE_SIZE - 1));
+    invalid_params_if(FLASH, count & (FLASH_PAGE_SIZE - 1));
+    invalid_params_if(FLASH, flash_offs + count > PICO_FLASH_SIZE_BYTES);
+    check_init();
+    model_duration(timing_call_us + (uint64_t)timing_page_program_us * (count / FLASH_PAGE_SIZE));
+    for (uint32_t i = 0; i < count; i += FLASH_PAGE_SIZE) {
+        size_t n = power_check(FLASH_PAGE_SIZE);
+        if (!n) return;
+        // programming can only clear bits
+        uint8_t *dst = contents + flash_offs + i;
+        for (size_t j = 0; j < n; j++) dst[j] &= data[i + j];
+        write_through(flash_offs + i, n);
+        stats.pages_programmed++;
+    }
+}
+
+void flash_get_unique_id(uint8_t *id_out) {
+    static const uint8_t host_id[FLASH_UNIQUE_ID_SIZE_BYTES] = {'P', 'I', 'C', 'O', 'H', 'O', 'S', 'T'};
+    memcpy(id_out, host_id, FLASH_UNIQUE_ID_SIZE_BYTES);
+}
+
+void flash_do_cmd(__unused const uint8_t *txbuf, uint8_t *rxbuf, size_t count) {
+    memset(rxbuf, 0xff, count);
+}
+
+const uint8_t *flash_host_get_contents(void) {
+    check_init();
+    return contents;
+}
+
+bool flash_host_set_backing_file(const char *path) {
+    check_init();
+    if (backing_file) {
+        fclose(backing_file);
+        backing_file = NULL;
+    }
+    FILE *f = fopen(path, "r+b");
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        if (ftell(f) == PICO_FLASH_SIZE_BYTES) {
+            fseek(f, 0, SEEK_SET);
+            if (fread(contents, 1, PICO_FLASH_SIZE_BYTES, f) != PICO_FLASH_SIZE_BYTES) {
+                fclose(f);
+                return false;
+            }
+            backing_file = f;
+            return true;
+        }
+        fclose(f);
+    }
+    f = fopen(path, "w+b");
+    if (!f) return false;
+    backing_file = f;
+    write_through(0, PICO_FLASH_SIZE_BYTES);
+    return true;
+}
+
+void flash_host_get_stats(flash_host_stats_t *stats_out) {
+    *stats_out = stats;
+}
+
+void flash_host_reset_stats(void) {
+    check_init();
+    memset(&stats, 0, sizeof(stats));
+    memset(erase_counts, 0, NUM_SECTORS * sizeof(uint32_t));
+}
+
+uint32_t flash_host_get_sector_erase_count(uint sector) {
+    invalid_params_if(FLASH, sector >= NUM_SECTORS);
+    check_init();
+    return erase_counts[sector];
+}
+
+void flash_host_set_timing(uint32_t call_us, uint32_t page_program_us, uint32_t sector_erase_us) {
+    timing_call_us = call_us;
+    timing_page_program_us = page_program_us;
+    timing_sector_erase_us = sector_erase_us;
+}
+
+void flash_host_set_power_fail_after(int32_t operations) {
+    power_fail_countdown = operations < 0 ? -1 : operations;
+    power_failed = false;
+}
+
+bool flash_host_is_power_failed(void) {
+    return power_failed;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_FLASH_H
+#define _HARDWARE_FLASH_H
+
+#include "pico.h"
+
+/*
+ * Host implementation of hardware_flash, emulating a PICO_FLASH_SIZE_BYTES NOR flash in memory (optionally backed by
+ * a file, so that its contents persist between runs).
+ *
+ * As with the real device, programming can only clear bits (the new data is ANDed with the old), and erasing sets a
+ * whole sector to 0xff. The number of times each sector has been erased is counted, the operations can be made to take
+ * a modelled amount of time, and a power failure can be injected after a given number of operations to test the
+ * recovery of data structures stored in flash.
+ */
+
+#ifndef PARAM_ASSERTIONS_ENABLED_FLASH
+#define PARAM_ASSERTIONS_ENABLED_FLASH 0
+#endif
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#define FLASH_BLOCK_SIZE (1u << 16)
+
+#define FLASH_UNIQUE_ID_SIZE_BYTES 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+
+void flash_get_unique_id(uint8_t *id_out);
+
+// Not supported on the host; the received bytes are all 0xff
+void flash_do_cmd(const uint8_t *txbuf, uint8_t *rxbuf, size_t count);
+
+// ----------------------------------------------------------------------------
+// Host emulation extensions
+
+// The emulated flash contents, i.e. what is visible at XIP_BASE on the device
+const uint8_t *flash_host_get_contents(void);
+
+// Back the flash with a file: its contents are loaded if it exists (and is PICO_FLASH_SIZE_BYTES long), otherwise it
+// is created with the current contents. Every later program or erase is written through to the file.
+// Returns false if the file cannot be opened or created.
+bool flash_host_set_backing_file(const char *path);
+
+typedef struct flash_host_stats {
+    uint64_t pages_programmed;      // 256 byte pages programmed (a program of part of a page counts as a whole page)
+    uint64_t sectors_erased;
+    uint32_t max_sector_erase_count; // the highest erase count of any sector
+} flash_host_stats_t;
+
+void flash_host_get_stats(flash_host_stats_t *stats);
+
+// Reset the statistics and the per sector erase counts
+void flash_host_reset_stats(void);
+
+uint32_t flash_host_get_sector_erase_count(uint sector);
+
+// Make each program or erase call busy wait for a modelled duration: call_us for entering and leaving XIP mode, plus
+// page_program_us per page programmed or sector_erase_us per sector erased. All are zero (i.e. the operations are
+// instant) by default. Combined with pico_virtual_time, this gives deterministic timings of flash operations.
+void flash_host_set_timing(uint32_t call_us, uint32_t page_program_us, uint32_t sector_erase_us);
+
+// Simulate losing power after the given number of further page programs and sector erases: the next operation is only
+// half done (the first half of the page is programmed, or of the sector erased), and all those after it are ignored.
+// A negative count cancels the failure (i.e. power is restored).
+void flash_host_set_power_fail_after(int32_t operations);
+
+bool flash_host_is_power_failed(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
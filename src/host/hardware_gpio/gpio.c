@@ -6,6 +6,9 @@
 
 #include "hardware/gpio.h"
 
+// the output levels; nothing else drives the pins, so these are also what is read back
+static uint32_t gpio_out;
+
 // todo weak or replace? probably weak
 void gpio_set_function(uint gpio, enum gpio_function fn) {
 
@@ -83,35 +86,40 @@ void gpio_init(uint gpio) {
 PICO_WEAK_FUNCTION_DEF(gpio_get)
 
 bool PICO_WEAK_FUNCTION_IMPL_NAME(gpio_get)(uint gpio) {
-    return 0;
+    return (gpio_out >> gpio) & 1u;
 }
 
 uint32_t gpio_get_all() {
-    return 0;
+    return gpio_out;
 }
 
 void gpio_set_mask(uint32_t mask) {
-
+    gpio_out |= mask;
 }
 
 void gpio_clr_mask(uint32_t mask) {
-
+    gpio_out &= ~mask;
 }
 
 void gpio_xor_mask(uint32_t mask) {
-
+    gpio_out ^= mask;
 }
 
 void gpio_put_masked(uint32_t mask, uint32_t value) {
-
+    gpio_out = (gpio_out & ~mask) | (value & mask);
 }
 
 void gpio_put_all(uint32_t value) {
-
+    gpio_out = value;
 }
 
 void gpio_put(uint gpio, int value) {
-
+    uint32_t mask = 1u << gpio;
+    if (value) {
+        gpio_out |= mask;
+    } else {
+        gpio_out &= ~mask;
+    }
 }
 
 void gpio_set_dir_out_masked(uint32_t mask) {
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+
+#define FIFO_DEPTH 16u
+
+// latched interrupts, cleared by i2c_clear_irqs
+#define LATCHED_BITS (I2C_IC_INTR_STAT_R_RESTART_DET_BITS | I2C_IC_INTR_STAT_R_GEN_CALL_BITS | \
+                      I2C_IC_INTR_STAT_R_START_DET_BITS | I2C_IC_INTR_STAT_R_STOP_DET_BITS | \
+                      I2C_IC_INTR_STAT_R_ACTIVITY_BITS | I2C_IC_INTR_STAT_R_RX_DONE_BITS | \
+                      I2C_IC_INTR_STAT_R_TX_ABRT_BITS | I2C_IC_INTR_STAT_R_RD_REQ_BITS | \
+                      I2C_IC_INTR_STAT_R_TX_OVER_BITS | I2C_IC_INTR_STAT_R_RX_OVER_BITS | \
+                      I2C_IC_INTR_STAT_R_RX_UNDER_BITS)
+
+struct i2c_inst {
+    uint baudrate;
+    bool slave;
+    uint8_t addr;
+    uint32_t raw;               // latched interrupts
+    uint32_t mask;
+    uint rx_threshold;
+    uint tx_threshold;
+    uint16_t rx_fifo[FIFO_DEPTH];   // data and FIRST_DATA_BYTE flag
+    uint rx_head;
+    uint rx_count;
+    uint8_t tx_fifo[FIFO_DEPTH];
+    uint tx_head;
+    uint tx_count;
+    uint32_t irq_count;
+};
+
+i2c_inst_t i2c0_inst = {.mask = I2C_IC_INTR_MASK_RESET};
+i2c_inst_t i2c1_inst = {.mask = I2C_IC_INTR_MASK_RESET};
+
+uint i2c_hw_index(i2c_inst_t *i2c) {
+    invalid_params_if(I2C, i2c != i2c0 && i2c != i2c1);
+    return i2c == i2c1 ? 1 : 0;
+}
+
+i2c_inst_t *i2c_get_instance(uint instance) {
+    invalid_params_if(I2C, instance > 1);
+    return instance ? i2c1 : i2c0;
+}
+
+static void reset(i2c_inst_t *i2c) {
+    i2c->slave = false;
+    i2c->addr = 0;
+    i2c->raw = 0;
+    i2c->mask = I2C_IC_INTR_MASK_RESET;
+    i2c->rx_threshold = i2c->tx_threshold = 0;
+    i2c->rx_head = i2c->rx_count = 0;
+    i2c->tx_head = i2c->tx_count = 0;
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    reset(i2c);
+    return i2c_set_baudrate(i2c, baudrate);
+}
+
+void i2c_deinit(i2c_inst_t *i2c) {
+    reset(i2c);
+    i2c->baudrate = 0;
+}
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate) {
+    invalid_params_if(I2C, baudrate == 0);
+    i2c->baudrate = baudrate;
+    return baudrate;
+}
+
+void i2c_set_slave_mode(i2c_inst_t *i2c, bool slave, uint8_t addr) {
+    invalid_params_if(I2C, addr >= 0x80); // 7-bit addresses
+    i2c->slave = slave;
+    i2c->addr = slave ? addr : 0;
+}
+
+// ----------------------------------------------------------------------------
+// the slave side, as seen by its own code
+
+static uint32_t irq_status(const i2c_inst_t *i2c) {
+    uint32_t raw = i2c->raw;
+    if (i2c->rx_count > i2c->rx_threshold) raw |= I2C_IC_INTR_STAT_R_RX_FULL_BITS;
+    if (i2c->tx_count <= i2c->tx_threshold) raw |= I2C_IC_INTR_STAT_R_TX_EMPTY_BITS;
+    return raw & i2c->mask;
+}
+
+uint32_t i2c_get_irq_status(i2c_inst_t *i2c) {
+    return irq_status(i2c);
+}
+
+void i2c_set_irq_mask(i2c_inst_t *i2c, uint32_t mask) {
+    i2c->mask = mask;
+}
+
+void i2c_clear_irqs(i2c_inst_t *i2c, uint32_t mask) {
+    i2c->raw &= ~(mask & LATCHED_BITS);
+}
+
+void i2c_set_fifo_thresholds(i2c_inst_t *i2c, uint rx_threshold, uint tx_threshold) {
+    invalid_params_if(I2C, rx_threshold > 15 || tx_threshold > 15);
+    i2c->rx_threshold = rx_threshold;
+    i2c->tx_threshold = tx_threshold;
+}
+
+size_t i2c_get_write_available(i2c_inst_t *i2c) {
+    return FIFO_DEPTH - i2c->tx_count;
+}
+
+size_t i2c_get_read_available(i2c_inst_t *i2c) {
+    return i2c->rx_count;
+}
+
+uint32_t i2c_read_data_cmd_raw(i2c_inst_t *i2c) {
+    if (!i2c->rx_count) {
+        i2c->raw |= I2C_IC_INTR_STAT_R_RX_UNDER_BITS;
+        return 0;
+    }
+    uint32_t entry = i2c->rx_fifo[i2c->rx_head];
+    i2c->rx_head = (i2c->rx_head + 1) % FIFO_DEPTH;
+    i2c->rx_count--;
+    return entry;
+}
+
+uint8_t i2c_read_byte_raw(i2c_inst_t *i2c) {
+    return (uint8_t)i2c_read_data_cmd_raw(i2c);
+}
+
+void i2c_write_byte_raw(i2c_inst_t *i2c, uint8_t value) {
+    if (i2c->tx_count == FIFO_DEPTH) {
+        i2c->raw |= I2C_IC_INTR_STAT_R_TX_OVER_BITS;
+        return;
+    }
+    i2c->tx_fifo[(i2c->tx_head + i2c->tx_count) % FIFO_DEPTH] = value;
+    i2c->tx_count++;
+}
+
+void i2c_write_raw_blocking(i2c_inst_t *i2c, const uint8_t *src, size_t len) {
+    // nothing drains the Tx FIFO while we wait, so just fill it
+    for (size_t i = 0; i < len; i++) i2c_write_byte_raw(i2c, src[i]);
+}
+
+void i2c_read_raw_blocking(i2c_inst_t *i2c, uint8_t *dst, size_t len) {
+    for (size_t i = 0; i < len; i++) dst[i] = i2c_read_byte_raw(i2c);
+}
+
+uint32_t i2c_host_get_irq_count(i2c_inst_t *i2c) {
+    return i2c->irq_count;
+}
+
+// ----------------------------------------------------------------------------
+// the bus, driven by the master
+
+// raise the slave's IRQ if an enabled interrupt is asserted (its handler runs straight away if it can)
+static void update_irq(i2c_inst_t *slave) {
+    if (irq_status(slave)) {
+        slave->irq_count++;
+        irq_set_pending(I2C0_IRQ + i2c_hw_index(slave));
+    }
+}
+
+static void latch(i2c_inst_t *slave, uint32_t bits) {
+    slave->raw |= bits;
+    update_irq(slave);
+}
+
+static i2c_inst_t *address(i2c_inst_t *master, uint8_t addr) {
+    invalid_params_if(I2C, addr >= 0x80); // 7-bit addresses
+    i2c_inst_t *other = master == i2c0 ? i2c1 : i2c0;
+    if (other->slave && other->addr == addr && !master->slave) {
+        return other;
+    }
+    return NULL;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    invalid_params_if(I2C, len == 0);
+    i2c_inst_t *slave = address(i2c, addr);
+    if (!slave) return PICO_ERROR_GENERIC;
+    latch(slave, I2C_IC_INTR_STAT_R_START_DET_BITS);
+    for (size_t i = 0; i < len; i++) {
+        if (slave->rx_count == FIFO_DEPTH) {
+            // the slave stretches the clock while its Rx FIFO is full
+            update_irq(slave);
+            if (slave->rx_count == FIFO_DEPTH) return PICO_ERROR_GENERIC;
+        }
+        slave->rx_fifo[(slave->rx_head + slave->rx_count) % FIFO_DEPTH] =
+                (uint16_t)(src[i] | (i ? 0 : I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS));
+        slave->rx_count++;
+        update_irq(slave);
+    }
+    if (!nostop) latch(slave, I2C_IC_INTR_STAT_R_STOP_DET_BITS);
+    return (int)len;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    invalid_params_if(I2C, len == 0);
+    i2c_inst_t *slave = address(i2c, addr);
+    if (!slave) return PICO_ERROR_GENERIC;
+    uint32_t bits = I2C_IC_INTR_STAT_R_START_DET_BITS;
+    if (slave->tx_count) {
+        // data left over from a previous read is flushed
+        slave->tx_count = 0;
+        bits |= I2C_IC_INTR_STAT_R_TX_ABRT_BITS;
+    }
+    latch(slave, bits);
+    for (size_t i = 0; i < len; i++) {
+        if (!slave->tx_count) {
+            // the slave stretches the clock until it supplies data
+            latch(slave, I2C_IC_INTR_STAT_R_RD_REQ_BITS);
+            if (!slave->tx_count) return PICO_ERROR_GENERIC;
+        }
+        dst[i] = slave->tx_fifo[slave->tx_head];
+        slave->tx_head = (slave->tx_head + 1) % FIFO_DEPTH;
+        slave->tx_count--;
+        update_irq(slave);
+    }
+    // the master NACKs the last byte
+    latch(slave, I2C_IC_INTR_STAT_R_RX_DONE_BITS);
+    if (!nostop) latch(slave, I2C_IC_INTR_STAT_R_STOP_DET_BITS);
+    return (int)len;
+}
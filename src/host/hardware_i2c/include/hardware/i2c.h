@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_I2C_H
+#define _HARDWARE_I2C_H
+
+#include "pico.h"
+#include "pico/time.h"
+
+#ifndef PARAM_ASSERTIONS_ENABLED_I2C
+#define PARAM_ASSERTIONS_ENABLED_I2C 0
+#endif
+
+/*
+ * Host implementation of hardware_i2c, modelling the two controllers attached to a single (simulated) bus.
+ *
+ * A controller in slave mode is modelled at the level of its FIFOs (16 entries each way, with the
+ * FIRST_DATA_BYTE flag on received data) and its interrupt status: the latched START_DET, STOP_DET, RD_REQ,
+ * TX_ABRT (when stale data is flushed from the Tx FIFO at the start of a read) and RX_DONE, and RX_FULL and
+ * TX_EMPTY following the FIFO levels and thresholds. Whenever an enabled interrupt is asserted, the controller's
+ * IRQ (I2C0_IRQ or I2C1_IRQ) is raised with the host hardware_irq.
+ *
+ * The other controller, as master, addresses it with i2c_write_blocking() and i2c_read_blocking(): each byte
+ * moves through the slave's FIFOs, with the slave's interrupt handlers running as it goes. Clock stretching is
+ * modelled by raising the slave's IRQ again when it has no Tx data or its Rx FIFO is full; if that doesn't help
+ * (nothing else will run), the transfer fails with PICO_ERROR_GENERIC, as it does if no slave has the address.
+ *
+ * DMA to and from the FIFOs is not modelled.
+ */
+
+#ifndef I2C_IC_INTR_STAT_R_RX_UNDER_BITS
+#define I2C_IC_INTR_STAT_R_RESTART_DET_BITS 0x00001000u
+#define I2C_IC_INTR_STAT_R_GEN_CALL_BITS    0x00000800u
+#define I2C_IC_INTR_STAT_R_START_DET_BITS   0x00000400u
+#define I2C_IC_INTR_STAT_R_STOP_DET_BITS    0x00000200u
+#define I2C_IC_INTR_STAT_R_ACTIVITY_BITS    0x00000100u
+#define I2C_IC_INTR_STAT_R_RX_DONE_BITS     0x00000080u
+#define I2C_IC_INTR_STAT_R_TX_ABRT_BITS     0x00000040u
+#define I2C_IC_INTR_STAT_R_RD_REQ_BITS      0x00000020u
+#define I2C_IC_INTR_STAT_R_TX_EMPTY_BITS    0x00000010u
+#define I2C_IC_INTR_STAT_R_TX_OVER_BITS     0x00000008u
+#define I2C_IC_INTR_STAT_R_RX_FULL_BITS     0x00000004u
+#define I2C_IC_INTR_STAT_R_RX_OVER_BITS     0x00000002u
+#define I2C_IC_INTR_STAT_R_RX_UNDER_BITS    0x00000001u
+
+#define I2C_IC_INTR_MASK_RESET              0x000008ffu
+#define I2C_IC_INTR_MASK_M_RESTART_DET_BITS 0x00001000u
+#define I2C_IC_INTR_MASK_M_GEN_CALL_BITS    0x00000800u
+#define I2C_IC_INTR_MASK_M_START_DET_BITS   0x00000400u
+#define I2C_IC_INTR_MASK_M_STOP_DET_BITS    0x00000200u
+#define I2C_IC_INTR_MASK_M_ACTIVITY_BITS    0x00000100u
+#define I2C_IC_INTR_MASK_M_RX_DONE_BITS     0x00000080u
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS     0x00000040u
+#define I2C_IC_INTR_MASK_M_RD_REQ_BITS      0x00000020u
+#define I2C_IC_INTR_MASK_M_TX_EMPTY_BITS    0x00000010u
+#define I2C_IC_INTR_MASK_M_TX_OVER_BITS     0x00000008u
+#define I2C_IC_INTR_MASK_M_RX_FULL_BITS     0x00000004u
+#define I2C_IC_INTR_MASK_M_RX_OVER_BITS     0x00000002u
+#define I2C_IC_INTR_MASK_M_RX_UNDER_BITS    0x00000001u
+
+#define I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS 0x00000800u
+#define I2C_IC_DATA_CMD_DAT_BITS            0x000000ffu
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct i2c_inst i2c_inst_t;
+
+extern i2c_inst_t i2c0_inst;
+extern i2c_inst_t i2c1_inst;
+
+#define i2c0 (&i2c0_inst)
+#define i2c1 (&i2c1_inst)
+
+#if !defined(PICO_DEFAULT_I2C_INSTANCE) && defined(PICO_DEFAULT_I2C)
+#define PICO_DEFAULT_I2C_INSTANCE (__CONCAT(i2c,PICO_DEFAULT_I2C))
+#endif
+
+#ifdef PICO_DEFAULT_I2C_INSTANCE
+#define i2c_default PICO_DEFAULT_I2C_INSTANCE
+#endif
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+void i2c_deinit(i2c_inst_t *i2c);
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate);
+void i2c_set_slave_mode(i2c_inst_t *i2c, bool slave, uint8_t addr);
+uint i2c_hw_index(i2c_inst_t *i2c);
+i2c_inst_t *i2c_get_instance(uint instance);
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+static inline int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, __unused uint timeout_us) {
+    return i2c_write_blocking(i2c, addr, src, len, nostop);
+}
+
+static inline int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, __unused uint timeout_us) {
+    return i2c_read_blocking(i2c, addr, dst, len, nostop);
+}
+
+size_t i2c_get_write_available(i2c_inst_t *i2c);
+size_t i2c_get_read_available(i2c_inst_t *i2c);
+void i2c_write_raw_blocking(i2c_inst_t *i2c, const uint8_t *src, size_t len);
+void i2c_read_raw_blocking(i2c_inst_t *i2c, uint8_t *dst, size_t len);
+uint8_t i2c_read_byte_raw(i2c_inst_t *i2c);
+void i2c_write_byte_raw(i2c_inst_t *i2c, uint8_t value);
+uint32_t i2c_read_data_cmd_raw(i2c_inst_t *i2c);
+
+uint32_t i2c_get_irq_status(i2c_inst_t *i2c);
+void i2c_set_irq_mask(i2c_inst_t *i2c, uint32_t mask);
+void i2c_clear_irqs(i2c_inst_t *i2c, uint32_t mask);
+void i2c_set_fifo_thresholds(i2c_inst_t *i2c, uint rx_threshold, uint tx_threshold);
+
+// host only: the number of times the controller's IRQ has been raised, e.g. to measure the interrupt load of a slave
+uint32_t i2c_host_get_irq_count(i2c_inst_t *i2c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_IRQ_H
+#define _HARDWARE_IRQ_H
+
+#include "pico.h"
+
+/*
+ * Host implementation of hardware_irq, simulating the NVIC of the calling core.
+ *
+ * Nothing on the host raises interrupts by itself; an IRQ becomes pending through irq_set_pending(), and if it is
+ * enabled and of higher priority than any IRQ being handled, its handler is called straight away on the calling
+ * thread (nesting inside a lower priority handler). Otherwise it is handled when that becomes possible: when the
+ * IRQ is enabled (although as on the device, enabling an IRQ first clears its pending state), or when the handlers
+ * in progress return. As on the RP2040 only the top two bits of the priority are significant, and IRQs of the same
+ * priority are handled in order of IRQ number.
+ *
+ * Shared handlers are always dispatched from a table (PICO_SHARED_IRQ_HANDLER_TABLE), with profiling enabled by
+ * default; handler execution "cycles" are derived from time_us_64() at the default 125MHz system clock, so are
+ * only meaningful (and then deterministic) with pico_virtual_time, when a handler's time is that which it spends
+ * in busy_wait_us() and the like.
+ */
+
+#ifndef PICO_MAX_SHARED_IRQ_HANDLERS
+#define PICO_MAX_SHARED_IRQ_HANDLERS 4u
+#endif
+
+#ifndef PICO_DISABLE_SHARED_IRQ_HANDLERS
+#define PICO_DISABLE_SHARED_IRQ_HANDLERS 0
+#endif
+
+#undef PICO_SHARED_IRQ_HANDLER_TABLE
+#define PICO_SHARED_IRQ_HANDLER_TABLE 1
+
+#ifndef PICO_SHARED_IRQ_HANDLER_PROFILING
+#define PICO_SHARED_IRQ_HANDLER_PROFILING 1
+#endif
+
+#ifndef PICO_VTABLE_PER_CORE
+#define PICO_VTABLE_PER_CORE 0
+#endif
+
+#ifndef PICO_DEFAULT_IRQ_PRIORITY
+#define PICO_DEFAULT_IRQ_PRIORITY 0x80
+#endif
+
+#define PICO_LOWEST_IRQ_PRIORITY 0xff
+#define PICO_HIGHEST_IRQ_PRIORITY 0x00
+
+#ifndef PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+#endif
+
+#define PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY 0xff
+#define PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY 0x00
+
+#ifndef PARAM_ASSERTIONS_ENABLED_IRQ
+#define PARAM_ASSERTIONS_ENABLED_IRQ 0
+#endif
+
+#ifndef TIMER_IRQ_0
+#define TIMER_IRQ_0 0
+#define TIMER_IRQ_1 1
+#define TIMER_IRQ_2 2
+#define TIMER_IRQ_3 3
+#define PWM_IRQ_WRAP 4
+#define USBCTRL_IRQ 5
+#define XIP_IRQ 6
+#define PIO0_IRQ_0 7
+#define PIO0_IRQ_1 8
+#define PIO1_IRQ_0 9
+#define PIO1_IRQ_1 10
+#define DMA_IRQ_0 11
+#define DMA_IRQ_1 12
+#define IO_IRQ_BANK0 13
+#define IO_IRQ_QSPI 14
+#define SIO_IRQ_PROC0 15
+#define SIO_IRQ_PROC1 16
+#define CLOCKS_IRQ 17
+#define SPI0_IRQ 18
+#define SPI1_IRQ 19
+#define UART0_IRQ 20
+#define UART1_IRQ 21
+#define ADC_IRQ_FIFO 22
+#define I2C0_IRQ 23
+#define I2C1_IRQ 24
+#define RTC_IRQ 25
+#endif
+
+#ifndef NUM_USER_IRQS
+#define NUM_USER_IRQS 6u
+#define FIRST_USER_IRQ (NUM_IRQS - NUM_USER_IRQS)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*irq_handler_t)(void);
+
+typedef bool (*irq_chain_handler_t)(void);
+
+static inline void check_irq_param(__unused uint num) {
+    invalid_params_if(IRQ, num >= NUM_IRQS);
+}
+
+void irq_set_priority(uint num, uint8_t hardware_priority);
+uint irq_get_priority(uint num);
+void irq_set_enabled(uint num, bool enabled);
+bool irq_is_enabled(uint num);
+void irq_set_mask_enabled(uint32_t mask, bool enabled);
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+irq_handler_t irq_get_exclusive_handler(uint num);
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority);
+void irq_add_shared_chain_handler(uint num, irq_chain_handler_t handler, uint8_t order_priority);
+void irq_remove_handler(uint num, irq_handler_t handler);
+bool irq_has_shared_handler(uint num);
+irq_handler_t irq_get_vtable_handler(uint num);
+void irq_clear(uint int_num);
+void irq_set_pending(uint num);
+void irq_init_priorities(void);
+
+typedef struct irq_shared_handler_stats {
+    irq_handler_t handler;
+    uint8_t order_priority;
+    uint8_t max_depth;
+    uint32_t count;
+    uint32_t chain_stops;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+} irq_shared_handler_stats_t;
+
+uint irq_get_shared_handler_stats(uint num, irq_shared_handler_stats_t *stats, uint max_handlers);
+void irq_clear_shared_handler_stats(void);
+uint irq_get_shared_handler_max_depth(void);
+
+void user_irq_claim(uint irq_num);
+void user_irq_unclaim(uint irq_num);
+int user_irq_claim_unused(bool required);
+bool user_irq_is_claimed(uint irq_num);
+
+// host only: the IRQ whose handler is running on the calling thread, or -1
+int irq_host_get_current_irq(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "irq_shared_table.h"
+
+// the processor clock assumed when converting time to cycles
+#define CYCLES_PER_US 125u
+
+// the simulated NVIC of each core; the vtable is shared, as by default on the device
+typedef struct {
+    uint32_t enabled;
+    uint32_t pending;
+    uint8_t priority[NUM_IRQS];
+    int active_irq;             // -1 if none
+    uint active_level;          // priority level of active_irq, or one past the lowest if none
+} nvic_t;
+
+static irq_handler_t vtable[NUM_IRQS];
+static nvic_t nvic[NUM_CORES];
+static uint8_t user_irq_claimed[NUM_CORES];
+static bool initialized;
+
+// only the top two bits of the priority are implemented
+#define PRIORITY_LEVEL(p) ((uint)(p) >> 6)
+#define NO_LEVEL 4u
+
+void __unhandled_user_irq(void) {
+    panic("Unhandled IRQ %d", irq_host_get_current_irq());
+}
+
+static uint32_t irq_lock(void) {
+    uint32_t save = spin_lock_blocking(spin_lock_instance(PICO_SPINLOCK_ID_IRQ));
+    if (!initialized) {
+        for (uint i = 0; i < NUM_IRQS; i++) vtable[i] = __unhandled_user_irq;
+        for (uint c = 0; c < NUM_CORES; c++) {
+            for (uint i = 0; i < NUM_IRQS; i++) nvic[c].priority[i] = PICO_DEFAULT_IRQ_PRIORITY;
+            nvic[c].active_irq = -1;
+            nvic[c].active_level = NO_LEVEL;
+        }
+        initialized = true;
+    }
+    return save;
+}
+
+static void irq_unlock(uint32_t save) {
+    spin_unlock(spin_lock_instance(PICO_SPINLOCK_ID_IRQ), save);
+}
+
+// handle any pending IRQs which may preempt what is running on this core
+static void service(void) {
+    nvic_t *n = &nvic[get_core_num()];
+    while (true) {
+        uint32_t save = irq_lock();
+        uint32_t ready = n->pending & n->enabled;
+        int best = -1;
+        uint best_level = n->active_level;
+        for (uint i = 0; ready; i++, ready >>= 1) {
+            if ((ready & 1u) && PRIORITY_LEVEL(n->priority[i]) < best_level) {
+                best = (int)i;
+                best_level = PRIORITY_LEVEL(n->priority[i]);
+            }
+        }
+        if (best < 0) {
+            irq_unlock(save);
+            return;
+        }
+        n->pending &= ~(1u << best);
+        int prev_irq = n->active_irq;
+        uint prev_level = n->active_level;
+        n->active_irq = best;
+        n->active_level = best_level;
+        irq_handler_t handler = vtable[best];
+        irq_unlock(save);
+        handler();
+        save = irq_lock();
+        n->active_irq = prev_irq;
+        n->active_level = prev_level;
+        irq_unlock(save);
+    }
+}
+
+int irq_host_get_current_irq(void) {
+    uint32_t save = irq_lock();
+    int irq = nvic[get_core_num()].active_irq;
+    irq_unlock(save);
+    return irq;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    check_irq_param(num);
+    irq_set_mask_enabled(1u << num, enabled);
+}
+
+bool irq_is_enabled(uint num) {
+    check_irq_param(num);
+    uint32_t save = irq_lock();
+    bool enabled = nvic[get_core_num()].enabled & (1u << num);
+    irq_unlock(save);
+    return enabled;
+}
+
+void irq_set_mask_enabled(uint32_t mask, bool enabled) {
+    uint32_t save = irq_lock();
+    nvic_t *n = &nvic[get_core_num()];
+    if (enabled) {
+        // as on the device, clear pending before enable
+        n->pending &= ~mask;
+        n->enabled |= mask;
+    } else {
+        n->enabled &= ~mask;
+    }
+    irq_unlock(save);
+}
+
+void irq_set_pending(uint num) {
+    check_irq_param(num);
+    uint32_t save = irq_lock();
+    nvic[get_core_num()].pending |= 1u << num;
+    irq_unlock(save);
+    service();
+}
+
+void irq_clear(uint int_num) {
+    uint32_t save = irq_lock();
+    nvic[get_core_num()].pending &= ~(1u << (int_num & 0x1f));
+    irq_unlock(save);
+}
+
+void irq_set_priority(uint num, uint8_t hardware_priority) {
+    check_irq_param(num);
+    uint32_t save = irq_lock();
+    nvic[get_core_num()].priority[num] = hardware_priority;
+    irq_unlock(save);
+}
+
+uint irq_get_priority(uint num) {
+    check_irq_param(num);
+    uint32_t save = irq_lock();
+    uint priority = nvic[get_core_num()].priority[num];
+    irq_unlock(save);
+    return priority;
+}
+
+void irq_init_priorities(void) {
+    uint32_t save = irq_lock();
+    for (uint i = 0; i < NUM_IRQS; i++) nvic[get_core_num()].priority[i] = PICO_DEFAULT_IRQ_PRIORITY;
+    irq_unlock(save);
+}
+
+irq_handler_t irq_get_vtable_handler(uint num) {
+    check_irq_param(num);
+    if (!initialized) irq_unlock(irq_lock());
+    return vtable[num];
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    check_irq_param(num);
+    uint32_t save = irq_lock();
+    hard_assert(vtable[num] == __unhandled_user_irq || vtable[num] == handler);
+    vtable[num] = handler;
+    irq_unlock(save);
+}
+
+irq_handler_t irq_get_exclusive_handler(uint num) {
+    check_irq_param(num);
+    uint32_t save = irq_lock();
+    irq_handler_t current = vtable[num];
+    irq_unlock(save);
+    if (current == __unhandled_user_irq || current == irq_shared_table_dispatch) {
+        return NULL;
+    }
+    return current;
+}
+
+bool irq_has_shared_handler(uint num) {
+    return irq_get_vtable_handler(num) == irq_shared_table_dispatch;
+}
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority) {
+    check_irq_param(num);
+#if PICO_DISABLE_SHARED_IRQ_HANDLERS
+    irq_set_exclusive_handler(num, handler);
+#else
+    // make sure the vtable is initialized before the table looks at it
+    irq_unlock(irq_lock());
+    irq_shared_table_add(num, handler, false, order_priority);
+#endif
+}
+
+void irq_remove_handler(uint num, irq_handler_t handler) {
+    check_irq_param(num);
+    uint32_t save = irq_lock();
+    if (vtable[num] == handler) {
+        vtable[num] = __unhandled_user_irq;
+    } else {
+        __unused bool found = vtable[num] == irq_shared_table_dispatch && irq_shared_table_remove(num, handler);
+        assert(found);
+    }
+    irq_unlock(save);
+}
+
+// ----------------------------------------------------------------------------
+// backend of the shared handler table
+
+uint irq_shared_table_backend_current_irq(void) {
+    return (uint)irq_host_get_current_irq();
+}
+
+void irq_shared_table_backend_set_vtable_handler(uint num, irq_handler_t handler) {
+    vtable[num] = handler;
+}
+
+uint32_t irq_shared_table_backend_get_cycles(void) {
+    return (uint32_t)(time_us_64() * CYCLES_PER_US);
+}
+
+uint32_t irq_shared_table_backend_cycles_since(uint32_t start) {
+    return irq_shared_table_backend_get_cycles() - start;
+}
+
+// ----------------------------------------------------------------------------
+// user IRQ claims
+
+static uint get_user_irq_claim_index(uint irq_num) {
+    invalid_params_if(IRQ, irq_num < FIRST_USER_IRQ || irq_num >= NUM_IRQS);
+    // we count backwards from the last, as on the device
+    return NUM_IRQS - irq_num - 1u;
+}
+
+void user_irq_claim(uint irq_num) {
+    uint bit = 1u << get_user_irq_claim_index(irq_num);
+    uint32_t save = irq_lock();
+    uint8_t *claimed = &user_irq_claimed[get_core_num()];
+    bool was_claimed = *claimed & bit;
+    *claimed |= (uint8_t)bit;
+    irq_unlock(save);
+    if (was_claimed) {
+        panic("User IRQ is already claimed");
+    }
+}
+
+void user_irq_unclaim(uint irq_num) {
+    uint bit = 1u << get_user_irq_claim_index(irq_num);
+    uint32_t save = irq_lock();
+    user_irq_claimed[get_core_num()] &= (uint8_t)~bit;
+    irq_unlock(save);
+}
+
+int user_irq_claim_unused(bool required) {
+    int irq_num = -1;
+    uint32_t save = irq_lock();
+    uint8_t *claimed = &user_irq_claimed[get_core_num()];
+    for (uint i = 0; i < NUM_USER_IRQS; i++) {
+        if (!(*claimed & (1u << i))) {
+            *claimed |= (uint8_t)(1u << i);
+            irq_num = (int)(NUM_IRQS - i - 1);
+            break;
+        }
+    }
+    irq_unlock(save);
+    if (irq_num < 0 && required) {
+        panic("No user IRQs are available");
+    }
+    return irq_num;
+}
+
+bool user_irq_is_claimed(uint irq_num) {
+    uint bit = 1u << get_user_irq_claim_index(irq_num);
+    uint32_t save = irq_lock();
+    bool claimed = user_irq_claimed[get_core_num()] & bit;
+    irq_unlock(save);
+    return claimed;
+}
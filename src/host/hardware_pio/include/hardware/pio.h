@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_PIO_H
+#define _HARDWARE_PIO_H
+
+#include "pico.h"
+#include "hardware/gpio.h"
+#include "hardware/pio_instructions.h"
+#include "pio_sim.h"
+
+#ifndef PARAM_ASSERTIONS_ENABLED_PIO
+#define PARAM_ASSERTIONS_ENABLED_PIO 0
+#endif
+
+/*
+ * Host implementation of hardware_pio, backed by the cycle accurate model of the PIO blocks in pio_sim.
+ *
+ * There is no free running clock; the emulated system clock only advances when the calling code waits on the PIO (or
+ * DMA), i.e. blocking FIFO accesses run cycles until they can complete, and each FIFO level/status query runs one
+ * cycle so that busy-wait loops make progress. pio_host_run_cycles() can also be used to advance the clock explicitly.
+ * Everything is deterministic, so pio_host_get_cycle_count() gives exact timings of PIO (and DMA) driven code.
+ *
+ * The pins of both PIO blocks are combined: a pin driven by either PIO (PIO 1 winning if both drive it) is seen as
+ * that level by both, otherwise it is at the level set by pio_host_set_gpio_in().
+ *
+ * There is no interrupt controller on the host, so the IRQ source enables are recorded but do nothing.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum pio_fifo_join {
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX = 1,
+    PIO_FIFO_JOIN_RX = 2,
+};
+
+enum pio_mov_status_type {
+    STATUS_TX_LESSTHAN = 0,
+    STATUS_RX_LESSTHAN = 1
+};
+
+enum pio_interrupt_source {
+    pis_interrupt0 = 8,
+    pis_interrupt1 = 9,
+    pis_interrupt2 = 10,
+    pis_interrupt3 = 11,
+    pis_sm0_tx_fifo_not_full = 4,
+    pis_sm1_tx_fifo_not_full = 5,
+    pis_sm2_tx_fifo_not_full = 6,
+    pis_sm3_tx_fifo_not_full = 7,
+    pis_sm0_rx_fifo_not_empty = 0,
+    pis_sm1_rx_fifo_not_empty = 1,
+    pis_sm2_rx_fifo_not_empty = 2,
+    pis_sm3_rx_fifo_not_empty = 3,
+};
+
+// Only the registers which other code may take the address of (e.g. as a DMA source or destination) or write
+// directly. The FIFO registers are placeholders; they are recognised by the host hardware_dma, but must not be
+// accessed directly
+typedef struct pio_hw {
+    volatile uint32_t txf[NUM_PIO_STATE_MACHINES];
+    volatile uint32_t rxf[NUM_PIO_STATE_MACHINES];
+    volatile uint32_t input_sync_bypass;
+} pio_hw_t;
+
+extern pio_hw_t pio_host_hw[NUM_PIOS];
+
+#define pio0_hw (&pio_host_hw[0])
+#define pio1_hw (&pio_host_hw[1])
+
+typedef pio_hw_t *PIO;
+
+#define pio0 pio0_hw
+#define pio1 pio1_hw
+
+// DREQ numbers match the RP2040's, so they can be passed to channel_config_set_dreq()
+#define DREQ_PIO0_TX0 0
+#define DREQ_PIO1_TX0 8
+
+typedef pio_sim_sm_config_t pio_sm_config;
+
+static inline void check_sm_param(__unused uint sm) {
+    valid_params_if(PIO, sm < NUM_PIO_STATE_MACHINES);
+}
+
+static inline void check_sm_mask(__unused uint mask) {
+    valid_params_if(PIO, mask < (1u << NUM_PIO_STATE_MACHINES));
+}
+
+static inline void check_pio_param(__unused PIO pio) {
+    valid_params_if(PIO, pio == pio0 || pio == pio1);
+}
+
+static inline void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count) {
+    valid_params_if(PIO, out_base < 32);
+    valid_params_if(PIO, out_count <= 32);
+    c->out_base = (uint8_t)out_base;
+    c->out_count = (uint8_t)out_count;
+}
+
+static inline void sm_config_set_set_pins(pio_sm_config *c, uint set_base, uint set_count) {
+    valid_params_if(PIO, set_base < 32);
+    valid_params_if(PIO, set_count <= 5);
+    c->set_base = (uint8_t)set_base;
+    c->set_count = (uint8_t)set_count;
+}
+
+static inline void sm_config_set_in_pins(pio_sm_config *c, uint in_base) {
+    valid_params_if(PIO, in_base < 32);
+    c->in_base = (uint8_t)in_base;
+}
+
+static inline void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base) {
+    valid_params_if(PIO, sideset_base < 32);
+    c->sideset_base = (uint8_t)sideset_base;
+}
+
+static inline void sm_config_set_sideset(pio_sm_config *c, uint bit_count, bool optional, bool pindirs) {
+    valid_params_if(PIO, bit_count <= 5);
+    valid_params_if(PIO, !optional || bit_count >= 1);
+    c->sideset_count = (uint8_t)bit_count;
+    c->sideset_opt = optional;
+    c->sideset_pindirs = pindirs;
+}
+
+static inline void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t div_int, uint8_t div_frac) {
+    invalid_params_if(PIO, div_int == 0 && div_frac != 0);
+    c->clkdiv_int = div_int;
+    c->clkdiv_frac = div_frac;
+}
+
+static inline void pio_calculate_clkdiv_from_float(float div, uint16_t *div_int, uint8_t *div_frac) {
+    valid_params_if(PIO, div >= 1 && div <= 65536);
+    *div_int = (uint16_t)div;
+    if (*div_int == 0) {
+        *div_frac = 0;
+    } else {
+        *div_frac = (uint8_t)((div - (float)*div_int) * (1u << 8u));
+    }
+}
+
+static inline void sm_config_set_clkdiv(pio_sm_config *c, float div) {
+    uint16_t div_int;
+    uint8_t div_frac;
+    pio_calculate_clkdiv_from_float(div, &div_int, &div_frac);
+    sm_config_set_clkdiv_int_frac(c, div_int, div_frac);
+}
+
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap) {
+    valid_params_if(PIO, wrap < PIO_INSTRUCTION_COUNT);
+    valid_params_if(PIO, wrap_target < PIO_INSTRUCTION_COUNT);
+    c->wrap_target = (uint8_t)wrap_target;
+    c->wrap = (uint8_t)wrap;
+}
+
+static inline void sm_config_set_jmp_pin(pio_sm_config *c, uint pin) {
+    valid_params_if(PIO, pin < 32);
+    c->jmp_pin = (uint8_t)pin;
+}
+
+static inline void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint push_threshold) {
+    valid_params_if(PIO, push_threshold <= 32);
+    c->in_shift_right = shift_right;
+    c->autopush = autopush;
+    c->push_threshold = (uint8_t)(push_threshold ? push_threshold : 32);
+}
+
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold) {
+    valid_params_if(PIO, pull_threshold <= 32);
+    c->out_shift_right = shift_right;
+    c->autopull = autopull;
+    c->pull_threshold = (uint8_t)(pull_threshold ? pull_threshold : 32);
+}
+
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join) {
+    valid_params_if(PIO, join == PIO_FIFO_JOIN_NONE || join == PIO_FIFO_JOIN_TX || join == PIO_FIFO_JOIN_RX);
+    c->fifo_join = (pio_sim_fifo_join_t)join;
+}
+
+// note: OUT sticky and the OUT enable pin are not emulated
+static inline void sm_config_set_out_special(__unused pio_sm_config *c, __unused bool sticky,
+                                             __unused bool has_enable_pin, __unused uint enable_pin_index) {
+}
+
+static inline void sm_config_set_mov_status(pio_sm_config *c, enum pio_mov_status_type status_sel, uint status_n) {
+    valid_params_if(PIO, status_sel == STATUS_TX_LESSTHAN || status_sel == STATUS_RX_LESSTHAN);
+    c->mov_status_rx = status_sel == STATUS_RX_LESSTHAN;
+    c->mov_status_n = (uint8_t)status_n;
+}
+
+static inline pio_sm_config pio_get_default_sm_config(void) {
+    return pio_sim_get_default_sm_config();
+}
+
+static inline uint pio_get_index(PIO pio) {
+    check_pio_param(pio);
+    return pio == pio1 ? 1 : 0;
+}
+
+static inline void pio_gpio_init(PIO pio, uint pin) {
+    check_pio_param(pio);
+    valid_params_if(PIO, pin < 32);
+    gpio_set_function(pin, pio == pio0 ? GPIO_FUNC_PIO0 : GPIO_FUNC_PIO1);
+}
+
+static inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    return sm + (is_tx ? 0 : NUM_PIO_STATE_MACHINES) + (pio == pio0 ? DREQ_PIO0_TX0 : DREQ_PIO1_TX0);
+}
+
+typedef struct pio_program {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin; // required instruction memory origin or -1
+} __packed pio_program_t;
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program);
+bool pio_can_add_program_at_offset(PIO pio, const pio_program_t *program, uint offset);
+uint pio_add_program(PIO pio, const pio_program_t *program);
+void pio_add_program_at_offset(PIO pio, const pio_program_t *program, uint offset);
+void pio_remove_program(PIO pio, const pio_program_t *program, uint loaded_offset);
+void pio_clear_instruction_memory(PIO pio);
+
+void pio_sm_set_config(PIO pio, uint sm, const pio_sm_config *config);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+
+void pio_set_sm_mask_enabled(PIO pio, uint32_t mask, bool enabled);
+void pio_restart_sm_mask(PIO pio, uint32_t mask);
+void pio_clkdiv_restart_sm_mask(PIO pio, uint32_t mask);
+
+static inline void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    check_sm_param(sm);
+    pio_set_sm_mask_enabled(pio, 1u << sm, enabled);
+}
+
+static inline void pio_sm_restart(PIO pio, uint sm) {
+    check_sm_param(sm);
+    pio_restart_sm_mask(pio, 1u << sm);
+}
+
+static inline void pio_sm_clkdiv_restart(PIO pio, uint sm) {
+    check_sm_param(sm);
+    pio_clkdiv_restart_sm_mask(pio, 1u << sm);
+}
+
+// enabling state machines always restarts their clock dividers, so they are in sync
+static inline void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask) {
+    pio_set_sm_mask_enabled(pio, mask, true);
+}
+
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled);
+void pio_set_irq1_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled);
+void pio_set_irq0_source_mask_enabled(PIO pio, uint32_t source_mask, bool enabled);
+void pio_set_irq1_source_mask_enabled(PIO pio, uint32_t source_mask, bool enabled);
+
+static inline void pio_set_irqn_source_enabled(PIO pio, uint irq_index, enum pio_interrupt_source source, bool enabled) {
+    invalid_params_if(PIO, irq_index > 1);
+    if (irq_index) {
+        pio_set_irq1_source_enabled(pio, source, enabled);
+    } else {
+        pio_set_irq0_source_enabled(pio, source, enabled);
+    }
+}
+
+static inline void pio_set_irqn_source_mask_enabled(PIO pio, uint irq_index, uint32_t source_mask, bool enabled) {
+    invalid_params_if(PIO, irq_index > 1);
+    if (irq_index) {
+        pio_set_irq1_source_mask_enabled(pio, source_mask, enabled);
+    } else {
+        pio_set_irq0_source_mask_enabled(pio, source_mask, enabled);
+    }
+}
+
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num);
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num);
+
+uint8_t pio_sm_get_pc(PIO pio, uint sm);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+bool pio_sm_is_exec_stalled(PIO pio, uint sm);
+
+static inline void pio_sm_exec_wait_blocking(PIO pio, uint sm, uint instr) {
+    pio_sm_exec(pio, sm, instr);
+    while (pio_sm_is_exec_stalled(pio, sm)) tight_loop_contents();
+}
+
+void pio_sm_set_wrap(PIO pio, uint sm, uint wrap_target, uint wrap);
+void pio_sm_set_out_pins(PIO pio, uint sm, uint out_base, uint out_count);
+void pio_sm_set_set_pins(PIO pio, uint sm, uint set_base, uint set_count);
+void pio_sm_set_in_pins(PIO pio, uint sm, uint in_base);
+void pio_sm_set_sideset_pins(PIO pio, uint sm, uint sideset_base);
+
+// Write to the TX FIFO; if it is full the write is ignored (as on the device)
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+// Read from the RX FIFO; if it is empty 0 is returned (the device returns an undefined value)
+uint32_t pio_sm_get(PIO pio, uint sm);
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm);
+bool pio_sm_is_rx_fifo_full(PIO pio, uint sm);
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+
+static inline bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm) {
+    return !pio_sm_get_rx_fifo_level(pio, sm);
+}
+
+static inline bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm) {
+    return !pio_sm_get_tx_fifo_level(pio, sm);
+}
+
+static inline void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data) {
+    while (pio_sm_is_tx_fifo_full(pio, sm)) tight_loop_contents();
+    pio_sm_put(pio, sm, data);
+}
+
+static inline uint32_t pio_sm_get_blocking(PIO pio, uint sm) {
+    while (pio_sm_is_rx_fifo_empty(pio, sm)) tight_loop_contents();
+    return pio_sm_get(pio, sm);
+}
+
+void pio_sm_drain_tx_fifo(PIO pio, uint sm);
+
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac);
+
+static inline void pio_sm_set_clkdiv(PIO pio, uint sm, float div) {
+    uint16_t div_int;
+    uint8_t div_frac;
+    pio_calculate_clkdiv_from_float(div, &div_int, &div_frac);
+    pio_sm_set_clkdiv_int_frac(pio, sm, div_int, div_frac);
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm);
+
+void pio_sm_set_pins(PIO pio, uint sm, uint32_t pin_values);
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask);
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+
+void pio_sm_claim(PIO pio, uint sm);
+void pio_claim_sm_mask(PIO pio, uint sm_mask);
+void pio_sm_unclaim(PIO pio, uint sm);
+int pio_claim_unused_sm(PIO pio, bool required);
+bool pio_sm_is_claimed(PIO pio, uint sm);
+
+// ----------------------------------------------------------------------------
+// Host emulation control
+
+// Advance the emulated system clock (and so every PIO state machine and DMA channel) by the given number of cycles
+void pio_host_run_cycles(uint32_t cycles);
+
+// The number of system clock cycles emulated so far
+uint64_t pio_host_get_cycle_count(void);
+
+// Set the levels driven onto the pins from outside the chip (seen where no PIO is driving the pin)
+void pio_host_set_gpio_in(uint32_t values);
+
+// The level of each pin as seen by the PIO blocks
+uint32_t pio_host_get_pins(void);
+
+// The model of a PIO block, e.g. for its statistics. Must only be accessed between pio_host_lock()/pio_host_unlock()
+pio_sim_t *pio_host_get_sim(PIO pio);
+
+/*
+ * Set a function to be called after every emulated cycle, with the emulation lock held (this is how the host
+ * hardware_dma hooks into the clock). Only one callback is supported.
+ */
+void pio_host_set_cycle_callback(void (*callback)(void));
+
+// The emulation lock; the callback set by pio_host_set_cycle_callback() may use the _locked functions below
+uint32_t pio_host_lock(void);
+void pio_host_unlock(uint32_t save);
+
+// pio_host_run_cycles() for use with the emulation lock held
+void pio_host_run_cycles_locked(uint32_t cycles);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,561 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "hardware/pio.h"
+#include "hardware/sync.h"
+
+pio_hw_t pio_host_hw[NUM_PIOS];
+
+static struct {
+    pio_sim_t sim[NUM_PIOS];
+    bool initialized;
+    uint32_t gpio_in;
+    uint32_t pins;
+    uint64_t cycle;
+    void (*cycle_callback)(void);
+    uint32_t irq_source_enabled[NUM_PIOS][2];
+} emu;
+
+static uint8_t claimed;
+static uint32_t used_instruction_space[NUM_PIOS];
+
+uint32_t pio_host_lock(void) {
+    uint32_t save = spin_lock_blocking(spin_lock_instance(PICO_SPINLOCK_ID_HARDWARE_CLAIM));
+    if (!emu.initialized) {
+        for (uint i = 0; i < NUM_PIOS; i++) pio_sim_init(&emu.sim[i]);
+        emu.initialized = true;
+    }
+    return save;
+}
+
+void pio_host_unlock(uint32_t save) {
+    spin_unlock(spin_lock_instance(PICO_SPINLOCK_ID_HARDWARE_CLAIM), save);
+}
+
+static pio_sim_t *sim_for(PIO pio) {
+    return &emu.sim[pio_get_index(pio)];
+}
+
+pio_sim_t *pio_host_get_sim(PIO pio) {
+    check_pio_param(pio);
+    return sim_for(pio);
+}
+
+static void update_pins(void) {
+    uint32_t pins = emu.gpio_in;
+    for (uint i = 0; i < NUM_PIOS; i++) {
+        pio_sim_t *sim = &emu.sim[i];
+        pins = (pins & ~sim->pindirs) | (sim->pins_out & sim->pindirs);
+    }
+    emu.pins = pins;
+    for (uint i = 0; i < NUM_PIOS; i++) {
+        pio_sim_set_gpio_in(&emu.sim[i], pins);
+    }
+}
+
+void pio_host_run_cycles_locked(uint32_t cycles) {
+    for (uint i = 0; i < NUM_PIOS; i++) {
+        emu.sim[i].input_sync_bypass = pio_host_hw[i].input_sync_bypass;
+    }
+    while (cycles--) {
+        update_pins();
+        for (uint i = 0; i < NUM_PIOS; i++) pio_sim_step(&emu.sim[i]);
+        emu.cycle++;
+        if (emu.cycle_callback) emu.cycle_callback();
+    }
+    update_pins();
+}
+
+void pio_host_run_cycles(uint32_t cycles) {
+    uint32_t save = pio_host_lock();
+    pio_host_run_cycles_locked(cycles);
+    pio_host_unlock(save);
+}
+
+uint64_t pio_host_get_cycle_count(void) {
+    uint32_t save = pio_host_lock();
+    uint64_t cycle = emu.cycle;
+    pio_host_unlock(save);
+    return cycle;
+}
+
+void pio_host_set_gpio_in(uint32_t values) {
+    uint32_t save = pio_host_lock();
+    emu.gpio_in = values;
+    update_pins();
+    pio_host_unlock(save);
+}
+
+uint32_t pio_host_get_pins(void) {
+    uint32_t save = pio_host_lock();
+    update_pins();
+    uint32_t pins = emu.pins;
+    pio_host_unlock(save);
+    return pins;
+}
+
+void pio_host_set_cycle_callback(void (*callback)(void)) {
+    uint32_t save = pio_host_lock();
+    emu.cycle_callback = callback;
+    pio_host_unlock(save);
+}
+
+// ----------------------------------------------------------------------------
+// claims and instruction memory
+
+static_assert(NUM_PIO_STATE_MACHINES * NUM_PIOS <= 8, "");
+
+void pio_sm_claim(PIO pio, uint sm) {
+    check_sm_param(sm);
+    uint bit = pio_get_index(pio) * NUM_PIO_STATE_MACHINES + sm;
+    uint32_t save = pio_host_lock();
+    bool was_claimed = claimed & (1u << bit);
+    claimed |= (uint8_t)(1u << bit);
+    pio_host_unlock(save);
+    if (was_claimed) {
+        panic("PIO %d SM %d already claimed", pio_get_index(pio), sm);
+    }
+}
+
+void pio_claim_sm_mask(PIO pio, uint sm_mask) {
+    for(uint i = 0; sm_mask; i++, sm_mask >>= 1u) {
+        if (sm_mask & 1u) pio_sm_claim(pio, i);
+    }
+}
+
+void pio_sm_unclaim(PIO pio, uint sm) {
+    check_sm_param(sm);
+    uint bit = pio_get_index(pio) * NUM_PIO_STATE_MACHINES + sm;
+    uint32_t save = pio_host_lock();
+    claimed &= (uint8_t)~(1u << bit);
+    pio_host_unlock(save);
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+    uint base = pio_get_index(pio) * NUM_PIO_STATE_MACHINES;
+    int sm = -1;
+    uint32_t save = pio_host_lock();
+    for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++) {
+        if (!(claimed & (1u << (base + i)))) {
+            claimed |= (uint8_t)(1u << (base + i));
+            sm = (int)i;
+            break;
+        }
+    }
+    pio_host_unlock(save);
+    if (sm < 0 && required) {
+        panic("No PIO state machines are available");
+    }
+    return sm;
+}
+
+bool pio_sm_is_claimed(PIO pio, uint sm) {
+    check_sm_param(sm);
+    return claimed & (1u << (pio_get_index(pio) * NUM_PIO_STATE_MACHINES + sm));
+}
+
+static int find_offset_for_program(PIO pio, const pio_program_t *program) {
+    assert(program->length <= PIO_INSTRUCTION_COUNT);
+    uint32_t used_mask = used_instruction_space[pio_get_index(pio)];
+    uint32_t program_mask = (1u << program->length) - 1;
+    if (program->origin >= 0) {
+        if (program->origin > 32 - program->length) return -1;
+        return used_mask & (program_mask << program->origin) ? -1 : program->origin;
+    } else {
+        // work down from the top always
+        for (int i = 32 - program->length; i >= 0; i--) {
+            if (!(used_mask & (program_mask << (uint) i))) {
+                return i;
+            }
+        }
+        return -1;
+    }
+}
+
+static bool can_add_program_at_offset(PIO pio, const pio_program_t *program, uint offset) {
+    valid_params_if(PIO, offset < PIO_INSTRUCTION_COUNT);
+    valid_params_if(PIO, offset + program->length <= PIO_INSTRUCTION_COUNT);
+    if (program->origin >= 0 && (uint)program->origin != offset) return false;
+    uint32_t used_mask = used_instruction_space[pio_get_index(pio)];
+    uint32_t program_mask = (1u << program->length) - 1;
+    return !(used_mask & (program_mask << offset));
+}
+
+static void add_program_at_offset(PIO pio, const pio_program_t *program, uint offset) {
+    if (!can_add_program_at_offset(pio, program, offset)) {
+        panic("No program space");
+    }
+    pio_sim_load_program(sim_for(pio), program->instructions, program->length, offset);
+    uint32_t program_mask = (1u << program->length) - 1;
+    used_instruction_space[pio_get_index(pio)] |= program_mask << offset;
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program) {
+    uint32_t save = pio_host_lock();
+    bool rc = -1 != find_offset_for_program(pio, program);
+    pio_host_unlock(save);
+    return rc;
+}
+
+bool pio_can_add_program_at_offset(PIO pio, const pio_program_t *program, uint offset) {
+    uint32_t save = pio_host_lock();
+    bool rc = can_add_program_at_offset(pio, program, offset);
+    pio_host_unlock(save);
+    return rc;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program) {
+    uint32_t save = pio_host_lock();
+    int offset = find_offset_for_program(pio, program);
+    if (offset < 0) {
+        panic("No program space");
+    }
+    add_program_at_offset(pio, program, (uint)offset);
+    pio_host_unlock(save);
+    return (uint)offset;
+}
+
+void pio_add_program_at_offset(PIO pio, const pio_program_t *program, uint offset) {
+    uint32_t save = pio_host_lock();
+    add_program_at_offset(pio, program, offset);
+    pio_host_unlock(save);
+}
+
+void pio_remove_program(PIO pio, const pio_program_t *program, uint loaded_offset) {
+    uint32_t program_mask = (1u << program->length) - 1;
+    program_mask <<= loaded_offset;
+    uint32_t save = pio_host_lock();
+    assert(program_mask == (used_instruction_space[pio_get_index(pio)] & program_mask));
+    used_instruction_space[pio_get_index(pio)] &= ~program_mask;
+    pio_host_unlock(save);
+}
+
+void pio_clear_instruction_memory(PIO pio) {
+    uint32_t save = pio_host_lock();
+    used_instruction_space[pio_get_index(pio)] = 0;
+    for (uint i = 0; i < PIO_INSTRUCTION_COUNT; i++) {
+        sim_for(pio)->instr_mem[i] = (uint16_t)pio_encode_jmp(i);
+    }
+    pio_host_unlock(save);
+}
+
+// ----------------------------------------------------------------------------
+// state machine control
+
+void pio_sm_set_config(PIO pio, uint sm, const pio_sm_config *config) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t save = pio_host_lock();
+    pio_sim_sm_set_config(sim_for(pio), sm, config);
+    pio_host_unlock(save);
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+    valid_params_if(PIO, initial_pc < PIO_INSTRUCTION_COUNT);
+    check_pio_param(pio);
+    check_sm_param(sm);
+    pio_sm_config c = config ? *config : pio_get_default_sm_config();
+    uint32_t save = pio_host_lock();
+    // as on the device, this leaves the pin outputs and the scratch registers alone
+    pio_sim_t *sim = sim_for(pio);
+    pio_sim_sm_set_enabled_mask(sim, 1u << sm, false);
+    pio_sim_sm_set_config(sim, sm, &c);
+    pio_sim_sm_clear_fifos(sim, sm);
+    pio_sim_sm_restart(sim, sm);
+    pio_sim_sm_clkdiv_restart(sim, sm);
+    pio_sim_sm_exec(sim, sm, (uint16_t)pio_encode_jmp(initial_pc));
+    pio_host_unlock(save);
+}
+
+void pio_set_sm_mask_enabled(PIO pio, uint32_t mask, bool enabled) {
+    check_pio_param(pio);
+    check_sm_mask(mask);
+    uint32_t save = pio_host_lock();
+    pio_sim_sm_set_enabled_mask(sim_for(pio), mask, enabled);
+    pio_host_unlock(save);
+}
+
+void pio_restart_sm_mask(PIO pio, uint32_t mask) {
+    check_pio_param(pio);
+    check_sm_mask(mask);
+    uint32_t save = pio_host_lock();
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (mask & (1u << sm)) pio_sim_sm_restart(sim_for(pio), sm);
+    }
+    pio_host_unlock(save);
+}
+
+void pio_clkdiv_restart_sm_mask(PIO pio, uint32_t mask) {
+    check_pio_param(pio);
+    check_sm_mask(mask);
+    uint32_t save = pio_host_lock();
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (mask & (1u << sm)) pio_sim_sm_clkdiv_restart(sim_for(pio), sm);
+    }
+    pio_host_unlock(save);
+}
+
+static void set_irq_source_mask_enabled(PIO pio, uint irq_index, uint32_t source_mask, bool enabled) {
+    check_pio_param(pio);
+    uint32_t save = pio_host_lock();
+    if (enabled) {
+        emu.irq_source_enabled[pio_get_index(pio)][irq_index] |= source_mask;
+    } else {
+        emu.irq_source_enabled[pio_get_index(pio)][irq_index] &= ~source_mask;
+    }
+    pio_host_unlock(save);
+}
+
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled) {
+    set_irq_source_mask_enabled(pio, 0, 1u << source, enabled);
+}
+
+void pio_set_irq1_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled) {
+    set_irq_source_mask_enabled(pio, 1, 1u << source, enabled);
+}
+
+void pio_set_irq0_source_mask_enabled(PIO pio, uint32_t source_mask, bool enabled) {
+    set_irq_source_mask_enabled(pio, 0, source_mask, enabled);
+}
+
+void pio_set_irq1_source_mask_enabled(PIO pio, uint32_t source_mask, bool enabled) {
+    set_irq_source_mask_enabled(pio, 1, source_mask, enabled);
+}
+
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num) {
+    check_pio_param(pio);
+    invalid_params_if(PIO, pio_interrupt_num >= 8);
+    uint32_t save = pio_host_lock();
+    // polled status; let the state machines make progress
+    pio_host_run_cycles_locked(1);
+    bool rc = sim_for(pio)->irq & (1u << pio_interrupt_num);
+    pio_host_unlock(save);
+    return rc;
+}
+
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num) {
+    check_pio_param(pio);
+    invalid_params_if(PIO, pio_interrupt_num >= 8);
+    uint32_t save = pio_host_lock();
+    sim_for(pio)->irq &= (uint8_t)~(1u << pio_interrupt_num);
+    pio_host_unlock(save);
+}
+
+uint8_t pio_sm_get_pc(PIO pio, uint sm) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t save = pio_host_lock();
+    pio_host_run_cycles_locked(1);
+    uint8_t pc = sim_for(pio)->sm[sm].pc;
+    pio_host_unlock(save);
+    return pc;
+}
+
+void pio_sm_exec(PIO pio, uint sm, uint instr) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t save = pio_host_lock();
+    pio_sim_sm_exec(sim_for(pio), sm, (uint16_t)instr);
+    pio_host_unlock(save);
+}
+
+bool pio_sm_is_exec_stalled(PIO pio, uint sm) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t save = pio_host_lock();
+    pio_host_run_cycles_locked(1);
+    pio_sim_sm_t *s = &sim_for(pio)->sm[sm];
+    bool rc = s->exec_pending && s->stall != PIO_SIM_STALL_NONE;
+    pio_host_unlock(save);
+    return rc;
+}
+
+// lock a state machine's configuration to apply a change to part of it; release with unlock_config
+static inline pio_sm_config *lock_config(PIO pio, uint sm, uint32_t *save) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    *save = pio_host_lock();
+    return &sim_for(pio)->sm[sm].config;
+}
+
+static inline void unlock_config(uint32_t save) {
+    pio_host_unlock(save);
+}
+
+void pio_sm_set_wrap(PIO pio, uint sm, uint wrap_target, uint wrap) {
+    uint32_t save;
+    sm_config_set_wrap(lock_config(pio, sm, &save), wrap_target, wrap);
+    unlock_config(save);
+}
+
+void pio_sm_set_out_pins(PIO pio, uint sm, uint out_base, uint out_count) {
+    uint32_t save;
+    sm_config_set_out_pins(lock_config(pio, sm, &save), out_base, out_count);
+    unlock_config(save);
+}
+
+void pio_sm_set_set_pins(PIO pio, uint sm, uint set_base, uint set_count) {
+    uint32_t save;
+    sm_config_set_set_pins(lock_config(pio, sm, &save), set_base, set_count);
+    unlock_config(save);
+}
+
+void pio_sm_set_in_pins(PIO pio, uint sm, uint in_base) {
+    uint32_t save;
+    sm_config_set_in_pins(lock_config(pio, sm, &save), in_base);
+    unlock_config(save);
+}
+
+void pio_sm_set_sideset_pins(PIO pio, uint sm, uint sideset_base) {
+    uint32_t save;
+    sm_config_set_sideset_pins(lock_config(pio, sm, &save), sideset_base);
+    unlock_config(save);
+}
+
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac) {
+    uint32_t save;
+    sm_config_set_clkdiv_int_frac(lock_config(pio, sm, &save), div_int, div_frac);
+    unlock_config(save);
+}
+
+// ----------------------------------------------------------------------------
+// FIFOs
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t save = pio_host_lock();
+    pio_sim_sm_put(sim_for(pio), sm, data);
+    pio_host_unlock(save);
+}
+
+uint32_t pio_sm_get(PIO pio, uint sm) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t data = 0;
+    uint32_t save = pio_host_lock();
+    pio_sim_sm_get(sim_for(pio), sm, &data);
+    pio_host_unlock(save);
+    return data;
+}
+
+// the FIFO status functions are how code waits on the PIO, so each runs a cycle
+static uint get_fifo_level(PIO pio, uint sm, bool tx) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t save = pio_host_lock();
+    pio_host_run_cycles_locked(1);
+    uint level = tx ? pio_sim_sm_get_tx_level(sim_for(pio), sm) : pio_sim_sm_get_rx_level(sim_for(pio), sm);
+    pio_host_unlock(save);
+    return level;
+}
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm) {
+    return get_fifo_level(pio, sm, false);
+}
+
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm) {
+    return get_fifo_level(pio, sm, true);
+}
+
+static bool is_fifo_full(PIO pio, uint sm, bool tx) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t save = pio_host_lock();
+    pio_host_run_cycles_locked(1);
+    uint level = tx ? pio_sim_sm_get_tx_level(sim_for(pio), sm) : pio_sim_sm_get_rx_level(sim_for(pio), sm);
+    bool full = level >= pio_sim_sm_get_fifo_capacity(sim_for(pio), sm, tx);
+    pio_host_unlock(save);
+    return full;
+}
+
+bool pio_sm_is_rx_fifo_full(PIO pio, uint sm) {
+    return is_fifo_full(pio, sm, false);
+}
+
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm) {
+    return is_fifo_full(pio, sm, true);
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t save = pio_host_lock();
+    pio_sim_sm_clear_fifos(sim_for(pio), sm);
+    pio_host_unlock(save);
+}
+
+void pio_sm_drain_tx_fifo(PIO pio, uint sm) {
+    uint instr = sim_for(pio)->sm[sm].config.autopull ? pio_encode_out(pio_null, 32) : pio_encode_pull(false, false);
+    while (!pio_sm_is_tx_fifo_empty(pio, sm)) {
+        pio_sm_exec(pio, sm, instr);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// pins; as on the device these execute SET instructions on the given state machine
+
+static void exec_set(PIO pio, uint sm, enum pio_src_dest dest, uint base, uint count, uint32_t value) {
+    pio_sim_t *sim = sim_for(pio);
+    pio_sm_config saved = sim->sm[sm].config;
+    pio_sm_config c = saved;
+    c.set_base = (uint8_t)base;
+    c.set_count = (uint8_t)count;
+    pio_sim_sm_set_config(sim, sm, &c);
+    pio_sim_sm_exec(sim, sm, (uint16_t)pio_encode_set(dest, value));
+    pio_sim_sm_set_config(sim, sm, &saved);
+}
+
+void pio_sm_set_pins(PIO pio, uint sm, uint32_t pins) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t save = pio_host_lock();
+    for (uint base = 0; base < 32; base += 5) {
+        uint count = MIN(5u, 32 - base);
+        exec_set(pio, sm, pio_pins, base, count, (pins >> base) & 0x1fu);
+    }
+    pio_host_unlock(save);
+}
+
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pinvals, uint32_t pin_mask) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t save = pio_host_lock();
+    while (pin_mask) {
+        uint base = (uint)__builtin_ctz(pin_mask);
+        exec_set(pio, sm, pio_pins, base, 1, (pinvals >> base) & 0x1u);
+        pin_mask &= pin_mask - 1;
+    }
+    pio_host_unlock(save);
+}
+
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pindirs, uint32_t pin_mask) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    uint32_t save = pio_host_lock();
+    while (pin_mask) {
+        uint base = (uint)__builtin_ctz(pin_mask);
+        exec_set(pio, sm, pio_pindirs, base, 1, (pindirs >> base) & 0x1u);
+        pin_mask &= pin_mask - 1;
+    }
+    pio_host_unlock(save);
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin, uint count, bool is_out) {
+    check_pio_param(pio);
+    check_sm_param(sm);
+    valid_params_if(PIO, pin < 32u);
+    uint pindir_val = is_out ? 0x1f : 0;
+    uint32_t save = pio_host_lock();
+    while (count > 5) {
+        exec_set(pio, sm, pio_pindirs, pin, 5, pindir_val);
+        count -= 5;
+        pin = (pin + 5) & 0x1f;
+    }
+    exec_set(pio, sm, pio_pindirs, pin, count, pindir_val);
+    pio_host_unlock(save);
+}
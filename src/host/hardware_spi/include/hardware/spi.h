@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_SPI_H
+#define _HARDWARE_SPI_H
+
+#include "pico.h"
+
+#ifndef PARAM_ASSERTIONS_ENABLED_SPI
+#define PARAM_ASSERTIONS_ENABLED_SPI 0
+#endif
+
+/*
+ * Host implementation of hardware_spi, emulating the two SPI controllers as masters on the same system clock as the
+ * host hardware_pio and hardware_dma (at 125MHz; the baud rate is that clock divided by an even number).
+ *
+ * Each controller has 8 entry Tx and Rx FIFOs, and shifts one frame at a time from the Tx FIFO at the baud rate. By
+ * default MOSI is looped back to MISO, so each frame sent is received; spi_host_set_peer() instead attaches a model
+ * of a device which returns a received frame for each one sent. If the Rx FIFO is full, a received frame is lost.
+ *
+ * The clock runs while code waits on the SPI (each FIFO status query runs one cycle, as with the PIO FIFOs), or on the
+ * PIO or DMA. The DMA channels can access the FIFOs through &spi_get_hw(spi)->dr, paced by the spi_get_dreq() DREQs.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Only the registers which other code may take the address of (i.e. dr, as a DMA source or destination). They are
+// placeholders, recognised by the host hardware_dma, but must not be accessed directly
+typedef struct spi_hw {
+    volatile uint32_t cr0;
+    volatile uint32_t cr1;
+    volatile uint32_t dr;
+    volatile uint32_t sr;
+} spi_hw_t;
+
+extern spi_hw_t spi_host_hw[NUM_SPIS];
+
+#define spi0_hw (&spi_host_hw[0])
+#define spi1_hw (&spi_host_hw[1])
+
+typedef struct spi_inst spi_inst_t;
+
+#define spi0 ((spi_inst_t *)spi0_hw)
+#define spi1 ((spi_inst_t *)spi1_hw)
+
+#if !defined(PICO_DEFAULT_SPI_INSTANCE) && defined(PICO_DEFAULT_SPI)
+#define PICO_DEFAULT_SPI_INSTANCE (__CONCAT(spi,PICO_DEFAULT_SPI))
+#endif
+
+#ifdef PICO_DEFAULT_SPI_INSTANCE
+#define spi_default PICO_DEFAULT_SPI_INSTANCE
+#endif
+
+// DREQ numbers match the RP2040's, so they can be passed to channel_config_set_dreq()
+#ifndef DREQ_SPI0_TX
+#define DREQ_SPI0_TX 0x10
+#define DREQ_SPI0_RX 0x11
+#define DREQ_SPI1_TX 0x12
+#define DREQ_SPI1_RX 0x13
+#endif
+
+typedef enum {
+    SPI_CPHA_0 = 0,
+    SPI_CPHA_1 = 1
+} spi_cpha_t;
+
+typedef enum {
+    SPI_CPOL_0 = 0,
+    SPI_CPOL_1 = 1
+} spi_cpol_t;
+
+typedef enum {
+    SPI_LSB_FIRST = 0,
+    SPI_MSB_FIRST = 1
+} spi_order_t;
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_deinit(spi_inst_t *spi);
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate);
+uint spi_get_baudrate(const spi_inst_t *spi);
+
+static inline uint spi_get_index(const spi_inst_t *spi) {
+    invalid_params_if(SPI, spi != spi0 && spi != spi1);
+    return spi == spi1 ? 1 : 0;
+}
+
+static inline spi_hw_t *spi_get_hw(spi_inst_t *spi) {
+    spi_get_index(spi); // check it is a hw spi
+    return (spi_hw_t *)spi;
+}
+
+static inline const spi_hw_t *spi_get_const_hw(const spi_inst_t *spi) {
+    spi_get_index(spi);  // check it is a hw spi
+    return (const spi_hw_t *)spi;
+}
+
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+void spi_set_slave(spi_inst_t *spi, bool slave);
+
+bool spi_is_writable(const spi_inst_t *spi);
+bool spi_is_readable(const spi_inst_t *spi);
+bool spi_is_busy(const spi_inst_t *spi);
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len);
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len);
+int spi_write16_read16_blocking(spi_inst_t *spi, const uint16_t *src, uint16_t *dst, size_t len);
+int spi_write16_blocking(spi_inst_t *spi, const uint16_t *src, size_t len);
+int spi_read16_blocking(spi_inst_t *spi, uint16_t repeated_tx_data, uint16_t *dst, size_t len);
+
+static inline uint spi_get_dreq(spi_inst_t *spi, bool is_tx) {
+    return DREQ_SPI0_TX + spi_get_index(spi) * 2 + !is_tx;
+}
+
+// ----------------------------------------------------------------------------
+// Host emulation
+
+/*
+ * A model of the device attached to an SPI controller: called (with the emulation lock held, see pio_host_lock())
+ * as each frame finishes shifting, with the frame sent, and returns the frame received
+ */
+typedef uint16_t (*spi_host_peer_t)(spi_inst_t *spi, uint16_t tx_frame);
+
+// Attach a model of a device, or NULL to loop MOSI back to MISO
+void spi_host_set_peer(spi_inst_t *spi, spi_host_peer_t peer);
+
+// The number of frames the controller has shifted, and the number of cycles for which it has been shifting
+void spi_host_get_stats(const spi_inst_t *spi, uint64_t *frames, uint64_t *busy_cycles);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+
+// the emulated system clock, which the baud rate is divided from
+#define SYS_CLK_HZ 125000000u
+
+#define FIFO_DEPTH 8u
+
+typedef struct {
+    bool enabled;
+    uint cycles_per_bit;
+    uint data_bits;
+    spi_host_peer_t peer;
+    uint16_t tx_fifo[FIFO_DEPTH];
+    uint tx_head;
+    uint tx_count;
+    uint16_t rx_fifo[FIFO_DEPTH];
+    uint rx_head;
+    uint rx_count;
+    uint16_t shift_frame;
+    uint shift_cycles_left;     // 0 if not shifting
+    uint64_t frames;
+    uint64_t busy_cycles;
+} spi_state_t;
+
+spi_hw_t spi_host_hw[NUM_SPIS];
+
+static spi_state_t spi_state[NUM_SPIS];
+
+static inline spi_state_t *get_state(const spi_inst_t *spi) {
+    return &spi_state[spi_get_index(spi)];
+}
+
+static inline uint16_t frame_mask(const spi_state_t *s) {
+    return (uint16_t)((1u << s->data_bits) - 1);
+}
+
+static void push_tx_locked(spi_state_t *s, uint32_t value) {
+    // as on the PL022, writes to a full Tx FIFO are lost
+    if (s->tx_count == FIFO_DEPTH) return;
+    s->tx_fifo[(s->tx_head + s->tx_count++) % FIFO_DEPTH] = (uint16_t)(value & frame_mask(s));
+}
+
+static uint16_t pop_rx_locked(spi_state_t *s) {
+    if (!s->rx_count) return 0;
+    uint16_t value = s->rx_fifo[s->rx_head];
+    s->rx_head = (s->rx_head + 1) % FIFO_DEPTH;
+    s->rx_count--;
+    return value;
+}
+
+// ----------------------------------------------------------------------------
+// emulation, as a peripheral of the host hardware_dma
+
+static void spi_cycle(void) {
+    for (uint i = 0; i < NUM_SPIS; i++) {
+        spi_state_t *s = &spi_state[i];
+        if (!s->enabled) continue;
+        if (s->shift_cycles_left) {
+            s->busy_cycles++;
+            if (--s->shift_cycles_left) continue;
+            uint16_t rx = s->peer ? s->peer((spi_inst_t *)&spi_host_hw[i], s->shift_frame) : s->shift_frame;
+            if (s->rx_count < FIFO_DEPTH) {
+                s->rx_fifo[(s->rx_head + s->rx_count++) % FIFO_DEPTH] = (uint16_t)(rx & frame_mask(s));
+            }
+            s->frames++;
+        }
+        // the next frame follows straight on
+        if (s->tx_count) {
+            s->shift_frame = s->tx_fifo[s->tx_head];
+            s->tx_head = (s->tx_head + 1) % FIFO_DEPTH;
+            s->tx_count--;
+            s->shift_cycles_left = s->data_bits * s->cycles_per_bit;
+        }
+    }
+}
+
+static bool spi_dreq_asserted(uint dreq) {
+    spi_state_t *s = &spi_state[(dreq - DREQ_SPI0_TX) / 2];
+    if ((dreq - DREQ_SPI0_TX) & 1u) {
+        return s->rx_count > 0;
+    }
+    return s->tx_count < FIFO_DEPTH;
+}
+
+static spi_state_t *state_at(uintptr_t addr) {
+    return &spi_state[(addr - (uintptr_t)spi_host_hw) / sizeof(spi_hw_t)];
+}
+
+static uint32_t spi_read(uintptr_t addr, __unused uint size) {
+    return pop_rx_locked(state_at(addr));
+}
+
+static void spi_write(uintptr_t addr, uint32_t data, __unused uint size) {
+    push_tx_locked(state_at(addr), data);
+}
+
+static const dma_host_peripheral_t spi_peripheral = {
+        .base = (uintptr_t)spi_host_hw,
+        .size = sizeof(spi_host_hw),
+        .first_dreq = DREQ_SPI0_TX,
+        .num_dreqs = NUM_SPIS * 2,
+        .dreq_asserted = spi_dreq_asserted,
+        .read = spi_read,
+        .write = spi_write,
+        .cycle = spi_cycle,
+};
+
+// ----------------------------------------------------------------------------
+
+uint spi_init(spi_inst_t *spi, uint baudrate) {
+    // the SPI is clocked (and its FIFOs accessed) by the DMA emulation
+    dma_host_add_peripheral(&spi_peripheral);
+    uint32_t save = pio_host_lock();
+    spi_state_t *s = get_state(spi);
+    spi_host_peer_t peer = s->peer;
+    *s = (spi_state_t){ .peer = peer, .data_bits = 8 };
+    pio_host_unlock(save);
+    uint baud = spi_set_baudrate(spi, baudrate);
+    save = pio_host_lock();
+    s->enabled = true;
+    pio_host_unlock(save);
+    return baud;
+}
+
+void spi_deinit(spi_inst_t *spi) {
+    uint32_t save = pio_host_lock();
+    spi_state_t *s = get_state(spi);
+    s->enabled = false;
+    s->tx_count = s->rx_count = 0;
+    s->shift_cycles_left = 0;
+    pio_host_unlock(save);
+}
+
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate) {
+    invalid_params_if(SPI, !baudrate || baudrate > SYS_CLK_HZ);
+    // the nearest even divisor which doesn't exceed the requested rate
+    uint cycles = (SYS_CLK_HZ + baudrate - 1) / baudrate;
+    cycles = cycles < 2 ? 2 : (cycles + 1) & ~1u;
+    uint32_t save = pio_host_lock();
+    get_state(spi)->cycles_per_bit = cycles;
+    pio_host_unlock(save);
+    return SYS_CLK_HZ / cycles;
+}
+
+uint spi_get_baudrate(const spi_inst_t *spi) {
+    uint32_t save = pio_host_lock();
+    uint cycles = get_state(spi)->cycles_per_bit;
+    pio_host_unlock(save);
+    return cycles ? SYS_CLK_HZ / cycles : 0;
+}
+
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, __unused spi_order_t order) {
+    invalid_params_if(SPI, data_bits < 4 || data_bits > 16);
+    // LSB-first not supported on PL022:
+    invalid_params_if(SPI, order != SPI_MSB_FIRST);
+    invalid_params_if(SPI, cpol != SPI_CPOL_0 && cpol != SPI_CPOL_1);
+    invalid_params_if(SPI, cpha != SPI_CPHA_0 && cpha != SPI_CPHA_1);
+    uint32_t save = pio_host_lock();
+    get_state(spi)->data_bits = data_bits;
+    pio_host_unlock(save);
+}
+
+void spi_set_slave(__unused spi_inst_t *spi, bool slave) {
+    if (slave) panic_unsupported();
+}
+
+void spi_host_set_peer(spi_inst_t *spi, spi_host_peer_t peer) {
+    uint32_t save = pio_host_lock();
+    get_state(spi)->peer = peer;
+    pio_host_unlock(save);
+}
+
+void spi_host_get_stats(const spi_inst_t *spi, uint64_t *frames, uint64_t *busy_cycles) {
+    uint32_t save = pio_host_lock();
+    *frames = get_state(spi)->frames;
+    *busy_cycles = get_state(spi)->busy_cycles;
+    pio_host_unlock(save);
+}
+
+// As with the PIO FIFO status functions, these run a cycle so busy-waits make progress
+
+bool spi_is_writable(const spi_inst_t *spi) {
+    uint32_t save = pio_host_lock();
+    pio_host_run_cycles_locked(1);
+    bool writable = get_state(spi)->tx_count < FIFO_DEPTH;
+    pio_host_unlock(save);
+    return writable;
+}
+
+bool spi_is_readable(const spi_inst_t *spi) {
+    uint32_t save = pio_host_lock();
+    pio_host_run_cycles_locked(1);
+    bool readable = get_state(spi)->rx_count > 0;
+    pio_host_unlock(save);
+    return readable;
+}
+
+bool spi_is_busy(const spi_inst_t *spi) {
+    uint32_t save = pio_host_lock();
+    pio_host_run_cycles_locked(1);
+    const spi_state_t *s = get_state(spi);
+    bool busy = s->tx_count || s->shift_cycles_left;
+    pio_host_unlock(save);
+    return busy;
+}
+
+static void put_dr(spi_inst_t *spi, uint32_t value) {
+    uint32_t save = pio_host_lock();
+    push_tx_locked(get_state(spi), value);
+    pio_host_unlock(save);
+}
+
+static uint16_t get_dr(spi_inst_t *spi) {
+    uint32_t save = pio_host_lock();
+    uint16_t value = pop_rx_locked(get_state(spi));
+    pio_host_unlock(save);
+    return value;
+}
+
+// the blocking functions are as on the device, with data register accesses replaced by put_dr() and get_dr()
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len) {
+    invalid_params_if(SPI, 0 > (int)len);
+    const size_t fifo_depth = FIFO_DEPTH;
+    size_t rx_remaining = len, tx_remaining = len;
+
+    while (rx_remaining || tx_remaining) {
+        if (tx_remaining && spi_is_writable(spi) && rx_remaining < tx_remaining + fifo_depth) {
+            put_dr(spi, *src++);
+            --tx_remaining;
+        }
+        if (rx_remaining && spi_is_readable(spi)) {
+            *dst++ = (uint8_t)get_dr(spi);
+            --rx_remaining;
+        }
+    }
+    return (int)len;
+}
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len) {
+    invalid_params_if(SPI, 0 > (int)len);
+    for (size_t i = 0; i < len; ++i) {
+        while (!spi_is_writable(spi))
+            tight_loop_contents();
+        put_dr(spi, src[i]);
+    }
+    while (spi_is_readable(spi))
+        (void)get_dr(spi);
+    while (spi_is_busy(spi))
+        tight_loop_contents();
+    while (spi_is_readable(spi))
+        (void)get_dr(spi);
+    return (int)len;
+}
+
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len) {
+    invalid_params_if(SPI, 0 > (int)len);
+    const size_t fifo_depth = FIFO_DEPTH;
+    size_t rx_remaining = len, tx_remaining = len;
+
+    while (rx_remaining || tx_remaining) {
+        if (tx_remaining && spi_is_writable(spi) && rx_remaining < tx_remaining + fifo_depth) {
+            put_dr(spi, repeated_tx_data);
+            --tx_remaining;
+        }
+        if (rx_remaining && spi_is_readable(spi)) {
+            *dst++ = (uint8_t)get_dr(spi);
+            --rx_remaining;
+        }
+    }
+    return (int)len;
+}
+
+int spi_write16_read16_blocking(spi_inst_t *spi, const uint16_t *src, uint16_t *dst, size_t len) {
+    invalid_params_if(SPI, 0 > (int)len);
+    const size_t fifo_depth = FIFO_DEPTH;
+    size_t rx_remaining = len, tx_remaining = len;
+
+    while (rx_remaining || tx_remaining) {
+        if (tx_remaining && spi_is_writable(spi) && rx_remaining < tx_remaining + fifo_depth) {
+            put_dr(spi, *src++);
+            --tx_remaining;
+        }
+        if (rx_remaining && spi_is_readable(spi)) {
+            *dst++ = get_dr(spi);
+            --rx_remaining;
+        }
+    }
+    return (int)len;
+}
+
+int spi_write16_blocking(spi_inst_t *spi, const uint16_t *src, size_t len) {
+    invalid_params_if(SPI, 0 > (int)len);
+    for (size_t i = 0; i < len; ++i) {
+        while (!spi_is_writable(spi))
+            tight_loop_contents();
+        put_dr(spi, src[i]);
+    }
+    while (spi_is_readable(spi))
+        (void)get_dr(spi);
+    while (spi_is_busy(spi))
+        tight_loop_contents();
+    while (spi_is_readable(spi))
+        (void)get_dr(spi);
+    return (int)len;
+}
+
+int spi_read16_blocking(spi_inst_t *spi, uint16_t repeated_tx_data, uint16_t *dst, size_t len) {
+    invalid_params_if(SPI, 0 > (int)len);
+    const size_t fifo_depth = FIFO_DEPTH;
+    size_t rx_remaining = len, tx_remaining = len;
+
+    while (rx_remaining || tx_remaining) {
+        if (tx_remaining && spi_is_writable(spi) && rx_remaining < tx_remaining + fifo_depth) {
+            put_dr(spi, repeated_tx_data);
+            --tx_remaining;
+        }
+        if (rx_remaining && spi_is_readable(spi)) {
+            *dst++ = get_dr(spi);
+            --rx_remaining;
+        }
+    }
+    return (int)len;
+}
@@ -26,10 +26,18 @@ static inline void atomic_thread_fence(uint x) {}
 
 #endif
 
+#ifndef PICO_SPINLOCK_ID_IRQ
+#define PICO_SPINLOCK_ID_IRQ 9
+#endif
+
 #ifndef PICO_SPINLOCK_ID_TIMER
 #define PICO_SPINLOCK_ID_TIMER 10
 #endif
 
+#ifndef PICO_SPINLOCK_ID_HARDWARE_CLAIM
+#define PICO_SPINLOCK_ID_HARDWARE_CLAIM 11
+#endif
+
 #ifndef PICO_SPINLOCK_ID_STRIPED_FIRST
 #define PICO_SPINLOCK_ID_STRIPED_FIRST 16
 #endif
@@ -38,6 +46,14 @@ static inline void atomic_thread_fence(uint x) {}
 #define PICO_SPINLOCK_ID_STRIPED_LAST 23
 #endif
 
+#ifndef PICO_SPINLOCK_ID_CLAIM_FREE_FIRST
+#define PICO_SPINLOCK_ID_CLAIM_FREE_FIRST 24
+#endif
+
+#ifndef PICO_SPINLOCK_ID_CLAIM_FREE_LAST
+#define PICO_SPINLOCK_ID_CLAIM_FREE_LAST 31
+#endif
+
 typedef struct _spin_lock_t spin_lock_t;
 
 inline static void __mem_fence_acquire() {
@@ -56,6 +72,14 @@ inline static void __mem_fence_release() {
 #endif
 }
 
+inline static void __dmb() {
+#ifndef __cplusplus
+    atomic_thread_fence(memory_order_seq_cst);
+#else
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+#endif
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -7,10 +7,18 @@
 #include "hardware/sync.h"
 #include "hardware/platform_defs.h"
 
-// This is a dummy implementation that is single threaded
+#ifdef __unix__
+#include <sched.h>
+#define host_yield() sched_yield()
+#else
+#define host_yield() tight_loop_contents()
+#endif
+
+// This is a dummy implementation that is single threaded, except that spin locks are real atomic
+// locks so that data structures protected by them may be exercised from multiple host threads
 
 static struct _spin_lock_t {
-    bool locked;
+    atomic_bool locked;
 } _spinlocks[NUM_SPIN_LOCKS];
 
 PICO_WEAK_FUNCTION_DEF(save_and_disable_interrupts)
@@ -50,7 +58,9 @@ spin_lock_t *PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_init)(uint lock_num) {
 PICO_WEAK_FUNCTION_DEF(spin_lock_unsafe_blocking)
 
 void PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_unsafe_blocking)(spin_lock_t *lock) {
-    lock->locked = true;
+    while (atomic_exchange_explicit(&lock->locked, true, memory_order_acquire)) {
+        host_yield();
+    }
 }
 
 PICO_WEAK_FUNCTION_DEF(spin_lock_blocking)
@@ -63,13 +73,13 @@ uint32_t PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_blocking)(spin_lock_t *lock) {
 PICO_WEAK_FUNCTION_DEF(is_spin_locked)
 
 bool PICO_WEAK_FUNCTION_IMPL_NAME(is_spin_locked)(const spin_lock_t *lock) {
-    return lock->locked;
+    return atomic_load_explicit(&lock->locked, memory_order_relaxed);
 }
 
 PICO_WEAK_FUNCTION_DEF(spin_unlock_unsafe)
 
 void PICO_WEAK_FUNCTION_IMPL_NAME(spin_unlock_unsafe)(spin_lock_t *lock) {
-    lock->locked = false;
+    atomic_store_explicit(&lock->locked, false, memory_order_release);
 }
 
 PICO_WEAK_FUNCTION_DEF(spin_unlock)
@@ -95,6 +105,8 @@ void PICO_WEAK_FUNCTION_IMPL_NAME(__wfi)() {
 PICO_WEAK_FUNCTION_DEF(__wfe)
 
 void PICO_WEAK_FUNCTION_IMPL_NAME(__wfe)() {
+    // give any other host thread a chance to run before the caller re-checks its condition
+    host_yield();
     while (!event_fired) tight_loop_contents();
 }
 
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include "hardware/sync.h"
+#include "hardware/platform_defs.h"
+#if PICO_HOST_VIRTUAL_TIME
+#include "pico/virtual_time.h"
+#endif
+
+// This implementation treats each host thread as a separate "core". Spin locks are real atomic locks, and
+// the event register used by __sev/__wfe is modelled per thread on top of a condition variable, so that
+// the pico_sync primitives (which are built on lock_core) genuinely block and wake across threads.
+//
+// There are no interrupts on the host, so save_and_disable_interrupts/restore_interrupts do nothing.
+//
+// With PICO_HOST_VIRTUAL_TIME, __wfe and spinning instead block/yield via pico_virtual_time, as only one
+// simulated thread may run at a time.
+
+static struct _spin_lock_t {
+    atomic_bool locked;
+} _spinlocks[NUM_SPIN_LOCKS];
+
+// incremented by every __sev
+static atomic_uint event_generation;
+#if !PICO_HOST_VIRTUAL_TIME
+static pthread_mutex_t event_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t event_cond = PTHREAD_COND_INITIALIZER;
+// number of threads blocked in __wfe; __sev only needs to take the mutex if this is non zero
+static atomic_uint event_waiters;
+#endif
+// the event generation last consumed by a __wfe on this thread; the "event register" is set if this differs
+// from event_generation
+static __thread uint event_generation_seen;
+
+static void host_yield(void) {
+    // allow a thread which is spinning to be cancelled by multicore_reset_core1
+    pthread_testcancel();
+#if PICO_HOST_VIRTUAL_TIME
+    virtual_time_yield();
+#else
+    sched_yield();
+#endif
+}
+
+PICO_WEAK_FUNCTION_DEF(save_and_disable_interrupts)
+
+uint32_t PICO_WEAK_FUNCTION_IMPL_NAME(save_and_disable_interrupts)() {
+    return 0;
+}
+
+PICO_WEAK_FUNCTION_DEF(restore_interrupts)
+
+void PICO_WEAK_FUNCTION_IMPL_NAME(restore_interrupts)(uint32_t status) {
+}
+
+PICO_WEAK_FUNCTION_DEF(spin_lock_instance)
+
+spin_lock_t *PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_instance)(uint lock_num) {
+    assert(lock_num < NUM_SPIN_LOCKS);
+    return &_spinlocks[lock_num];
+}
+
+PICO_WEAK_FUNCTION_DEF(spin_lock_get_num)
+
+uint PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_get_num)(spin_lock_t *lock) {
+    return lock - _spinlocks;
+}
+
+PICO_WEAK_FUNCTION_DEF(spin_lock_init)
+
+spin_lock_t *PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_init)(uint lock_num) {
+    spin_lock_t *lock = spin_lock_instance(lock_num);
+    spin_unlock_unsafe(lock);
+    return lock;
+}
+
+PICO_WEAK_FUNCTION_DEF(spin_lock_unsafe_blocking)
+
+void PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_unsafe_blocking)(spin_lock_t *lock) {
+    while (atomic_exchange_explicit(&lock->locked, true, memory_order_acquire)) {
+        // spin locks are only ever held briefly, but the holder may have been descheduled
+        while (atomic_load_explicit(&lock->locked, memory_order_relaxed)) {
+            host_yield();
+        }
+    }
+}
+
+PICO_WEAK_FUNCTION_DEF(spin_lock_blocking)
+
+uint32_t PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_blocking)(spin_lock_t *lock) {
+    uint32_t save = save_and_disable_interrupts();
+    spin_lock_unsafe_blocking(lock);
+    return save;
+}
+
+PICO_WEAK_FUNCTION_DEF(is_spin_locked)
+
+bool PICO_WEAK_FUNCTION_IMPL_NAME(is_spin_locked)(const spin_lock_t *lock) {
+    return atomic_load_explicit(&lock->locked, memory_order_relaxed);
+}
+
+PICO_WEAK_FUNCTION_DEF(spin_unlock_unsafe)
+
+void PICO_WEAK_FUNCTION_IMPL_NAME(spin_unlock_unsafe)(spin_lock_t *lock) {
+    atomic_store_explicit(&lock->locked, false, memory_order_release);
+}
+
+PICO_WEAK_FUNCTION_DEF(spin_unlock)
+
+void PICO_WEAK_FUNCTION_IMPL_NAME(spin_unlock)(spin_lock_t *lock, uint32_t saved_irq) {
+    spin_unlock_unsafe(lock);
+    restore_interrupts(saved_irq);
+}
+
+PICO_WEAK_FUNCTION_DEF(__sev)
+
+void PICO_WEAK_FUNCTION_IMPL_NAME(__sev)() {
+    atomic_fetch_add(&event_generation, 1);
+#if PICO_HOST_VIRTUAL_TIME
+    virtual_time_notify(&event_generation);
+#else
+    if (atomic_load(&event_waiters)) {
+        pthread_mutex_lock(&event_mutex);
+        pthread_cond_broadcast(&event_cond);
+        pthread_mutex_unlock(&event_mutex);
+    }
+#endif
+}
+
+PICO_WEAK_FUNCTION_DEF(__wfi)
+
+void PICO_WEAK_FUNCTION_IMPL_NAME(__wfi)() {
+    panic("Can't wait on irq for host");
+}
+
+#if !PICO_HOST_VIRTUAL_TIME
+static void wfe_cleanup(void *arg) {
+    (void)arg;
+    atomic_fetch_sub(&event_waiters, 1);
+    pthread_mutex_unlock(&event_mutex);
+}
+#endif
+
+PICO_WEAK_FUNCTION_DEF(__wfe)
+
+void PICO_WEAK_FUNCTION_IMPL_NAME(__wfe)() {
+    uint generation;
+#if PICO_HOST_VIRTUAL_TIME
+    while ((generation = atomic_load(&event_generation)) == event_generation_seen) {
+        virtual_time_wait(&event_generation, NULL, UINT64_MAX);
+    }
+#else
+    generation = atomic_load(&event_generation);
+    if (generation == event_generation_seen) {
+        pthread_mutex_lock(&event_mutex);
+        atomic_fetch_add(&event_waiters, 1);
+        pthread_cleanup_push(wfe_cleanup, NULL);
+        while ((generation = atomic_load(&event_generation)) == event_generation_seen) {
+            pthread_cond_wait(&event_cond, &event_mutex);
+        }
+        pthread_cleanup_pop(1);
+    }
+#endif
+    // clear the event register
+    event_generation_seen = generation;
+}
+
+PICO_WEAK_FUNCTION_DEF(get_core_num)
+
+uint PICO_WEAK_FUNCTION_IMPL_NAME(get_core_num)() {
+    return 0;
+}
+
+PICO_WEAK_FUNCTION_DEF(clear_spin_locks)
+
+void PICO_WEAK_FUNCTION_IMPL_NAME(clear_spin_locks)(void) {
+    for (uint i = 0; i < NUM_SPIN_LOCKS; i++) {
+        spin_unlock_unsafe(spin_lock_instance(i));
+    }
+}
+
+PICO_WEAK_FUNCTION_DEF(next_striped_spin_lock_num)
+uint PICO_WEAK_FUNCTION_IMPL_NAME(next_striped_spin_lock_num)() {
+    static atomic_uint striped_spin_lock_num;
+    uint n = atomic_fetch_add(&striped_spin_lock_num, 1);
+    return PICO_SPINLOCK_ID_STRIPED_FIRST + n % (PICO_SPINLOCK_ID_STRIPED_LAST - PICO_SPINLOCK_ID_STRIPED_FIRST + 1);
+}
+
+static atomic_uint claimed_spin_locks;
+
+PICO_WEAK_FUNCTION_DEF(spin_lock_claim)
+void PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_claim)(uint lock_num) {
+    uint prev = atomic_fetch_or(&claimed_spin_locks, 1u << lock_num);
+    if (prev & (1u << lock_num)) {
+        panic("Spin lock %d already claimed", lock_num);
+    }
+}
+
+PICO_WEAK_FUNCTION_DEF(spin_lock_claim_mask)
+void PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_claim_mask)(uint32_t mask) {
+    for(uint i = 0; mask; i++, mask >>= 1u) {
+        if (mask & 1u) spin_lock_claim(i);
+    }
+}
+
+PICO_WEAK_FUNCTION_DEF(spin_lock_unclaim)
+void PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_unclaim)(uint lock_num) {
+    spin_unlock_unsafe(spin_lock_instance(lock_num));
+    atomic_fetch_and(&claimed_spin_locks, ~(1u << lock_num));
+}
+
+PICO_WEAK_FUNCTION_DEF(spin_lock_claim_unused)
+int PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_claim_unused)(bool required) {
+    // match the device, where claim_unused only hands out the locks reserved for that purpose
+    for (uint i = PICO_SPINLOCK_ID_CLAIM_FREE_FIRST; i <= PICO_SPINLOCK_ID_CLAIM_FREE_LAST; i++) {
+        uint prev = atomic_fetch_or(&claimed_spin_locks, 1u << i);
+        if (!(prev & (1u << i))) return (int)i;
+    }
+    if (required) {
+        panic("No spin locks are available");
+    }
+    return -1;
+}
+
+PICO_WEAK_FUNCTION_DEF(spin_lock_num)
+uint PICO_WEAK_FUNCTION_IMPL_NAME(spin_lock_num)(spin_lock_t *lock) {
+    return spin_lock_get_num(lock);
+}
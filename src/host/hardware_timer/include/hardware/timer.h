@@ -26,6 +26,7 @@ uint32_t time_us_32();
 uint64_t time_us_64();
 void busy_wait_us_32(uint32_t delay_us);
 void busy_wait_us(uint64_t delay_us);
+void busy_wait_ms(uint32_t delay_ms);
 void busy_wait_until(absolute_time_t t);
 bool time_reached(absolute_time_t t);
 typedef void (*hardware_alarm_callback_t)(uint alarm_num);
@@ -36,6 +37,10 @@ void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callb
 bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t);
 void hardware_alarm_cancel(uint alarm_num);
 void hardware_alarm_force_irq(uint alarm_num);
+#if PICO_HOST_TIMER_ALARM_THREAD
+// host only: the number of times the (simulated) IRQ for the given alarm has fired, e.g. to measure the effect of alarm coalescing
+uint32_t hardware_alarm_get_irq_count(uint alarm_num);
+#endif
 #ifdef __cplusplus
 }
 #endif
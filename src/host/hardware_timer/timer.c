@@ -10,12 +10,21 @@
 #include <sys/time.h>
 #include <time.h>
 
+#endif
+#if PICO_HOST_TIMER_ALARM_THREAD
+#include <pthread.h>
+#include "hardware/sync.h"
+#endif
+#if PICO_HOST_VIRTUAL_TIME
+#include "pico/virtual_time.h"
 #endif
 
 // in our case not a busy wait
 PICO_WEAK_FUNCTION_DEF(busy_wait_us)
 void PICO_WEAK_FUNCTION_IMPL_NAME(busy_wait_us_32)(uint32_t delay_us) {
-#if defined(__unix__) || defined(__APPLE__)
+#if PICO_HOST_VIRTUAL_TIME
+    busy_wait_us(delay_us);
+#elif defined(__unix__) || defined(__APPLE__)
     usleep(delay_us);
 #else
     assert(false);
@@ -28,10 +37,17 @@ void PICO_WEAK_FUNCTION_IMPL_NAME(busy_wait_us)(uint64_t delay_us) {
     busy_wait_until(t);
 }
 
+PICO_WEAK_FUNCTION_DEF(busy_wait_ms)
+void PICO_WEAK_FUNCTION_IMPL_NAME(busy_wait_ms)(uint32_t delay_ms) {
+    busy_wait_us(delay_ms * 1000ull);
+}
+
 // this may or may not wrap
 PICO_WEAK_FUNCTION_DEF(time_us_64)
 uint64_t PICO_WEAK_FUNCTION_IMPL_NAME(time_us_64)() {
-#if defined(__unix__) || defined(__APPLE__)
+#if PICO_HOST_VIRTUAL_TIME
+    return virtual_time_us();
+#elif defined(__unix__) || defined(__APPLE__)
 //    struct timeval tv;
 //    gettimeofday(&tv, NULL);
 //    return tv.tv_sec * (uint64_t) 1000000 + tv.tv_usec;
@@ -51,12 +67,22 @@ uint32_t PICO_WEAK_FUNCTION_IMPL_NAME(timer_us_32)() {
 PICO_WEAK_FUNCTION_DEF(time_reached)
 bool PICO_WEAK_FUNCTION_IMPL_NAME(time_reached)(absolute_time_t t) {
     uint64_t target = to_us_since_boot(t);
+#if PICO_HOST_VIRTUAL_TIME
+    if (time_us_64() < target) {
+        virtual_time_poll_hint(target);
+        return false;
+    }
+    return true;
+#else
     return time_us_64() >= target;
+#endif
 }
 
 PICO_WEAK_FUNCTION_DEF(busy_wait_until)
 void PICO_WEAK_FUNCTION_IMPL_NAME(busy_wait_until)(absolute_time_t target) {
-#if defined(__unix__)
+#if PICO_HOST_VIRTUAL_TIME
+    virtual_time_wait(NULL, NULL, to_us_since_boot(target));
+#elif defined(__unix__)
     struct timespec tspec;
     tspec.tv_sec = to_us_since_boot(target) / 1000000;
     tspec.tv_nsec = (to_us_since_boot(target) % 1000000) * 1000;
@@ -88,12 +114,159 @@ void hardware_alarm_unclaim(uint alarm_num) {
 }
 
 int hardware_alarm_claim_unused(bool required) {
-    int alarm_id = claimed_alarms ? __builtin_clz(~claimed_alarms) : 1;
-    if (alarm_id >= NUM_TIMERS) return -1;
-    claimed_alarms |= 1u << alarm_id;
-    return alarm_id;
+    for (uint alarm_num = 0; alarm_num < NUM_TIMERS; alarm_num++) {
+        if (!(claimed_alarms & (1u << alarm_num))) {
+            claimed_alarms |= 1u << alarm_num;
+            return (int)alarm_num;
+        }
+    }
+    if (required) {
+        panic("No timers available");
+    }
+    return -1;
 }
 
+#if PICO_HOST_TIMER_ALARM_THREAD
+// The timer IRQ is modelled by a host thread, which calls the alarm callbacks when their targets are reached.
+// As on the device, the callbacks may run concurrently with code on the "cores" (other threads), which must
+// protect any shared state with spin locks.
+//
+// With PICO_HOST_VIRTUAL_TIME, the thread is just another simulated thread, which blocks in virtual time.
+
+static struct {
+    hardware_alarm_callback_t callback;
+    uint64_t target;
+    uint32_t irq_count;
+    bool armed;
+    bool forced;
+} alarms[NUM_TIMERS];
+
+static pthread_mutex_t alarm_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t alarm_cond;
+static pthread_t alarm_thread;
+static bool alarm_thread_started;
+
+// alarm_mutex must be held
+static void alarm_thread_wait(uint64_t until_us) {
+#if PICO_HOST_VIRTUAL_TIME
+    virtual_time_wait(&alarm_cond, &alarm_mutex, until_us);
+#else
+    if (until_us == UINT64_MAX) {
+        pthread_cond_wait(&alarm_cond, &alarm_mutex);
+    } else {
+        struct timespec ts;
+        ts.tv_sec = (time_t)(until_us / 1000000);
+        ts.tv_nsec = (long)((until_us % 1000000) * 1000);
+        pthread_cond_timedwait(&alarm_cond, &alarm_mutex, &ts);
+    }
+#endif
+}
+
+static void *alarm_thread_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&alarm_mutex);
+    while (true) {
+        uint64_t now = time_us_64();
+        uint64_t next = UINT64_MAX;
+        int fire = -1;
+        for (uint i = 0; i < NUM_TIMERS; i++) {
+            if (!alarms[i].callback) continue;
+            if (alarms[i].forced || (alarms[i].armed && alarms[i].target <= now)) {
+                fire = (int)i;
+                break;
+            }
+            if (alarms[i].armed && alarms[i].target < next) next = alarms[i].target;
+        }
+        if (fire >= 0) {
+            hardware_alarm_callback_t callback = alarms[fire].callback;
+            alarms[fire].armed = alarms[fire].forced = false;
+            alarms[fire].irq_count++;
+            pthread_mutex_unlock(&alarm_mutex);
+            callback((uint)fire);
+            // as on the device, returning from the IRQ wakes a core waiting in __wfe
+            __sev();
+            pthread_mutex_lock(&alarm_mutex);
+        } else {
+            alarm_thread_wait(next);
+        }
+    }
+    return NULL;
+}
+
+// alarm_mutex must be held
+static void alarm_thread_notify(void) {
+    if (!alarm_thread_started) {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&alarm_cond, &attr);
+        pthread_condattr_destroy(&attr);
+#if PICO_HOST_VIRTUAL_TIME
+        if (virtual_time_thread_create(&alarm_thread, alarm_thread_main, NULL)) {
+#else
+        if (pthread_create(&alarm_thread, NULL, alarm_thread_main, NULL)) {
+#endif
+            panic("Failed to start timer thread");
+        }
+        alarm_thread_started = true;
+    }
+#if PICO_HOST_VIRTUAL_TIME
+    virtual_time_notify(&alarm_cond);
+#else
+    pthread_cond_signal(&alarm_cond);
+#endif
+}
+
+PICO_WEAK_FUNCTION_DEF(hardware_alarm_set_callback)
+void PICO_WEAK_FUNCTION_IMPL_NAME(hardware_alarm_set_callback)(uint alarm_num, hardware_alarm_callback_t callback) {
+    check_hardware_alarm_num_param(alarm_num);
+    pthread_mutex_lock(&alarm_mutex);
+    alarms[alarm_num].callback = callback;
+    alarms[alarm_num].armed = alarms[alarm_num].forced = false;
+    alarm_thread_notify();
+    pthread_mutex_unlock(&alarm_mutex);
+}
+
+PICO_WEAK_FUNCTION_DEF(hardware_alarm_set_target)
+bool PICO_WEAK_FUNCTION_IMPL_NAME(hardware_alarm_set_target)(uint alarm_num, absolute_time_t target) {
+    check_hardware_alarm_num_param(alarm_num);
+    uint64_t t = to_us_since_boot(target);
+    if (time_us_64() >= t) {
+        return true;
+    }
+    pthread_mutex_lock(&alarm_mutex);
+    alarms[alarm_num].target = t;
+    alarms[alarm_num].armed = true;
+    alarm_thread_notify();
+    pthread_mutex_unlock(&alarm_mutex);
+    return false;
+}
+
+PICO_WEAK_FUNCTION_DEF(hardware_alarm_cancel)
+void PICO_WEAK_FUNCTION_IMPL_NAME(hardware_alarm_cancel)(uint alarm_num) {
+    check_hardware_alarm_num_param(alarm_num);
+    pthread_mutex_lock(&alarm_mutex);
+    alarms[alarm_num].armed = false;
+    pthread_mutex_unlock(&alarm_mutex);
+}
+
+PICO_WEAK_FUNCTION_DEF(hardware_alarm_force_irq)
+void PICO_WEAK_FUNCTION_IMPL_NAME(hardware_alarm_force_irq)(uint alarm_num) {
+    check_hardware_alarm_num_param(alarm_num);
+    pthread_mutex_lock(&alarm_mutex);
+    alarms[alarm_num].forced = true;
+    alarm_thread_notify();
+    pthread_mutex_unlock(&alarm_mutex);
+}
+
+uint32_t hardware_alarm_get_irq_count(uint alarm_num) {
+    check_hardware_alarm_num_param(alarm_num);
+    pthread_mutex_lock(&alarm_mutex);
+    uint32_t count = alarms[alarm_num].irq_count;
+    pthread_mutex_unlock(&alarm_mutex);
+    return count;
+}
+#else
 PICO_WEAK_FUNCTION_DEF(hardware_alarm_set_callback)
 void PICO_WEAK_FUNCTION_IMPL_NAME(hardware_alarm_set_callback)(uint alarm_num, hardware_alarm_callback_t callback) {
     panic_unsupported();
@@ -113,3 +286,4 @@ PICO_WEAK_FUNCTION_DEF(hardware_alarm_force_irq)
 void PICO_WEAK_FUNCTION_IMPL_NAME(hardware_alarm_force_irq)(uint alarm_num) {
     panic_unsupported();
 }
+#endif
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <pthread.h>
+#include <time.h>
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+#if PICO_HOST_VIRTUAL_TIME
+#include "pico/virtual_time.h"
+#endif
+
+// Core 1 is modelled as a host thread. The inter-core FIFOs are 8 entries deep, as on RP2040, and pushing or
+// popping a value signals an event (__sev) just as the hardware does, so code which waits on the FIFO status
+// with __wfe works unmodified.
+
+#define FIFO_DEPTH 8
+
+// matches SIO_FIFO_ST_VLD_BITS and SIO_FIFO_ST_RDY_BITS on RP2040
+#define FIFO_ST_VLD_BITS 1u
+#define FIFO_ST_RDY_BITS 2u
+
+typedef struct {
+    uint32_t data[FIFO_DEPTH];
+    uint head;
+    uint count;
+} fifo_t;
+
+// fifos[n] is the fifo read by core n
+static fifo_t fifos[2];
+static pthread_mutex_t fifo_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fifo_cond;
+static pthread_once_t fifo_cond_once = PTHREAD_ONCE_INIT;
+
+static pthread_t core1_thread;
+static bool core1_thread_valid;
+static __thread uint core_num;
+
+uint get_core_num() {
+    return core_num;
+}
+
+static void fifo_cond_init(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+#if !defined(__APPLE__)
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+#endif
+    pthread_cond_init(&fifo_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static inline fifo_t *rx_fifo(void) {
+    return &fifos[get_core_num()];
+}
+
+static inline fifo_t *tx_fifo(void) {
+    return &fifos[get_core_num() ^ 1u];
+}
+
+static void fifo_wait_cleanup(void *arg) {
+    (void)arg;
+    pthread_mutex_unlock(&fifo_mutex);
+}
+
+// wait for a change of fifo state; fifo_mutex must be held. returns false if the timeout (if any) was reached
+static bool fifo_wait(const uint64_t *until_us) {
+    pthread_once(&fifo_cond_once, fifo_cond_init);
+    bool rc = true;
+    // the wait is a cancellation point (see multicore_reset_core1), so make sure the mutex is released
+    pthread_cleanup_push(fifo_wait_cleanup, NULL);
+#if PICO_HOST_VIRTUAL_TIME
+    virtual_time_wait(&fifo_cond, &fifo_mutex, until_us ? *until_us : UINT64_MAX);
+    rc = !until_us || time_us_64() < *until_us;
+#else
+    if (!until_us) {
+        pthread_cond_wait(&fifo_cond, &fifo_mutex);
+    } else {
+        // note time_us_64 is based on CLOCK_MONOTONIC on the host
+        struct timespec ts;
+        ts.tv_sec = (time_t)(*until_us / 1000000);
+        ts.tv_nsec = (long)((*until_us % 1000000) * 1000);
+        pthread_cond_timedwait(&fifo_cond, &fifo_mutex, &ts);
+        rc = time_us_64() < *until_us;
+    }
+#endif
+    pthread_cleanup_pop(0);
+    return rc;
+}
+
+static void fifo_notify(void) {
+#if PICO_HOST_VIRTUAL_TIME
+    virtual_time_notify(&fifo_cond);
+#else
+    pthread_once(&fifo_cond_once, fifo_cond_init);
+    pthread_cond_broadcast(&fifo_cond);
+#endif
+}
+
+static bool fifo_push_internal(uint32_t data, const uint64_t *until_us) {
+    pthread_mutex_lock(&fifo_mutex);
+    fifo_t *fifo = tx_fifo();
+    while (fifo->count == FIFO_DEPTH) {
+        if (!fifo_wait(until_us) && fifo->count == FIFO_DEPTH) {
+            pthread_mutex_unlock(&fifo_mutex);
+            return false;
+        }
+    }
+    fifo->data[(fifo->head + fifo->count++) % FIFO_DEPTH] = data;
+    fifo_notify();
+    pthread_mutex_unlock(&fifo_mutex);
+    // Fire off an event to the other core
+    __sev();
+    return true;
+}
+
+static bool fifo_pop_internal(uint32_t *out, const uint64_t *until_us) {
+    pthread_mutex_lock(&fifo_mutex);
+    fifo_t *fifo = rx_fifo();
+    while (!fifo->count) {
+        if (!fifo_wait(until_us) && !fifo->count) {
+            pthread_mutex_unlock(&fifo_mutex);
+            return false;
+        }
+    }
+    *out = fifo->data[fifo->head];
+    fifo->head = (fifo->head + 1) % FIFO_DEPTH;
+    fifo->count--;
+    fifo_notify();
+    pthread_mutex_unlock(&fifo_mutex);
+    __sev();
+    return true;
+}
+
+bool multicore_fifo_rvalid(void) {
+    pthread_mutex_lock(&fifo_mutex);
+    bool rc = rx_fifo()->count != 0;
+    pthread_mutex_unlock(&fifo_mutex);
+    return rc;
+}
+
+bool multicore_fifo_wready(void) {
+    pthread_mutex_lock(&fifo_mutex);
+    bool rc = tx_fifo()->count != FIFO_DEPTH;
+    pthread_mutex_unlock(&fifo_mutex);
+    return rc;
+}
+
+void multicore_fifo_push_blocking(uint32_t data) {
+    fifo_push_internal(data, NULL);
+}
+
+bool multicore_fifo_push_timeout_us(uint32_t data, uint64_t timeout_us) {
+    uint64_t until_us = time_us_64() + timeout_us;
+    return fifo_push_internal(data, &until_us);
+}
+
+uint32_t multicore_fifo_pop_blocking() {
+    uint32_t data = 0;
+    fifo_pop_internal(&data, NULL);
+    return data;
+}
+
+bool multicore_fifo_pop_timeout_us(uint64_t timeout_us, uint32_t *out) {
+    uint64_t until_us = time_us_64() + timeout_us;
+    return fifo_pop_internal(out, &until_us);
+}
+
+void multicore_fifo_drain(void) {
+    pthread_mutex_lock(&fifo_mutex);
+    rx_fifo()->count = 0;
+    fifo_notify();
+    pthread_mutex_unlock(&fifo_mutex);
+}
+
+void multicore_fifo_clear_irq(void) {
+    // there are no overflow/underflow flags to clear on the host
+}
+
+uint32_t multicore_fifo_get_status(void) {
+    pthread_mutex_lock(&fifo_mutex);
+    uint32_t status = (rx_fifo()->count ? FIFO_ST_VLD_BITS : 0) | (tx_fifo()->count != FIFO_DEPTH ? FIFO_ST_RDY_BITS : 0);
+    pthread_mutex_unlock(&fifo_mutex);
+    return status;
+}
+
+static void *core1_thread_main(void *arg) {
+    core_num = 1;
+    ((void (*)(void)) arg)();
+    return NULL;
+}
+
+void multicore_reset_core1(void) {
+    assert(get_core_num() == 0);
+    if (core1_thread_valid) {
+        // core 1 can only be stopped when it is blocked (in __wfe, a spin lock or a FIFO operation) or has returned
+        pthread_cancel(core1_thread);
+        pthread_join(core1_thread, NULL);
+        core1_thread_valid = false;
+    }
+    pthread_mutex_lock(&fifo_mutex);
+    fifos[0].count = fifos[1].count = 0;
+    fifo_notify();
+    pthread_mutex_unlock(&fifo_mutex);
+}
+
+void multicore_launch_core1(void (*entry)(void)) {
+    assert(!core1_thread_valid);
+#if PICO_HOST_VIRTUAL_TIME
+    if (virtual_time_thread_create(&core1_thread, core1_thread_main, (void *)entry)) {
+#else
+    if (pthread_create(&core1_thread, NULL, core1_thread_main, (void *)entry)) {
+#endif
+        panic("Failed to start core 1 thread");
+    }
+    core1_thread_valid = true;
+}
+
+void multicore_launch_core1_with_stack(void (*entry)(void), uint32_t *stack_bottom, size_t stack_size_bytes) {
+    // the host thread uses its own stack
+    (void)stack_bottom;
+    (void)stack_size_bytes;
+    multicore_launch_core1(entry);
+}
+
+void multicore_launch_core1_raw(void (*entry)(void), uint32_t *sp, uint32_t vector_table) {
+    panic_unsupported();
+}
+
+// The host has no XIP flash to protect, and threads cannot be paused safely, so lockout is a no-op
+void multicore_lockout_victim_init(void) {
+}
+
+bool multicore_lockout_start_timeout_us(uint64_t timeout_us) {
+    return true;
+}
+
+void multicore_lockout_start_blocking(void) {
+}
+
+bool multicore_lockout_end_timeout_us(uint64_t timeout_us) {
+    return true;
+}
+
+void multicore_lockout_end_blocking(void) {
+}
@@ -11,8 +11,18 @@
 
 #define NUM_DMA_CHANNELS 12u
 
+#define NUM_DMA_TIMERS 4u
+
+#define NUM_PIOS 2u
+
+#define NUM_PIO_STATE_MACHINES 4u
+
+#define PIO_INSTRUCTION_COUNT 32u
+
 #define NUM_TIMERS 4u
 
+#define NUM_SPIS 2u
+
 #define NUM_IRQS 32u
 
 #define NUM_SPIN_LOCKS 32u
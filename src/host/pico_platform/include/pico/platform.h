@@ -38,6 +38,7 @@ extern "C" {
 #endif
 
 #define __time_critical_func(x) x
+#define __isr
 #define __after_data(group)
 
 //int running_on_fpga() { return false; }
@@ -7,11 +7,17 @@
 #include <stdio.h>
 
 #include "pico.h"
+#if PICO_HOST_VIRTUAL_TIME
+#include "pico/virtual_time.h"
+#endif
 
 PICO_WEAK_FUNCTION_DEF(tight_loop_contents)
 
 void PICO_WEAK_FUNCTION_IMPL_NAME(tight_loop_contents)() {
-
+#if PICO_HOST_VIRTUAL_TIME
+    // let other simulated threads run (or time pass) while polling
+    virtual_time_yield();
+#endif
 }
 
 void __noreturn panic_unsupported() {
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_VIRTUAL_TIME_H
+#define _PICO_VIRTUAL_TIME_H
+
+#include <pthread.h>
+#include "pico.h"
+
+/** \file virtual_time.h
+ *  \defgroup pico_virtual_time pico_virtual_time
+ *  \brief Deterministic virtual time for host builds
+ *
+ * Linking against pico_virtual_time replaces the host's real time clock with a virtual one. Only one simulated
+ * thread (core 0, core 1 or the timer IRQ thread) runs at a time, and time stands still while it does; time only
+ * moves on when every simulated thread is blocked (in a sleep, a FIFO or other timed wait, or __wfe), at which point
+ * it jumps straight to the earliest time any of them is waiting for (e.g. the next alarm target).
+ *
+ * Since the order in which threads run depends only on the program itself, a run is exactly reproducible, and
+ * a test which spends minutes sleeping or waiting for timeouts completes as quickly as the code can execute.
+ *
+ * Code which polls rather than blocks (via tight_loop_contents() or a contended spin lock) hands over to any other
+ * simulated thread which is ready to run; if there is none, time is moved on to the next time any blocked thread
+ * is waiting for, but no further than the time last passed to time_reached() by the polling thread, or
+ * \ref PICO_HOST_VIRTUAL_TIME_IDLE_STEP_US if that time has already passed. Pure computation never advances time.
+ *
+ * The functions below are used by the host hardware_timer, hardware_sync and pico_multicore implementations,
+ * and are only needed directly by other host simulations which block threads.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// PICO_CONFIG: PICO_HOST_VIRTUAL_TIME_IDLE_STEP_US, Amount by which virtual time is advanced when a thread polls and nothing else can run, min=1, default=100, group=pico_virtual_time
+#ifndef PICO_HOST_VIRTUAL_TIME_IDLE_STEP_US
+#define PICO_HOST_VIRTUAL_TIME_IDLE_STEP_US 100
+#endif
+
+/*! \brief Return the current virtual time
+ *  \ingroup pico_virtual_time
+ *
+ * \return the number of virtual microseconds since boot
+ */
+uint64_t virtual_time_us(void);
+
+/*! \brief Create a simulated thread
+ *  \ingroup pico_virtual_time
+ *
+ * The new thread is ready to run, but does not start until the calling thread blocks or yields.
+ *
+ * \param thread the pthread handle of the new thread
+ * \param start_routine the thread function
+ * \param arg the argument to pass to start_routine
+ * \return 0 on success, or an error number as for pthread_create
+ */
+int virtual_time_thread_create(pthread_t *thread, void *(*start_routine)(void *), void *arg);
+
+/*! \brief Block the calling simulated thread until notified, or until a virtual time is reached
+ *  \ingroup pico_virtual_time
+ *
+ * This behaves much like pthread_cond_timedwait, with the channel (any address) taking the place of the condition
+ * variable. The calling thread is also a pthread cancellation point; as with pthread_cond_wait the mutex (if any)
+ * is re-acquired before any cancellation cleanup handlers are called.
+ *
+ * \param channel the address to wait for a notification on, or NULL to wait only for the time
+ * \param mutex a mutex held by the caller, which is released while blocked, or NULL
+ * \param until_us the virtual time at which to stop waiting, or UINT64_MAX to wait only for a notification
+ * \return true if the thread was notified, false if the time was reached first
+ */
+bool virtual_time_wait(const void *channel, pthread_mutex_t *mutex, uint64_t until_us);
+
+/*! \brief Wake all simulated threads waiting on a channel
+ *  \ingroup pico_virtual_time
+ *
+ * The woken threads run once the calling thread blocks or yields.
+ *
+ * \param channel the address passed to virtual_time_wait
+ */
+void virtual_time_notify(const void *channel);
+
+/*! \brief Let any other ready simulated thread run
+ *  \ingroup pico_virtual_time
+ *
+ * This is called by polling loops; if no other thread is ready, virtual time is advanced as described above.
+ */
+void virtual_time_yield(void);
+
+/*! \brief Note the time the calling thread is polling for
+ *  \ingroup pico_virtual_time
+ *
+ * This is called by time_reached() when the time has not yet been reached, so that a thread which polls for a
+ * time (rather than sleeping) does not have to creep towards it in \ref PICO_HOST_VIRTUAL_TIME_IDLE_STEP_US steps.
+ *
+ * \param until_us the virtual time being polled for
+ */
+void virtual_time_poll_hint(uint64_t until_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include "pico/virtual_time.h"
+
+// Each simulated thread is either running (there is exactly one, which holds the "run token"), ready (waiting
+// for the token, in FIFO order), or blocked (waiting for a notification and/or a virtual time). The token is only
+// handed on when the running thread blocks, yields or exits, so the interleaving of threads is fixed by the program
+// itself. Everything here is protected by vt_mutex; threads not holding the token wait on their own condition variable.
+
+typedef enum {
+    VT_RUNNING,
+    VT_READY,
+    VT_BLOCKED,
+} vt_state_t;
+
+typedef struct vt_thread {
+    struct vt_thread *next;         // next simulated thread in creation order
+    struct vt_thread *next_ready;   // next thread in the ready queue
+    pthread_cond_t cond;
+    const void *channel;
+    uint64_t until_us;
+    uint64_t poll_until_us;
+    pthread_mutex_t *relock_mutex;  // the caller's mutex, to re-acquire if cancelled while blocked
+    void *(*start_routine)(void *);
+    void *arg;
+    vt_state_t state;
+    bool notified;
+} vt_thread_t;
+
+static pthread_mutex_t vt_mutex = PTHREAD_MUTEX_INITIALIZER;
+static vt_thread_t *threads;
+static vt_thread_t *ready_head, *ready_tail;
+static vt_thread_t *running;
+static uint64_t now_us;
+static __thread vt_thread_t *self;
+
+static vt_thread_t *new_thread_locked(void) {
+    vt_thread_t *t = (vt_thread_t *)calloc(1, sizeof(vt_thread_t));
+    pthread_cond_init(&t->cond, NULL);
+    vt_thread_t **p = &threads;
+    while (*p) p = &(*p)->next;
+    *p = t;
+    return t;
+}
+
+static void make_ready_locked(vt_thread_t *t) {
+    t->state = VT_READY;
+    t->next_ready = NULL;
+    if (ready_tail) {
+        ready_tail->next_ready = t;
+    } else {
+        ready_head = t;
+    }
+    ready_tail = t;
+}
+
+static void remove_thread_locked(vt_thread_t *t) {
+    vt_thread_t **p = &threads;
+    while (*p != t) p = &(*p)->next;
+    *p = t->next;
+    if (t->state == VT_READY) {
+        vt_thread_t *prev = NULL;
+        for (vt_thread_t *r = ready_head; r != t; r = r->next_ready) prev = r;
+        if (prev) {
+            prev->next_ready = t->next_ready;
+        } else {
+            ready_head = t->next_ready;
+        }
+        if (ready_tail == t) ready_tail = prev;
+    }
+}
+
+static void free_thread(vt_thread_t *t) {
+    pthread_cond_destroy(&t->cond);
+    free(t);
+}
+
+// the calling thread's state; the first thread to get here (i.e. core 0) starts out holding the token
+static vt_thread_t *self_locked(void) {
+    if (!self) {
+        if (threads) {
+            panic("Thread was not created by virtual_time_thread_create");
+        }
+        self = new_thread_locked();
+        self->state = VT_RUNNING;
+        running = self;
+    }
+    return self;
+}
+
+static uint64_t next_until_locked(void) {
+    uint64_t next = UINT64_MAX;
+    for (vt_thread_t *t = threads; t; t = t->next) {
+        if (t->state == VT_BLOCKED && t->until_us < next) next = t->until_us;
+    }
+    return next;
+}
+
+// move time on, waking (in creation order) any threads whose time has been reached
+static void advance_locked(uint64_t to_us) {
+    if (to_us > now_us) now_us = to_us;
+    for (vt_thread_t *t = threads; t; t = t->next) {
+        if (t->state == VT_BLOCKED && t->until_us <= now_us) make_ready_locked(t);
+    }
+}
+
+// hand the token to the next ready thread; the caller has already marked itself as no longer running
+static void switch_locked(void) {
+    while (!ready_head) {
+        uint64_t next = next_until_locked();
+        if (next == UINT64_MAX) {
+            panic("Virtual time deadlock: all threads are blocked with no timeout");
+        }
+        advance_locked(next);
+    }
+    running = ready_head;
+    ready_head = running->next_ready;
+    if (!ready_head) ready_tail = NULL;
+    running->state = VT_RUNNING;
+    pthread_cond_signal(&running->cond);
+}
+
+static void cancel_cleanup(void *arg) {
+    // called with vt_mutex held if the thread is cancelled (by multicore_reset_core1) while waiting for the token
+    vt_thread_t *t = (vt_thread_t *)arg;
+    pthread_mutex_t *relock_mutex = t->relock_mutex;
+    remove_thread_locked(t);
+    self = NULL;
+    pthread_mutex_unlock(&vt_mutex);
+    free_thread(t);
+    if (relock_mutex) pthread_mutex_lock(relock_mutex);
+}
+
+static void wait_for_token_locked(vt_thread_t *t) {
+    pthread_cleanup_push(cancel_cleanup, t);
+    while (running != t) {
+        pthread_cond_wait(&t->cond, &vt_mutex);
+    }
+    pthread_cleanup_pop(0);
+}
+
+uint64_t virtual_time_us(void) {
+    return now_us;
+}
+
+static void *thread_main(void *arg) {
+    vt_thread_t *t = (vt_thread_t *)arg;
+    pthread_mutex_lock(&vt_mutex);
+    self = t;
+    wait_for_token_locked(t);
+    pthread_mutex_unlock(&vt_mutex);
+    void *rc = t->start_routine(t->arg);
+    pthread_mutex_lock(&vt_mutex);
+    remove_thread_locked(t);
+    switch_locked();
+    pthread_mutex_unlock(&vt_mutex);
+    free_thread(t);
+    return rc;
+}
+
+int virtual_time_thread_create(pthread_t *thread, void *(*start_routine)(void *), void *arg) {
+    pthread_mutex_lock(&vt_mutex);
+    // make sure the creating thread is known first
+    self_locked();
+    vt_thread_t *t = new_thread_locked();
+    t->start_routine = start_routine;
+    t->arg = arg;
+    make_ready_locked(t);
+    int rc = pthread_create(thread, NULL, thread_main, t);
+    if (rc) {
+        remove_thread_locked(t);
+        free_thread(t);
+    }
+    pthread_mutex_unlock(&vt_mutex);
+    return rc;
+}
+
+bool virtual_time_wait(const void *channel, pthread_mutex_t *mutex, uint64_t until_us) {
+    pthread_mutex_lock(&vt_mutex);
+    vt_thread_t *t = self_locked();
+    if (mutex) pthread_mutex_unlock(mutex);
+    bool notified = false;
+    if (until_us > now_us) {
+        t->channel = channel;
+        t->until_us = until_us;
+        t->notified = false;
+        t->relock_mutex = mutex;
+        t->state = VT_BLOCKED;
+        switch_locked();
+        wait_for_token_locked(t);
+        t->relock_mutex = NULL;
+        notified = t->notified;
+    }
+    pthread_mutex_unlock(&vt_mutex);
+    if (mutex) pthread_mutex_lock(mutex);
+    return notified;
+}
+
+void virtual_time_notify(const void *channel) {
+    pthread_mutex_lock(&vt_mutex);
+    for (vt_thread_t *t = threads; t; t = t->next) {
+        if (t->state == VT_BLOCKED && channel && t->channel == channel) {
+            t->notified = true;
+            make_ready_locked(t);
+        }
+    }
+    pthread_mutex_unlock(&vt_mutex);
+}
+
+void virtual_time_yield(void) {
+    pthread_mutex_lock(&vt_mutex);
+    vt_thread_t *t = self_locked();
+    if (!ready_head) {
+        // nothing else can run, so the caller is waiting for time to pass
+        uint64_t until_us = t->poll_until_us > now_us ? t->poll_until_us : now_us + PICO_HOST_VIRTUAL_TIME_IDLE_STEP_US;
+        uint64_t next_us = next_until_locked();
+        t->poll_until_us = 0;
+        advance_locked(MIN(until_us, next_us));
+    }
+    if (ready_head) {
+        make_ready_locked(t);
+        switch_locked();
+        wait_for_token_locked(t);
+    }
+    pthread_mutex_unlock(&vt_mutex);
+}
+
+void virtual_time_poll_hint(uint64_t until_us) {
+    // only ever accessed by the thread itself
+    if (self) self->poll_until_us = until_us;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PIO_SIM_H
+#define _PIO_SIM_H
+
+// NOTE: This file does not use SDK includes, so the model can be built into host tools as well as host binaries
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A cycle accurate model of one RP2040 PIO block: 32 instructions of instruction memory, 4 state machines (with their
+ * FIFOs, OSR/ISR, clock dividers, delays and side-set), the 8 IRQ flags, and the 32 pins as seen by the PIO (outputs,
+ * output enables, and the inputs with their 2 cycle input synchronisers).
+ *
+ * The model is advanced one system clock cycle at a time by pio_sim_step(). Within a cycle the state machines all see
+ * the pin inputs and IRQ flags as they were at the start of the cycle; their pin writes are applied in state machine
+ * order (so the highest numbered state machine wins, and side-set wins over OUT/SET/MOV within a state machine), and
+ * their IRQ flag changes take effect at the end of the cycle.
+ */
+
+#define PIO_SIM_NUM_STATE_MACHINES 4
+#define PIO_SIM_INSTRUCTION_COUNT 32
+#define PIO_SIM_NUM_PINS 32
+#define PIO_SIM_FIFO_DEPTH 4
+
+typedef enum pio_sim_fifo_join {
+    PIO_SIM_FIFO_JOIN_NONE = 0,
+    PIO_SIM_FIFO_JOIN_TX = 1,
+    PIO_SIM_FIFO_JOIN_RX = 2,
+} pio_sim_fifo_join_t;
+
+// why a state machine was stalled
+typedef enum pio_sim_stall {
+    PIO_SIM_STALL_NONE = 0,
+    PIO_SIM_STALL_TX_EMPTY,  // PULL or autopull with the TX FIFO empty
+    PIO_SIM_STALL_RX_FULL,   // PUSH or autopush with the RX FIFO full
+    PIO_SIM_STALL_WAIT,      // WAIT condition not met
+    PIO_SIM_STALL_IRQ,       // IRQ WAIT flag not yet cleared
+    PIO_SIM_STALL_COUNT
+} pio_sim_stall_t;
+
+/*
+ * State machine configuration, equivalent to the SDK pio_sm_config (with the values passed to the sm_config_set_
+ * functions rather than register encodings). Thresholds are 1-32, and sideset_count includes the enable bit if
+ * sideset_opt is set.
+ */
+typedef struct pio_sim_sm_config {
+    uint16_t clkdiv_int;
+    uint8_t clkdiv_frac;
+    uint8_t wrap_target;
+    uint8_t wrap;
+    uint8_t sideset_count;
+    bool sideset_opt;
+    bool sideset_pindirs;
+    uint8_t sideset_base;
+    uint8_t out_base;
+    uint8_t out_count;
+    uint8_t set_base;
+    uint8_t set_count;
+    uint8_t in_base;
+    uint8_t jmp_pin;
+    bool in_shift_right;
+    bool out_shift_right;
+    bool autopush;
+    bool autopull;
+    uint8_t push_threshold;
+    uint8_t pull_threshold;
+    pio_sim_fifo_join_t fifo_join;
+    bool mov_status_rx;
+    uint8_t mov_status_n;
+} pio_sim_sm_config_t;
+
+typedef struct pio_sim_sm_stats {
+    uint64_t ticks;                             // cycles on which the clock divider enabled the state machine
+    uint64_t instructions;                      // instructions completed
+    uint64_t delay_cycles;                      // ticks spent in delay cycles
+    uint64_t stall_cycles[PIO_SIM_STALL_COUNT]; // ticks spent stalled, by reason
+    uint64_t words_pulled;                      // words taken from the TX FIFO by the state machine
+    uint64_t words_pushed;                      // words added to the RX FIFO by the state machine
+    uint64_t tx_underruns;                      // PULL noblock with the TX FIFO empty
+    uint64_t rx_overruns;                       // PUSH noblock with the RX FIFO full (the data is lost)
+    uint8_t tx_min_level;                       // lowest TX FIFO level seen when the state machine was enabled
+    uint8_t rx_max_level;                       // highest RX FIFO level seen
+} pio_sim_sm_stats_t;
+
+typedef struct pio_sim_fifo {
+    uint32_t data[PIO_SIM_FIFO_DEPTH * 2];
+    uint8_t head;
+    uint8_t level;
+} pio_sim_fifo_t;
+
+typedef struct pio_sim_sm {
+    pio_sim_sm_config_t config;
+    pio_sim_sm_stats_t stats;
+    pio_sim_fifo_t tx;
+    pio_sim_fifo_t rx;
+    uint32_t x, y;
+    uint32_t osr, isr;
+    uint8_t osr_count;  // number of bits shifted out of the OSR
+    uint8_t isr_count;  // number of bits shifted into the ISR
+    uint8_t pc;
+    uint8_t delay;      // remaining delay cycles
+    bool enabled;
+    bool exec_pending;  // exec_instr is to be executed instead of the instruction at pc
+    bool irq_waiting;   // an IRQ WAIT has set its flag and is waiting for it to be cleared
+    uint16_t exec_instr;
+    uint32_t clkdiv_acc;
+    pio_sim_stall_t stall; // why the current instruction is stalled (if it is)
+} pio_sim_sm_t;
+
+typedef struct pio_sim {
+    uint16_t instr_mem[PIO_SIM_INSTRUCTION_COUNT];
+    pio_sim_sm_t sm[PIO_SIM_NUM_STATE_MACHINES];
+    uint8_t irq;
+    uint32_t pins_out;          // PIO output values
+    uint32_t pindirs;           // PIO output enables
+    uint32_t gpio_in;           // levels driven onto pins by the outside world
+    uint32_t input_sync_bypass; // pins whose inputs are not synchronised
+    uint32_t sync[2];           // input synchroniser stages
+    uint32_t pins_in;           // input values seen by the state machines this cycle
+    uint8_t irq_set, irq_clear; // IRQ flag changes to apply at the end of the cycle
+    uint64_t cycle;
+} pio_sim_t;
+
+// Reset the whole PIO block, with all state machines disabled and configured per pio_sim_get_default_sm_config()
+void pio_sim_init(pio_sim_t *pio);
+
+pio_sim_sm_config_t pio_sim_get_default_sm_config(void);
+
+// Copy a program into instruction memory at offset, relocating its JMP targets as the SDK does
+void pio_sim_load_program(pio_sim_t *pio, const uint16_t *instructions, unsigned int length, unsigned int offset);
+
+// Reset a state machine (clearing its FIFOs, shift registers and statistics) and apply a configuration; it is left disabled
+void pio_sim_sm_init(pio_sim_t *pio, unsigned int sm, unsigned int initial_pc, const pio_sim_sm_config_t *config);
+
+// Change a state machine's configuration without otherwise affecting its state (as a write to its control registers does)
+void pio_sim_sm_set_config(pio_sim_t *pio, unsigned int sm, const pio_sim_sm_config_t *config);
+
+// Clear a state machine's shift counters, delay, stall and any pending exec instruction, as SM_RESTART does
+void pio_sim_sm_restart(pio_sim_t *pio, unsigned int sm);
+
+// Restart a state machine's clock divider, as CLKDIV_RESTART does
+void pio_sim_sm_clkdiv_restart(pio_sim_t *pio, unsigned int sm);
+
+// Empty both of a state machine's FIFOs
+void pio_sim_sm_clear_fifos(pio_sim_t *pio, unsigned int sm);
+
+// Enable or disable the state machines in the mask; state machines enabled together have synchronised clock dividers
+void pio_sim_sm_set_enabled_mask(pio_sim_t *pio, uint32_t mask, bool enabled);
+
+// Add a word to a state machine's TX FIFO; returns false if the FIFO is full
+bool pio_sim_sm_put(pio_sim_t *pio, unsigned int sm, uint32_t data);
+
+// Remove a word from a state machine's RX FIFO; returns false if the FIFO is empty
+bool pio_sim_sm_get(pio_sim_t *pio, unsigned int sm, uint32_t *data);
+
+unsigned int pio_sim_sm_get_tx_level(const pio_sim_t *pio, unsigned int sm);
+unsigned int pio_sim_sm_get_rx_level(const pio_sim_t *pio, unsigned int sm);
+
+// The depth of a state machine's TX or RX FIFO given its FIFO join (0, 4 or 8)
+unsigned int pio_sim_sm_get_fifo_capacity(const pio_sim_t *pio, unsigned int sm, bool tx);
+
+/*
+ * Execute an instruction on a state machine immediately (even if it is disabled), as a write to SMx_INSTR does. If
+ * the instruction stalls, it is retried each time the (enabled) state machine is clocked.
+ */
+void pio_sim_sm_exec(pio_sim_t *pio, unsigned int sm, uint16_t instr);
+
+// Set the levels driven on the pins by the outside world (which are seen where the PIO is not itself driving the pin)
+void pio_sim_set_gpio_in(pio_sim_t *pio, uint32_t values);
+
+// The level of each pin: the PIO output where the output is enabled, otherwise the external level
+uint32_t pio_sim_get_pins(const pio_sim_t *pio);
+
+// Advance the model by one system clock cycle
+void pio_sim_step(pio_sim_t *pio);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
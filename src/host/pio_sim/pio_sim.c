@@ -0,0 +1,541 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// NOTE: This file does not use SDK includes, so the model can be built into host tools as well as host binaries
+
+#include <assert.h>
+#include <string.h>
+#include "pio_sim.h"
+
+enum {
+    INSTR_JMP = 0,
+    INSTR_WAIT = 1,
+    INSTR_IN = 2,
+    INSTR_OUT = 3,
+    INSTR_PUSH_PULL = 4,
+    INSTR_MOV = 5,
+    INSTR_IRQ = 6,
+    INSTR_SET = 7,
+};
+
+// IN/OUT/SET/MOV source and destination encodings (not all valid for every instruction)
+enum {
+    LOC_PINS = 0,
+    LOC_X = 1,
+    LOC_Y = 2,
+    LOC_NULL = 3,
+    LOC_PINDIRS = 4, // also MOV exec
+    LOC_PC = 5,      // also IN/MOV status
+    LOC_ISR = 6,
+    LOC_OSR = 7,     // also OUT exec
+};
+
+static uint32_t bit_mask(unsigned int bits) {
+    return bits >= 32 ? 0xffffffffu : (1u << bits) - 1u;
+}
+
+static uint32_t rotl(uint32_t v, unsigned int n) {
+    n &= 31u;
+    return n ? (v << n) | (v >> (32u - n)) : v;
+}
+
+static uint32_t rotr(uint32_t v, unsigned int n) {
+    return rotl(v, 32u - (n & 31u));
+}
+
+static uint32_t reverse_bits(uint32_t v) {
+    uint32_t r = 0;
+    for (unsigned int i = 0; i < 32; i++) {
+        r = (r << 1) | (v & 1u);
+        v >>= 1;
+    }
+    return r;
+}
+
+static unsigned int fifo_capacity(const pio_sim_sm_t *sm, bool tx) {
+    switch (sm->config.fifo_join) {
+        case PIO_SIM_FIFO_JOIN_TX:
+            return tx ? PIO_SIM_FIFO_DEPTH * 2 : 0;
+        case PIO_SIM_FIFO_JOIN_RX:
+            return tx ? 0 : PIO_SIM_FIFO_DEPTH * 2;
+        default:
+            return PIO_SIM_FIFO_DEPTH;
+    }
+}
+
+static void fifo_push(pio_sim_fifo_t *fifo, uint32_t data) {
+    fifo->data[(fifo->head + fifo->level) % (PIO_SIM_FIFO_DEPTH * 2)] = data;
+    fifo->level++;
+}
+
+static uint32_t fifo_pop(pio_sim_fifo_t *fifo) {
+    uint32_t data = fifo->data[fifo->head];
+    fifo->head = (uint8_t)((fifo->head + 1) % (PIO_SIM_FIFO_DEPTH * 2));
+    fifo->level--;
+    return data;
+}
+
+static void write_pins(pio_sim_t *pio, unsigned int base, unsigned int count, uint32_t value) {
+    uint32_t mask = rotl(bit_mask(count), base);
+    pio->pins_out = (pio->pins_out & ~mask) | (rotl(value, base) & mask);
+}
+
+static void write_pindirs(pio_sim_t *pio, unsigned int base, unsigned int count, uint32_t value) {
+    uint32_t mask = rotl(bit_mask(count), base);
+    pio->pindirs = (pio->pindirs & ~mask) | (rotl(value, base) & mask);
+}
+
+static uint32_t mov_status(const pio_sim_sm_t *sm) {
+    unsigned int level = sm->config.mov_status_rx ? sm->rx.level : sm->tx.level;
+    return level < sm->config.mov_status_n ? 0xffffffffu : 0;
+}
+
+static bool osr_empty(const pio_sim_sm_t *sm) {
+    return sm->osr_count >= sm->config.pull_threshold;
+}
+
+static void refill_osr(pio_sim_sm_t *sm) {
+    sm->osr = fifo_pop(&sm->tx);
+    sm->osr_count = 0;
+    sm->stats.words_pulled++;
+}
+
+static void push_isr(pio_sim_sm_t *sm) {
+    fifo_push(&sm->rx, sm->isr);
+    sm->isr = 0;
+    sm->isr_count = 0;
+    sm->stats.words_pushed++;
+}
+
+static void shift_in(pio_sim_sm_t *sm, uint32_t data, unsigned int bits) {
+    data &= bit_mask(bits);
+    if (sm->config.in_shift_right) {
+        sm->isr = bits >= 32 ? data : (sm->isr >> bits) | (data << (32u - bits));
+    } else {
+        sm->isr = bits >= 32 ? data : (sm->isr << bits) | data;
+    }
+    sm->isr_count = (uint8_t)(sm->isr_count + bits > 32 ? 32 : sm->isr_count + bits);
+}
+
+static uint32_t shift_out(pio_sim_sm_t *sm, unsigned int bits) {
+    uint32_t data;
+    if (sm->config.out_shift_right) {
+        data = sm->osr & bit_mask(bits);
+        sm->osr = bits >= 32 ? 0 : sm->osr >> bits;
+    } else {
+        data = bits >= 32 ? sm->osr : sm->osr >> (32u - bits);
+        sm->osr = bits >= 32 ? 0 : sm->osr << bits;
+    }
+    sm->osr_count = (uint8_t)(sm->osr_count + bits > 32 ? 32 : sm->osr_count + bits);
+    return data;
+}
+
+static unsigned int irq_index(unsigned int sm_num, unsigned int index) {
+    // bit 4 selects the relative mode, where the state machine number is added modulo 4 to the bottom two bits
+    return (index & 0x10u) ? (index & 4u) | ((index + sm_num) & 3u) : index & 7u;
+}
+
+/*
+ * Perform the effect of an instruction (other than side-set and delay), returning why it stalled if it did. A stalled
+ * instruction has had no effect, and will be retried on the next tick. new_pc is set if the instruction writes the
+ * PC, and exec if it supplies an instruction to execute next.
+ */
+static pio_sim_stall_t execute(pio_sim_t *pio, unsigned int sm_num, uint16_t instr, int *new_pc, bool *exec, uint16_t *exec_instr) {
+    pio_sim_sm_t *sm = &pio->sm[sm_num];
+    const pio_sim_sm_config_t *config = &sm->config;
+    unsigned int arg1 = (instr >> 5u) & 7u;
+    unsigned int arg2 = instr & 0x1fu;
+    unsigned int bit_count = arg2 ? arg2 : 32;
+    uint32_t pins_in = rotr(pio->pins_in, config->in_base);
+    switch (instr >> 13u) {
+        case INSTR_JMP: {
+            bool taken;
+            switch (arg1) {
+                case 0: taken = true; break;
+                case 1: taken = !sm->x; break;
+                case 2: taken = sm->x != 0; sm->x--; break;
+                case 3: taken = !sm->y; break;
+                case 4: taken = sm->y != 0; sm->y--; break;
+                case 5: taken = sm->x != sm->y; break;
+                case 6: taken = (pio->pins_in >> config->jmp_pin) & 1u; break;
+                default: taken = !osr_empty(sm); break;
+            }
+            if (taken) *new_pc = (int)arg2;
+            return PIO_SIM_STALL_NONE;
+        }
+        case INSTR_WAIT: {
+            bool polarity = arg1 & 4u;
+            bool level;
+            switch (arg1 & 3u) {
+                case 0:
+                    level = (pio->pins_in >> arg2) & 1u;
+                    break;
+                case 1:
+                    level = (pins_in >> arg2) & 1u;
+                    break;
+                case 2: {
+                    unsigned int irq = irq_index(sm_num, arg2);
+                    level = (pio->irq >> irq) & 1u;
+                    // waiting for an IRQ flag to be set clears it
+                    if (level && polarity) pio->irq_clear |= (uint8_t)(1u << irq);
+                    break;
+                }
+                default:
+                    level = polarity; // reserved; don't hang
+                    break;
+            }
+            return level == polarity ? PIO_SIM_STALL_NONE : PIO_SIM_STALL_WAIT;
+        }
+        case INSTR_IN: {
+            if (config->autopush && sm->isr_count + bit_count >= config->push_threshold &&
+                sm->rx.level >= fifo_capacity(sm, false)) {
+                return PIO_SIM_STALL_RX_FULL;
+            }
+            uint32_t data;
+            switch (arg1) {
+                case LOC_PINS: data = pins_in; break;
+                case LOC_X: data = sm->x; break;
+                case LOC_Y: data = sm->y; break;
+                case LOC_PC: data = mov_status(sm); break;
+                case LOC_ISR: data = sm->isr; break;
+                case LOC_OSR: data = sm->osr; break;
+                default: data = 0; break;
+            }
+            shift_in(sm, data, bit_count);
+            if (config->autopush && sm->isr_count >= config->push_threshold) push_isr(sm);
+            return PIO_SIM_STALL_NONE;
+        }
+        case INSTR_OUT: {
+            if (config->autopull && osr_empty(sm)) {
+                if (!sm->tx.level) return PIO_SIM_STALL_TX_EMPTY;
+                refill_osr(sm);
+            }
+            uint32_t data = shift_out(sm, bit_count);
+            switch (arg1) {
+                case LOC_PINS: write_pins(pio, config->out_base, config->out_count, data); break;
+                case LOC_X: sm->x = data; break;
+                case LOC_Y: sm->y = data; break;
+                case LOC_PINDIRS: write_pindirs(pio, config->out_base, config->out_count, data); break;
+                case LOC_PC: *new_pc = (int)(data & 0x1fu); break;
+                case LOC_ISR:
+                    sm->isr = data;
+                    sm->isr_count = (uint8_t)bit_count;
+                    break;
+                case LOC_OSR:
+                    *exec = true;
+                    *exec_instr = (uint16_t)data;
+                    break;
+                default: break;
+            }
+            // the OSR is refilled in the background as soon as it is emptied
+            if (config->autopull && osr_empty(sm) && sm->tx.level) refill_osr(sm);
+            return PIO_SIM_STALL_NONE;
+        }
+        case INSTR_PUSH_PULL: {
+            bool if_full_empty = arg1 & 2u;
+            bool block = arg1 & 1u;
+            if (arg1 & 4u) {
+                // PULL is a no-op when the OSR is full if autopull is enabled, or not yet empty if IfEmpty
+                if (config->autopull && !sm->osr_count) return PIO_SIM_STALL_NONE;
+                if (if_full_empty && !osr_empty(sm)) return PIO_SIM_STALL_NONE;
+                if (!sm->tx.level) {
+                    if (block) return PIO_SIM_STALL_TX_EMPTY;
+                    sm->stats.tx_underruns++;
+                    sm->osr = sm->x;
+                    sm->osr_count = 0;
+                } else {
+                    refill_osr(sm);
+                }
+            } else {
+                if (if_full_empty && sm->isr_count < config->push_threshold) return PIO_SIM_STALL_NONE;
+                if (sm->rx.level >= fifo_capacity(sm, false)) {
+                    if (block) return PIO_SIM_STALL_RX_FULL;
+                    sm->stats.rx_overruns++;
+                    sm->isr = 0;
+                    sm->isr_count = 0;
+                } else {
+                    push_isr(sm);
+                }
+            }
+            return PIO_SIM_STALL_NONE;
+        }
+        case INSTR_MOV: {
+            uint32_t data;
+            switch (arg2 & 7u) {
+                case LOC_PINS: data = pins_in; break;
+                case LOC_X: data = sm->x; break;
+                case LOC_Y: data = sm->y; break;
+                case LOC_PC: data = mov_status(sm); break;
+                case LOC_ISR: data = sm->isr; break;
+                case LOC_OSR: data = sm->osr; break;
+                default: data = 0; break;
+            }
+            switch ((arg2 >> 3u) & 3u) {
+                case 1: data = ~data; break;
+                case 2: data = reverse_bits(data); break;
+                default: break;
+            }
+            switch (arg1) {
+                case LOC_PINS: write_pins(pio, config->out_base, config->out_count, data); break;
+                case LOC_X: sm->x = data; break;
+                case LOC_Y: sm->y = data; break;
+                case LOC_PINDIRS:
+                    *exec = true;
+                    *exec_instr = (uint16_t)data;
+                    break;
+                case LOC_PC: *new_pc = (int)(data & 0x1fu); break;
+                case LOC_ISR:
+                    sm->isr = data;
+                    sm->isr_count = 0;
+                    break;
+                case LOC_OSR:
+                    sm->osr = data;
+                    sm->osr_count = 0;
+                    break;
+                default: break;
+            }
+            return PIO_SIM_STALL_NONE;
+        }
+        case INSTR_IRQ: {
+            uint8_t bit = (uint8_t)(1u << irq_index(sm_num, arg2));
+            if (arg1 & 2u) {
+                pio->irq_clear |= bit;
+                return PIO_SIM_STALL_NONE;
+            }
+            if (sm->irq_waiting) {
+                // flags set earlier are visible from the start of the following cycle
+                if (pio->irq & bit) return PIO_SIM_STALL_IRQ;
+                sm->irq_waiting = false;
+                return PIO_SIM_STALL_NONE;
+            }
+            pio->irq_set |= bit;
+            if (arg1 & 1u) {
+                sm->irq_waiting = true;
+                return PIO_SIM_STALL_IRQ;
+            }
+            return PIO_SIM_STALL_NONE;
+        }
+        default: {
+            switch (arg1) {
+                case LOC_PINS: write_pins(pio, config->set_base, config->set_count, arg2); break;
+                case LOC_X: sm->x = arg2; break;
+                case LOC_Y: sm->y = arg2; break;
+                case LOC_PINDIRS: write_pindirs(pio, config->set_base, config->set_count, arg2); break;
+                default: break;
+            }
+            return PIO_SIM_STALL_NONE;
+        }
+    }
+}
+
+// issue the current instruction, which is retried (including its side-set) on every tick while it stalls
+static void run_instruction(pio_sim_t *pio, unsigned int sm_num) {
+    pio_sim_sm_t *sm = &pio->sm[sm_num];
+    const pio_sim_sm_config_t *config = &sm->config;
+    bool from_exec = sm->exec_pending;
+    uint16_t instr = from_exec ? sm->exec_instr : pio->instr_mem[sm->pc];
+    int new_pc = -1;
+    bool exec = false;
+    uint16_t exec_instr = 0;
+    pio_sim_stall_t stall = execute(pio, sm_num, instr, &new_pc, &exec, &exec_instr);
+
+    // side-set is applied after the instruction's own pin writes, so takes precedence
+    unsigned int delay_bits = 5u - config->sideset_count;
+    unsigned int field = (instr >> 8u) & 0x1fu;
+    unsigned int sideset = field >> delay_bits;
+    unsigned int sideset_bits = config->sideset_count;
+    bool sideset_enabled = sideset_bits != 0;
+    if (config->sideset_opt && sideset_bits) {
+        sideset_bits--;
+        sideset_enabled = (sideset >> sideset_bits) & 1u;
+    }
+    if (sideset_enabled) {
+        if (config->sideset_pindirs) {
+            write_pindirs(pio, config->sideset_base, sideset_bits, sideset);
+        } else {
+            write_pins(pio, config->sideset_base, sideset_bits, sideset);
+        }
+    }
+
+    sm->stall = stall;
+    if (stall != PIO_SIM_STALL_NONE) {
+        sm->stats.stall_cycles[stall]++;
+        return;
+    }
+    sm->stats.instructions++;
+    sm->exec_pending = exec;
+    sm->exec_instr = exec_instr;
+    // the delay of an OUT/MOV EXEC is ignored, the executed instruction runs on the next tick
+    sm->delay = exec ? 0 : (uint8_t)(field & bit_mask(delay_bits));
+    if (new_pc >= 0) {
+        sm->pc = (uint8_t)new_pc;
+    } else if (!from_exec) {
+        sm->pc = sm->pc == config->wrap ? config->wrap_target : (uint8_t)((sm->pc + 1u) % PIO_SIM_INSTRUCTION_COUNT);
+    }
+}
+
+static void apply_irq_changes(pio_sim_t *pio) {
+    pio->irq = (uint8_t)((pio->irq & ~pio->irq_clear) | pio->irq_set);
+    pio->irq_set = pio->irq_clear = 0;
+}
+
+static uint32_t clkdiv_fixed(const pio_sim_sm_config_t *config) {
+    // a divisor of 0 means 65536
+    uint32_t div = ((uint32_t)config->clkdiv_int << 8u) | config->clkdiv_frac;
+    return config->clkdiv_int ? div : 65536u << 8u;
+}
+
+pio_sim_sm_config_t pio_sim_get_default_sm_config(void) {
+    pio_sim_sm_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.clkdiv_int = 1;
+    config.wrap = PIO_SIM_INSTRUCTION_COUNT - 1;
+    config.in_shift_right = true;
+    config.out_shift_right = true;
+    config.push_threshold = 32;
+    config.pull_threshold = 32;
+    return config;
+}
+
+void pio_sim_init(pio_sim_t *pio) {
+    memset(pio, 0, sizeof(*pio));
+    pio_sim_sm_config_t config = pio_sim_get_default_sm_config();
+    for (unsigned int sm = 0; sm < PIO_SIM_NUM_STATE_MACHINES; sm++) {
+        pio_sim_sm_init(pio, sm, 0, &config);
+    }
+}
+
+void pio_sim_load_program(pio_sim_t *pio, const uint16_t *instructions, unsigned int length, unsigned int offset) {
+    assert(offset + length <= PIO_SIM_INSTRUCTION_COUNT);
+    for (unsigned int i = 0; i < length; i++) {
+        uint16_t instr = instructions[i];
+        // JMP targets are relative to the start of the program
+        pio->instr_mem[offset + i] = (instr >> 13u) == INSTR_JMP ? (uint16_t)(instr + offset) : instr;
+    }
+}
+
+void pio_sim_sm_init(pio_sim_t *pio, unsigned int sm_num, unsigned int initial_pc, const pio_sim_sm_config_t *config) {
+    assert(sm_num < PIO_SIM_NUM_STATE_MACHINES);
+    assert(config->sideset_count <= 5);
+    assert(config->push_threshold >= 1 && config->push_threshold <= 32);
+    assert(config->pull_threshold >= 1 && config->pull_threshold <= 32);
+    pio_sim_sm_t *sm = &pio->sm[sm_num];
+    memset(sm, 0, sizeof(*sm));
+    sm->config = *config;
+    sm->pc = (uint8_t)initial_pc;
+    // both shift registers start empty
+    sm->osr_count = 32;
+    sm->stats.tx_min_level = (uint8_t)fifo_capacity(sm, true);
+}
+
+void pio_sim_sm_set_config(pio_sim_t *pio, unsigned int sm_num, const pio_sim_sm_config_t *config) {
+    assert(sm_num < PIO_SIM_NUM_STATE_MACHINES);
+    assert(config->sideset_count <= 5);
+    pio_sim_sm_t *sm = &pio->sm[sm_num];
+    // changing the FIFO join clears the FIFOs
+    if (config->fifo_join != sm->config.fifo_join) pio_sim_sm_clear_fifos(pio, sm_num);
+    sm->config = *config;
+}
+
+void pio_sim_sm_restart(pio_sim_t *pio, unsigned int sm_num) {
+    pio_sim_sm_t *sm = &pio->sm[sm_num];
+    sm->isr = 0;
+    sm->isr_count = 0;
+    sm->osr_count = 32;
+    sm->delay = 0;
+    sm->exec_pending = false;
+    sm->irq_waiting = false;
+    sm->stall = PIO_SIM_STALL_NONE;
+}
+
+void pio_sim_sm_clkdiv_restart(pio_sim_t *pio, unsigned int sm_num) {
+    pio_sim_sm_t *sm = &pio->sm[sm_num];
+    sm->clkdiv_acc = clkdiv_fixed(&sm->config) - 256u;
+}
+
+void pio_sim_sm_clear_fifos(pio_sim_t *pio, unsigned int sm_num) {
+    pio_sim_sm_t *sm = &pio->sm[sm_num];
+    memset(&sm->tx, 0, sizeof(sm->tx));
+    memset(&sm->rx, 0, sizeof(sm->rx));
+}
+
+void pio_sim_sm_set_enabled_mask(pio_sim_t *pio, uint32_t mask, bool enabled) {
+    for (unsigned int sm_num = 0; sm_num < PIO_SIM_NUM_STATE_MACHINES; sm_num++) {
+        if (!(mask & (1u << sm_num))) continue;
+        pio_sim_sm_t *sm = &pio->sm[sm_num];
+        // tick on the first cycle after being enabled
+        if (enabled && !sm->enabled) pio_sim_sm_clkdiv_restart(pio, sm_num);
+        sm->enabled = enabled;
+    }
+}
+
+bool pio_sim_sm_put(pio_sim_t *pio, unsigned int sm_num, uint32_t data) {
+    pio_sim_sm_t *sm = &pio->sm[sm_num];
+    if (sm->tx.level >= fifo_capacity(sm, true)) return false;
+    fifo_push(&sm->tx, data);
+    return true;
+}
+
+bool pio_sim_sm_get(pio_sim_t *pio, unsigned int sm_num, uint32_t *data) {
+    pio_sim_sm_t *sm = &pio->sm[sm_num];
+    if (!sm->rx.level) return false;
+    *data = fifo_pop(&sm->rx);
+    return true;
+}
+
+unsigned int pio_sim_sm_get_tx_level(const pio_sim_t *pio, unsigned int sm_num) {
+    return pio->sm[sm_num].tx.level;
+}
+
+unsigned int pio_sim_sm_get_rx_level(const pio_sim_t *pio, unsigned int sm_num) {
+    return pio->sm[sm_num].rx.level;
+}
+
+unsigned int pio_sim_sm_get_fifo_capacity(const pio_sim_t *pio, unsigned int sm_num, bool tx) {
+    return fifo_capacity(&pio->sm[sm_num], tx);
+}
+
+void pio_sim_sm_exec(pio_sim_t *pio, unsigned int sm_num, uint16_t instr) {
+    pio_sim_sm_t *sm = &pio->sm[sm_num];
+    sm->exec_pending = true;
+    sm->exec_instr = instr;
+    sm->irq_waiting = false;
+    run_instruction(pio, sm_num);
+    apply_irq_changes(pio);
+}
+
+void pio_sim_set_gpio_in(pio_sim_t *pio, uint32_t values) {
+    pio->gpio_in = values;
+}
+
+uint32_t pio_sim_get_pins(const pio_sim_t *pio) {
+    return (pio->pins_out & pio->pindirs) | (pio->gpio_in & ~pio->pindirs);
+}
+
+void pio_sim_step(pio_sim_t *pio) {
+    pio->pins_in = (pio->sync[1] & ~pio->input_sync_bypass) | (pio_sim_get_pins(pio) & pio->input_sync_bypass);
+    for (unsigned int sm_num = 0; sm_num < PIO_SIM_NUM_STATE_MACHINES; sm_num++) {
+        pio_sim_sm_t *sm = &pio->sm[sm_num];
+        if (!sm->enabled) continue;
+        if (sm->tx.level < sm->stats.tx_min_level) sm->stats.tx_min_level = sm->tx.level;
+        sm->clkdiv_acc += 256u;
+        uint32_t div = clkdiv_fixed(&sm->config);
+        if (sm->clkdiv_acc < div) continue;
+        sm->clkdiv_acc -= div;
+        sm->stats.ticks++;
+        if (sm->delay) {
+            sm->delay--;
+            sm->stats.delay_cycles++;
+            continue;
+        }
+        run_instruction(pio, sm_num);
+        if (sm->rx.level > sm->stats.rx_max_level) sm->stats.rx_max_level = sm->rx.level;
+    }
+    apply_irq_changes(pio);
+    pio->sync[1] = pio->sync[0];
+    pio->sync[0] = pio_sim_get_pins(pio);
+    pio->cycle++;
+}
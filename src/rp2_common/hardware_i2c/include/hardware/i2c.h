@@ -348,6 +348,79 @@ static inline void i2c_write_byte_raw(i2c_inst_t *i2c, uint8_t value) {
     hw->data_cmd = value;
 }
 
+/**
+ * \brief Pop an entry from I2C Rx FIFO, including its flags
+ * \ingroup hardware_i2c
+ *
+ * This function is non-blocking and assumes the Rx FIFO isn't empty. In slave mode, the
+ * I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS flag marks the first byte received after the slave was addressed, so
+ * separates the data of consecutive transfers.
+ *
+ * \param i2c I2C instance.
+ * \return The byte value in the low 8 bits, and the I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS flag
+ */
+static inline uint32_t i2c_read_data_cmd_raw(i2c_inst_t *i2c) {
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    assert(hw->status & I2C_IC_STATUS_RFNE_BITS); // Rx FIFO must not be empty
+    return hw->data_cmd & (I2C_IC_DATA_CMD_DAT_BITS | I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS);
+}
+
+/*! \brief Get the pending (enabled) interrupts of an I2C instance
+ *  \ingroup hardware_i2c
+ *
+ * \param i2c Either \ref i2c0 or \ref i2c1
+ * \return a mask of I2C_IC_INTR_STAT_R_..._BITS
+ */
+static inline uint32_t i2c_get_irq_status(i2c_inst_t *i2c) {
+    return i2c_get_hw(i2c)->intr_stat;
+}
+
+/*! \brief Set which interrupts of an I2C instance are enabled
+ *  \ingroup hardware_i2c
+ *
+ * \param i2c Either \ref i2c0 or \ref i2c1
+ * \param mask a mask of I2C_IC_INTR_MASK_M_..._BITS
+ */
+static inline void i2c_set_irq_mask(i2c_inst_t *i2c, uint32_t mask) {
+    i2c_get_hw(i2c)->intr_mask = mask;
+}
+
+/*! \brief Clear latched interrupts of an I2C instance
+ *  \ingroup hardware_i2c
+ *
+ * The RX_FULL and TX_EMPTY interrupts follow the FIFO levels, so are not cleared this way.
+ *
+ * \param i2c Either \ref i2c0 or \ref i2c1
+ * \param mask a mask of I2C_IC_INTR_STAT_R_..._BITS to clear
+ */
+static inline void i2c_clear_irqs(i2c_inst_t *i2c, uint32_t mask) {
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    if (mask & I2C_IC_INTR_STAT_R_RX_UNDER_BITS) hw->clr_rx_under;
+    if (mask & I2C_IC_INTR_STAT_R_RX_OVER_BITS) hw->clr_rx_over;
+    if (mask & I2C_IC_INTR_STAT_R_TX_OVER_BITS) hw->clr_tx_over;
+    if (mask & I2C_IC_INTR_STAT_R_RD_REQ_BITS) hw->clr_rd_req;
+    if (mask & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) hw->clr_tx_abrt;
+    if (mask & I2C_IC_INTR_STAT_R_RX_DONE_BITS) hw->clr_rx_done;
+    if (mask & I2C_IC_INTR_STAT_R_ACTIVITY_BITS) hw->clr_activity;
+    if (mask & I2C_IC_INTR_STAT_R_STOP_DET_BITS) hw->clr_stop_det;
+    if (mask & I2C_IC_INTR_STAT_R_START_DET_BITS) hw->clr_start_det;
+    if (mask & I2C_IC_INTR_STAT_R_GEN_CALL_BITS) hw->clr_gen_call;
+    if (mask & I2C_IC_INTR_STAT_R_RESTART_DET_BITS) hw->clr_restart_det;
+}
+
+/*! \brief Set the FIFO levels at which the RX_FULL and TX_EMPTY interrupts are asserted
+ *  \ingroup hardware_i2c
+ *
+ * \param i2c Either \ref i2c0 or \ref i2c1
+ * \param rx_threshold RX_FULL is asserted while the Rx FIFO holds more than this many entries (0-15)
+ * \param tx_threshold TX_EMPTY is asserted while the Tx FIFO holds this many entries or fewer (0-15)
+ */
+static inline void i2c_set_fifo_thresholds(i2c_inst_t *i2c, uint rx_threshold, uint tx_threshold) {
+    invalid_params_if(I2C, rx_threshold > 15 || tx_threshold > 15);
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    hw->rx_tl = rx_threshold;
+    hw->tx_tl = tx_threshold;
+}
 
 /*! \brief Return the DREQ to use for pacing transfers to/from a particular I2C instance
  *  \ingroup hardware_i2c
@@ -18,6 +18,11 @@
 #define PICO_DISABLE_SHARED_IRQ_HANDLERS 0
 #endif
 
+// PICO_CONFIG: PICO_SHARED_IRQ_HANDLER_TABLE, Dispatch shared IRQ handlers from a table rather than a chain of generated code, as required by irq_add_shared_chain_handler() and shared handler profiling, type=bool, default=0, group=hardware_irq
+#ifndef PICO_SHARED_IRQ_HANDLER_TABLE
+#define PICO_SHARED_IRQ_HANDLER_TABLE 0
+#endif
+
 // PICO_CONFIG: PICO_VTABLE_PER_CORE, user is using separate vector tables per core, type=bool, default=0, group=hardware_irq
 #ifndef PICO_VTABLE_PER_CORE
 #define PICO_VTABLE_PER_CORE 0
@@ -111,6 +116,11 @@
 #define PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY 0xff
 #define PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY 0x00
 
+// PICO_CONFIG: PICO_SHARED_IRQ_HANDLER_PROFILING, Record invocation counts and execution cycles of each shared IRQ handler (requires PICO_SHARED_IRQ_HANDLER_TABLE), type=bool, default=0, group=hardware_irq
+#ifndef PICO_SHARED_IRQ_HANDLER_PROFILING
+#define PICO_SHARED_IRQ_HANDLER_PROFILING 0
+#endif
+
 // PICO_CONFIG: PARAM_ASSERTIONS_ENABLED_IRQ, Enable/disable assertions in the IRQ module, type=bool, default=0, group=hardware_irq
 #ifndef PARAM_ASSERTIONS_ENABLED_IRQ
 #define PARAM_ASSERTIONS_ENABLED_IRQ 0
@@ -127,6 +137,16 @@ extern "C" {
  */
 typedef void (*irq_handler_t)(void);
 
+/*! \brief Shared interrupt handler function type for handlers which may end the handling of an interrupt
+ *  \ingroup hardware_irq
+ *
+ * The handler returns true if it has handled the interrupt and the remaining (lower order priority) shared handlers
+ * for the IRQ should not be called, or false to continue with them.
+ *
+ * \see irq_add_shared_chain_handler()
+ */
+typedef bool (*irq_chain_handler_t)(void);
+
 static inline void check_irq_param(__unused uint num) {
     invalid_params_if(IRQ, num >= NUM_IRQS);
 }
@@ -239,6 +259,22 @@ irq_handler_t irq_get_exclusive_handler(uint num);
  */
 void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority);
 
+/*! \brief Add a shared interrupt handler which may end the handling of an interrupt, for an interrupt on the executing core
+ *  \ingroup hardware_irq
+ *
+ * As irq_add_shared_handler(), except that when the handler returns true the remaining (lower order priority)
+ * handlers for the interrupt are skipped; this lets a handler which knows it has dealt with the only possible source
+ * of the interrupt save the time taken by the others to check their sources. The handler is removed by passing it
+ * (cast to \ref irq_handler_t) to irq_remove_handler().
+ *
+ * \note Only available when PICO_SHARED_IRQ_HANDLER_TABLE is set.
+ *
+ * \param num Interrupt number \ref interrupt_nums
+ * \param handler The handler to set. See \ref irq_chain_handler_t
+ * \param order_priority The order priority, as for irq_add_shared_handler()
+ */
+void irq_add_shared_chain_handler(uint num, irq_chain_handler_t handler, uint8_t order_priority);
+
 /*! \brief Remove a specific interrupt handler for the given irq number on the executing core
  *  \ingroup hardware_irq
  *
@@ -249,6 +285,9 @@ void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_prior
  * \note This method may *only* be called from user (non IRQ code) or from within the handler
  * itself (i.e. an IRQ handler may remove itself as part of handling the IRQ). Attempts to call
  * from another IRQ will cause an assertion.
+ * With PICO_SHARED_IRQ_HANDLER_TABLE, a shared handler may also remove other handlers of the same IRQ; those
+ * not yet called by the dispatch in progress are skipped. The slots of handlers removed during a dispatch are not
+ * reused (counting against PICO_MAX_SHARED_IRQ_HANDLERS) until no dispatch is in progress.
  *
  * \param num Interrupt number \ref interrupt_nums
  * \param handler The handler to removed.
@@ -265,6 +304,50 @@ void irq_remove_handler(uint num, irq_handler_t handler);
  */
 bool irq_has_shared_handler(uint num);
 
+/*! \brief Statistics of a shared interrupt handler
+ *  \ingroup hardware_irq
+ *
+ * \see irq_get_shared_handler_stats()
+ */
+typedef struct irq_shared_handler_stats {
+    irq_handler_t handler;      ///< the handler (cast if it was added as an \ref irq_chain_handler_t)
+    uint8_t order_priority;     ///< its order priority
+    uint8_t max_depth;          ///< the deepest nesting of shared IRQ dispatch (1 being not nested) it has been called at
+    uint32_t count;             ///< the number of times it has been called
+    uint32_t chain_stops;       ///< the number of times it ended the handling of the interrupt
+    uint32_t max_cycles;        ///< its longest execution time, in cycles
+    uint64_t total_cycles;      ///< its total execution time, in cycles
+} irq_shared_handler_stats_t;
+
+/*! \brief Get the statistics of the shared handlers for the given irq number on the executing core
+ *  \ingroup hardware_irq
+ *
+ * The statistics are recorded when PICO_SHARED_IRQ_HANDLER_PROFILING is set (along with PICO_SHARED_IRQ_HANDLER_TABLE).
+ * Cycles are counted using SysTick, which is started (with the processor clock and maximum reload value) if it is
+ * not already running; a SysTick already in use with a smaller reload value will give incorrect cycle counts.
+ *
+ * \param num Interrupt number \ref interrupt_nums
+ * \param stats Receives the statistics of the handlers, in the order they are called
+ * \param max_handlers The number of entries in stats
+ * \return the number of shared handlers for the irq (which may be more than max_handlers)
+ */
+uint irq_get_shared_handler_stats(uint num, irq_shared_handler_stats_t *stats, uint max_handlers);
+
+/*! \brief Reset the statistics of all shared handlers
+ *  \ingroup hardware_irq
+ */
+void irq_clear_shared_handler_stats(void);
+
+/*! \brief Get the deepest nesting of shared IRQ dispatch seen on either core
+ *  \ingroup hardware_irq
+ *
+ * i.e. the most shared IRQ handler chains which have been in progress at once, because a higher priority interrupt
+ * with shared handlers fired while one was running.
+ *
+ * \return the depth, or 0 if no shared handler has been called since the statistics were reset
+ */
+uint irq_get_shared_handler_max_depth(void);
+
 /*! \brief Get the current IRQ handler for the specified IRQ from the currently installed hardware vector table (VTOR)
  * of the execution core
  *  \ingroup hardware_irq
@@ -13,6 +13,11 @@
 #include "pico/mutex.h"
 #include "pico/assert.h"
 
+#if PICO_SHARED_IRQ_HANDLER_TABLE && !PICO_DISABLE_SHARED_IRQ_HANDLERS
+#include "hardware/structs/systick.h"
+#include "irq_shared_table.h"
+#endif
+
 extern void __unhandled_user_irq(void);
 
 #if PICO_VTABLE_PER_CORE
@@ -72,7 +77,39 @@ void irq_set_pending(uint num) {
     *((io_rw_32 *) (PPB_BASE + M0PLUS_NVIC_ISPR_OFFSET)) = 1u << num;
 }
 
-#if !PICO_DISABLE_SHARED_IRQ_HANDLERS
+#if !PICO_DISABLE_SHARED_IRQ_HANDLERS && PICO_SHARED_IRQ_HANDLER_TABLE
+static inline bool is_shared_irq_raw_handler(irq_handler_t raw_handler) {
+    return raw_handler == irq_shared_table_dispatch;
+}
+
+bool irq_has_shared_handler(uint irq_num) {
+    check_irq_param(irq_num);
+    return is_shared_irq_raw_handler(irq_get_vtable_handler(irq_num));
+}
+
+uint irq_shared_table_backend_current_irq(void) {
+    return __get_current_exception() - VTABLE_FIRST_IRQ;
+}
+
+void irq_shared_table_backend_set_vtable_handler(uint num, irq_handler_t handler) {
+    get_vtable()[VTABLE_FIRST_IRQ + num] = handler;
+    __dmb();
+}
+
+// cycles are counted by SysTick (a 24 bit down counter), which is started free running if it isn't already
+uint32_t irq_shared_table_backend_get_cycles(void) {
+    if (!(systick_hw->csr & M0PLUS_SYST_CSR_ENABLE_BITS)) {
+        systick_hw->rvr = M0PLUS_SYST_RVR_BITS;
+        systick_hw->cvr = 0;
+        systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+    }
+    return systick_hw->cvr;
+}
+
+uint32_t irq_shared_table_backend_cycles_since(uint32_t start) {
+    return (start - systick_hw->cvr) & M0PLUS_SYST_CVR_BITS;
+}
+#elif !PICO_DISABLE_SHARED_IRQ_HANDLERS
 // limited by 8 bit relative links (and reality)
 static_assert(PICO_MAX_SHARED_IRQ_HANDLERS >= 1 && PICO_MAX_SHARED_IRQ_HANDLERS < 0x7f, "");
 
@@ -155,7 +192,7 @@ irq_handler_t irq_get_exclusive_handler(uint num) {
 }
 
 
-#if !PICO_DISABLE_SHARED_IRQ_HANDLERS
+#if !PICO_DISABLE_SHARED_IRQ_HANDLERS && !PICO_SHARED_IRQ_HANDLER_TABLE
 static uint16_t make_branch(uint16_t *from, void *to) {
     uint32_t ui_from = (uint32_t)from;
     uint32_t ui_to = (uint32_t)to;
@@ -209,6 +246,8 @@ void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_prior
     panic_unsupported()
 #elif PICO_DISABLE_SHARED_IRQ_HANDLERS
     irq_set_exclusive_handler(num, handler);
+#elif PICO_SHARED_IRQ_HANDLER_TABLE
+    irq_shared_table_add(num, handler, false, order_priority);
 #else
     spin_lock_t *lock = spin_lock_instance(PICO_SPINLOCK_ID_IRQ);
     uint32_t save = spin_lock_blocking(lock);
@@ -283,7 +322,14 @@ void irq_remove_handler(uint num, irq_handler_t handler) {
     uint32_t save = spin_lock_blocking(lock);
     irq_handler_t vtable_handler = get_vtable()[16 + num];
     if (vtable_handler != __unhandled_user_irq && vtable_handler != handler) {
-#if !PICO_DISABLE_SHARED_IRQ_HANDLERS
+#if !PICO_DISABLE_SHARED_IRQ_HANDLERS && PICO_SHARED_IRQ_HANDLER_TABLE
+        // a dispatch in progress may still reach the removed slot; it keeps its link, and the dispatcher skips it,
+        // and it isn't reused until no dispatch is in progress (see irq_shared_table.c)
+        __unused bool found = is_shared_irq_raw_handler(vtable_handler) && irq_shared_table_remove(num, handler);
+        assert(found);
+        spin_unlock(lock, save);
+        return;
+#elif !PICO_DISABLE_SHARED_IRQ_HANDLERS
         if (is_shared_irq_raw_handler(vtable_handler)) {
             // This is a bit tricky, as an executing IRQ handler doesn't take a lock.
 
@@ -390,7 +436,7 @@ uint irq_get_priority(uint num) {
     return (uint8_t)(*p >> (8 * (num & 3u)));
 }
 
-#if !PICO_DISABLE_SHARED_IRQ_HANDLERS
+#if !PICO_DISABLE_SHARED_IRQ_HANDLERS && !PICO_SHARED_IRQ_HANDLER_TABLE
 // used by irq_handler_chain.S to remove the last link in a handler chain after it executes
 // note this must be called only with the last slot in a chain (and during the exception)
 void irq_add_tail_to_free_list(struct irq_handler_chain_slot *slot) {
@@ -424,6 +470,24 @@ void irq_add_tail_to_free_list(struct irq_handler_chain_slot *slot) {
 }
 #endif
 
+#if PICO_DISABLE_SHARED_IRQ_HANDLERS || !PICO_SHARED_IRQ_HANDLER_TABLE
+// these need the table driven dispatch
+void irq_add_shared_chain_handler(__unused uint num, __unused irq_chain_handler_t handler, __unused uint8_t order_priority) {
+    panic_unsupported();
+}
+
+uint irq_get_shared_handler_stats(__unused uint num, __unused irq_shared_handler_stats_t *stats, __unused uint max_handlers) {
+    return 0;
+}
+
+void irq_clear_shared_handler_stats(void) {
+}
+
+uint irq_get_shared_handler_max_depth(void) {
+    return 0;
+}
+#endif
+
 void irq_init_priorities() {
 #if PICO_DEFAULT_IRQ_PRIORITY != 0
     static_assert(!(NUM_IRQS & 3), "");
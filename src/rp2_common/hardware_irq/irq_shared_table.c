@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pico/assert.h"
+#include "irq_shared_table.h"
+
+#if PICO_SHARED_IRQ_HANDLER_TABLE && !PICO_DISABLE_SHARED_IRQ_HANDLERS
+
+// Each IRQ with shared handlers has its raw vtable handler set to irq_shared_table_dispatch, which looks up the head
+// of the IRQ's list of handler slots (ordered by descending order priority) in a table indexed by IRQ number, and
+// calls the handlers in turn. Slot numbers are stored plus one, so zero (the initial value) means none.
+static_assert(PICO_MAX_SHARED_IRQ_HANDLERS >= 1 && PICO_MAX_SHARED_IRQ_HANDLERS < 0xff, "");
+
+extern void __unhandled_user_irq(void);
+
+typedef struct {
+    union {
+        irq_handler_t handler;
+        irq_chain_handler_t chain_handler;
+    };
+    uint8_t link;
+    uint8_t priority;
+    bool chain;
+    bool retired;       // removed, but a dispatch in progress may still reach it
+#if PICO_SHARED_IRQ_HANDLER_PROFILING
+    uint8_t max_depth;
+    uint32_t count;
+    uint32_t chain_stops;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+#endif
+} irq_handler_slot_t;
+
+// a slot is free when its handler is NULL. The link of a removed slot is left unchanged, so a dispatch in progress
+// which reaches the slot skips it and carries on along the chain; the slot is retired rather than freed until no
+// dispatch is in progress, so that it can't be reused (with a different link) under a dispatch
+static irq_handler_slot_t slots[PICO_MAX_SHARED_IRQ_HANDLERS];
+
+#if PICO_VTABLE_PER_CORE
+static uint8_t chain_heads[NUM_CORES][NUM_IRQS];
+static inline uint8_t *chain_heads_ptr(void) {
+    return chain_heads[get_core_num()];
+}
+#else
+static uint8_t chain_heads[NUM_IRQS];
+static inline uint8_t *chain_heads_ptr(void) {
+    return chain_heads;
+}
+#endif
+
+static uint8_t dispatch_depth[NUM_CORES];
+static uint8_t max_dispatch_depth;
+
+void __not_in_flash_func(irq_shared_table_dispatch)(void) {
+    uint num = irq_shared_table_backend_current_irq();
+    uint core = get_core_num();
+    uint8_t depth = ++dispatch_depth[core];
+#if PICO_SHARED_IRQ_HANDLER_PROFILING
+    if (depth > max_dispatch_depth) max_dispatch_depth = depth;
+#endif
+    // the dispatch must be seen to be in progress before it can reach any slot
+    __dmb();
+    uint i = chain_heads_ptr()[num];
+    for (; i; i = slots[i - 1].link) {
+        // read after the previous handler returns, as it may have removed this one (or this one may have been removed
+        // by a handler which preempted the dispatch)
+        irq_handler_slot_t *slot = &slots[i - 1];
+        irq_handler_t handler = slot->handler;
+        if (!handler) continue;
+#if PICO_SHARED_IRQ_HANDLER_PROFILING
+        uint32_t start = irq_shared_table_backend_get_cycles();
+#endif
+        bool stop;
+        if (slot->chain) {
+            stop = ((irq_chain_handler_t)handler)();
+        } else {
+            handler();
+            stop = false;
+        }
+#if PICO_SHARED_IRQ_HANDLER_PROFILING
+        uint32_t cycles = irq_shared_table_backend_cycles_since(start);
+        slot->count++;
+        slot->total_cycles += cycles;
+        if (cycles > slot->max_cycles) slot->max_cycles = cycles;
+        if (depth > slot->max_depth) slot->max_depth = depth;
+        if (stop) slot->chain_stops++;
+#endif
+        if (stop) break;
+    }
+    dispatch_depth[core]--;
+}
+
+// Is a dispatch in progress on either core? Once none is, no dispatch can reach a slot removed before
+static bool is_dispatch_in_progress(void) {
+    __dmb();
+    for (uint core = 0; core < NUM_CORES; core++) {
+        if (dispatch_depth[core]) return true;
+    }
+    return false;
+}
+
+void irq_shared_table_add(uint num, irq_handler_t handler, bool chain, uint8_t order_priority) {
+    spin_lock_t *lock = spin_lock_instance(PICO_SPINLOCK_ID_IRQ);
+    uint32_t save = spin_lock_blocking(lock);
+    uint8_t *heads = chain_heads_ptr();
+    irq_handler_t vtable_handler = irq_get_vtable_handler(num);
+    hard_assert(heads[num] ? vtable_handler == irq_shared_table_dispatch : vtable_handler == __unhandled_user_irq);
+    if (!is_dispatch_in_progress()) {
+        for (uint i = 0; i < PICO_MAX_SHARED_IRQ_HANDLERS; i++) slots[i].retired = false;
+    }
+    uint free_slot = 0;
+    while (free_slot < PICO_MAX_SHARED_IRQ_HANDLERS && (slots[free_slot].handler || slots[free_slot].retired)) {
+        free_slot++;
+    }
+    hard_assert(free_slot < PICO_MAX_SHARED_IRQ_HANDLERS); // we must have a slot
+    irq_handler_slot_t *slot = &slots[free_slot];
+    // new handlers go before existing ones of the same priority, as with the handler chain
+    uint8_t *link = &heads[num];
+    while (*link && slots[*link - 1].priority > order_priority) link = &slots[*link - 1].link;
+    irq_handler_slot_t slot_data = {
+            .handler = handler,
+            .link = *link,
+            .priority = order_priority,
+            .chain = chain,
+    };
+    *slot = slot_data;
+    // the slot must be complete before a dispatch can reach it
+    __mem_fence_release();
+    *link = (uint8_t)(free_slot + 1);
+    irq_shared_table_backend_set_vtable_handler(num, irq_shared_table_dispatch);
+    spin_unlock(lock, save);
+}
+
+void irq_add_shared_chain_handler(uint num, irq_chain_handler_t handler, uint8_t order_priority) {
+    check_irq_param(num);
+    irq_shared_table_add(num, (irq_handler_t)handler, true, order_priority);
+}
+
+bool irq_shared_table_remove(uint num, irq_handler_t handler) {
+    uint8_t *heads = chain_heads_ptr();
+    uint8_t *link = &heads[num];
+    while (*link && slots[*link - 1].handler != handler) link = &slots[*link - 1].link;
+    if (!*link) return false;
+    irq_handler_slot_t *slot = &slots[*link - 1];
+    *link = slot->link;
+    __mem_fence_release();
+    slot->handler = NULL;
+    slot->retired = true;
+    if (!heads[num]) irq_shared_table_backend_set_vtable_handler(num, __unhandled_user_irq);
+    return true;
+}
+
+uint irq_get_shared_handler_stats(uint num, irq_shared_handler_stats_t *stats, uint max_handlers) {
+    check_irq_param(num);
+    spin_lock_t *lock = spin_lock_instance(PICO_SPINLOCK_ID_IRQ);
+    uint32_t save = spin_lock_blocking(lock);
+    uint n = 0;
+    for (uint i = chain_heads_ptr()[num]; i; i = slots[i - 1].link, n++) {
+        if (n < max_handlers) {
+            const irq_handler_slot_t *slot = &slots[i - 1];
+            irq_shared_handler_stats_t s = {
+                    .handler = slot->handler,
+                    .order_priority = slot->priority,
+#if PICO_SHARED_IRQ_HANDLER_PROFILING
+                    .max_depth = slot->max_depth,
+                    .count = slot->count,
+                    .chain_stops = slot->chain_stops,
+                    .max_cycles = slot->max_cycles,
+                    .total_cycles = slot->total_cycles,
+#endif
+            };
+            stats[n] = s;
+        }
+    }
+    spin_unlock(lock, save);
+    return n;
+}
+
+void irq_clear_shared_handler_stats(void) {
+#if PICO_SHARED_IRQ_HANDLER_PROFILING
+    spin_lock_t *lock = spin_lock_instance(PICO_SPINLOCK_ID_IRQ);
+    uint32_t save = spin_lock_blocking(lock);
+    for (uint i = 0; i < PICO_MAX_SHARED_IRQ_HANDLERS; i++) {
+        slots[i].max_depth = 0;
+        slots[i].count = 0;
+        slots[i].chain_stops = 0;
+        slots[i].max_cycles = 0;
+        slots[i].total_cycles = 0;
+    }
+    max_dispatch_depth = 0;
+    spin_unlock(lock, save);
+#endif
+}
+
+uint irq_get_shared_handler_max_depth(void) {
+    return max_dispatch_depth;
+}
+
+#endif
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _IRQ_SHARED_TABLE_H
+#define _IRQ_SHARED_TABLE_H
+
+// Private interface between the table driven shared IRQ dispatcher (irq_shared_table.c) and the hardware_irq
+// implementation using it, which provides the backend functions below (the device one, or the host simulation)
+
+#include "hardware/irq.h"
+
+// the raw vtable handler for an IRQ with shared handlers
+void irq_shared_table_dispatch(void);
+
+void irq_shared_table_add(uint num, irq_handler_t handler, bool chain, uint8_t order_priority);
+
+// called with the IRQ spin lock held; returns false if the handler is not a shared handler for the IRQ
+bool irq_shared_table_remove(uint num, irq_handler_t handler);
+
+// backend: the number of the IRQ being handled
+uint irq_shared_table_backend_current_irq(void);
+
+// backend: update the vtable entry for an IRQ (called with the IRQ spin lock held)
+void irq_shared_table_backend_set_vtable_handler(uint num, irq_handler_t handler);
+
+// backend: a cycle counter, and the cycles elapsed since a value it returned
+uint32_t irq_shared_table_backend_get_cycles(void);
+uint32_t irq_shared_table_backend_cycles_since(uint32_t start);
+
+#endif
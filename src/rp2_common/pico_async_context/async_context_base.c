@@ -31,6 +31,46 @@ bool async_context_base_remove_at_time_worker(async_context_t *self, async_at_ti
     return false;
 }
 
+void async_context_base_init(async_context_t *self) {
+    self->when_pending_lock = spin_lock_instance(next_striped_spin_lock_num());
+}
+
+// Workers with work pending are kept on a singly linked list via next_pending. The last entry points to
+// itself rather than NULL, so that a non-NULL next_pending always means the worker is on a list.
+// These must be called with when_pending_lock held.
+static void push_pending_worker(async_context_t *self, async_when_pending_worker_t *worker) {
+    if (worker->added && !worker->next_pending) {
+        worker->next_pending = self->when_pending_ready_list ? self->when_pending_ready_list : worker;
+        self->when_pending_ready_list = worker;
+    }
+}
+
+static async_when_pending_worker_t *pop_pending_worker(async_when_pending_worker_t **list) {
+    async_when_pending_worker_t *worker = *list;
+    if (worker) {
+        *list = worker->next_pending == worker ? NULL : worker->next_pending;
+        worker->next_pending = NULL;
+    }
+    return worker;
+}
+
+static bool unlink_pending_worker(async_when_pending_worker_t **list, async_when_pending_worker_t *worker) {
+    async_when_pending_worker_t *prev = NULL;
+    for (async_when_pending_worker_t *w = *list; w; prev = w, w = w->next_pending == w ? NULL : w->next_pending) {
+        if (w == worker) {
+            async_when_pending_worker_t *next = w->next_pending == w ? NULL : w->next_pending;
+            if (!prev) {
+                *list = next;
+            } else {
+                prev->next_pending = next ? next : prev;
+            }
+            worker->next_pending = NULL;
+            return true;
+        }
+    }
+    return false;
+}
+
 bool async_context_base_add_when_pending_worker(async_context_t *self, async_when_pending_worker_t *worker) {
     async_when_pending_worker_t **prev = &self->when_pending_list;
     while (*prev) {
@@ -41,6 +81,12 @@ bool async_context_base_add_when_pending_worker(async_context_t *self, async_whe
     }
     *prev = worker;
     worker->next = NULL;
+    uint32_t save = spin_lock_blocking(self->when_pending_lock);
+    worker->added = true;
+    worker->next_pending = NULL;
+    // the worker may have been marked as pending before it was added
+    if (worker->work_pending) push_pending_worker(self, worker);
+    spin_unlock(self->when_pending_lock, save);
     return true;
 }
 
@@ -49,6 +95,12 @@ bool async_context_base_remove_when_pending_worker(async_context_t *self, async_
     while (*prev) {
         if (worker == *prev) {
             *prev = worker->next;
+            uint32_t save = spin_lock_blocking(self->when_pending_lock);
+            worker->added = false;
+            if (worker->next_pending && !unlink_pending_worker(&self->when_pending_ready_list, worker)) {
+                unlink_pending_worker(&self->when_pending_run_list, worker);
+            }
+            spin_unlock(self->when_pending_lock, save);
             return true;
         }
         prev = &(*prev)->next;
@@ -56,6 +108,13 @@ bool async_context_base_remove_when_pending_worker(async_context_t *self, async_
     return false;
 }
 
+void async_context_base_set_work_pending(async_context_t *self, async_when_pending_worker_t *worker) {
+    uint32_t save = spin_lock_blocking(self->when_pending_lock);
+    worker->work_pending = true;
+    push_pending_worker(self, worker);
+    spin_unlock(self->when_pending_lock, save);
+}
+
 async_at_time_worker_t *async_context_base_remove_ready_at_time_worker(async_context_t *self) {
     async_at_time_worker_t **best_prev = NULL;
     if (self->at_time_list) {
@@ -90,17 +149,56 @@ void async_context_base_refresh_next_timeout(async_context_t *self) {
     self->next_time = earliest;
 }
 
+#if PICO_ASYNC_CONTEXT_SCAN_WHEN_PENDING_WORKERS
+// pick up workers which had work_pending set directly, rather than via async_context_set_work_pending
+static bool push_directly_pending_workers(async_context_t *self) {
+    bool any = false;
+    for (async_when_pending_worker_t *worker = self->when_pending_list; worker; worker = worker->next) {
+        if (worker->work_pending && !worker->next_pending) {
+            uint32_t save = spin_lock_blocking(self->when_pending_lock);
+            push_pending_worker(self, worker);
+            spin_unlock(self->when_pending_lock, save);
+            any = true;
+        }
+    }
+    return any;
+}
+#endif
+
 absolute_time_t async_context_base_execute_once(async_context_t *self) {
     async_at_time_worker_t *at_time_worker;
     while (NULL != (at_time_worker = async_context_base_remove_ready_at_time_worker(self))) {
         at_time_worker->do_work(self, at_time_worker);
     }
-    for(async_when_pending_worker_t *when_pending_worker = self->when_pending_list; when_pending_worker; when_pending_worker = when_pending_worker->next) {
-        if (when_pending_worker->work_pending) {
-            when_pending_worker->work_pending = false;
+#if PICO_ASYNC_CONTEXT_SCAN_WHEN_PENDING_WORKERS
+    push_directly_pending_workers(self);
+#endif
+    // take the workers marked as pending so far; any marked from here on (including by themselves
+    // from do_work) are run on the next execution. if we are nested within another execution, we
+    // just continue with its remaining workers
+    uint32_t save = spin_lock_blocking(self->when_pending_lock);
+    if (!self->when_pending_run_list) {
+        self->when_pending_run_list = self->when_pending_ready_list;
+        self->when_pending_ready_list = NULL;
+    }
+    spin_unlock(self->when_pending_lock, save);
+    do {
+        save = spin_lock_blocking(self->when_pending_lock);
+        async_when_pending_worker_t *when_pending_worker = pop_pending_worker(&self->when_pending_run_list);
+        bool work_pending = when_pending_worker && when_pending_worker->work_pending;
+        if (work_pending) when_pending_worker->work_pending = false;
+        spin_unlock(self->when_pending_lock, save);
+        if (!when_pending_worker) break;
+        if (work_pending) {
             when_pending_worker->do_work(self, when_pending_worker);
+            // the worker may have set work_pending directly to be called again
+            if (when_pending_worker->work_pending) {
+                save = spin_lock_blocking(self->when_pending_lock);
+                push_pending_worker(self, when_pending_worker);
+                spin_unlock(self->when_pending_lock, save);
+            }
         }
-    }
+    } while (true);
     async_context_base_refresh_next_timeout(self);
     return self->next_time;
 }
@@ -114,10 +212,10 @@ bool async_context_base_needs_servicing(async_context_t *self) {
             }
         }
     }
-    for(async_when_pending_worker_t *when_pending_worker = self->when_pending_list; when_pending_worker; when_pending_worker = when_pending_worker->next) {
-        if (when_pending_worker->work_pending) {
-            return true;
-        }
+#if PICO_ASYNC_CONTEXT_SCAN_WHEN_PENDING_WORKERS
+    if (push_directly_pending_workers(self)) {
+        return true;
     }
-    return false;
+#endif
+    return self->when_pending_ready_list || self->when_pending_run_list;
 }
\ No newline at end of file
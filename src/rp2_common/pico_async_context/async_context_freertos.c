@@ -107,6 +107,7 @@ static void timer_handler(__unused TimerHandle_t handle)
 bool async_context_freertos_init(async_context_freertos_t *self, async_context_freertos_config_t *config) {
     memset(self, 0, sizeof(*self));
     self->core.type = &template;
+    async_context_base_init(&self->core);
     self->core.flags = ASYNC_CONTEXT_FLAG_CALLBACK_FROM_NON_IRQ;
     self->core.core_num = get_core_num();
     self->lock_mutex = xSemaphoreCreateRecursiveMutex();
@@ -187,8 +188,9 @@ typedef struct sync_func_call{
 static void handle_sync_func_call(async_context_t *context, async_when_pending_worker_t *worker) {
     sync_func_call_t *call = (sync_func_call_t *)worker;
     call->rc = call->func(call->param);
-    xSemaphoreGive(call->sem);
+    // remove the worker before releasing the caller, as the worker lives on the caller's stack
     async_context_remove_when_pending_worker(context, worker);
+    xSemaphoreGive(call->sem);
 }
 
 uint32_t async_context_freertos_execute_sync(async_context_t *self_base, uint32_t (*func)(void *param), void *param) {
@@ -258,7 +260,7 @@ static bool async_context_freertos_remove_when_pending_worker(async_context_t *s
 }
 
 static void async_context_freertos_set_work_pending(async_context_t *self_base, async_when_pending_worker_t *worker) {
-    worker->work_pending = true;
+    async_context_base_set_work_pending(self_base, worker);
     async_context_freertos_wake_up(self_base);
 }
 
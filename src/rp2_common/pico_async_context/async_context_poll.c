@@ -17,6 +17,7 @@ bool async_context_poll_init_with_defaults(async_context_poll_t *self) {
     memset(self, 0, sizeof(*self));
     self->core.core_num = get_core_num();
     self->core.type = &template;
+    async_context_base_init(&self->core);
     self->core.flags = ASYNC_CONTEXT_FLAG_POLLED | ASYNC_CONTEXT_FLAG_CALLBACK_FROM_NON_IRQ;
     sem_init(&self->sem, 1, 1);
     return true;
@@ -27,7 +28,7 @@ static void async_context_poll_wake_up(async_context_t *self_base) {
 }
 
 static void async_context_poll_requires_update(async_context_t *self_base, async_when_pending_worker_t *worker) {
-    worker->work_pending = true;
+    async_context_base_set_work_pending(self_base, worker);
     async_context_poll_wake_up(self_base);
 }
 
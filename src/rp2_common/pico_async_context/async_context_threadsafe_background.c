@@ -97,8 +97,9 @@ typedef struct sync_func_call{
 static void handle_sync_func_call(async_context_t *context, async_when_pending_worker_t *worker) {
     sync_func_call_t *call = (sync_func_call_t *)worker;
     call->rc = call->func(call->param);
-    sem_release(&call->sem);
+    // remove the worker before releasing the caller, as the worker lives on the caller's stack
     async_context_remove_when_pending_worker(context, worker);
+    sem_release(&call->sem);
 }
 
 
@@ -194,6 +195,7 @@ static int64_t alarm_handler(__unused alarm_id_t id, void *user_data) {
 bool async_context_threadsafe_background_init(async_context_threadsafe_background_t *self, async_context_threadsafe_background_config_t *config) {
     memset(self, 0, sizeof(*self));
     self->core.type = &template;
+    async_context_base_init(&self->core);
     self->core.flags = ASYNC_CONTEXT_FLAG_CALLBACK_FROM_IRQ | ASYNC_CONTEXT_FLAG_CALLBACK_FROM_NON_IRQ;
     self->core.core_num = get_core_num();
     if (config->custom_alarm_pool) {
@@ -220,7 +222,7 @@ bool async_context_threadsafe_background_init(async_context_threadsafe_backgroun
 }
 
 static void async_context_threadsafe_background_set_work_pending(async_context_t *self_base, async_when_pending_worker_t *worker) {
-    worker->work_pending = true;
+    async_context_base_set_work_pending(self_base, worker);
     async_context_threadsafe_background_wake_up(self_base);
 }
 
@@ -65,11 +65,17 @@
 
 #include "pico.h"
 #include "pico/time.h"
+#include "hardware/sync.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// PICO_CONFIG: PICO_ASYNC_CONTEXT_SCAN_WHEN_PENDING_WORKERS, Also run "when pending" workers whose work_pending flag was set directly after they were added (rather than via async_context_set_work_pending) by checking every worker on each execution of the async_context, type=bool, default=0, group=pico_async_context
+#ifndef PICO_ASYNC_CONTEXT_SCAN_WHEN_PENDING_WORKERS
+#define PICO_ASYNC_CONTEXT_SCAN_WHEN_PENDING_WORKERS 0
+#endif
+
 enum {
     ASYNC_CONTEXT_POLL = 1,
     ASYNC_CONTEXT_THREADSAFE_BACKGROUND = 2,
@@ -134,10 +140,24 @@ typedef struct async_when_pending_worker {
      * @param worker the function to be called when work is pending
      */
     void (*do_work)(async_context_t *context, struct async_when_pending_worker *worker);
+    /*!
+     * private link list pointer for the async_context's list of workers with work pending
+     * (NULL if the worker is not in that list)
+     */
+    struct async_when_pending_worker *next_pending;
     /**
      * True if the worker need do_work called
+     *
+     * \note this should be set via \ref async_context_set_work_pending. Setting it directly is only
+     * supported before the worker is added to the async_context, or from within the worker's own do_work
+     * method (to have it called again on the next execution of the async_context). A worker whose flag
+     * is otherwise set directly while it is added is not run, unless PICO_ASYNC_CONTEXT_SCAN_WHEN_PENDING_WORKERS is set
      */
     bool work_pending;
+    /*!
+     * private flag; true while the worker is added to an async_context
+     */
+    bool added;
 } async_when_pending_worker_t;
 
 #define ASYNC_CONTEXT_FLAG_CALLBACK_FROM_NON_IRQ 0x1
@@ -175,6 +195,11 @@ typedef struct async_context_type {
 struct async_context {
     const async_context_type_t *type;
     async_when_pending_worker_t *when_pending_list;
+    // when_pending workers with work pending, pushed from any core/IRQ under when_pending_lock
+    async_when_pending_worker_t *when_pending_ready_list;
+    // when_pending workers taken from the ready list which are being run by async_context_base_execute_once
+    async_when_pending_worker_t *when_pending_run_list;
+    spin_lock_t *when_pending_lock;
     async_at_time_worker_t *at_time_list;
     absolute_time_t next_time;
     uint16_t flags;
@@ -367,9 +392,12 @@ static inline bool async_context_remove_when_pending_worker(async_context_t *con
  * \brief Mark a "when pending" worker as having work pending
  * \ingroup pico_async_context
  *
- * The worker will be run from the async_context at a later time.
+ * The worker will be run from the async_context at a later time. Marking a worker which already
+ * has work pending has no further effect.
  *
- * \note this method may be called from any context including IRQs
+ * \note this method may be called from any context including IRQs, and from either core. It does not
+ * acquire the async_context lock, and only workers which have been marked as pending are visited when
+ * the async_context next runs.
  *
  * \param context the async_context
  * \param worker the "when pending" worker to mark as pending.
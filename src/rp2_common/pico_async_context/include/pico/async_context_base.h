@@ -14,11 +14,14 @@ extern "C" {
 #endif
 
 // common functions for async_context implementations to use
+void async_context_base_init(async_context_t *self);
+
 bool async_context_base_add_at_time_worker(async_context_t *self, async_at_time_worker_t *worker);
 bool async_context_base_remove_at_time_worker(async_context_t *self, async_at_time_worker_t *worker);
 
 bool async_context_base_add_when_pending_worker(async_context_t *self, async_when_pending_worker_t *worker);
 bool async_context_base_remove_when_pending_worker(async_context_t *self, async_when_pending_worker_t *worker);
+void async_context_base_set_work_pending(async_context_t *self, async_when_pending_worker_t *worker);
 
 async_at_time_worker_t *async_context_base_remove_ready_at_time_worker(async_context_t *self);
 void async_context_base_refresh_next_timeout(async_context_t *self);
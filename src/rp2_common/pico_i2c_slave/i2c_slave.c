@@ -8,38 +8,64 @@
 #include "pico/i2c_slave.h"
 #include "hardware/irq.h"
 
+// DMA needs the I2C DREQs, which the host model of hardware_i2c doesn't have
+#define I2C_SLAVE_DMA PICO_ON_DEVICE
+
+#if I2C_SLAVE_DMA
+#include "hardware/dma.h"
+#endif
+
+#define I2C_FIFO_DEPTH 16u
+
+typedef enum {
+    BUFFERED_IDLE,
+    BUFFERED_ADDRESSING,    // receiving the offset
+    BUFFERED_WRITING,
+    BUFFERED_READING,
+} buffered_state_t;
+
 typedef struct i2c_slave {
     i2c_slave_handler_t handler;
     bool transfer_in_progress;
+    // buffered mode
+    i2c_slave_transfer_handler_t transfer_handler;
+    i2c_slave_buffers_t buffers;
+    buffered_state_t state;
+    uint offset;            // the register pointer
+    uint offset_bytes_left;
+    uint start;             // offset of the transaction in progress
+    uint length;            // bytes written so far, or bytes pushed into the Tx FIFO for a read
+#if I2C_SLAVE_DMA
+    int dma_channel;        // -1 if not using DMA
+    uint dma_requested;     // transfer count of the DMA in progress, or 0
+#endif
 } i2c_slave_t;
 
 static i2c_slave_t i2c_slaves[2];
 
 static inline i2c_inst_t *get_hw_instance(const i2c_slave_t *slave) {
-    return i2c_get_instance(slave - i2c_slaves);
+    return i2c_get_instance((uint)(slave - i2c_slaves));
 }
 
-static void __isr __not_in_flash_func(i2c_slave_irq_handler)(void) {
-    uint i2c_index = __get_current_exception() - VTABLE_FIRST_IRQ - I2C0_IRQ;
+static void __not_in_flash_func(i2c_slave_irq_handler)(uint i2c_index) {
     i2c_slave_t *slave = &i2c_slaves[i2c_index];
     i2c_inst_t *i2c = i2c_get_instance(i2c_index);
-    i2c_hw_t *hw = i2c_get_hw(i2c);
 
-    uint32_t intr_stat = hw->intr_stat;
+    uint32_t intr_stat = i2c_get_irq_status(i2c);
     if (intr_stat == 0) {
         return;
     }
     bool do_finish_transfer = false;
     if (intr_stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
-        hw->clr_tx_abrt;
+        i2c_clear_irqs(i2c, I2C_IC_INTR_STAT_R_TX_ABRT_BITS);
         do_finish_transfer = true;
     }
     if (intr_stat & I2C_IC_INTR_STAT_R_START_DET_BITS) {
-        hw->clr_start_det;
+        i2c_clear_irqs(i2c, I2C_IC_INTR_STAT_R_START_DET_BITS);
         do_finish_transfer = true;
     }
     if (intr_stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
-        hw->clr_stop_det;
+        i2c_clear_irqs(i2c, I2C_IC_INTR_STAT_R_STOP_DET_BITS);
         do_finish_transfer = true;
     }
     if (do_finish_transfer && slave->transfer_in_progress) {
@@ -51,12 +77,194 @@ static void __isr __not_in_flash_func(i2c_slave_irq_handler)(void) {
         slave->handler(i2c, I2C_SLAVE_RECEIVE);
     }
     if (intr_stat & I2C_IC_INTR_STAT_R_RD_REQ_BITS) {
-        hw->clr_rd_req;
+        i2c_clear_irqs(i2c, I2C_IC_INTR_STAT_R_RD_REQ_BITS);
         slave->transfer_in_progress = true;
         slave->handler(i2c, I2C_SLAVE_REQUEST);
     }
 }
 
+// ----------------------------------------------------------------------------
+// buffered mode
+
+#define BUFFERED_IRQ_MASK (I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_RD_REQ_BITS | \
+                           I2C_IC_INTR_MASK_M_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_RX_DONE_BITS | \
+                           I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_START_DET_BITS)
+
+static inline uint window_offset(uint offset, size_t size) {
+    return size ? offset % size : 0;
+}
+
+static void __not_in_flash_func(buffered_finish)(i2c_slave_t *slave, i2c_inst_t *i2c) {
+    i2c_slave_event_t event;
+    size_t size;
+    if (slave->state == BUFFERED_WRITING) {
+        event = I2C_SLAVE_RECEIVE;
+        size = slave->buffers.rx_size;
+    } else if (slave->state == BUFFERED_READING) {
+        // whatever is left in the Tx FIFO wasn't read; it is flushed when the next read starts
+        slave->length -= I2C_FIFO_DEPTH - (uint)i2c_get_write_available(i2c);
+        i2c_set_irq_mask(i2c, BUFFERED_IRQ_MASK);
+        event = I2C_SLAVE_REQUEST;
+        size = slave->buffers.tx_size;
+    } else {
+        // nothing, or just the offset, was written
+        slave->state = BUFFERED_IDLE;
+        return;
+    }
+    slave->state = BUFFERED_IDLE;
+    uint start = window_offset(slave->start, size);
+    slave->offset = window_offset(start + slave->length, size);
+    if (slave->length && slave->transfer_handler) {
+        slave->transfer_handler(i2c, event, start, slave->length);
+    }
+}
+
+static void __not_in_flash_func(buffered_store)(i2c_slave_t *slave, uint8_t value) {
+    if (slave->state == BUFFERED_ADDRESSING) {
+        slave->offset = (slave->offset << 8) | value;
+        if (!--slave->offset_bytes_left) {
+            slave->state = BUFFERED_WRITING;
+            slave->start = slave->offset;
+            slave->length = 0;
+        }
+    } else if (slave->state == BUFFERED_WRITING) {
+        if (slave->buffers.rx_buf) {
+            slave->buffers.rx_buf[window_offset(slave->start + slave->length, slave->buffers.rx_size)] = value;
+        }
+        slave->length++;
+    }
+}
+
+// returns true if the start of a new write was seen
+static bool __not_in_flash_func(buffered_drain_rx)(i2c_slave_t *slave, i2c_inst_t *i2c) {
+    bool started = false;
+    for (uint n = (uint)i2c_get_read_available(i2c); n; n--) {
+        uint32_t entry = i2c_read_data_cmd_raw(i2c);
+        if (entry & I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS) {
+            buffered_finish(slave, i2c);
+            slave->state = BUFFERED_ADDRESSING;
+            slave->offset = 0;
+            slave->offset_bytes_left = slave->buffers.offset_bytes;
+            started = true;
+        }
+        buffered_store(slave, (uint8_t)entry);
+    }
+    return started;
+}
+
+static void __not_in_flash_func(buffered_fill_tx)(i2c_slave_t *slave, i2c_inst_t *i2c) {
+    for (uint n = (uint)i2c_get_write_available(i2c); n; n--) {
+        uint8_t value = 0xff;
+        if (slave->buffers.tx_buf) {
+            value = slave->buffers.tx_buf[window_offset(slave->start + slave->length, slave->buffers.tx_size)];
+        }
+        i2c_write_byte_raw(i2c, value);
+        slave->length++;
+    }
+}
+
+#if I2C_SLAVE_DMA
+// account for (and stop) a DMA of written data into the receive window
+static void __not_in_flash_func(buffered_dma_stop)(i2c_slave_t *slave) {
+    if (!slave->dma_requested) return;
+    dma_channel_abort((uint)slave->dma_channel);
+    slave->length += slave->dma_requested - dma_channel_hw_addr((uint)slave->dma_channel)->transfer_count;
+    slave->dma_requested = 0;
+}
+
+// let DMA move the rest of a write, up to the end of the receive window; the CPU takes over again at the next
+// interrupt (START_DET or STOP_DET at the end of the transaction, or RX_FULL when the DMA has finished), so the
+// FIRST_DATA_BYTE flag of the next write isn't lost unless a restart is serviced very late
+static void __not_in_flash_func(buffered_dma_start)(i2c_slave_t *slave, i2c_inst_t *i2c) {
+    if (slave->dma_channel < 0 || !slave->buffers.rx_buf) return;
+    uint pos = window_offset(slave->start + slave->length, slave->buffers.rx_size);
+    uint count = (uint)slave->buffers.rx_size - pos;
+    dma_channel_config c = dma_channel_get_default_config((uint)slave->dma_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c, false));
+    slave->dma_requested = count;
+    dma_channel_configure((uint)slave->dma_channel, &c, slave->buffers.rx_buf + pos, &i2c_get_hw(i2c)->data_cmd,
+                          count, true);
+}
+#endif
+
+static void __not_in_flash_func(i2c_slave_buffered_irq_handler)(uint i2c_index) {
+    i2c_slave_t *slave = &i2c_slaves[i2c_index];
+    i2c_inst_t *i2c = i2c_get_instance(i2c_index);
+
+    uint32_t intr_stat = i2c_get_irq_status(i2c);
+    if (intr_stat == 0) {
+        return;
+    }
+    // stale Tx data was flushed at the start of a read; the flush continues until this is cleared
+    uint32_t clear = intr_stat & (I2C_IC_INTR_STAT_R_TX_ABRT_BITS | I2C_IC_INTR_STAT_R_RD_REQ_BITS |
+                                  I2C_IC_INTR_STAT_R_RX_DONE_BITS | I2C_IC_INTR_STAT_R_START_DET_BITS |
+                                  I2C_IC_INTR_STAT_R_STOP_DET_BITS);
+    if (clear) i2c_clear_irqs(i2c, clear);
+#if I2C_SLAVE_DMA
+    buffered_dma_stop(slave);
+#endif
+    bool started = buffered_drain_rx(slave, i2c);
+    // the master NACKs the last byte it reads
+    if ((intr_stat & I2C_IC_INTR_STAT_R_RX_DONE_BITS) && slave->state == BUFFERED_READING) {
+        buffered_finish(slave, i2c);
+    }
+    // a STOP ends the transaction in progress, as does a START unless it was that of the write just drained
+    if ((intr_stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) ||
+        ((intr_stat & I2C_IC_INTR_STAT_R_START_DET_BITS) && !started)) {
+        buffered_finish(slave, i2c);
+    }
+    if (intr_stat & I2C_IC_INTR_STAT_R_RD_REQ_BITS) {
+        if (slave->state != BUFFERED_READING) {
+            buffered_finish(slave, i2c);
+            slave->state = BUFFERED_READING;
+            slave->start = slave->offset;
+            slave->length = 0;
+            i2c_set_irq_mask(i2c, BUFFERED_IRQ_MASK | I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
+        }
+        buffered_fill_tx(slave, i2c);
+    } else if ((intr_stat & I2C_IC_INTR_STAT_R_TX_EMPTY_BITS) && slave->state == BUFFERED_READING) {
+        buffered_fill_tx(slave, i2c);
+    }
+#if I2C_SLAVE_DMA
+    if (slave->dma_channel >= 0) {
+        if (slave->state == BUFFERED_WRITING) {
+            buffered_dma_start(slave, i2c);
+        }
+        // take the offset as soon as it arrives, so DMA can take over the rest of the write
+        i2c_set_fifo_thresholds(i2c, slave->state == BUFFERED_WRITING ? PICO_I2C_SLAVE_BUFFERED_RX_THRESHOLD : 0,
+                                PICO_I2C_SLAVE_BUFFERED_TX_THRESHOLD);
+    }
+#endif
+}
+
+// ----------------------------------------------------------------------------
+
+static void __isr __not_in_flash_func(i2c0_slave_irq_handler)(void) {
+    if (i2c_slaves[0].handler) {
+        i2c_slave_irq_handler(0);
+    } else {
+        i2c_slave_buffered_irq_handler(0);
+    }
+}
+
+static void __isr __not_in_flash_func(i2c1_slave_irq_handler)(void) {
+    if (i2c_slaves[1].handler) {
+        i2c_slave_irq_handler(1);
+    } else {
+        i2c_slave_buffered_irq_handler(1);
+    }
+}
+
+static void slave_irq_enable(uint i2c_index) {
+    // enable interrupt for current core
+    uint num = I2C0_IRQ + i2c_index;
+    irq_set_exclusive_handler(num, i2c_index ? i2c1_slave_irq_handler : i2c0_slave_irq_handler);
+    irq_set_enabled(num, true);
+}
+
 void i2c_slave_init(i2c_inst_t *i2c, uint8_t address, i2c_slave_handler_t handler) {
     assert(i2c == i2c0 || i2c == i2c1);
     assert(handler != NULL);
@@ -70,34 +278,71 @@ void i2c_slave_init(i2c_inst_t *i2c, uint8_t address, i2c_slave_handler_t handle
     // disabled since the Rx FIFO should never fill up (unless slave->handler() is way too slow).
     i2c_set_slave_mode(i2c, true, address);
 
-    i2c_hw_t *hw = i2c_get_hw(i2c);
     // unmask necessary interrupts
-    hw->intr_mask =
-            I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_RD_REQ_BITS | I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS |
-            I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_START_DET_BITS;
+    i2c_set_irq_mask(i2c,
+            I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_RD_REQ_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS |
+            I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_START_DET_BITS);
 
-    // enable interrupt for current core
-    uint num = I2C0_IRQ + i2c_index;
-    irq_set_exclusive_handler(num, i2c_slave_irq_handler);
-    irq_set_enabled(num, true);
+    slave_irq_enable(i2c_index);
 }
 
-void i2c_slave_deinit(i2c_inst_t *i2c) {
+void i2c_slave_init_buffered(i2c_inst_t *i2c, uint8_t address, const i2c_slave_buffers_t *buffers,
+                             i2c_slave_transfer_handler_t handler) {
     assert(i2c == i2c0 || i2c == i2c1);
+    invalid_params_if(I2C, buffers->offset_bytes < 1 || buffers->offset_bytes > 2);
+    invalid_params_if(I2C, (buffers->rx_buf && !buffers->rx_size) || (buffers->tx_buf && !buffers->tx_size));
 
     uint i2c_index = i2c_hw_index(i2c);
     i2c_slave_t *slave = &i2c_slaves[i2c_index];
-    assert(slave->handler); // should be called after i2c_slave_init()
-
     slave->handler = NULL;
-    slave->transfer_in_progress = false;
+    slave->transfer_handler = handler;
+    slave->buffers = *buffers;
+    slave->state = BUFFERED_IDLE;
+    slave->offset = 0;
+#if I2C_SLAVE_DMA
+    slave->dma_channel = buffers->use_dma ? dma_claim_unused_channel(true) : -1;
+    slave->dma_requested = 0;
+#endif
+
+    i2c_set_slave_mode(i2c, true, address);
+
+    // the Rx FIFO is drained when it passes the threshold (or the transfer ends), and the Tx FIFO is kept topped
+    // up from the threshold while the master is reading
+    uint rx_threshold = PICO_I2C_SLAVE_BUFFERED_RX_THRESHOLD;
+#if I2C_SLAVE_DMA
+    if (slave->dma_channel >= 0) rx_threshold = 0;
+#endif
+    i2c_set_fifo_thresholds(i2c, rx_threshold, PICO_I2C_SLAVE_BUFFERED_TX_THRESHOLD);
+    i2c_set_irq_mask(i2c, BUFFERED_IRQ_MASK);
+
+    slave_irq_enable(i2c_index);
+}
+
+void i2c_slave_deinit(i2c_inst_t *i2c) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    uint i2c_index = i2c_hw_index(i2c);
+    i2c_slave_t *slave = &i2c_slaves[i2c_index];
+    assert(slave->handler || slave->buffers.offset_bytes); // should be called after i2c_slave_init()
 
     uint num = I2C0_IRQ + i2c_index;
     irq_set_enabled(num, false);
-    irq_remove_handler(num, i2c_slave_irq_handler);
+    irq_remove_handler(num, i2c_index ? i2c1_slave_irq_handler : i2c0_slave_irq_handler);
+
+#if I2C_SLAVE_DMA
+    if (slave->buffers.offset_bytes && slave->dma_channel >= 0) {
+        buffered_dma_stop(slave);
+        dma_channel_unclaim((uint)slave->dma_channel);
+    }
+#endif
+    slave->handler = NULL;
+    slave->transfer_in_progress = false;
+    slave->transfer_handler = NULL;
+    slave->buffers.offset_bytes = 0;
+    slave->state = BUFFERED_IDLE;
 
-    i2c_hw_t *hw = i2c_get_hw(i2c);
-    hw->intr_mask = I2C_IC_INTR_MASK_RESET;
+    i2c_set_irq_mask(i2c, I2C_IC_INTR_MASK_RESET);
+    i2c_set_fifo_thresholds(i2c, 0, 0);
 
     i2c_set_slave_mode(i2c, false, 0);
 }
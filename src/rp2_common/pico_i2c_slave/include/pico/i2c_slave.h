@@ -24,8 +24,23 @@ extern "C" {
  *
  * An example application \c slave_mem_i2c, which makes use of this library, can be found in 
  * <a href="https://github.com/raspberrypi/pico-examples/blob/master/i2c/slave_mem_i2c/slave_mem_i2c.c">pico_examples</a>.
+ *
+ * Alternatively, \ref i2c_slave_init_buffered() makes the slave look like a register mapped device: the master
+ * writes a register offset followed by data, or reads from the current offset, and the library moves the data
+ * between the I2C FIFOs and application supplied memory itself, serviced at the FIFO thresholds (or with DMA)
+ * rather than per byte. The application is called once per transaction, after it completes.
  */
 
+// PICO_CONFIG: PICO_I2C_SLAVE_BUFFERED_RX_THRESHOLD, Rx FIFO level above which a buffered I2C slave drains the FIFO before the end of a write, type=int, min=0, max=15, default=11, group=pico_i2c_slave
+#ifndef PICO_I2C_SLAVE_BUFFERED_RX_THRESHOLD
+#define PICO_I2C_SLAVE_BUFFERED_RX_THRESHOLD 11
+#endif
+
+// PICO_CONFIG: PICO_I2C_SLAVE_BUFFERED_TX_THRESHOLD, Tx FIFO level at or below which a buffered I2C slave refills the FIFO during a read, type=int, min=0, max=15, default=4, group=pico_i2c_slave
+#ifndef PICO_I2C_SLAVE_BUFFERED_TX_THRESHOLD
+#define PICO_I2C_SLAVE_BUFFERED_TX_THRESHOLD 4
+#endif
+
 /**
  * \brief I2C slave event types.
  * \ingroup pico_i2c_slave
@@ -61,6 +76,55 @@ typedef void (*i2c_slave_handler_t)(i2c_inst_t *i2c, i2c_slave_event_t event);
  */
 void i2c_slave_init(i2c_inst_t *i2c, uint8_t address, i2c_slave_handler_t handler);
 
+/**
+ * \brief The memory windows of a buffered I2C slave
+ * \ingroup pico_i2c_slave
+ *
+ * Each transaction starts at the current offset, which is set by the first \p offset_bytes bytes (big endian) of
+ * a write, and is left one past the last byte transferred. Offsets wrap around the window being accessed. The
+ * two windows may be the same memory.
+ */
+typedef struct i2c_slave_buffers {
+    uint8_t *rx_buf;            ///< data written by the master is stored here, or discarded if NULL
+    size_t rx_size;
+    const uint8_t *tx_buf;      ///< data read by the master comes from here, or is 0xff if NULL
+    size_t tx_size;
+    uint offset_bytes;          ///< the size of the register offset; 1 or 2
+    bool use_dma;               ///< move data written by the master with DMA (ignored where unsupported)
+} i2c_slave_buffers_t;
+
+/**
+ * \brief Buffered I2C slave transaction handler
+ * \ingroup pico_i2c_slave
+ *
+ * Called from the I2C ISR once each transaction is complete: with \ref I2C_SLAVE_RECEIVE after the master has
+ * written \p length bytes to the receive window at \p offset, or with \ref I2C_SLAVE_REQUEST after the master has
+ * read \p length bytes from the transmit window at \p offset. A write which only sets the offset is not reported.
+ *
+ * \param i2c Either \ref i2c0 or \ref i2c1
+ * \param event \ref I2C_SLAVE_RECEIVE or \ref I2C_SLAVE_REQUEST
+ * \param offset The offset in the window at which the transfer started
+ * \param length The number of bytes transferred, which may have wrapped around the end of the window
+ */
+typedef void (*i2c_slave_transfer_handler_t)(i2c_inst_t *i2c, i2c_slave_event_t event, uint offset, uint length);
+
+/**
+ * \brief Configure an I2C instance as a buffered slave
+ * \ingroup pico_i2c_slave
+ *
+ * Unlike \ref i2c_slave_init(), the data is moved by the library, and \p handler is only called once per
+ * transaction. The memory windows must remain valid until \ref i2c_slave_deinit(); the transmit window may be
+ * updated by the application at any time, although a read in progress may see a mixture of old and new data.
+ *
+ * \param i2c I2C instance.
+ * \param address 7-bit slave address.
+ * \param buffers The memory windows (the structure is copied).
+ * \param handler Callback for completed transactions, or NULL. It will run from the I2C ISR, on the CPU core
+ *                where the slave was initialised.
+ */
+void i2c_slave_init_buffered(i2c_inst_t *i2c, uint8_t address, const i2c_slave_buffers_t *buffers,
+                             i2c_slave_transfer_handler_t handler);
+
 /**
  * \brief Restore an I2C instance to master mode.
  * \ingroup pico_i2c_slave
@@ -7,7 +7,7 @@
 #ifndef _PICO_MEM_OPS_H
 #define _PICO_MEM_OPS_H
 
-#include "pico/types.h"
+#include "pico.h"
 
 /** \file mem_ops.h
  *  \defgroup pico_mem_ops pico_mem_ops
@@ -17,6 +17,25 @@
  * - memset, memcpy
  * - __aeabi_memset, __aeabi_memset4, __aeabi_memset8, __aeabi_memcpy, __aeabi_memcpy4, __aeabi_memcpy8
  *
- * This library does not provide any additional functions
+ * This library does not provide any additional functions.
+ *
+ * The implementation can be chosen per executable with `pico_set_mem_ops_implementation(TARGET IMPL)`:
+ *
+ * - `pico` (the default): the bootrom routines
+ * - `dma`: the bootrom routines, except that calls of at least PICO_MEM_OPS_DMA_THRESHOLD bytes from thread mode are
+ *   done by a DMA channel (one per core, claimed on first use) while the CPU waits. Calls made from IRQ handlers, while
+ *   the core's channel is in use (e.g. by an RTOS task which the caller preempted), or when no DMA channel is free,
+ *   use the bootrom routines. As the DMA code runs from flash, it is not used at all when PICO_MEM_IN_RAM is set
+ * - `compiler`: whatever the compiler and C library provide
+ *
+ * See \ref pico_mem_ops_async for asynchronous DMA backed memcpy and memset.
+ *
+ * This header may be included by assembly code
  */
+
+// PICO_CONFIG: PICO_MEM_OPS_DMA_THRESHOLD, Minimum size in bytes of a memcpy or memset done by DMA in the dma pico_mem_ops implementation, min=1, default=256, group=pico_mem_ops
+#ifndef PICO_MEM_OPS_DMA_THRESHOLD
+#define PICO_MEM_OPS_DMA_THRESHOLD 256
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_MEM_OPS_ASYNC_H
+#define _PICO_MEM_OPS_ASYNC_H
+
+#include "pico.h"
+
+/** \file mem_ops_async.h
+ *  \defgroup pico_mem_ops_async pico_mem_ops_async
+ *
+ * DMA backed asynchronous memcpy and memset
+ *
+ * \ref memcpy_async and \ref memset_async start a copy or fill on a DMA channel (claimed with
+ * dma_claim_unused_channel() for the duration of the operation) and return immediately, leaving the CPU free. The
+ * largest transfer size the alignment of the buffers permits is used: 32-bit transfers when the source and
+ * destination are equally word aligned (any leading or trailing bytes are copied by the CPU before the DMA is
+ * started), otherwise 16 or 8-bit transfers.
+ *
+ * Completion can be polled with \ref mem_async_is_done, waited for with \ref mem_async_wait, or notified by a
+ * callback. On the device the callback is called from the DMA IRQ handler (PICO_MEM_OPS_ASYNC_DMA_IRQ) on the core
+ * which started the first asynchronous operation; on the host (where the DMA is emulated, and there are no interrupts)
+ * it is called from \ref mem_async_is_done or \ref mem_async_wait.
+ *
+ * If no DMA channel is free, the operation is performed synchronously by the CPU, and the callback (if any) is called
+ * before the function returns.
+ *
+ * \note The buffers must not be accessed by the CPU (or other DMA channels) until the operation is complete.
+ *
+ * See also the `dma` implementation of \ref pico_mem_ops, which uses the DMA for large calls to the standard memcpy
+ * and memset.
+ */
+
+// PICO_CONFIG: PICO_MEM_OPS_ASYNC_DMA_IRQ, The DMA IRQ (0 or 1) used to signal completion of asynchronous memory operations, min=0, max=1, default=1, group=pico_mem_ops_async
+#ifndef PICO_MEM_OPS_ASYNC_DMA_IRQ
+#define PICO_MEM_OPS_ASYNC_DMA_IRQ 1
+#endif
+
+// PICO_CONFIG: PICO_MEM_OPS_ASYNC_IRQ_ORDER_PRIORITY, Shared IRQ order priority of the completion handler for asynchronous memory operations, min=0, max=255, default=PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY, group=pico_mem_ops_async
+#ifndef PICO_MEM_OPS_ASYNC_IRQ_ORDER_PRIORITY
+#define PICO_MEM_OPS_ASYNC_IRQ_ORDER_PRIORITY PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief Callback for completion of an asynchronous memory operation
+ *  \ingroup pico_mem_ops_async
+ *
+ * \param param The param passed when the operation was started
+ */
+typedef void (*mem_async_callback_t)(void *param);
+
+/*! \brief State of an asynchronous memory operation
+ *  \ingroup pico_mem_ops_async
+ *
+ * Owned by the caller, and must remain valid until the operation is complete. The members are private.
+ */
+typedef struct mem_async_op {
+    mem_async_callback_t callback;
+    void *param;
+    uint32_t fill;      // the word read repeatedly by the DMA for a memset
+    int8_t channel;     // the DMA channel while the operation is in progress, otherwise -1
+    volatile bool done;
+} mem_async_op_t;
+
+/*! \brief Start copying memory using DMA
+ *  \ingroup pico_mem_ops_async
+ *
+ * \param op State for the operation, which must remain valid until it is complete
+ * \param dest The destination, which must not overlap the source
+ * \param src The source
+ * \param n The number of bytes to copy
+ * \param callback Function to call on completion, or NULL
+ * \param param Passed to the callback
+ * \return true if the copy is in progress using DMA, false if it has already been completed by the CPU
+ */
+bool memcpy_async(mem_async_op_t *op, void *dest, const void *src, size_t n, mem_async_callback_t callback, void *param);
+
+/*! \brief Start filling memory using DMA
+ *  \ingroup pico_mem_ops_async
+ *
+ * \param op State for the operation, which must remain valid until it is complete
+ * \param dest The memory to fill
+ * \param c The value to set each byte to
+ * \param n The number of bytes to set
+ * \param callback Function to call on completion, or NULL
+ * \param param Passed to the callback
+ * \return true if the fill is in progress using DMA, false if it has already been completed by the CPU
+ */
+bool memset_async(mem_async_op_t *op, void *dest, int c, size_t n, mem_async_callback_t callback, void *param);
+
+/*! \brief Check whether an asynchronous memory operation is complete
+ *  \ingroup pico_mem_ops_async
+ *
+ * \param op The operation
+ * \return true if the operation is complete. The callback (if any) is called after the operation is marked complete
+ */
+bool mem_async_is_done(mem_async_op_t *op);
+
+/*! \brief Wait for an asynchronous memory operation to complete
+ *  \ingroup pico_mem_ops_async
+ *
+ * \param op The operation
+ */
+void mem_async_wait(mem_async_op_t *op);
+
+// Copy (or fill, if fill is not NULL) the part of the buffers which can be DMAed on the given (claimed) channel,
+// without waiting or enabling its IRQ; the rest is done by the CPU. Returns false if the CPU did the whole operation.
+// Used by the dma pico_mem_ops implementation.
+bool __mem_ops_dma_start(uint channel, void *dest, const void *src, const uint32_t *fill, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
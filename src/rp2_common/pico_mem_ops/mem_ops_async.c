@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "pico/mem_ops_async.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#if !PICO_NO_HARDWARE
+#include "hardware/irq.h"
+#include "hardware/claim.h"
+#endif
+
+// the operation in progress on each channel (only channels claimed by this library have entries)
+static mem_async_op_t *volatile channel_ops[NUM_DMA_CHANNELS];
+
+bool __mem_ops_dma_start(uint channel, void *dest, const void *src, const uint32_t *fill, size_t n) {
+    uintptr_t d = (uintptr_t)dest;
+    // for a fill, the source is the (word aligned) fill word, so only the destination alignment matters
+    uintptr_t misalign = fill ? 0 : d ^ (uintptr_t)src;
+    enum dma_channel_transfer_size size = (misalign & 1u) ? DMA_SIZE_8 : (misalign & 2u) ? DMA_SIZE_16 : DMA_SIZE_32;
+    size_t align = 1u << size;
+    size_t head = (align - (d & (align - 1))) & (align - 1);
+    if (head > n) head = n;
+    size_t count = (n - head) >> size;
+    size_t tail = (n - head) & (align - 1);
+    uint8_t *d8 = (uint8_t *)dest;
+    const uint8_t *s8 = (const uint8_t *)src;
+    if (fill) {
+        memset(d8, (int)(*fill & 0xffu), head);
+        memset(d8 + n - tail, (int)(*fill & 0xffu), tail);
+    } else {
+        memcpy(d8, s8, head);
+        memcpy(d8 + n - tail, s8 + n - tail, tail);
+    }
+    if (!count) return false;
+    dma_channel_config c = dma_channel_get_default_config(channel);
+    channel_config_set_transfer_data_size(&c, size);
+    channel_config_set_read_increment(&c, !fill);
+    channel_config_set_write_increment(&c, true);
+    dma_channel_configure(channel, &c, d8 + head, fill ? (const void *)fill : s8 + head, count, true);
+    return true;
+}
+
+static void finish_op(mem_async_op_t *op) {
+    if (op->channel >= 0) {
+        uint channel = (uint)op->channel;
+#if !PICO_NO_HARDWARE
+        dma_irqn_set_channel_enabled(PICO_MEM_OPS_ASYNC_DMA_IRQ, channel, false);
+#endif
+        channel_ops[channel] = NULL;
+        op->channel = -1;
+        dma_channel_unclaim(channel);
+    }
+    op->done = true;
+    if (op->callback) op->callback(op->param);
+}
+
+#if !PICO_NO_HARDWARE
+static void mem_ops_async_irq_handler(void) {
+    for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+        mem_async_op_t *op = channel_ops[channel];
+        if (op && dma_irqn_get_channel_status(PICO_MEM_OPS_ASYNC_DMA_IRQ, channel)) {
+            dma_irqn_acknowledge_channel(PICO_MEM_OPS_ASYNC_DMA_IRQ, channel);
+            finish_op(op);
+        }
+    }
+}
+
+static void install_irq_handler(void) {
+    static bool installed;
+    uint32_t save = hw_claim_lock();
+    if (!installed) {
+        uint irq_num = DMA_IRQ_0 + PICO_MEM_OPS_ASYNC_DMA_IRQ;
+        irq_add_shared_handler(irq_num, mem_ops_async_irq_handler, PICO_MEM_OPS_ASYNC_IRQ_ORDER_PRIORITY);
+        irq_set_enabled(irq_num, true);
+        installed = true;
+    }
+    hw_claim_unlock(save);
+}
+#endif
+
+static bool start_op(mem_async_op_t *op, void *dest, const void *src, bool is_fill, size_t n,
+                     mem_async_callback_t callback, void *param) {
+    op->callback = callback;
+    op->param = param;
+    op->channel = -1;
+    op->done = false;
+    int channel = n ? dma_claim_unused_channel(false) : -1;
+    if (channel < 0) {
+        if (is_fill) {
+            memset(dest, (int)(op->fill & 0xffu), n);
+        } else {
+            memcpy(dest, src, n);
+        }
+        finish_op(op);
+        return false;
+    }
+    op->channel = (int8_t)channel;
+    channel_ops[channel] = op;
+#if !PICO_NO_HARDWARE
+    install_irq_handler();
+    dma_irqn_acknowledge_channel(PICO_MEM_OPS_ASYNC_DMA_IRQ, (uint)channel);
+    dma_irqn_set_channel_enabled(PICO_MEM_OPS_ASYNC_DMA_IRQ, (uint)channel, true);
+#endif
+    if (!__mem_ops_dma_start((uint)channel, dest, src, is_fill ? &op->fill : NULL, n)) {
+        // too small for any DMA transfers, so no IRQ will fire
+        finish_op(op);
+        return false;
+    }
+    return true;
+}
+
+bool memcpy_async(mem_async_op_t *op, void *dest, const void *src, size_t n, mem_async_callback_t callback,
+                  void *param) {
+    op->fill = 0;
+    return start_op(op, dest, src, false, n, callback, param);
+}
+
+bool memset_async(mem_async_op_t *op, void *dest, int c, size_t n, mem_async_callback_t callback, void *param) {
+    op->fill = (uint8_t)c * 0x01010101u;
+    return start_op(op, dest, NULL, true, n, callback, param);
+}
+
+bool mem_async_is_done(mem_async_op_t *op) {
+#if PICO_NO_HARDWARE
+    // no interrupts on the host, so completion is noticed here
+    if (!op->done && op->channel >= 0 && !dma_channel_is_busy((uint)op->channel)) {
+        finish_op(op);
+    }
+#endif
+    return op->done;
+}
+
+void mem_async_wait(mem_async_op_t *op) {
+    while (!mem_async_is_done(op)) tight_loop_contents();
+}
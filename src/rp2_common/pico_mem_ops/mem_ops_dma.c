@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pico/mem_ops.h"
+#include "pico/mem_ops_async.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+
+// Called by the memcpy/memset wrappers in mem_ops_aeabi.S for calls of at least PICO_MEM_OPS_DMA_THRESHOLD bytes
+
+typedef void *(*memcpy_func_t)(void *, const void *, size_t);
+typedef void *(*memset_func_t)(void *, int, size_t);
+
+// the bootrom function table from mem_ops_aeabi.S (memset, memcpy, memset4, memcpy4)
+extern void *aeabi_mem_funcs[];
+
+#define MEMSET_INDEX 0
+#define MEMCPY_INDEX 1
+
+// each core's channel, claimed on first use, and shared by everything running on that core
+typedef struct {
+    int8_t channel;     // -1 if none was available
+    bool claimed;
+    bool busy;          // in use by a transfer, which a task switch (or IRQ) may have interrupted
+} core_channel_t;
+
+static core_channel_t core_channels[NUM_CORES];
+
+// returns the core's channel, marked busy until release_channel(), or NULL if the bootrom should be used instead
+static core_channel_t *acquire_channel(void) {
+    // calls from IRQ handlers would hold up the interrupted code for the whole transfer
+    if (__get_current_exception()) return NULL;
+    uint32_t save = save_and_disable_interrupts();
+    core_channel_t *core = &core_channels[get_core_num()];
+    if (!core->claimed) {
+        core->channel = (int8_t)dma_claim_unused_channel(false);
+        core->claimed = true;
+    }
+    if (core->channel < 0 || core->busy) {
+        core = NULL;
+    } else {
+        core->busy = true;
+    }
+    restore_interrupts(save);
+    return core;
+}
+
+static void release_channel(core_channel_t *core) {
+    core->busy = false;
+}
+
+void *__mem_ops_dma_memcpy(void *dest, const void *src, size_t n) {
+    core_channel_t *core = acquire_channel();
+    if (!core) return ((memcpy_func_t)aeabi_mem_funcs[MEMCPY_INDEX])(dest, src, n);
+    uint channel = (uint)core->channel;
+    if (__mem_ops_dma_start(channel, dest, src, NULL, n)) {
+        dma_channel_wait_for_finish_blocking(channel);
+    }
+    release_channel(core);
+    return dest;
+}
+
+void *__mem_ops_dma_memset(void *dest, int c, size_t n) {
+    core_channel_t *core = acquire_channel();
+    if (!core) return ((memset_func_t)aeabi_mem_funcs[MEMSET_INDEX])(dest, c, n);
+    uint channel = (uint)core->channel;
+    uint32_t fill = (uint8_t)c * 0x01010101u;
+    if (__mem_ops_dma_start(channel, dest, NULL, &fill, n)) {
+        dma_channel_wait_for_finish_blocking(channel);
+    }
+    release_channel(core);
+    return dest;
+}
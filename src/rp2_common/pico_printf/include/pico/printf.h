@@ -79,6 +79,17 @@ bool weak_raw_vprintf(const char *fmt, va_list args);
  */
 int vfctprintf(void (*out)(char character, void *arg), void *arg, const char *format, va_list va);
 
+/**
+ * printf with span output function
+ * Like vfctprintf(), but the output function is passed runs of characters (e.g. each literal part of the format,
+ * or each converted argument) rather than a character at a time
+ * \param out An output function which takes a pointer to some characters, their count, and an argument pointer
+ * \param arg An argument pointer for user data passed to output function
+ * \param format A string that specifies the format of the output
+ * \return The number of characters that are sent to the output function, not counting the terminating null character
+ */
+int vfctprintf_span(void (*out)(const char *s, size_t len, void *arg), void *arg, const char *format, va_list va);
+
 #else
 
 #define weak_raw_printf(...) ({printf(__VA_ARGS__); true;})
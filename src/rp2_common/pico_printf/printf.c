@@ -33,20 +33,21 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "pico.h"
 #include "pico/printf.h"
 
 // PICO_CONFIG: PICO_PRINTF_NTOA_BUFFER_SIZE, Define printf ntoa buffer size, min=0, max=128, default=32, group=pico_printf
-// 'ntoa' conversion buffer size, this must be big enough to hold one converted
-// numeric number including padded zeros (dynamically created on stack)
+// 'ntoa' conversion buffer size, this must be big enough to hold the digits of one converted
+// number (dynamically created on stack); padding is output directly so is not limited by it
 #ifndef PICO_PRINTF_NTOA_BUFFER_SIZE
 #define PICO_PRINTF_NTOA_BUFFER_SIZE    32U
 #endif
 
-// PICO_CONFIG: PICO_PRINTF_FTOA_BUFFER_SIZE, Define printf ftoa buffer size, min=0, max=128, default=32, group=pico_printf
-// 'ftoa' conversion buffer size, this must be big enough to hold one converted
-// float number including padded zeros (dynamically created on stack)
+// PICO_CONFIG: PICO_PRINTF_FTOA_BUFFER_SIZE, Define printf ftoa buffer size, min=1, max=128, default=32, group=pico_printf
+// 'ftoa' conversion buffer size (dynamically created on stack); floating point numbers with more
+// significant digits than this are still printed in full, but their digits are generated twice
 #ifndef PICO_PRINTF_FTOA_BUFFER_SIZE
 #define PICO_PRINTF_FTOA_BUFFER_SIZE    32U
 #endif
@@ -68,10 +69,7 @@
 #define PICO_PRINTF_DEFAULT_FLOAT_PRECISION  6U
 #endif
 
-// PICO_CONFIG: PICO_PRINTF_MAX_FLOAT, Define the largest float suitable to print with %f, min=1, max=1e9, default=1e9, group=pico_printf
-#ifndef PICO_PRINTF_MAX_FLOAT
-#define PICO_PRINTF_MAX_FLOAT  1e9
-#endif
+// PICO_CONFIG: PICO_PRINTF_MAX_FLOAT, Define the largest float to print with %f; larger values are printed with %e. By default all values are printed in full with %f, min=1, default=none, group=pico_printf
 
 // PICO_CONFIG: PICO_PRINTF_SUPPORT_LONG_LONG, Enable support for long long types (%llu or %p), type=bool, default=1, group=pico_printf
 #ifndef PICO_PRINTF_SUPPORT_LONG_LONG
@@ -100,13 +98,6 @@
 #define FLAGS_PRECISION (1U << 10U)
 #define FLAGS_ADAPT_EXP (1U << 11U)
 
-// import float.h for DBL_MAX
-#if PICO_PRINTF_SUPPORT_FLOAT
-
-#include <float.h>
-
-#endif
-
 /**
  * Output a character to a custom device like UART, used by the printf() function
  * This function is declared here only. You have to write your custom implementation somewhere
@@ -133,6 +124,12 @@ typedef struct {
     void *arg;
 } out_fct_wrap_type;
 
+// wrapper (used as buffer) for span output function type
+typedef struct {
+    void (*fct)(const char *s, size_t len, void *arg);
+    void *arg;
+} out_span_fct_wrap_type;
+
 // internal buffer output
 static inline void _out_buffer(char character, void *buffer, size_t idx, size_t maxlen) {
     if (idx < maxlen) {
@@ -170,6 +167,18 @@ static inline void _out_fct(char character, void *buffer, size_t idx, size_t max
 }
 
 
+// internal span output function wrapper; runs of characters are passed straight to the wrapped function by
+// _out_span and _out_fill, so this only sees the odd single character
+static inline void _out_span_fct(char character, void *buffer, size_t idx, size_t maxlen) {
+    (void) idx;
+    (void) maxlen;
+    if (character) {
+        // buffer is the span output fct pointer
+        ((out_span_fct_wrap_type *) buffer)->fct(&character, 1U, ((out_span_fct_wrap_type *) buffer)->arg);
+    }
+}
+
+
 // internal secure strlen
 // \return The length of the string (excluding the terminating 0) limited by 'maxsize'
 static inline unsigned int _strnlen_s(const char *str, size_t maxsize) {
@@ -196,82 +205,174 @@ static unsigned int _atoi(const char **str) {
 }
 
 
-// output the specified string in reverse, taking care of any zero-padding
-static size_t _out_rev(out_fct_type out, char *buffer, size_t idx, size_t maxlen, const char *buf, size_t len,
-                       unsigned int width, unsigned int flags) {
-    const size_t start_idx = idx;
-
-    // pad spaces up to given width
-    if (!(flags & FLAGS_LEFT) && !(flags & FLAGS_ZEROPAD)) {
-        for (size_t i = len; i < width; i++) {
-            out(' ', buffer, idx++, maxlen);
+// output a run of characters; output to a buffer or span output function is done in bulk rather than a character
+// at a time
+static size_t _out_span(out_fct_type out, char *buffer, size_t idx, size_t maxlen, const char *s, size_t len) {
+    if (out == _out_buffer) {
+        if (idx < maxlen) {
+            memcpy(buffer + idx, s, len < maxlen - idx ? len : maxlen - idx);
+        }
+    } else if (out == _out_span_fct) {
+        if (len) {
+            ((out_span_fct_wrap_type *) buffer)->fct(s, len, ((out_span_fct_wrap_type *) buffer)->arg);
+        }
+    } else if (out != _out_null) {
+        for (size_t i = 0; i < len; i++) {
+            out(s[i], buffer, idx + i, maxlen);
         }
     }
+    return idx + len;
+}
 
-    // reverse string
-    while (len) {
-        out(buf[--len], buffer, idx++, maxlen);
-    }
 
-    // append pad spaces up to given width
-    if (flags & FLAGS_LEFT) {
-        while (idx - start_idx < width) {
-            out(' ', buffer, idx++, maxlen);
+// output a character repeatedly
+static size_t _out_fill(out_fct_type out, char *buffer, size_t idx, size_t maxlen, char character, size_t count) {
+    if (out == _out_buffer) {
+        if (idx < maxlen) {
+            memset(buffer + idx, character, count < maxlen - idx ? count : maxlen - idx);
+        }
+    } else if (out == _out_span_fct) {
+        char chunk[16];
+        memset(chunk, character, count < sizeof(chunk) ? count : sizeof(chunk));
+        for (size_t done = 0; done < count; done += sizeof(chunk)) {
+            _out_span(out, buffer, idx + done, maxlen, chunk, count - done < sizeof(chunk) ? count - done : sizeof(chunk));
+        }
+    } else if (out != _out_null) {
+        for (size_t i = 0; i < count; i++) {
+            out(character, buffer, idx + i, maxlen);
         }
     }
+    return idx + count;
+}
+
 
+// output the specified string, padded with spaces to the given width
+static size_t _out_padded(out_fct_type out, char *buffer, size_t idx, size_t maxlen, const char *s, size_t len,
+                          unsigned int width, unsigned int flags) {
+    const size_t pad = len < width ? width - len : 0U;
+    if (!(flags & FLAGS_LEFT)) {
+        idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
+    }
+    idx = _out_span(out, buffer, idx, maxlen, s, len);
+    if (flags & FLAGS_LEFT) {
+        idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
+    }
     return idx;
 }
 
 
+static const char _digit_pairs[200] = {
+        '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+        '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+        '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+        '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+        '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+        '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+        '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+        '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+        '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+        '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9',
+};
+
+
+// write the decimal digits of value backwards, two at a time, ending at p
+// \return The first digit
+static char *_utoa10(char *p, uint32_t value) {
+    while (value >= 100U) {
+        const uint32_t q = value / 100U;
+        p -= 2;
+        memcpy(p, &_digit_pairs[2U * (value - q * 100U)], 2);
+        value = q;
+    }
+    if (value >= 10U) {
+        p -= 2;
+        memcpy(p, &_digit_pairs[2U * value], 2);
+    } else {
+        *--p = (char) ('0' + value);
+    }
+    return p;
+}
+
+
+// write the digits of value in base 2, 8, 10 or 16 backwards, ending at p
+// \return The first digit
+static char *_utoa(char *p, unsigned long long value, unsigned int base, unsigned int flags) {
+    const char *digits = (flags & FLAGS_UPPERCASE) ? "0123456789ABCDEF" : "0123456789abcdef";
+    const unsigned int shift = base == 16U ? 4U : (base == 8U ? 3U : 1U);
+    // only use 64 bit arithmetic while the value needs it
+    while (value > UINT32_MAX) {
+        if (base == 10U) {
+            // one 64 bit division per eight digits
+            const unsigned long long q = value / 100000000U;
+            char *end = p - 8;
+            p = _utoa10(p, (uint32_t) (value - q * 100000000U));
+            while (p > end) {
+                *--p = '0';
+            }
+            value = q;
+        } else {
+            *--p = digits[value & (base - 1U)];
+            value >>= shift;
+        }
+    }
+    uint32_t v = (uint32_t) value;
+    if (base == 10U) {
+        return _utoa10(p, v);
+    }
+    do {
+        *--p = digits[v & (base - 1U)];
+        v >>= shift;
+    } while (v);
+    return p;
+}
+
+
 // internal itoa format
-static size_t _ntoa_format(out_fct_type out, char *buffer, size_t idx, size_t maxlen, char *buf, size_t len,
+static size_t _ntoa_format(out_fct_type out, char *buffer, size_t idx, size_t maxlen, const char *digits, size_t len,
                            bool negative, unsigned int base, unsigned int prec, unsigned int width,
                            unsigned int flags) {
-    // pad leading zeros
-    if (!(flags & FLAGS_LEFT)) {
-        if (width && (flags & FLAGS_ZEROPAD) && (negative || (flags & (FLAGS_PLUS | FLAGS_SPACE)))) {
-            width--;
-        }
-        while ((len < prec) && (len < PICO_PRINTF_NTOA_BUFFER_SIZE)) {
-            buf[len++] = '0';
-        }
-        while ((flags & FLAGS_ZEROPAD) && (len < width) && (len < PICO_PRINTF_NTOA_BUFFER_SIZE)) {
-            buf[len++] = '0';
-        }
+    char prefix[3];
+    size_t prefix_len = 0U;
+    if (negative) {
+        prefix[prefix_len++] = '-';
+    } else if (flags & FLAGS_PLUS) {
+        prefix[prefix_len++] = '+';  // ignore the space if the '+' exists
+    } else if (flags & FLAGS_SPACE) {
+        prefix[prefix_len++] = ' ';
     }
 
+    size_t zeros = prec > len ? prec - len : 0U;
+
     // handle hash
     if (flags & FLAGS_HASH) {
-        if (!(flags & FLAGS_PRECISION) && len && ((len == prec) || (len == width))) {
-            len--;
-            if (len && (base == 16U)) {
-                len--;
+        if (base == 8U) {
+            // the number must start with a 0
+            if (!zeros && (!len || digits[0] != '0')) {
+                zeros = 1U;
             }
-        }
-        if ((base == 16U) && !(flags & FLAGS_UPPERCASE) && (len < PICO_PRINTF_NTOA_BUFFER_SIZE)) {
-            buf[len++] = 'x';
-        } else if ((base == 16U) && (flags & FLAGS_UPPERCASE) && (len < PICO_PRINTF_NTOA_BUFFER_SIZE)) {
-            buf[len++] = 'X';
-        } else if ((base == 2U) && (len < PICO_PRINTF_NTOA_BUFFER_SIZE)) {
-            buf[len++] = 'b';
-        }
-        if (len < PICO_PRINTF_NTOA_BUFFER_SIZE) {
-            buf[len++] = '0';
+        } else if (base == 16U || base == 2U) {
+            prefix[prefix_len++] = '0';
+            prefix[prefix_len++] = base == 2U ? 'b' : ((flags & FLAGS_UPPERCASE) ? 'X' : 'x');
         }
     }
 
-    if (len < PICO_PRINTF_NTOA_BUFFER_SIZE) {
-        if (negative) {
-            buf[len++] = '-';
-        } else if (flags & FLAGS_PLUS) {
-            buf[len++] = '+';  // ignore the space if the '+' exists
-        } else if (flags & FLAGS_SPACE) {
-            buf[len++] = ' ';
-        }
+    // pad leading zeros
+    if ((flags & FLAGS_ZEROPAD) && !(flags & FLAGS_LEFT) && (prefix_len + zeros + len < width)) {
+        zeros = width - prefix_len - len;
     }
 
-    return _out_rev(out, buffer, idx, maxlen, buf, len, width, flags);
+    const size_t total = prefix_len + zeros + len;
+    const size_t pad = total < width ? width - total : 0U;
+    if (!(flags & FLAGS_LEFT)) {
+        idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
+    }
+    idx = _out_span(out, buffer, idx, maxlen, prefix, prefix_len);
+    idx = _out_fill(out, buffer, idx, maxlen, '0', zeros);
+    idx = _out_span(out, buffer, idx, maxlen, digits, len);
+    if (flags & FLAGS_LEFT) {
+        idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
+    }
+    return idx;
 }
 
 
@@ -279,23 +380,21 @@ static size_t _ntoa_format(out_fct_type out, char *buffer, size_t idx, size_t ma
 static size_t _ntoa_long(out_fct_type out, char *buffer, size_t idx, size_t maxlen, unsigned long value, bool negative,
                          unsigned long base, unsigned int prec, unsigned int width, unsigned int flags) {
     char buf[PICO_PRINTF_NTOA_BUFFER_SIZE];
-    size_t len = 0U;
+    char *const end = buf + PICO_PRINTF_NTOA_BUFFER_SIZE;
+    char *p = end;
 
-    // no hash for 0 values
-    if (!value) {
+    // no hash for 0 values (except octal where the hash just asks for a leading 0)
+    if (!value && base != 8U) {
         flags &= ~FLAGS_HASH;
     }
 
     // write if precision != 0 and value is != 0
     if (!(flags & FLAGS_PRECISION) || value) {
-        do {
-            const char digit = (char) (value % base);
-            buf[len++] = (char)(digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10);
-            value /= base;
-        } while (value && (len < PICO_PRINTF_NTOA_BUFFER_SIZE));
+        p = _utoa(end, value, (unsigned int) base, flags);
     }
 
-    return _ntoa_format(out, buffer, idx, maxlen, buf, len, negative, (unsigned int) base, prec, width, flags);
+    return _ntoa_format(out, buffer, idx, maxlen, p, (size_t) (end - p), negative, (unsigned int) base, prec, width,
+                        flags);
 }
 
 
@@ -306,23 +405,21 @@ static size_t _ntoa_long_long(out_fct_type out, char *buffer, size_t idx, size_t
                               bool negative, unsigned long long base, unsigned int prec, unsigned int width,
                               unsigned int flags) {
     char buf[PICO_PRINTF_NTOA_BUFFER_SIZE];
-    size_t len = 0U;
+    char *const end = buf + PICO_PRINTF_NTOA_BUFFER_SIZE;
+    char *p = end;
 
-    // no hash for 0 values
-    if (!value) {
+    // no hash for 0 values (except octal where the hash just asks for a leading 0)
+    if (!value && base != 8U) {
         flags &= ~FLAGS_HASH;
     }
 
     // write if precision != 0 and value is != 0
     if (!(flags & FLAGS_PRECISION) || value) {
-        do {
-            const char digit = (char) (value % base);
-            buf[len++] = (char)(digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10);
-            value /= base;
-        } while (value && (len < PICO_PRINTF_NTOA_BUFFER_SIZE));
+        p = _utoa(end, value, (unsigned int) base, flags);
     }
 
-    return _ntoa_format(out, buffer, idx, maxlen, buf, len, negative, (unsigned int) base, prec, width, flags);
+    return _ntoa_format(out, buffer, idx, maxlen, p, (size_t) (end - p), negative, (unsigned int) base, prec, width,
+                        flags);
 }
 
 #endif  // PICO_PRINTF_SUPPORT_LONG_LONG
@@ -330,251 +427,430 @@ static size_t _ntoa_long_long(out_fct_type out, char *buffer, size_t idx, size_t
 
 #if PICO_PRINTF_SUPPORT_FLOAT
 
-#if PICO_PRINTF_SUPPORT_EXPONENTIAL
-// forward declaration so that _ftoa can switch to exp notation for values > PICO_PRINTF_MAX_FLOAT
-static size_t _etoa(out_fct_type out, char *buffer, size_t idx, size_t maxlen, double value, unsigned int prec,
-                    unsigned int width, unsigned int flags);
-#endif
+// Floating point numbers are printed exactly (i.e. as glibc does, with correct round-half-even rounding at any
+// precision, and all the digits of large numbers), from the exact decimal expansion of the double, which is produced a
+// chunk of digits at a time, integer part first. Nearly all values are handled with 64 bit integer arithmetic; only
+// numbers >= 2^64 or with a fraction of more than 57 bits use a small bignum.
 
-#define is_nan __builtin_isnan
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_EXPONENT_MASK 0x7ffU
+#define DOUBLE_EXPONENT_BIAS 1075 // including the mantissa bits
+#define DTOA_FAST_FRACTION_BITS 57 // the fraction can be multiplied by 100 in 64 bits
+#define DTOA_BIG_WORDS 36 // enough for the 35 base 1e9 words of DBL_MAX, or the 34 binary fraction words of DBL_TRUE_MIN
 
-// internal ftoa for fixed decimal floating point
-static size_t _ftoa(out_fct_type out, char *buffer, size_t idx, size_t maxlen, double value, unsigned int prec,
-                    unsigned int width, unsigned int flags) {
-    char buf[PICO_PRINTF_FTOA_BUFFER_SIZE];
-    size_t len = 0U;
-    double diff = 0.0;
-
-    // powers of 10
-    static const double pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
-
-    // test for special values
-    if (is_nan(value))
-        return _out_rev(out, buffer, idx, maxlen, "nan", 3, width, flags);
-    if (value < -DBL_MAX)
-        return _out_rev(out, buffer, idx, maxlen, "fni-", 4, width, flags);
-    if (value > DBL_MAX)
-        return _out_rev(out, buffer, idx, maxlen, (flags & FLAGS_PLUS) ? "fni+" : "fni", (flags & FLAGS_PLUS) ? 4U : 3U,
-                        width, flags);
-
-    // test for very large values
-    // standard printf behavior is to print EVERY whole number digit -- which could be 100s of characters overflowing your buffers == bad
-    if ((value > PICO_PRINTF_MAX_FLOAT) || (value < -PICO_PRINTF_MAX_FLOAT)) {
-#if PICO_PRINTF_SUPPORT_EXPONENTIAL
-        return _etoa(out, buffer, idx, maxlen, value, prec, width, flags);
-#else
-        return 0U;
-#endif
+typedef struct {
+    uint64_t ip;                    // the integer part, if it fits in 64 bits
+    uint64_t fp;                    // the fraction, as fp / 2^fp_bits, if fp_bits <= DTOA_FAST_FRACTION_BITS
+    uint32_t big[DTOA_BIG_WORDS];   // otherwise the integer part in base 1e9, or the fraction as big / 2^(32 * big_len)
+    int big_len;                    // number of words in big, or 0 if it is not used
+    int big_pos;                    // next integer word to output, or lowest non zero fraction word
+    unsigned int fp_bits;
+    bool big_int;
+    int int_digits;                 // number of digits in the integer part, 0 if it is zero
+    char chunk[20];
+    unsigned int chunk_pos;
+    unsigned int chunk_end;
+} _dgen_t;
+
+// start the decimal expansion of the non-negative finite double with the given bits
+static void _dgen_init(_dgen_t *g, uint64_t bits) {
+    const int biased = (int) (bits >> DOUBLE_MANTISSA_BITS);
+    uint64_t m = bits & ((1ULL << DOUBLE_MANTISSA_BITS) - 1U);
+    int e2 = 1 - DOUBLE_EXPONENT_BIAS;
+    if (biased) {
+        m |= 1ULL << DOUBLE_MANTISSA_BITS;
+        e2 = biased - DOUBLE_EXPONENT_BIAS;
     }
-
-    // test for negative
-    bool negative = false;
-    if (value < 0) {
-        negative = true;
-        value = 0 - value;
+    g->ip = 0U;
+    g->fp = 0U;
+    g->fp_bits = 0U;
+    g->big_len = 0;
+    g->big_int = false;
+    g->int_digits = 0;
+    g->chunk_pos = g->chunk_end = sizeof(g->chunk);
+    if (e2 > 64 - 1 - DOUBLE_MANTISSA_BITS) {
+        // m * 2^e2 in base 1e9, multiplying by up to 2^29 at a time
+        g->big_int = true;
+        g->big[0] = (uint32_t) (m % 1000000000U);
+        m /= 1000000000U;
+        g->big[1] = (uint32_t) m;
+        g->big_len = m ? 2 : 1;
+        while (e2) {
+            const int shift = e2 > 29 ? 29 : e2;
+            uint32_t carry = 0U;
+            for (int i = 0; i < g->big_len; i++) {
+                const uint64_t t = ((uint64_t) g->big[i] << shift) + carry;
+                carry = (uint32_t) (t / 1000000000U);
+                g->big[i] = (uint32_t) (t - (uint64_t) carry * 1000000000U);
+            }
+            if (carry) {
+                g->big[g->big_len++] = carry;
+            }
+            e2 -= shift;
+        }
+        g->big_pos = g->big_len - 1;
+        g->int_digits = 9 * g->big_pos;
+        for (uint32_t top = g->big[g->big_pos]; top; top /= 10U) {
+            g->int_digits++;
+        }
+    } else if (e2 >= 0) {
+        g->ip = m << e2;
+    } else {
+        const unsigned int s = (unsigned int) -e2;
+        if (s < 64U) {
+            g->ip = m >> s;
+            m &= (1ULL << s) - 1U;
+        }
+        if (s <= DTOA_FAST_FRACTION_BITS) {
+            g->fp = m;
+            g->fp_bits = s;
+        } else {
+            // the fraction (< 1, so < 2^s) is m << shift as a big number of n words
+            const int n = (int) (s + 31U) / 32;
+            const unsigned int shift = 32U * (unsigned int) n - s;
+            const uint64_t lo = m << shift;
+            memset(g->big, 0, sizeof(g->big[0]) * (size_t) n);
+            g->big[0] = (uint32_t) lo;
+            g->big[1] = (uint32_t) (lo >> 32U);
+            if (n > 2) {
+                g->big[2] = shift ? (uint32_t) (m >> (64U - shift)) : 0U;
+            }
+            g->big_len = n;
+            g->big_pos = 0;
+            while (!g->big[g->big_pos]) {
+                g->big_pos++;
+            }
+        }
+    }
+    if (g->ip) {
+        char *p = _utoa(g->chunk + sizeof(g->chunk), g->ip, 10U, 0U);
+        g->chunk_pos = (unsigned int) (p - g->chunk);
+        g->int_digits = (int) (sizeof(g->chunk) - g->chunk_pos);
     }
+}
 
-    // set default precision, if not set explicitly
-    if (!(flags & FLAGS_PRECISION)) {
-        prec = PICO_PRINTF_DEFAULT_FLOAT_PRECISION;
+// produce the next chunk of digits
+static void _dgen_refill(_dgen_t *g) {
+    char *const end = g->chunk + sizeof(g->chunk);
+    char *p = end;
+    g->chunk_end = sizeof(g->chunk);
+    if (g->big_int) {
+        if (g->big_pos >= 0) {
+            p = _utoa10(end, g->big[g->big_pos]);
+            if (g->big_pos != g->big_len - 1) {
+                while (p > end - 9) {
+                    *--p = '0';
+                }
+            }
+            g->big_pos--;
+        }
+    } else if (g->big_len) {
+        if (g->big_pos < g->big_len) {
+            // the next nine digits are the integer part of the fraction * 1e9
+            uint32_t carry = 0U;
+            for (int i = g->big_pos; i < g->big_len; i++) {
+                const uint64_t t = (uint64_t) g->big[i] * 1000000000U + carry;
+                g->big[i] = (uint32_t) t;
+                carry = (uint32_t) (t >> 32U);
+            }
+            while (g->big_pos < g->big_len && !g->big[g->big_pos]) {
+                g->big_pos++;
+            }
+            p = _utoa10(end, carry);
+            while (p > end - 9) {
+                *--p = '0';
+            }
+        }
+    } else if (g->fp) {
+        // two digits at a time, written forwards
+        const uint64_t mask = (1ULL << g->fp_bits) - 1U;
+        unsigned int n = 0U;
+        do {
+            g->fp *= 100U;
+            memcpy(g->chunk + n, &_digit_pairs[2U * (unsigned int) (g->fp >> g->fp_bits)], 2);
+            g->fp &= mask;
+            n += 2U;
+        } while (g->fp && n < 16U);
+        g->chunk_pos = 0U;
+        g->chunk_end = n;
+        return;
+    }
+    if (p == end) {
+        // the expansion has ended
+        memset(g->chunk, '0', sizeof(g->chunk));
+        p = g->chunk;
     }
-    // limit precision to 9, cause a prec >= 10 can lead to overflow errors
-    while ((len < PICO_PRINTF_FTOA_BUFFER_SIZE) && (prec > 9U)) {
-        buf[len++] = '0';
-        prec--;
+    g->chunk_pos = (unsigned int) (p - g->chunk);
+}
+
+static inline char _dgen_peek(_dgen_t *g) {
+    if (g->chunk_pos == g->chunk_end) {
+        _dgen_refill(g);
     }
+    return g->chunk[g->chunk_pos];
+}
 
-    int whole = (int) value;
-    double tmp = (value - whole) * pow10[prec];
-    unsigned long frac = (unsigned long) tmp;
-    diff = tmp - frac;
+static inline char _dgen_next(_dgen_t *g) {
+    const char c = _dgen_peek(g);
+    g->chunk_pos++;
+    return c;
+}
 
-    if (diff > 0.5) {
-        ++frac;
-        // handle rollover, e.g. case 0.99 with prec 1 is 1.0
-        if (frac >= pow10[prec]) {
-            frac = 0;
-            ++whole;
+// \return true if any of the digits not yet produced are non zero
+static bool _dgen_sticky(const _dgen_t *g) {
+    for (unsigned int i = g->chunk_pos; i < g->chunk_end; i++) {
+        if (g->chunk[i] != '0') {
+            return true;
         }
-    } else if (diff < 0.5) {
-    } else if ((frac == 0U) || (frac & 1U)) {
-        // if halfway, round up if odd OR if last digit is 0
-        ++frac;
     }
-
-    if (prec == 0U) {
-        diff = value - (double) whole;
-        if (!((diff < 0.5) || (diff > 0.5)) && (whole & 1)) {
-            // exactly 0.5 and ODD, then round up
-            // 1.5 -> 2, but 2.5 -> 2
-            ++whole;
+    if (g->big_int) {
+        for (int i = 0; i <= g->big_pos; i++) {
+            if (g->big[i]) {
+                return true;
+            }
         }
+        return false;
+    }
+    if (g->big_len) {
+        return g->big_pos < g->big_len;
+    }
+    return g->fp != 0U;
+}
+
+// the digits of a double, rounded to a number of decimal places (fixed) or significant digits (exponential)
+typedef struct {
+    _dgen_t g;
+    char buf[PICO_PRINTF_FTOA_BUFFER_SIZE]; // the rounded digits, if they fit
+    int count;          // number of digits
+    int skip;           // leading zeros in the expansion before the first digit
+    int exp10;          // decimal exponent of the first digit
+    int last_nz;        // index of the last non zero digit, or -1
+    int round_pos;      // index of the digit which was rounded up, or -1
+    bool carry_out;     // the digits were rounded up to 1 followed by zeros
+} _dtoa_t;
+
+static void _dtoa_round(_dtoa_t *d, uint64_t bits, bool fixed, unsigned int prec) {
+    _dgen_t *g = &d->g;
+    _dgen_init(g, bits);
+    d->skip = 0;
+    if (g->int_digits) {
+        d->exp10 = g->int_digits - 1;
+    } else if (fixed || !bits) {
+        d->exp10 = 0;
     } else {
-        unsigned int count = prec;
-        // now do fractional part, as an unsigned number
-        while (len < PICO_PRINTF_FTOA_BUFFER_SIZE) {
-            --count;
-            buf[len++] = (char) (48U + (frac % 10U));
-            if (!(frac /= 10U)) {
-                break;
-            }
+        while (_dgen_peek(g) == '0') {
+            g->chunk_pos++;
+            d->skip++;
         }
-        // add extra 0s
-        while ((len < PICO_PRINTF_FTOA_BUFFER_SIZE) && (count-- > 0U)) {
-            buf[len++] = '0';
+        d->exp10 = -d->skip - 1;
+    }
+    d->count = (int) prec + (fixed ? g->int_digits : 1);
+
+    int last_non9 = -1;
+    char last = '0';
+    d->last_nz = -1;
+    for (int i = 0; i < d->count; i++) {
+        last = _dgen_next(g);
+        if (i < (int) sizeof(d->buf)) {
+            d->buf[i] = last;
         }
-        if (len < PICO_PRINTF_FTOA_BUFFER_SIZE) {
-            // add decimal
-            buf[len++] = '.';
+        if (last != '9') {
+            last_non9 = i;
         }
-    }
-
-    // do whole part, number is reversed
-    while (len < PICO_PRINTF_FTOA_BUFFER_SIZE) {
-        buf[len++] = (char) (48 + (whole % 10));
-        if (!(whole /= 10)) {
-            break;
+        if (last != '0') {
+            d->last_nz = i;
         }
     }
 
-    // pad leading zeros
-    if (!(flags & FLAGS_LEFT) && (flags & FLAGS_ZEROPAD)) {
-        if (width && (negative || (flags & (FLAGS_PLUS | FLAGS_SPACE)))) {
-            width--;
+    // round half to even, looking at the next digit, and whether there are any non zero digits after it
+    const char next = _dgen_next(g);
+    d->round_pos = -1;
+    d->carry_out = false;
+    if ((next > '5') || ((next == '5') && (((last - '0') & 1) || _dgen_sticky(g)))) {
+        int from;
+        if (last_non9 >= 0) {
+            d->round_pos = last_non9;
+            if (last_non9 < (int) sizeof(d->buf)) {
+                d->buf[last_non9]++;
+            }
+            from = last_non9 + 1;
+        } else {
+            // e.g. 9.99 -> 10.0
+            d->carry_out = true;
+            d->exp10++;
+            if (fixed) {
+                d->count++;
+            }
+            d->buf[0] = '1';
+            from = 1;
         }
-        while ((len < width) && (len < PICO_PRINTF_FTOA_BUFFER_SIZE)) {
-            buf[len++] = '0';
+        for (int i = from; i < d->count && i < (int) sizeof(d->buf); i++) {
+            d->buf[i] = '0';
         }
+        d->last_nz = from - 1;
     }
+}
 
-    if (len < PICO_PRINTF_FTOA_BUFFER_SIZE) {
-        if (negative) {
-            buf[len++] = '-';
-        } else if (flags & FLAGS_PLUS) {
-            buf[len++] = '+';  // ignore the space if the '+' exists
-        } else if (flags & FLAGS_SPACE) {
-            buf[len++] = ' ';
+// output digits [from, to) of the rounded result; the digits are output in order, so a later call must follow on
+static size_t _dtoa_digits(out_fct_type out, char *buffer, size_t idx, size_t maxlen, _dtoa_t *d, int from, int to) {
+    if (d->count <= (int) sizeof(d->buf)) {
+        return _out_span(out, buffer, idx, maxlen, d->buf + from, (size_t) (to - from));
+    }
+    // there were too many digits to store, so generate them again
+    char tmp[16];
+    unsigned int n = 0U;
+    for (int i = from; i < to; i++) {
+        char c;
+        if (d->carry_out) {
+            c = i ? '0' : '1';
+        } else {
+            c = _dgen_next(&d->g);
+            if ((d->round_pos >= 0) && (i >= d->round_pos)) {
+                c = i == d->round_pos ? (char) (c + 1) : '0';
+            }
+        }
+        tmp[n++] = c;
+        if (n == sizeof(tmp)) {
+            idx = _out_span(out, buffer, idx, maxlen, tmp, n);
+            n = 0U;
         }
     }
-
-    return _out_rev(out, buffer, idx, maxlen, buf, len, width, flags);
+    return _out_span(out, buffer, idx, maxlen, tmp, n);
 }
 
+// internal dtoa for fixed (%f), exponential (%e) and with FLAGS_ADAPT_EXP general (%g) floating point
+static size_t _dtoa(out_fct_type out, char *buffer, size_t idx, size_t maxlen, double value, unsigned int prec,
+                    unsigned int width, unsigned int flags, bool exponential) {
+    union {
+        uint64_t U;
+        double F;
+    } conv;
+    conv.F = value;
 
-#if PICO_PRINTF_SUPPORT_EXPONENTIAL
-
-// internal ftoa variant for exponential floating-point type, contributed by Martijn Jasperse <m.jasperse@gmail.com>
-static size_t _etoa(out_fct_type out, char *buffer, size_t idx, size_t maxlen, double value, unsigned int prec,
-                    unsigned int width, unsigned int flags) {
-    // check for NaN and special values
-    if (is_nan(value) || (value > DBL_MAX) || (value < -DBL_MAX)) {
-        return _ftoa(out, buffer, idx, maxlen, value, prec, width, flags);
+    char prefix = 0;
+    if (conv.U >> 63U) {
+        prefix = '-';
+    } else if (flags & FLAGS_PLUS) {
+        prefix = '+';  // ignore the space if the '+' exists
+    } else if (flags & FLAGS_SPACE) {
+        prefix = ' ';
     }
+    conv.U &= ~(1ULL << 63U);
 
-    // determine the sign
-    const bool negative = value < 0;
-    if (negative) {
-        value = -value;
+    // test for special values
+    if ((conv.U >> DOUBLE_MANTISSA_BITS) == DOUBLE_EXPONENT_MASK) {
+        char s[4];
+        size_t len = 0U;
+        if (prefix) {
+            s[len++] = prefix;
+        }
+        const bool is_nan = conv.U & ((1ULL << DOUBLE_MANTISSA_BITS) - 1U);
+        memcpy(s + len, is_nan ? ((flags & FLAGS_UPPERCASE) ? "NAN" : "nan") : ((flags & FLAGS_UPPERCASE) ? "INF" : "inf"), 3);
+        return _out_padded(out, buffer, idx, maxlen, s, len + 3U, width, flags);
     }
 
-    // default precision
+    // set default precision, if not set explicitly
     if (!(flags & FLAGS_PRECISION)) {
         prec = PICO_PRINTF_DEFAULT_FLOAT_PRECISION;
     }
 
-    // determine the decimal exponent
-    // based on the algorithm by David Gay (https://www.ampl.com/netlib/fp/dtoa.c)
-    union {
-        uint64_t U;
-        double F;
-    } conv;
-
-    conv.F = value;
-    int expval;
-    if (conv.U) {
-        int exp2 = (int) ((conv.U >> 52U) & 0x07FFU) - 1023;           // effectively log2
-        conv.U = (conv.U & ((1ULL << 52U) - 1U)) | (1023ULL << 52U);  // drop the exponent so conv.F is now in [1,2)
-        // now approximate log10 from the log2 integer part and an expansion of ln around 1.5
-        expval = (int) (0.1760912590558 + exp2 * 0.301029995663981 + (conv.F - 1.5) * 0.289529654602168);
-        // now we want to compute 10^expval but we want to be sure it won't overflow
-        exp2 = (int) (expval * 3.321928094887362 + 0.5);
-        const double z = expval * 2.302585092994046 - exp2 * 0.6931471805599453;
-        const double z2 = z * z;
-        conv.U = (uint64_t) (exp2 + 1023) << 52U;
-        // compute exp(z) using continued fractions, see https://en.wikipedia.org/wiki/Exponential_function#Continued_fractions_for_ex
-        conv.F *= 1 + 2 * z / (2 - z + (z2 / (6 + (z2 / (10 + z2 / 14)))));
-        // correct for rounding errors
-        if (value < conv.F) {
-            expval--;
-            conv.F /= 10;
-        }
-    } else {
-        expval = 0;
+#ifdef PICO_PRINTF_MAX_FLOAT
+    if (!exponential && (conv.F > PICO_PRINTF_MAX_FLOAT)) {
+#if PICO_PRINTF_SUPPORT_EXPONENTIAL
+        exponential = true;
+#else
+        return idx;
+#endif
     }
+#endif
 
-    // the exponent format is "%+03d" and largest value is "307", so set aside 4-5 characters
-    unsigned int minwidth = ((expval < 100) && (expval > -100)) ? 4U : 5U;
-
-    // in "%g" mode, "prec" is the number of *significant figures* not decimals
+    _dtoa_t d;
+    bool strip = false;
+#if PICO_PRINTF_SUPPORT_EXPONENTIAL
     if (flags & FLAGS_ADAPT_EXP) {
-        // do we want to fall-back to "%f" mode?
-        if ((conv.U == 0) || ((value >= 1e-4) && (value < 1e6))) {
-            if ((int) prec > expval) {
-                prec = (unsigned) ((int) prec - expval - 1);
-            } else {
-                prec = 0;
-            }
-            flags |= FLAGS_PRECISION;   // make sure _ftoa respects precision
-            // no characters in exponent
-            minwidth = 0U;
-            expval = 0;
+        // prec is the number of significant digits, and fixed notation is used unless the exponent is < -4 or >= prec
+        const int sig = prec ? (int) prec : 1;
+        _dtoa_round(&d, conv.U, false, (unsigned int) sig - 1U);
+        exponential = (d.exp10 < -4) || (d.exp10 >= sig);
+        if (exponential) {
+            prec = (unsigned int) sig - 1U;
         } else {
-            // we use one sigfig for the whole part
-            if ((prec > 0) && (flags & FLAGS_PRECISION)) {
-                --prec;
-            }
+            prec = (unsigned int) (sig - 1 - d.exp10);
+            _dtoa_round(&d, conv.U, true, prec);
         }
+        // trailing zeros are removed unless the hash flag is given
+        strip = !(flags & FLAGS_HASH);
+    } else
+#endif
+    {
+        _dtoa_round(&d, conv.U, !exponential, prec);
     }
 
-    // will everything fit?
-    unsigned int fwidth = width;
-    if (width > minwidth) {
-        // we didn't fall-back so subtract the characters required for the exponent
-        fwidth -= minwidth;
-    } else {
-        // not enough characters, so go back to default sizing
-        fwidth = 0U;
-    }
-    if ((flags & FLAGS_LEFT) && minwidth) {
-        // if we're padding on the right, DON'T pad the floating part
-        fwidth = 0U;
+    const int int_len = exponential ? 1 : d.count - (int) prec;
+    int frac_len = (int) prec;
+    if (strip) {
+        frac_len = d.last_nz + 1 - int_len;
+        if (frac_len < 0) {
+            frac_len = 0;
+        }
     }
+    const bool point = frac_len || (flags & FLAGS_HASH);
 
-    // rescale the float value
-    if (expval) {
-        value /= conv.F;
+    char exp_buf[6];
+    size_t exp_len = 0U;
+#if PICO_PRINTF_SUPPORT_EXPONENTIAL
+    if (exponential) {
+        const unsigned int e = (unsigned int) (d.exp10 < 0 ? -d.exp10 : d.exp10);
+        exp_buf[exp_len++] = (flags & FLAGS_UPPERCASE) ? 'E' : 'e';
+        exp_buf[exp_len++] = d.exp10 < 0 ? '-' : '+';
+        if (e >= 100U) {
+            exp_buf[exp_len++] = (char) ('0' + e / 100U);
+        }
+        memcpy(exp_buf + exp_len, &_digit_pairs[2U * (e % 100U)], 2);
+        exp_len += 2U;
     }
+#endif
 
-    // output the floating part
-    const size_t start_idx = idx;
-    idx = _ftoa(out, buffer, idx, maxlen, negative ? -value : value, prec, fwidth, flags & ~FLAGS_ADAPT_EXP);
+    const size_t total = (prefix ? 1U : 0U) + (size_t) (int_len ? int_len : 1) + (point ? 1U : 0U) +
+                         (size_t) frac_len + exp_len;
+    size_t pad = total < width ? width - total : 0U;
+    size_t zeros = 0U;
+    if ((flags & FLAGS_ZEROPAD) && !(flags & FLAGS_LEFT)) {
+        zeros = pad;
+        pad = 0U;
+    }
+    if (!(flags & FLAGS_LEFT)) {
+        idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
+    }
+    if (prefix) {
+        idx = _out_span(out, buffer, idx, maxlen, &prefix, 1U);
+    }
+    idx = _out_fill(out, buffer, idx, maxlen, '0', zeros);
 
-    // output the exponent part
-    if (minwidth) {
-        // output the exponential symbol
-        out((flags & FLAGS_UPPERCASE) ? 'E' : 'e', buffer, idx++, maxlen);
-        // output the exponent value
-        idx = _ntoa_long(out, buffer, idx, maxlen, (uint)((expval < 0) ? -expval : expval), expval < 0, 10, 0, minwidth - 1,
-                         FLAGS_ZEROPAD | FLAGS_PLUS);
-        // might need to right-pad spaces
-        if (flags & FLAGS_LEFT) {
-            while (idx - start_idx < width) out(' ', buffer, idx++, maxlen);
+    if (d.count > (int) sizeof(d.buf) && !d.carry_out) {
+        // start generating the digits again
+        _dgen_init(&d.g, conv.U);
+        for (int i = 0; i < d.skip; i++) {
+            _dgen_next(&d.g);
         }
     }
+    if (int_len) {
+        idx = _dtoa_digits(out, buffer, idx, maxlen, &d, 0, int_len);
+    } else {
+        idx = _out_span(out, buffer, idx, maxlen, "0", 1U);
+    }
+    if (point) {
+        idx = _out_span(out, buffer, idx, maxlen, ".", 1U);
+    }
+    idx = _dtoa_digits(out, buffer, idx, maxlen, &d, int_len, int_len + frac_len);
+    idx = _out_span(out, buffer, idx, maxlen, exp_buf, exp_len);
+
+    if (flags & FLAGS_LEFT) {
+        idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
+    }
     return idx;
 }
 
-#endif  // PICO_PRINTF_SUPPORT_EXPONENTIAL
 #endif  // PICO_PRINTF_SUPPORT_FLOAT
 
 // internal vsnprintf
@@ -593,9 +869,10 @@ static int _vsnprintf(out_fct_type out, char *buffer, const size_t maxlen, const
     while (*format) {
         // format specifier?  %[flags][width][.precision][length]
         if (*format != '%') {
-            // no
-            out(*format, buffer, idx++, maxlen);
-            format++;
+            // no, output the run of characters up to the next one
+            const char *run = format;
+            while (*++format && *format != '%');
+            idx = _out_span(out, buffer, idx, maxlen, run, (size_t) (format - run));
             continue;
         } else {
             // yes, evaluate it
@@ -745,18 +1022,18 @@ static int _vsnprintf(out_fct_type out, char *buffer, const size_t maxlen, const
 #if PICO_PRINTF_SUPPORT_LONG_LONG
                         const long long value = va_arg(va, long long);
                         idx = _ntoa_long_long(out, buffer, idx, maxlen,
-                                              (unsigned long long) (value > 0 ? value : 0 - value), value < 0, base,
+                                              value < 0 ? 0U - (unsigned long long) value : (unsigned long long) value, value < 0, base,
                                               precision, width, flags);
 #endif
                     } else if (flags & FLAGS_LONG) {
                         const long value = va_arg(va, long);
-                        idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned long) (value > 0 ? value : 0 - value),
+                        idx = _ntoa_long(out, buffer, idx, maxlen, value < 0 ? 0U - (unsigned long) value : (unsigned long) value,
                                          value < 0, base, precision, width, flags);
                     } else {
                         const int value = (flags & FLAGS_CHAR) ? (char) va_arg(va, int) : (flags & FLAGS_SHORT)
                                                                                           ? (short int) va_arg(va, int)
                                                                                           : va_arg(va, int);
-                        idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned int) (value > 0 ? value : 0 - value),
+                        idx = _ntoa_long(out, buffer, idx, maxlen, value < 0 ? 0U - (unsigned int) value : (unsigned int) value,
                                          value < 0, base, precision, width, flags);
                     }
                 } else {
@@ -785,7 +1062,7 @@ static int _vsnprintf(out_fct_type out, char *buffer, const size_t maxlen, const
             case 'F' :
 #if PICO_PRINTF_SUPPORT_FLOAT
                 if (*format == 'F') flags |= FLAGS_UPPERCASE;
-                idx = _ftoa(out, buffer, idx, maxlen, va_arg(va, double), precision, width, flags);
+                idx = _dtoa(out, buffer, idx, maxlen, va_arg(va, double), precision, width, flags, false);
 #else
                 for(int i=0;i<2;i++) out('?', buffer, idx++, maxlen);
                 va_arg(va, double);
@@ -799,7 +1076,7 @@ static int _vsnprintf(out_fct_type out, char *buffer, const size_t maxlen, const
 #if PICO_PRINTF_SUPPORT_FLOAT && PICO_PRINTF_SUPPORT_EXPONENTIAL
                 if ((*format == 'g') || (*format == 'G')) flags |= FLAGS_ADAPT_EXP;
                 if ((*format == 'E') || (*format == 'G')) flags |= FLAGS_UPPERCASE;
-                idx = _etoa(out, buffer, idx, maxlen, va_arg(va, double), precision, width, flags);
+                idx = _dtoa(out, buffer, idx, maxlen, va_arg(va, double), precision, width, flags, true);
 #else
                 for(int i=0;i<2;i++) out('?', buffer, idx++, maxlen);
                 va_arg(va, double);
@@ -807,47 +1084,16 @@ static int _vsnprintf(out_fct_type out, char *buffer, const size_t maxlen, const
                 format++;
                 break;
             case 'c' : {
-                unsigned int l = 1U;
-                // pre padding
-                if (!(flags & FLAGS_LEFT)) {
-                    while (l++ < width) {
-                        out(' ', buffer, idx++, maxlen);
-                    }
-                }
-                // char output
-                out((char) va_arg(va, int), buffer, idx++, maxlen);
-                // post padding
-                if (flags & FLAGS_LEFT) {
-                    while (l++ < width) {
-                        out(' ', buffer, idx++, maxlen);
-                    }
-                }
+                const char c = (char) va_arg(va, int);
+                idx = _out_padded(out, buffer, idx, maxlen, &c, 1U, width, flags);
                 format++;
                 break;
             }
 
             case 's' : {
                 const char *p = va_arg(va, char*);
-                unsigned int l = _strnlen_s(p, precision ? precision : (size_t) -1);
-                // pre padding
-                if (flags & FLAGS_PRECISION) {
-                    l = (l < precision ? l : precision);
-                }
-                if (!(flags & FLAGS_LEFT)) {
-                    while (l++ < width) {
-                        out(' ', buffer, idx++, maxlen);
-                    }
-                }
-                // string output
-                while ((*p != 0) && (!(flags & FLAGS_PRECISION) || precision--)) {
-                    out(*(p++), buffer, idx++, maxlen);
-                }
-                // post padding
-                if (flags & FLAGS_LEFT) {
-                    while (l++ < width) {
-                        out(' ', buffer, idx++, maxlen);
-                    }
-                }
+                const unsigned int l = _strnlen_s(p, (flags & FLAGS_PRECISION) ? precision : (size_t) -1);
+                idx = _out_padded(out, buffer, idx, maxlen, p, l, width, flags);
                 format++;
                 break;
             }
@@ -918,6 +1164,11 @@ int vfctprintf(void (*out)(char character, void *arg), void *arg, const char *fo
     return _vsnprintf(_out_fct, (char *) (uintptr_t) &out_fct_wrap, (size_t) -1, format, va);
 }
 
+int vfctprintf_span(void (*out)(const char *s, size_t len, void *arg), void *arg, const char *format, va_list va) {
+    const out_span_fct_wrap_type out_span_fct_wrap = {out, arg};
+    return _vsnprintf(_out_span_fct, (char *) (uintptr_t) &out_span_fct_wrap, (size_t) -1, format, va);
+}
+
 #if LIB_PICO_PRINTF_PICO
 #if !PICO_PRINTF_ALWAYS_INCLUDED
 bool weak_raw_printf(const char *fmt, ...) {
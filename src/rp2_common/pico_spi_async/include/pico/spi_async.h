@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_SPI_ASYNC_H
+#define _PICO_SPI_ASYNC_H
+
+#include "pico.h"
+#include "hardware/spi.h"
+#include "hardware/sync.h"
+
+/** \file spi_async.h
+ *  \defgroup pico_spi_async pico_spi_async
+ *
+ * DMA driven, non-blocking SPI transfers
+ *
+ * An \ref spi_async_t engine owns an SPI instance (already set up with spi_init(), in 8-bit mode) and a pair of DMA
+ * channels, one feeding the Tx FIFO and one draining the Rx FIFO. Transfers (each with its own chip select, buffers,
+ * length and completion callback) are queued with \ref spi_async_submit and run back to back, in order: when the Rx
+ * channel of one transfer completes, its chip select is deasserted, and the next transfer is started before the
+ * completed transfer's callback is called, so the SPI keeps running while the CPU deals with the data it received.
+ *
+ * On the device, completion is handled by a shared handler on the DMA IRQ PICO_SPI_ASYNC_DMA_IRQ, on the core which
+ * initialized the engine, and callbacks are called from that IRQ; to handle a completion in an async_context
+ * instead, have the callback call async_context_set_work_pending(). On the host (where the DMA is emulated, and
+ * there are no DMA interrupts) completion is noticed, and callbacks are called, from \ref spi_async_is_idle,
+ * \ref spi_async_transfer_is_done and the functions which wait for them.
+ *
+ * \note A transfer's buffers must not be accessed by the CPU until it is complete.
+ */
+
+// PICO_CONFIG: PICO_SPI_ASYNC_DMA_IRQ, The DMA IRQ (0 or 1) used to signal completion of asynchronous SPI transfers, min=0, max=1, default=0, group=pico_spi_async
+#ifndef PICO_SPI_ASYNC_DMA_IRQ
+#define PICO_SPI_ASYNC_DMA_IRQ 0
+#endif
+
+// PICO_CONFIG: PICO_SPI_ASYNC_IRQ_ORDER_PRIORITY, Shared IRQ order priority of the completion handler for asynchronous SPI transfers, min=0, max=255, default=PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY, group=pico_spi_async
+#ifndef PICO_SPI_ASYNC_IRQ_ORDER_PRIORITY
+#define PICO_SPI_ASYNC_IRQ_ORDER_PRIORITY PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct spi_async_transfer spi_async_transfer_t;
+
+/*! \brief Callback for completion of an asynchronous SPI transfer
+ *  \ingroup pico_spi_async
+ *
+ * It may submit further transfers.
+ *
+ * \param transfer The transfer, which may be reused (or freed) by the callback
+ */
+typedef void (*spi_async_callback_t)(spi_async_transfer_t *transfer);
+
+/*! \brief An asynchronous SPI transfer
+ *  \ingroup pico_spi_async
+ *
+ * Owned by the caller, and must remain valid until the transfer is complete. Set the public members (or use
+ * \ref spi_async_transfer_init) before submitting it; the remaining members are private.
+ */
+struct spi_async_transfer {
+    const uint8_t *tx_buf;          ///< data to send, or NULL to send tx_fill repeatedly
+    uint8_t *rx_buf;                ///< buffer for the data received, or NULL to discard it
+    size_t len;                     ///< bytes to transfer, at least 1
+    int cs_pin;                     ///< GPIO (an output) driven low for the duration of the transfer, or -1
+    uint8_t tx_fill;
+    spi_async_callback_t callback;  ///< called on completion, or NULL
+    void *user_data;
+    // private
+    spi_async_transfer_t *next;
+    volatile bool done;
+};
+
+/*! \brief State of an asynchronous SPI engine
+ *  \ingroup pico_spi_async
+ *
+ * The members are private.
+ */
+typedef struct spi_async {
+    spi_inst_t *spi;
+    uint8_t tx_channel;
+    uint8_t rx_channel;
+    uint8_t rx_discard;             // where the Rx channel writes data which isn't wanted
+    spin_lock_t *lock;
+    spi_async_transfer_t *head;     // the transfer in progress, if any
+    spi_async_transfer_t *tail;
+} spi_async_t;
+
+/*! \brief Initialize an asynchronous SPI transfer
+ *  \ingroup pico_spi_async
+ *
+ * \param transfer The transfer
+ * \param tx_buf Data to send, or NULL to send 0
+ * \param rx_buf Buffer for the data received, or NULL to discard it
+ * \param len The number of bytes to transfer
+ * \param cs_pin GPIO to drive low during the transfer, or -1
+ * \param callback Function to call on completion, or NULL
+ * \param user_data For use by the callback
+ */
+static inline void spi_async_transfer_init(spi_async_transfer_t *transfer, const uint8_t *tx_buf, uint8_t *rx_buf,
+                                           size_t len, int cs_pin, spi_async_callback_t callback, void *user_data) {
+    transfer->tx_buf = tx_buf;
+    transfer->rx_buf = rx_buf;
+    transfer->len = len;
+    transfer->cs_pin = cs_pin;
+    transfer->tx_fill = 0;
+    transfer->callback = callback;
+    transfer->user_data = user_data;
+    transfer->next = NULL;
+    transfer->done = false;
+}
+
+/*! \brief Initialize an asynchronous SPI engine, claiming two DMA channels
+ *  \ingroup pico_spi_async
+ *
+ * \param engine The engine state, which must remain valid until \ref spi_async_deinit
+ * \param spi The SPI instance, which must be initialized (with 8 data bits); only one engine may use each instance
+ */
+void spi_async_init(spi_async_t *engine, spi_inst_t *spi);
+
+/*! \brief Release the DMA channels of an idle asynchronous SPI engine
+ *  \ingroup pico_spi_async
+ *
+ * \param engine The engine, which must have no transfers queued or in progress
+ */
+void spi_async_deinit(spi_async_t *engine);
+
+/*! \brief Queue a transfer, starting it straight away if the engine is idle
+ *  \ingroup pico_spi_async
+ *
+ * May be called from a completion callback (or any IRQ handler).
+ *
+ * \param engine The engine
+ * \param transfer The transfer
+ */
+void spi_async_submit(spi_async_t *engine, spi_async_transfer_t *transfer);
+
+/*! \brief Check whether a transfer is complete
+ *  \ingroup pico_spi_async
+ *
+ * \param engine The engine the transfer was submitted to
+ * \param transfer The transfer
+ * \return true if the transfer is complete (its callback is called after it is marked complete)
+ */
+bool spi_async_transfer_is_done(spi_async_t *engine, spi_async_transfer_t *transfer);
+
+/*! \brief Wait for a transfer to complete
+ *  \ingroup pico_spi_async
+ *
+ * \param engine The engine the transfer was submitted to
+ * \param transfer The transfer
+ */
+void spi_async_transfer_wait(spi_async_t *engine, spi_async_transfer_t *transfer);
+
+/*! \brief Check whether an engine has no transfers queued or in progress
+ *  \ingroup pico_spi_async
+ *
+ * \param engine The engine
+ * \return true if the engine is idle
+ */
+bool spi_async_is_idle(spi_async_t *engine);
+
+/*! \brief Wait for all the transfers queued on an engine to complete
+ *  \ingroup pico_spi_async
+ *
+ * \param engine The engine
+ */
+void spi_async_wait_idle(spi_async_t *engine);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pico/spi_async.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#if !PICO_NO_HARDWARE
+#include "hardware/irq.h"
+#include "hardware/claim.h"
+#endif
+
+// the engine using each SPI instance
+static spi_async_t *volatile engines[NUM_SPIS];
+
+// start the DMA for a transfer; the Rx channel, which completes last, signals the end of the transfer
+static void start_transfer(spi_async_t *engine, spi_async_transfer_t *t) {
+    volatile void *dr = &spi_get_hw(engine->spi)->dr;
+    if (t->cs_pin >= 0) gpio_put((uint)t->cs_pin, 0);
+
+    dma_channel_config c = dma_channel_get_default_config(engine->rx_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, t->rx_buf != NULL);
+    channel_config_set_dreq(&c, spi_get_dreq(engine->spi, false));
+    dma_channel_configure(engine->rx_channel, &c, t->rx_buf ? t->rx_buf : &engine->rx_discard, dr, t->len, false);
+
+    c = dma_channel_get_default_config(engine->tx_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, t->tx_buf != NULL);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, spi_get_dreq(engine->spi, true));
+    channel_config_set_irq_quiet(&c, true);
+    dma_channel_configure(engine->tx_channel, &c, dr, t->tx_buf ? t->tx_buf : &t->tx_fill, t->len, false);
+
+    // both at once, so the Rx channel is ready for the first frame
+    dma_start_channel_mask((1u << engine->rx_channel) | (1u << engine->tx_channel));
+}
+
+// finish the transfer in progress, and start the next
+static void complete_transfer(spi_async_t *engine) {
+    uint32_t save = spin_lock_blocking(engine->lock);
+    spi_async_transfer_t *t = engine->head;
+    if (!t) {
+        spin_unlock(engine->lock, save);
+        return;
+    }
+    if (t->cs_pin >= 0) gpio_put((uint)t->cs_pin, 1);
+    engine->head = t->next;
+    if (engine->head) {
+        start_transfer(engine, engine->head);
+    } else {
+        engine->tail = NULL;
+    }
+    spin_unlock(engine->lock, save);
+    t->done = true;
+    if (t->callback) t->callback(t);
+}
+
+#if !PICO_NO_HARDWARE
+static void spi_async_irq_handler(void) {
+    for (uint i = 0; i < NUM_SPIS; i++) {
+        spi_async_t *engine = engines[i];
+        if (engine && dma_irqn_get_channel_status(PICO_SPI_ASYNC_DMA_IRQ, engine->rx_channel)) {
+            dma_irqn_acknowledge_channel(PICO_SPI_ASYNC_DMA_IRQ, engine->rx_channel);
+            complete_transfer(engine);
+        }
+    }
+}
+
+static void install_irq_handler(void) {
+    static bool installed;
+    uint32_t save = hw_claim_lock();
+    if (!installed) {
+        uint irq_num = DMA_IRQ_0 + PICO_SPI_ASYNC_DMA_IRQ;
+        irq_add_shared_handler(irq_num, spi_async_irq_handler, PICO_SPI_ASYNC_IRQ_ORDER_PRIORITY);
+        irq_set_enabled(irq_num, true);
+        installed = true;
+    }
+    hw_claim_unlock(save);
+}
+#endif
+
+// no interrupts on the host, so completion is noticed here
+static inline void poll(__unused spi_async_t *engine) {
+#if PICO_NO_HARDWARE
+    if (engine->head && !dma_channel_is_busy(engine->rx_channel)) {
+        complete_transfer(engine);
+    }
+#endif
+}
+
+void spi_async_init(spi_async_t *engine, spi_inst_t *spi) {
+    uint index = spi_get_index(spi);
+    assert(!engines[index]);
+    engine->spi = spi;
+    engine->tx_channel = (uint8_t)dma_claim_unused_channel(true);
+    engine->rx_channel = (uint8_t)dma_claim_unused_channel(true);
+    engine->lock = spin_lock_init((uint)spin_lock_claim_unused(true));
+    engine->head = engine->tail = NULL;
+    engines[index] = engine;
+#if !PICO_NO_HARDWARE
+    install_irq_handler();
+    dma_irqn_acknowledge_channel(PICO_SPI_ASYNC_DMA_IRQ, engine->rx_channel);
+    dma_irqn_set_channel_enabled(PICO_SPI_ASYNC_DMA_IRQ, engine->rx_channel, true);
+#endif
+}
+
+void spi_async_deinit(spi_async_t *engine) {
+    hard_assert(spi_async_is_idle(engine));
+#if !PICO_NO_HARDWARE
+    dma_irqn_set_channel_enabled(PICO_SPI_ASYNC_DMA_IRQ, engine->rx_channel, false);
+#endif
+    engines[spi_get_index(engine->spi)] = NULL;
+    dma_channel_unclaim(engine->tx_channel);
+    dma_channel_unclaim(engine->rx_channel);
+    spin_lock_unclaim(spin_lock_get_num(engine->lock));
+}
+
+void spi_async_submit(spi_async_t *engine, spi_async_transfer_t *transfer) {
+    invalid_params_if(SPI, !transfer->len);
+    transfer->next = NULL;
+    transfer->done = false;
+    uint32_t save = spin_lock_blocking(engine->lock);
+    if (engine->tail) {
+        engine->tail->next = transfer;
+    } else {
+        engine->head = transfer;
+        start_transfer(engine, transfer);
+    }
+    engine->tail = transfer;
+    spin_unlock(engine->lock, save);
+}
+
+bool spi_async_transfer_is_done(spi_async_t *engine, spi_async_transfer_t *transfer) {
+    if (!transfer->done) poll(engine);
+    return transfer->done;
+}
+
+void spi_async_transfer_wait(spi_async_t *engine, spi_async_transfer_t *transfer) {
+    while (!spi_async_transfer_is_done(engine, transfer)) tight_loop_contents();
+}
+
+bool spi_async_is_idle(spi_async_t *engine) {
+    poll(engine);
+    return !engine->head;
+}
+
+void spi_async_wait_idle(spi_async_t *engine) {
+    while (!spi_async_is_idle(engine)) tight_loop_contents();
+}
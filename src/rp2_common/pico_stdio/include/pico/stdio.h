@@ -41,6 +41,21 @@
 #define PICO_STDIO_DEADLOCK_TIMEOUT_MS 1000
 #endif
 
+// PICO_CONFIG: PICO_STDIO_ASYNC_OUTPUT, Enable/disable support for asynchronous (ring buffered) stdout; see stdio_async_output_enable, type=bool, default=0, group=pico_stdio
+#ifndef PICO_STDIO_ASYNC_OUTPUT
+#define PICO_STDIO_ASYNC_OUTPUT 0
+#endif
+
+// PICO_CONFIG: PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE, Size of the asynchronous stdout ring buffer in bytes which must be a power of 2, min=16, default=2048, depends=PICO_STDIO_ASYNC_OUTPUT, group=pico_stdio
+#ifndef PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE
+#define PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE 2048
+#endif
+
+// PICO_CONFIG: PICO_STDIO_ASYNC_OUTPUT_IRQ_PRIORITY, Priority of the IRQ used to drain asynchronous stdout when no drain request callback is given, type=int, min=0, max=255, default=PICO_LOWEST_IRQ_PRIORITY, depends=PICO_STDIO_ASYNC_OUTPUT, group=pico_stdio
+#ifndef PICO_STDIO_ASYNC_OUTPUT_IRQ_PRIORITY
+#define PICO_STDIO_ASYNC_OUTPUT_IRQ_PRIORITY PICO_LOWEST_IRQ_PRIORITY
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -48,6 +63,15 @@ extern "C" {
 
 typedef struct stdio_driver stdio_driver_t;
 
+/*! \brief What to do with stdout output when the asynchronous stdout ring buffer is full
+ * \ingroup pico_stdio
+ */
+typedef enum {
+    STDIO_ASYNC_OVERFLOW_DROP,      ///< Discard the new output which does not fit
+    STDIO_ASYNC_OVERFLOW_BLOCK,     ///< Wait for (or perform) draining until the new output fits
+    STDIO_ASYNC_OVERFLOW_OVERWRITE, ///< Discard the oldest output which has not yet been drained to make room for the new output
+} stdio_async_overflow_t;
+
 /*! \brief Initialize all of the present standard stdio types that are linked into the binary.
  * \ingroup pico_stdio
  *
@@ -122,6 +146,58 @@ int puts_raw(const char *s);
  */
 void stdio_set_chars_available_callback(void (*fn)(void*), void *param);
 
+#if PICO_STDIO_ASYNC_OUTPUT
+/*! \brief Switch stdout to asynchronous output
+ * \ingroup pico_stdio
+ *
+ * Once enabled, printf, puts, putchar etc. copy their output into a ring buffer of
+ * \ref PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE bytes and return without waiting for the stdio drivers. The
+ * buffered output is fed to the drivers in large chunks by \ref stdio_async_output_drain, which is called in
+ * the background.
+ *
+ * If drain_request is NULL, a low priority IRQ (see \ref PICO_STDIO_ASYNC_OUTPUT_IRQ_PRIORITY) is claimed on the
+ * calling core to call \ref stdio_async_output_drain. Output written from the other core does not trigger this IRQ;
+ * it is drained along with the next output from this core, or by \ref stdio_flush.
+ *
+ * Otherwise drain_request is called (from the context which wrote the output) when there is new output and no
+ * drain has been requested since the last one started. It should arrange for \ref stdio_async_output_drain to be
+ * called soon, e.g. via an async_context "when pending" worker or by signalling the other core.
+ *
+ * The putchar_raw and puts_raw functions are still synchronous, as are calls to \ref stdio_flush, which wait
+ * for all buffered output to be drained. \ref stdio_filter_driver also drains the buffered output first, so that
+ * output goes to the drivers which were selected when it was written.
+ *
+ * \param overflow what to do when the ring buffer is full
+ * \param drain_request the function to call to request a drain, or NULL to use a low priority IRQ
+ * \param param the parameter to pass to drain_request
+ * \return true if asynchronous output was enabled, false if no user IRQ was available
+ */
+bool stdio_async_output_enable(stdio_async_overflow_t overflow, void (*drain_request)(void *param), void *param);
+
+/*! \brief Switch stdout back to synchronous output
+ * \ingroup pico_stdio
+ *
+ * Any buffered output is drained first. This must be called from the core which enabled asynchronous output.
+ */
+void stdio_async_output_disable(void);
+
+/*! \brief Feed buffered asynchronous output to the stdio drivers
+ * \ingroup pico_stdio
+ *
+ * Outputs everything in the asynchronous stdout ring buffer (including any output written while this function
+ * is running), then flushes the drivers. This may be called from any context; if a drain is already in progress
+ * elsewhere, this function returns immediately, and that drain will output everything instead.
+ */
+void stdio_async_output_drain(void);
+
+/*! \brief Return the number of bytes of stdout output discarded because the ring buffer was full
+ * \ingroup pico_stdio
+ *
+ * \return the number of bytes discarded since asynchronous output was enabled
+ */
+uint32_t stdio_async_output_get_dropped_bytes(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
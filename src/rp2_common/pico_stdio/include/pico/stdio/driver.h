@@ -9,6 +9,14 @@
 
 #include "pico/stdio.h"
 
+/*! \brief A run of characters passed to a driver's out_chars_gather function
+ *  \ingroup pico_stdio
+ */
+typedef struct stdio_span {
+    const char *buf;
+    int len;
+} stdio_span_t;
+
 struct stdio_driver {
     void (*out_chars)(const char *buf, int len);
     void (*out_flush)(void);
@@ -19,6 +27,10 @@ struct stdio_driver {
     bool last_ended_with_cr;
     bool crlf_enabled;
 #endif
+    // optional; outputs several runs of characters in one call (e.g. the pieces of a line which needed CR/LF
+    // translation). If this is NULL, out_chars (which must always be set) is called for each run instead. It comes
+    // last so that existing positional initializers of the members above are unaffected
+    void (*out_chars_gather)(const stdio_span_t *spans, uint count);
 };
 
 #endif
@@ -19,6 +19,11 @@
 #if PICO_STDOUT_MUTEX
 #include "pico/mutex.h"
 #endif
+#if PICO_STDIO_ASYNC_OUTPUT
+#include "pico/util/ring_buffer.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#endif
 
 #if LIB_PICO_STDIO_UART
 #include "pico/stdio_uart.h"
@@ -61,6 +66,52 @@ static void stdio_out_chars_no_crlf(stdio_driver_t *driver, const char *s, int l
     driver->out_chars(s, len);
 }
 
+#if PICO_STDIO_ENABLE_CRLF_SUPPORT
+// maximum number of runs of characters passed to a driver's out_chars_gather in one call
+#define STDIO_MAX_GATHER_SPANS 8
+
+static void stdio_out_spans(stdio_driver_t *driver, const stdio_span_t *spans, uint count) {
+    if (driver->out_chars_gather) {
+        driver->out_chars_gather(spans, count);
+    } else {
+        for (uint i = 0; i < count; i++) {
+            driver->out_chars(spans[i].buf, spans[i].len);
+        }
+    }
+}
+
+// returns the index of the first '\n' in s[from, len), or len if there is none. Aligned words are checked a whole
+// word at a time, as output is typically long runs of characters with few newlines
+static int stdio_find_newline(const char *s, int from, int len) {
+    const char *p = s + from;
+    const char *end = s + len;
+    while (p < end && ((uintptr_t)p & (sizeof(size_t) - 1))) {
+        if (*p == '\n') return (int)(p - s);
+        p++;
+    }
+    const size_t ones = (size_t)-1 / 0xff;
+    for (; end - p >= (ptrdiff_t)sizeof(size_t); p += sizeof(size_t)) {
+        size_t w;
+        memcpy(&w, p, sizeof(w));
+        w ^= ones * '\n';
+        // non-zero if any byte of w is zero, i.e. was a newline
+        if ((w - ones) & ~w & (ones << 7)) break;
+    }
+    while (p < end && *p != '\n') p++;
+    return (int)(p - s);
+}
+
+static inline void stdio_add_span(stdio_driver_t *driver, stdio_span_t *spans, uint *count, const char *buf, int len) {
+    if (*count == STDIO_MAX_GATHER_SPANS) {
+        stdio_out_spans(driver, spans, *count);
+        *count = 0;
+    }
+    spans[*count].buf = buf;
+    spans[*count].len = len;
+    (*count)++;
+}
+#endif
+
 static void stdio_out_chars_crlf(stdio_driver_t *driver, const char *s, int len) {
 #if PICO_STDIO_ENABLE_CRLF_SUPPORT
     if (!driver->crlf_enabled) {
@@ -69,18 +120,23 @@ static void stdio_out_chars_crlf(stdio_driver_t *driver, const char *s, int len)
     }
     int first_of_chunk = 0;
     static const char crlf_str[] = {'\r', '\n'};
-    for (int i = 0; i < len; i++) {
+    stdio_span_t spans[STDIO_MAX_GATHER_SPANS];
+    uint count = 0;
+    for (int i = stdio_find_newline(s, 0, len); i < len; i = stdio_find_newline(s, i + 1, len)) {
         bool prev_char_was_cr = i > 0 ? s[i - 1] == '\r' : driver->last_ended_with_cr;
-        if (s[i] == '\n' && !prev_char_was_cr) {
+        if (!prev_char_was_cr) {
             if (i > first_of_chunk) {
-                driver->out_chars(&s[first_of_chunk], i - first_of_chunk);
+                stdio_add_span(driver, spans, &count, &s[first_of_chunk], i - first_of_chunk);
             }
-            driver->out_chars(crlf_str, 2);
+            stdio_add_span(driver, spans, &count, crlf_str, 2);
             first_of_chunk = i + 1;
         }
     }
     if (first_of_chunk < len) {
-        driver->out_chars(&s[first_of_chunk], len - first_of_chunk);
+        stdio_add_span(driver, spans, &count, &s[first_of_chunk], len - first_of_chunk);
+    }
+    if (count) {
+        stdio_out_spans(driver, spans, count);
     }
     if (len > 0) {
         driver->last_ended_with_cr = s[len - 1] == '\r';
@@ -90,6 +146,225 @@ static void stdio_out_chars_crlf(stdio_driver_t *driver, const char *s, int len)
 #endif
 }
 
+#if PICO_STDIO_ASYNC_OUTPUT
+static_assert(!(PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE & (PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE - 1)), "PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE must be a power of 2");
+
+// Writers (serialized by async_out.lock) copy output into the ring, and a single drainer at a time feeds it to the
+// drivers. In the drop and block modes, the drainer reads the ring in place without taking the lock. In overwrite
+// mode writers must be able to discard undrained output, so the drainer instead removes each chunk from the ring
+// (under the lock) before outputting it, and writers leave the chunk's space alone until the drainer is done.
+static struct {
+    ring_buffer_t ring;
+    spin_lock_t *lock;
+    void (*drain_request)(void *param);
+    void *drain_request_param;
+    uint32_t dropped;
+    uint claimed;
+    stdio_async_overflow_t overflow;
+    volatile bool enabled;
+    bool draining;
+    bool drain_requested;
+    uint8_t drain_core;
+    uint8_t irq_core;
+    uint8_t irq_num;
+} async_out;
+
+static uint8_t async_out_storage[PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE];
+
+static bool async_out_drain_begin(void) {
+    uint32_t save = spin_lock_blocking(async_out.lock);
+    bool rc = !async_out.draining;
+    if (rc) {
+        async_out.draining = true;
+        async_out.drain_core = (uint8_t)get_core_num();
+        // output written from now on needs a new drain request
+        async_out.drain_requested = false;
+    }
+    spin_unlock(async_out.lock, save);
+    return rc;
+}
+
+// returns true if there is more output which arrived too late to be seen by the drain
+static bool async_out_drain_end(void) {
+    uint32_t save = spin_lock_blocking(async_out.lock);
+    async_out.draining = false;
+    bool rc = !ring_buffer_is_empty(&async_out.ring);
+    spin_unlock(async_out.lock, save);
+    return rc;
+}
+
+// true if we have pre-empted a drain in progress on this core, so cannot wait for it
+static bool async_out_drain_preempted(void) {
+    return async_out.draining && async_out.drain_core == get_core_num() && __get_current_exception();
+}
+
+static void async_out_drain_chunks(void) {
+    const uint8_t *data;
+    uint n;
+    do {
+        bool overwrite = async_out.overflow == STDIO_ASYNC_OVERFLOW_OVERWRITE;
+        uint32_t save = 0;
+        if (overwrite) save = spin_lock_blocking(async_out.lock);
+        n = ring_buffer_peek_contiguous(&async_out.ring, &data);
+        if (overwrite) {
+            ring_buffer_consume(&async_out.ring, n);
+            async_out.claimed = n;
+            spin_unlock(async_out.lock, save);
+        }
+        if (!n) break;
+        for (stdio_driver_t *d = drivers; d; d = d->next) {
+            if (!d->out_chars) continue;
+            if (filter && filter != d) continue;
+            stdio_out_chars_crlf(d, (const char *)data, (int)n);
+        }
+        if (overwrite) {
+            save = spin_lock_blocking(async_out.lock);
+            async_out.claimed = 0;
+            spin_unlock(async_out.lock, save);
+        } else {
+            ring_buffer_consume(&async_out.ring, n);
+        }
+    } while (true);
+}
+
+static void async_out_flush_drivers(void) {
+    for (stdio_driver_t *d = drivers; d; d = d->next) {
+        if (d->out_flush) d->out_flush();
+    }
+}
+
+void stdio_async_output_drain(void) {
+    do {
+        if (!async_out_drain_begin()) return;
+        async_out_drain_chunks();
+        async_out_flush_drivers();
+    } while (async_out_drain_end());
+}
+
+static void async_out_write(const char *s, int len) {
+    bool request = false;
+    while (len > 0) {
+        uint32_t save = spin_lock_blocking(async_out.lock);
+        if (async_out.overflow == STDIO_ASYNC_OVERFLOW_OVERWRITE) {
+            uint level = ring_buffer_get_level(&async_out.ring);
+            uint space = ring_buffer_get_size(&async_out.ring) - level - async_out.claimed;
+            if ((uint)len > space) {
+                uint discard = MIN((uint)len - space, level);
+                ring_buffer_consume(&async_out.ring, discard);
+                space += discard;
+                async_out.dropped += discard;
+                if ((uint)len > space) {
+                    // keep the most recent output
+                    async_out.dropped += (uint)len - space;
+                    s += (uint)len - space;
+                    len = (int)space;
+                }
+            }
+        }
+        int n = (int)ring_buffer_try_write(&async_out.ring, s, (uint)len);
+        if (n < len && async_out.overflow == STDIO_ASYNC_OVERFLOW_DROP) {
+            async_out.dropped += (uint)(len - n);
+            n = len;
+        }
+        if (n && !async_out.drain_requested && (async_out.drain_request || async_out.irq_core == get_core_num())) {
+            async_out.drain_requested = request = true;
+        }
+        bool block = n < len && !async_out.draining;
+        spin_unlock(async_out.lock, save);
+        s += n;
+        len -= n;
+        if (len) {
+            // STDIO_ASYNC_OVERFLOW_BLOCK; make room ourselves if nobody else is
+            if (block) {
+                stdio_async_output_drain();
+            } else if (async_out_drain_preempted()) {
+                // the drain cannot continue until we return, so this output has to be dropped
+                save = spin_lock_blocking(async_out.lock);
+                async_out.dropped += (uint)len;
+                spin_unlock(async_out.lock, save);
+                break;
+            } else {
+                tight_loop_contents();
+            }
+        }
+    }
+    if (request) {
+        if (async_out.drain_request) {
+            async_out.drain_request(async_out.drain_request_param);
+        } else {
+            irq_set_pending(async_out.irq_num);
+        }
+    }
+}
+
+// wait for all buffered output to be written to the drivers; returns false if that is not possible because
+// we have pre-empted the drain
+static bool async_out_wait_drained(void) {
+    do {
+        stdio_async_output_drain();
+        if (async_out_drain_preempted()) return false;
+        tight_loop_contents();
+    } while (!ring_buffer_is_empty(&async_out.ring) || async_out.draining);
+    return true;
+}
+
+static void async_out_irq_handler(void) {
+    stdio_async_output_drain();
+}
+
+bool stdio_async_output_enable(stdio_async_overflow_t overflow, void (*drain_request)(void *param), void *param) {
+    if (async_out.enabled) stdio_async_output_disable();
+    if (!async_out.lock) {
+        async_out.lock = spin_lock_instance(next_striped_spin_lock_num());
+    }
+    if (!drain_request) {
+        int irq = user_irq_claim_unused(false);
+        if (irq < 0) return false;
+        async_out.irq_num = (uint8_t)irq;
+        async_out.irq_core = (uint8_t)get_core_num();
+        irq_set_exclusive_handler(async_out.irq_num, async_out_irq_handler);
+        irq_set_priority(async_out.irq_num, PICO_STDIO_ASYNC_OUTPUT_IRQ_PRIORITY);
+        irq_set_enabled(async_out.irq_num, true);
+    } else {
+        // no core will pend the IRQ
+        async_out.irq_core = NUM_CORES;
+    }
+    ring_buffer_init(&async_out.ring, async_out_storage, sizeof(async_out_storage));
+    async_out.drain_request = drain_request;
+    async_out.drain_request_param = param;
+    async_out.overflow = overflow;
+    async_out.dropped = 0;
+    async_out.claimed = 0;
+    async_out.draining = async_out.drain_requested = false;
+    __mem_fence_release();
+    async_out.enabled = true;
+    return true;
+}
+
+void stdio_async_output_disable(void) {
+    if (!async_out.enabled) return;
+    async_out_wait_drained();
+    async_out.enabled = false;
+    __mem_fence_release();
+    // pick up anything written concurrently with the above
+    async_out_wait_drained();
+    if (!async_out.drain_request) {
+        assert(async_out.irq_core == get_core_num());
+        irq_set_enabled(async_out.irq_num, false);
+        irq_remove_handler(async_out.irq_num, async_out_irq_handler);
+        user_irq_unclaim(async_out.irq_num);
+    }
+}
+
+uint32_t stdio_async_output_get_dropped_bytes(void) {
+    return async_out.dropped;
+}
+
+#define async_out_enabled() async_out.enabled
+#else
+#define async_out_enabled() false
+#endif
+
 static bool stdio_put_string(const char *s, int len, bool newline, bool no_cr) {
     bool serialized = stdout_serialize_begin();
     if (!serialized) {
@@ -98,6 +373,21 @@ static bool stdio_put_string(const char *s, int len, bool newline, bool no_cr) {
 #endif
     }
     if (len == -1) len = (int)strlen(s);
+#if PICO_STDIO_ASYNC_OUTPUT
+    if (async_out_enabled()) {
+        if (!no_cr) {
+            async_out_write(s, len);
+            if (newline) async_out_write("\n", 1);
+            if (serialized) {
+                stdout_serialize_end();
+            }
+            return len;
+        }
+        // raw output bypasses the ring buffer (as CR/LF translation happens when it is drained), so make
+        // sure everything before it has been output first
+        async_out_wait_drained();
+    }
+#endif
     void (*out_func)(stdio_driver_t *, const char *, int) = no_cr ? stdio_out_chars_no_crlf : stdio_out_chars_crlf;
     for (stdio_driver_t *driver = drivers; driver; driver = driver->next) {
         if (!driver->out_chars) continue;
@@ -145,7 +435,7 @@ int WRAPPER_FUNC(putchar)(int c) {
 int WRAPPER_FUNC(puts)(const char *s) {
     int len = (int)strlen(s);
     stdio_put_string(s, len, true, false);
-    stdio_flush();
+    if (!async_out_enabled()) stdio_flush();
     return len;
 }
 
@@ -215,6 +505,10 @@ void stdio_set_driver_enabled(stdio_driver_t *driver, bool enable) {
 }
 
 void stdio_flush() {
+#if PICO_STDIO_ASYNC_OUTPUT
+    // the drain also flushes the drivers
+    if (async_out_enabled() && async_out_wait_drained()) return;
+#endif
     for (stdio_driver_t *d = drivers; d; d = d->next) {
         if (d->out_flush) d->out_flush();
     }
@@ -226,6 +520,12 @@ typedef struct stdio_stack_buffer {
 } stdio_stack_buffer_t;
 
 static void stdio_stack_buffer_flush(stdio_stack_buffer_t *buffer) {
+#if PICO_STDIO_ASYNC_OUTPUT
+    if (buffer->used && async_out_enabled()) {
+        async_out_write(buffer->buf, buffer->used);
+        buffer->used = 0;
+    }
+#endif
     if (buffer->used) {
         for (stdio_driver_t *d = drivers; d; d = d->next) {
             if (!d->out_chars) continue;
@@ -236,12 +536,18 @@ static void stdio_stack_buffer_flush(stdio_stack_buffer_t *buffer) {
     }
 }
 
-static void stdio_buffered_printer(char c, void *arg) {
+static void stdio_buffered_printer(const char *s, size_t len, void *arg) {
     stdio_stack_buffer_t *buffer = (stdio_stack_buffer_t *)arg;
-    if (buffer->used == PICO_STDIO_STACK_BUFFER_SIZE) {
-        stdio_stack_buffer_flush(buffer);
+    while (len) {
+        if (buffer->used == PICO_STDIO_STACK_BUFFER_SIZE) {
+            stdio_stack_buffer_flush(buffer);
+        }
+        size_t n = MIN(len, (size_t)(PICO_STDIO_STACK_BUFFER_SIZE - buffer->used));
+        memcpy(buffer->buf + buffer->used, s, n);
+        buffer->used += (int)n;
+        s += n;
+        len -= n;
     }
-    buffer->buf[buffer->used++] = c;
 }
 
 int WRAPPER_FUNC(vprintf)(const char *format, va_list va) {
@@ -255,9 +561,9 @@ int WRAPPER_FUNC(vprintf)(const char *format, va_list va) {
 #if LIB_PICO_PRINTF_PICO
     struct stdio_stack_buffer buffer;
     buffer.used = 0;
-    ret = vfctprintf(stdio_buffered_printer, &buffer, format, va);
+    ret = vfctprintf_span(stdio_buffered_printer, &buffer, format, va);
     stdio_stack_buffer_flush(&buffer);
-    stdio_flush();
+    if (!async_out_enabled()) stdio_flush();
 #elif LIB_PICO_PRINTF_NONE
     extern void printf_none_assert();
     printf_none_assert();
@@ -318,6 +624,10 @@ int getchar_timeout_us(uint32_t timeout_us) {
 }
 
 void stdio_filter_driver(stdio_driver_t *driver) {
+#if PICO_STDIO_ASYNC_OUTPUT
+    // the filter applies to output as it is written, so buffered output must go to the drivers it was written for
+    if (async_out_enabled()) async_out_wait_drained();
+#endif
     filter = driver;
 }
 
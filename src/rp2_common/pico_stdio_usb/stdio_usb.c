@@ -91,38 +91,51 @@ static void usb_irq(void) {
 
 #endif
 
-static void stdio_usb_out_chars(const char *buf, int length) {
-    static uint64_t last_avail_time;
+static uint64_t stdio_usb_last_avail_time;
+
+// queue characters for the CDC interface, sending what is queued whenever it fills up; returns false if we gave up
+// waiting for space
+static bool stdio_usb_write_chars(const char *buf, int length) {
+    for (int i = 0; i < length;) {
+        int n = length - i;
+        int avail = (int) tud_cdc_write_available();
+        if (n > avail) n = avail;
+        if (n) {
+            i += (int) tud_cdc_write(buf + i, (uint32_t)n);
+            stdio_usb_last_avail_time = time_us_64();
+        } else {
+            tud_task();
+            tud_cdc_write_flush();
+            if (!stdio_usb_connected() ||
+                (!tud_cdc_write_available() && time_us_64() > stdio_usb_last_avail_time + PICO_STDIO_USB_STDOUT_TIMEOUT_US)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// all the spans are queued before sending, so e.g. a line needing CR/LF translation goes in one packet
+static void stdio_usb_out_chars_gather(const stdio_span_t *spans, uint count) {
     if (!mutex_try_enter_block_until(&stdio_usb_mutex, make_timeout_time_ms(PICO_STDIO_DEADLOCK_TIMEOUT_MS))) {
         return;
     }
     if (stdio_usb_connected()) {
-        for (int i = 0; i < length;) {
-            int n = length - i;
-            int avail = (int) tud_cdc_write_available();
-            if (n > avail) n = avail;
-            if (n) {
-                int n2 = (int) tud_cdc_write(buf + i, (uint32_t)n);
-                tud_task();
-                tud_cdc_write_flush();
-                i += n2;
-                last_avail_time = time_us_64();
-            } else {
-                tud_task();
-                tud_cdc_write_flush();
-                if (!stdio_usb_connected() ||
-                    (!tud_cdc_write_available() && time_us_64() > last_avail_time + PICO_STDIO_USB_STDOUT_TIMEOUT_US)) {
-                    break;
-                }
-            }
-        }
+        for (uint i = 0; i < count && stdio_usb_write_chars(spans[i].buf, spans[i].len); i++);
+        tud_task();
+        tud_cdc_write_flush();
     } else {
         // reset our timeout
-        last_avail_time = 0;
+        stdio_usb_last_avail_time = 0;
     }
     mutex_exit(&stdio_usb_mutex);
 }
 
+static void stdio_usb_out_chars(const char *buf, int length) {
+    const stdio_span_t span = {buf, length};
+    stdio_usb_out_chars_gather(&span, 1);
+}
+
 int stdio_usb_in_chars(char *buf, int length) {
     // note we perform this check outside the lock, to try and prevent possible deadlock conditions
     // with printf in IRQs (which we will escape through timeouts elsewhere, but that would be less graceful).
@@ -164,6 +177,7 @@ void stdio_usb_set_chars_available_callback(void (*fn)(void*), void *param) {
 
 stdio_driver_t stdio_usb = {
     .out_chars = stdio_usb_out_chars,
+    .out_chars_gather = stdio_usb_out_chars_gather,
     .in_chars = stdio_usb_in_chars,
 #if PICO_STDIO_USB_SUPPORT_CHARS_AVAILABLE_CALLBACK
     .set_chars_available_callback = stdio_usb_set_chars_available_callback,
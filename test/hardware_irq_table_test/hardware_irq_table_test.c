@@ -0,0 +1,185 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+#include "hardware/irq.h"
+
+PICOTEST_MODULE_NAME("IRQ_TABLE", "shared IRQ handler table test");
+
+#define MAX_FIRE_COUNT 8
+static char fired[MAX_FIRE_COUNT + 1];
+static uint fire_count;
+
+static uint low_irq, high_irq;
+static bool stop_in_b;
+static bool remove_b;
+static bool raise_high_in_a;
+static bool remove_c_in_a;
+
+static void record_fire(char which) {
+    if (fire_count < MAX_FIRE_COUNT) fired[fire_count++] = which;
+    fired[fire_count] = 0;
+}
+
+static void handler_c(void);
+
+static void handler_a(void) {
+    record_fire('a');
+    if (raise_high_in_a) {
+        raise_high_in_a = false;
+        irq_set_pending(high_irq);
+    }
+    if (remove_c_in_a) {
+        remove_c_in_a = false;
+        irq_remove_handler(low_irq, handler_c);
+    }
+}
+
+static bool handler_b(void) {
+    record_fire('b');
+    if (remove_b) {
+        remove_b = false;
+        irq_remove_handler(low_irq, (irq_handler_t)handler_b);
+    }
+    return stop_in_b;
+}
+
+static void handler_c(void) {
+    record_fire('c');
+    busy_wait_us(50);
+}
+
+static void handler_h(void) {
+    record_fire('h');
+}
+
+// replaces itself on low_irq with handler_h on high_irq
+static void handler_x(void) {
+    record_fire('x');
+    irq_remove_handler(low_irq, handler_x);
+    irq_add_shared_handler(high_irq, handler_h, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+}
+
+static const char *fire(uint irq) {
+    fire_count = 0;
+    fired[0] = 0;
+    irq_set_pending(irq);
+    return fired;
+}
+
+static bool check_fire(uint irq, const char *expected) {
+    const char *actual = fire(irq);
+    bool ok = !strcmp(actual, expected);
+    if (!ok) printf("expected '%s', fired '%s'\n", expected, actual);
+    return ok;
+}
+
+int main() {
+    setup_default_uart();
+    PICOTEST_START();
+
+    low_irq = (uint)user_irq_claim_unused(true);
+    high_irq = (uint)user_irq_claim_unused(true);
+    irq_set_priority(low_irq, 0xc0);
+    irq_set_priority(high_irq, 0x40);
+
+    PICOTEST_START_SECTION("handlers are called in descending order priority");
+        irq_add_shared_handler(low_irq, handler_c, PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY);
+        irq_add_shared_handler(low_irq, handler_a, PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY);
+        irq_add_shared_chain_handler(low_irq, handler_b, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_add_shared_handler(high_irq, handler_h, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        PICOTEST_CHECK(irq_has_shared_handler(low_irq), "expected shared handlers");
+        PICOTEST_CHECK(!irq_get_exclusive_handler(low_irq), "expected no exclusive handler");
+        irq_set_enabled(low_irq, true);
+        irq_set_enabled(high_irq, true);
+        irq_clear_shared_handler_stats();
+        PICOTEST_CHECK(check_fire(low_irq, "abc"), "wrong handlers");
+        irq_shared_handler_stats_t stats[4];
+        PICOTEST_CHECK(irq_get_shared_handler_stats(low_irq, stats, 4) == 3, "expected three handlers");
+        PICOTEST_CHECK(stats[0].handler == handler_a && stats[1].handler == (irq_handler_t)handler_b &&
+                       stats[2].handler == handler_c, "stats not in order");
+        PICOTEST_CHECK(stats[0].count == 1 && stats[1].count == 1 && stats[2].count == 1, "wrong counts");
+        PICOTEST_CHECK(stats[2].max_cycles > stats[0].max_cycles, "handler_c should take longest");
+        PICOTEST_CHECK(stats[2].total_cycles == stats[2].max_cycles, "wrong total");
+        PICOTEST_CHECK(irq_get_shared_handler_max_depth() == 1, "expected no nesting");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("a chain handler can stop the chain");
+        stop_in_b = true;
+        PICOTEST_CHECK(check_fire(low_irq, "ab"), "wrong handlers");
+        stop_in_b = false;
+        PICOTEST_CHECK(check_fire(low_irq, "abc"), "wrong handlers");
+        irq_shared_handler_stats_t stats[3];
+        irq_get_shared_handler_stats(low_irq, stats, 3);
+        PICOTEST_CHECK(stats[1].count == 3 && stats[1].chain_stops == 1, "wrong chain stops");
+        PICOTEST_CHECK(stats[2].count == 2, "handler_c should have been skipped once");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("nesting depth");
+        raise_high_in_a = true;
+        PICOTEST_CHECK(check_fire(low_irq, "ahbc"), "higher priority IRQ should preempt");
+        irq_shared_handler_stats_t stats[1];
+        irq_get_shared_handler_stats(high_irq, stats, 1);
+        PICOTEST_CHECK(stats[0].count == 1 && stats[0].max_depth == 2, "handler_h should have run nested");
+        PICOTEST_CHECK(irq_get_shared_handler_max_depth() == 2, "expected nesting");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("handlers can remove themselves");
+        remove_b = true;
+        PICOTEST_CHECK(check_fire(low_irq, "abc"), "wrong handlers");
+        PICOTEST_CHECK(check_fire(low_irq, "ac"), "handler_b should be gone");
+        irq_remove_handler(low_irq, handler_a);
+        irq_remove_handler(low_irq, handler_c);
+        PICOTEST_CHECK(!irq_has_shared_handler(low_irq), "expected no shared handlers");
+        PICOTEST_CHECK(!irq_get_shared_handler_stats(low_irq, NULL, 0), "expected no handlers");
+        // the slots are reusable
+        irq_add_shared_handler(low_irq, handler_c, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        PICOTEST_CHECK(check_fire(low_irq, "c"), "wrong handlers");
+        irq_shared_handler_stats_t stats[1];
+        irq_get_shared_handler_stats(low_irq, stats, 1);
+        PICOTEST_CHECK(stats[0].count == 1, "a new handler should have fresh stats");
+        printf("handler_c: %"PRIu32" cycles\n", stats[0].max_cycles);
+        irq_remove_handler(low_irq, handler_c);
+        irq_remove_handler(high_irq, handler_h);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("handlers can remove later ones");
+        irq_add_shared_handler(low_irq, handler_a, 0xc0);
+        irq_add_shared_handler(low_irq, handler_c, 0x40);
+        remove_c_in_a = true;
+        PICOTEST_CHECK(check_fire(low_irq, "a"), "handler_c should not be called once removed");
+        PICOTEST_CHECK(check_fire(low_irq, "a"), "handler_c should be gone");
+        irq_remove_handler(low_irq, handler_a);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("a removed slot is not reused during a dispatch");
+        // were handler_h given handler_x's slot, the dispatch would carry on along high_irq's handlers rather than
+        // on to handler_c
+        irq_add_shared_handler(low_irq, handler_x, 0xc0);
+        irq_add_shared_handler(low_irq, handler_c, 0x40);
+        PICOTEST_CHECK(check_fire(low_irq, "xc"), "wrong handlers");
+        PICOTEST_CHECK(check_fire(high_irq, "h"), "handler_h should have been added");
+        PICOTEST_CHECK(check_fire(low_irq, "c"), "handler_x should be gone");
+        // once the dispatch is over, the slot is reused
+        irq_remove_handler(low_irq, handler_c);
+        irq_remove_handler(high_irq, handler_h);
+        for (uint i = 0; i < PICO_MAX_SHARED_IRQ_HANDLERS; i++) {
+            irq_add_shared_handler(low_irq, handler_c, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        }
+        for (uint i = 0; i < PICO_MAX_SHARED_IRQ_HANDLERS; i++) irq_remove_handler(low_irq, handler_c);
+        PICOTEST_CHECK(!irq_has_shared_handler(low_irq), "expected no shared handlers");
+    PICOTEST_END_SECTION();
+
+    irq_set_enabled(low_irq, false);
+    irq_set_enabled(high_irq, false);
+    user_irq_unclaim(low_irq);
+    user_irq_unclaim(high_irq);
+    PICOTEST_END_TEST();
+}
@@ -0,0 +1,188 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "invert.pio.h"
+
+PICOTEST_MODULE_NAME("PIO_DMA", "host emulation of PIO and DMA");
+
+#define NUM_WORDS 256u
+#define SQUARE_PIN 3u
+
+static uint32_t src[NUM_WORDS];
+static uint32_t dst[NUM_WORDS];
+
+static uint32_t crc32_reference(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (uint b = 0; b < 8; b++) crc = (crc & 1u) ? (crc >> 1) ^ 0xedb88320u : crc >> 1;
+    }
+    return ~crc;
+}
+
+static uint16_t crc16_ccitt_reference(const uint8_t *data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (uint b = 0; b < 8; b++) crc = (crc & 0x8000u) ? (uint16_t)((crc << 1) ^ 0x1021u) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static void fill_src(void) {
+    for (uint i = 0; i < NUM_WORDS; i++) src[i] = i * 0x9e3779b9u;
+    memset(dst, 0, sizeof(dst));
+}
+
+int main() {
+    stdio_init_all();
+    PICOTEST_START();
+
+    PIO pio = pio0;
+    uint offset = pio_add_program(pio, &invert_program);
+    uint sm = (uint)pio_claim_unused_sm(pio, true);
+    pio_sm_config c = invert_program_get_default_config(offset);
+    pio_sm_init(pio, sm, offset, &c);
+    pio_sm_set_enabled(pio, sm, true);
+
+    PICOTEST_START_SECTION("PIO FIFO round trip");
+        bool ok = true;
+        for (uint32_t i = 0; i < 100; i++) {
+            pio_sm_put_blocking(pio, sm, i * 12345u);
+            ok &= pio_sm_get_blocking(pio, sm) == ~(i * 12345u);
+        }
+        PICOTEST_CHECK(ok, "PIO did not return the inverted words");
+        PICOTEST_CHECK(pio_sm_is_rx_fifo_empty(pio, sm), "unexpected RX data");
+    PICOTEST_END_SECTION();
+
+    uint tx_chan = (uint)dma_claim_unused_channel(true);
+    uint rx_chan = (uint)dma_claim_unused_channel(true);
+
+    PICOTEST_START_SECTION("DMA through PIO with CRC32 sniffer");
+        fill_src();
+        dma_channel_config tc = dma_channel_get_default_config(tx_chan);
+        channel_config_set_dreq(&tc, pio_get_dreq(pio, sm, true));
+        channel_config_set_sniff_enable(&tc, true);
+        dma_channel_config rc = dma_channel_get_default_config(rx_chan);
+        channel_config_set_read_increment(&rc, false);
+        channel_config_set_write_increment(&rc, true);
+        channel_config_set_dreq(&rc, pio_get_dreq(pio, sm, false));
+        // the standard (reflected) CRC32
+        dma_sniffer_enable(tx_chan, 0x1, false);
+        dma_sniffer_set_output_reverse_enabled(true);
+        dma_sniffer_set_output_invert_enabled(true);
+        dma_sniffer_set_data_accumulator(0xffffffffu);
+        uint64_t t0 = pio_host_get_cycle_count();
+        dma_channel_configure(rx_chan, &rc, dst, &pio->rxf[sm], NUM_WORDS, true);
+        dma_channel_configure(tx_chan, &tc, &pio->txf[sm], src, NUM_WORDS, true);
+        dma_channel_wait_for_finish_blocking(rx_chan);
+        uint64_t cycles = pio_host_get_cycle_count() - t0;
+        printf("  %u words in %"PRIu64" cycles\n", NUM_WORDS, cycles);
+        bool match = true;
+        for (uint i = 0; i < NUM_WORDS; i++) match &= dst[i] == ~src[i];
+        PICOTEST_CHECK(match, "DMA data mismatch");
+        PICOTEST_CHECK(!dma_channel_is_busy(tx_chan), "TX channel still busy");
+        // the PIO program takes 3 cycles per word
+        PICOTEST_CHECK(cycles >= NUM_WORDS * 3 && cycles < NUM_WORDS * 3 + 20, "unexpected cycle count");
+        uint32_t crc = dma_sniffer_get_data_accumulator();
+        PICOTEST_CHECK(crc == crc32_reference((const uint8_t *)src, sizeof(src)), "sniffer CRC32 mismatch");
+        dma_sniffer_disable();
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("DMA CRC16 sniffer and IRQ status");
+        fill_src();
+        dma_channel_config cc = dma_channel_get_default_config(tx_chan);
+        channel_config_set_transfer_data_size(&cc, DMA_SIZE_8);
+        channel_config_set_write_increment(&cc, true);
+        channel_config_set_sniff_enable(&cc, true);
+        dma_sniffer_enable(tx_chan, 0x2, false);
+        dma_sniffer_set_data_accumulator(0);
+        dma_channel_set_irq0_enabled(tx_chan, true);
+        dma_channel_configure(tx_chan, &cc, dst, src, 100, true);
+        dma_channel_wait_for_finish_blocking(tx_chan);
+        PICOTEST_CHECK(!memcmp(dst, src, 100), "memory copy mismatch");
+        PICOTEST_CHECK(dma_sniffer_get_data_accumulator() == crc16_ccitt_reference((const uint8_t *)src, 100),
+                       "sniffer CRC16 mismatch");
+        PICOTEST_CHECK(dma_channel_get_irq0_status(tx_chan), "IRQ status not set");
+        dma_channel_acknowledge_irq0(tx_chan);
+        PICOTEST_CHECK(!dma_channel_get_irq0_status(tx_chan), "IRQ status not cleared");
+        dma_channel_set_irq0_enabled(tx_chan, false);
+        dma_sniffer_disable();
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("DMA ring and chain");
+        fill_src();
+        // the first channel repeats the first 4 words of src (a 16 byte ring) into dst, then chains to the
+        // second, which continues writing the next 8 words of src after it
+        static uint32_t __aligned(16) pattern[4] = {1, 2, 3, 4};
+        dma_channel_config ac = dma_channel_get_default_config(tx_chan);
+        channel_config_set_write_increment(&ac, true);
+        channel_config_set_ring(&ac, false, 4);
+        channel_config_set_chain_to(&ac, rx_chan);
+        dma_channel_config bc = dma_channel_get_default_config(rx_chan);
+        channel_config_set_write_increment(&bc, true);
+        dma_channel_configure(rx_chan, &bc, dst + 10, src, 8, false);
+        dma_channel_configure(tx_chan, &ac, dst, pattern, 10, true);
+        dma_channel_wait_for_finish_blocking(tx_chan);
+        dma_channel_wait_for_finish_blocking(rx_chan);
+        bool match = true;
+        for (uint i = 0; i < 10; i++) match &= dst[i] == pattern[i % 4];
+        PICOTEST_CHECK(match, "ring wrapping mismatch");
+        PICOTEST_CHECK(!memcmp(dst + 10, src, 8 * sizeof(uint32_t)), "chained channel mismatch");
+        PICOTEST_CHECK(dst[18] == 0, "chained channel overran");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("DMA timer pacing");
+        fill_src();
+        uint timer = (uint)dma_claim_unused_timer(true);
+        dma_timer_set_fraction(timer, 1, 10);
+        dma_channel_config pc = dma_channel_get_default_config(tx_chan);
+        channel_config_set_write_increment(&pc, true);
+        channel_config_set_dreq(&pc, dma_get_timer_dreq(timer));
+        uint64_t t0 = pio_host_get_cycle_count();
+        dma_channel_configure(tx_chan, &pc, dst, src, 50, true);
+        dma_channel_wait_for_finish_blocking(tx_chan);
+        uint64_t cycles = pio_host_get_cycle_count() - t0;
+        printf("  50 timer paced transfers in %"PRIu64" cycles\n", cycles);
+        PICOTEST_CHECK(cycles >= 500 && cycles <= 510, "unexpected timer pacing");
+        PICOTEST_CHECK(!memcmp(dst, src, 50 * sizeof(uint32_t)), "timer paced copy mismatch");
+        dma_host_channel_stats_t stats;
+        dma_host_get_channel_stats(tx_chan, &stats);
+        PICOTEST_CHECK(stats.dreq_wait_cycles >= 450, "DREQ wait cycles not counted");
+        dma_timer_unclaim(timer);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("PIO pins and clock divider");
+        uint sm2 = (uint)pio_claim_unused_sm(pio, true);
+        uint square_offset = pio_add_program(pio, &square_program);
+        pio_sm_config sc = square_program_get_default_config(square_offset);
+        sm_config_set_set_pins(&sc, SQUARE_PIN, 1);
+        sm_config_set_clkdiv_int_frac(&sc, 4, 0);
+        pio_sm_init(pio, sm2, square_offset, &sc);
+        pio_sm_set_consecutive_pindirs(pio, sm2, SQUARE_PIN, 1, true);
+        pio_sm_set_enabled(pio, sm2, true);
+        uint edges = 0;
+        bool last = false;
+        for (uint i = 0; i < 800; i++) {
+            pio_host_run_cycles(1);
+            bool level = pio_host_get_pins() & (1u << SQUARE_PIN);
+            edges += level && !last;
+            last = level;
+        }
+        // one rising edge every 8 cycles
+        PICOTEST_CHECK(edges == 100, "unexpected square wave frequency");
+        pio_sm_set_enabled(pio, sm2, false);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
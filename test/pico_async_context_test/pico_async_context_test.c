@@ -0,0 +1,266 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/async_context_base.h"
+#include "pico/multicore.h"
+#include "pico/test.h"
+
+PICOTEST_MODULE_NAME("ASYNC_CONTEXT", "async_context when pending worker test");
+
+// The async_context implementations aren't available on the host, so the test drives the common
+// async_context_base functions they are built on directly, with a context type which only has those
+
+static const async_context_type_t test_type = {
+        .type = ASYNC_CONTEXT_POLL,
+        .add_when_pending_worker = async_context_base_add_when_pending_worker,
+        .remove_when_pending_worker = async_context_base_remove_when_pending_worker,
+        .set_work_pending = async_context_base_set_work_pending,
+};
+
+static async_context_t context;
+
+typedef struct test_worker {
+    async_when_pending_worker_t worker;
+    uint index;
+    volatile uint runs;
+    // called from do_work after runs is incremented
+    void (*action)(struct test_worker *w);
+    struct test_worker *other;
+} test_worker_t;
+
+#define NUM_WORKERS 4
+
+static test_worker_t workers[NUM_WORKERS];
+
+static void do_work(__unused async_context_t *ctx, async_when_pending_worker_t *worker) {
+    test_worker_t *w = (test_worker_t *)worker;
+    w->runs++;
+    if (w->action) w->action(w);
+}
+
+static void reset_workers(void) {
+    for (uint i = 0; i < NUM_WORKERS; i++) {
+        async_context_remove_when_pending_worker(&context, &workers[i].worker);
+        memset(&workers[i], 0, sizeof(workers[i]));
+        workers[i].worker.do_work = do_work;
+        workers[i].index = i;
+    }
+}
+
+static void add_workers(void) {
+    for (uint i = 0; i < NUM_WORKERS; i++) {
+        async_context_add_when_pending_worker(&context, &workers[i].worker);
+    }
+}
+
+static bool runs_are(uint a, uint b, uint c, uint d) {
+    return workers[0].runs == a && workers[1].runs == b && workers[2].runs == c && workers[3].runs == d;
+}
+
+// core 1 marks the workers whose indexes it is sent, acknowledging each once it has done so
+static void core1_entry(void) {
+    while (true) {
+        uint32_t index = multicore_fifo_pop_blocking();
+        async_context_set_work_pending(&context, &workers[index].worker);
+        multicore_fifo_push_blocking(index);
+    }
+}
+
+static void mark_from_core1(test_worker_t *w) {
+    multicore_fifo_push_blocking(w->index);
+    multicore_fifo_pop_blocking();
+}
+
+static void remark_directly(test_worker_t *w) {
+    if (w->runs < 3) w->worker.work_pending = true;
+}
+
+static void remark_via_api(test_worker_t *w) {
+    if (w->runs < 3) async_context_set_work_pending(&context, &w->worker);
+}
+
+static bool other_was_waiting;
+
+static void mark_self_and_other_from_core1(test_worker_t *w) {
+    if (w->runs == 1) {
+        other_was_waiting = !w->other->runs;
+        mark_from_core1(w);
+        mark_from_core1(w->other);
+    }
+}
+
+static void remove_other(test_worker_t *w) {
+    async_context_remove_when_pending_worker(&context, &w->other->worker);
+}
+
+static void remove_self(test_worker_t *w) {
+    async_context_remove_when_pending_worker(&context, &w->worker);
+}
+
+static void mark_other_and_nest(test_worker_t *w) {
+    async_context_set_work_pending(&context, &w->other->worker);
+    async_context_base_execute_once(&context);
+}
+
+int main() {
+    stdio_init_all();
+    PICOTEST_START();
+
+    context.type = &test_type;
+    async_context_base_init(&context);
+    multicore_launch_core1(core1_entry);
+
+    PICOTEST_START_SECTION("only marked workers are run, once per execution");
+        reset_workers();
+        add_workers();
+        PICOTEST_CHECK(!async_context_base_needs_servicing(&context), "needs servicing with nothing marked");
+        async_context_set_work_pending(&context, &workers[1].worker);
+        async_context_set_work_pending(&context, &workers[3].worker);
+        async_context_set_work_pending(&context, &workers[3].worker);
+        PICOTEST_CHECK(async_context_base_needs_servicing(&context), "doesn't need servicing with workers marked");
+        async_context_base_execute_once(&context);
+        PICOTEST_CHECK(runs_are(0, 1, 0, 1), "wrong workers run");
+        PICOTEST_CHECK(!async_context_base_needs_servicing(&context), "still needs servicing");
+        async_context_base_execute_once(&context);
+        PICOTEST_CHECK(runs_are(0, 1, 0, 1), "workers run again");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("workers marked before they are added");
+        reset_workers();
+        workers[0].worker.work_pending = true;
+        async_context_set_work_pending(&context, &workers[2].worker);
+        PICOTEST_CHECK(!async_context_base_needs_servicing(&context), "needs servicing with no workers added");
+        add_workers();
+        PICOTEST_CHECK(async_context_base_needs_servicing(&context), "doesn't need servicing");
+        async_context_base_execute_once(&context);
+        PICOTEST_CHECK(runs_are(1, 0, 1, 0), "pending workers not run when added");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("workers which re-mark themselves from do_work run again on the next execution");
+        reset_workers();
+        workers[0].action = remark_directly;
+        workers[1].action = remark_via_api;
+        add_workers();
+        async_context_set_work_pending(&context, &workers[0].worker);
+        async_context_set_work_pending(&context, &workers[1].worker);
+        for (uint i = 1; i <= 3; i++) {
+            async_context_base_execute_once(&context);
+            PICOTEST_CHECK(runs_are(i, i, 0, 0), "wrong number of runs");
+            PICOTEST_CHECK(async_context_base_needs_servicing(&context) == (i < 3), "wrong needs servicing");
+        }
+        async_context_base_execute_once(&context);
+        PICOTEST_CHECK(runs_are(3, 3, 0, 0), "run after no longer re-marked");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("workers marked from core 1 during an execution");
+        reset_workers();
+        workers[0].action = mark_self_and_other_from_core1;
+        workers[0].other = &workers[1];
+        add_workers();
+        async_context_set_work_pending(&context, &workers[0].worker);
+        async_context_base_execute_once(&context);
+        PICOTEST_CHECK(runs_are(1, 0, 0, 0), "workers marked during the execution run by it");
+        PICOTEST_CHECK(async_context_base_needs_servicing(&context), "doesn't need servicing");
+        async_context_base_execute_once(&context);
+        PICOTEST_CHECK(runs_are(2, 1, 0, 0), "workers marked during the previous execution not run");
+        PICOTEST_CHECK(!async_context_base_needs_servicing(&context), "still needs servicing");
+
+        // marking a worker which is still waiting to run in the current execution has no further effect
+        reset_workers();
+        workers[0].action = mark_self_and_other_from_core1;
+        workers[0].other = &workers[2];
+        add_workers();
+        async_context_set_work_pending(&context, &workers[2].worker);
+        async_context_set_work_pending(&context, &workers[0].worker);
+        async_context_base_execute_once(&context);
+        async_context_base_execute_once(&context);
+        PICOTEST_CHECK(runs_are(2, 0, other_was_waiting ? 1 : 2, 0), "wrong number of runs");
+
+        // and when idle
+        mark_from_core1(&workers[3]);
+        async_context_base_execute_once(&context);
+        PICOTEST_CHECK(runs_are(2, 0, other_was_waiting ? 1 : 2, 1), "worker marked from core 1 not run");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("workers removed while waiting for the next execution");
+        for (uint removed = 0; removed < 3; removed++) {
+            reset_workers();
+            add_workers();
+            for (uint i = 0; i < 3; i++) async_context_set_work_pending(&context, &workers[i].worker);
+            async_context_remove_when_pending_worker(&context, &workers[removed].worker);
+            async_context_base_execute_once(&context);
+            PICOTEST_CHECK(runs_are(removed != 0, removed != 1, removed != 2, 0), "wrong workers run");
+            PICOTEST_CHECK(!async_context_base_needs_servicing(&context), "still needs servicing");
+        }
+        reset_workers();
+        add_workers();
+        async_context_set_work_pending(&context, &workers[0].worker);
+        async_context_remove_when_pending_worker(&context, &workers[0].worker);
+        PICOTEST_CHECK(!async_context_base_needs_servicing(&context), "needs servicing after the only worker removed");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("workers removed during an execution");
+        reset_workers();
+        workers[0].action = remove_other;
+        workers[0].other = &workers[1];
+        workers[1].action = remove_other;
+        workers[1].other = &workers[0];
+        add_workers();
+        async_context_set_work_pending(&context, &workers[0].worker);
+        async_context_set_work_pending(&context, &workers[1].worker);
+        async_context_set_work_pending(&context, &workers[2].worker);
+        async_context_base_execute_once(&context);
+        PICOTEST_CHECK(workers[0].runs + workers[1].runs == 1, "worker removed by another run anyway");
+        PICOTEST_CHECK(workers[2].runs == 1, "remaining worker not run");
+        PICOTEST_CHECK(!async_context_base_needs_servicing(&context), "still needs servicing");
+
+        // a worker removing itself, even though it is marked again
+        reset_workers();
+        workers[0].action = remove_self;
+        add_workers();
+        async_context_set_work_pending(&context, &workers[0].worker);
+        async_context_set_work_pending(&context, &workers[1].worker);
+        async_context_base_execute_once(&context);
+        async_context_set_work_pending(&context, &workers[0].worker);
+        PICOTEST_CHECK(!async_context_base_needs_servicing(&context), "needs servicing after worker removed itself");
+        async_context_base_execute_once(&context);
+        PICOTEST_CHECK(runs_are(1, 1, 0, 0), "wrong number of runs");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("nested executions continue with the remaining workers");
+        reset_workers();
+        workers[0].action = mark_other_and_nest;
+        workers[0].other = &workers[3];
+        add_workers();
+        for (uint i = 0; i < 3; i++) async_context_set_work_pending(&context, &workers[i].worker);
+        async_context_base_execute_once(&context);
+        // the worker marked before nesting is run by the nested execution only if there were no others left to run
+        PICOTEST_CHECK(runs_are(1, 1, 1, workers[3].runs) && workers[3].runs <= 1, "wrong number of runs");
+        async_context_base_execute_once(&context);
+        PICOTEST_CHECK(runs_are(1, 1, 1, 1), "worker marked before nesting not run");
+        PICOTEST_CHECK(!async_context_base_needs_servicing(&context), "still needs servicing");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("workers with work_pending set directly once added");
+        reset_workers();
+        add_workers();
+        workers[1].worker.work_pending = true;
+        async_context_base_execute_once(&context);
+#if PICO_ASYNC_CONTEXT_SCAN_WHEN_PENDING_WORKERS
+        PICOTEST_CHECK(runs_are(0, 1, 0, 0), "worker not found by the scan");
+        PICOTEST_CHECK(!async_context_base_needs_servicing(&context), "still needs servicing");
+#else
+        // are not run (use async_context_set_work_pending)
+        PICOTEST_CHECK(runs_are(0, 0, 0, 0), "worker run");
+#endif
+    PICOTEST_END_SECTION();
+
+    reset_workers();
+    PICOTEST_END_TEST();
+}
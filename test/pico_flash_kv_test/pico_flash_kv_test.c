@@ -0,0 +1,283 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+#include "pico/flash_kv.h"
+#include "hardware/flash.h"
+
+PICOTEST_MODULE_NAME("FLASH_KV", "flash key value store");
+
+#define NUM_SECTORS 8u
+#define STORE_OFFSET (PICO_FLASH_SIZE_BYTES - NUM_SECTORS * FLASH_SECTOR_SIZE)
+
+static flash_kv_t kv;
+
+static void erase_store(void) {
+    flash_range_erase(STORE_OFFSET, NUM_SECTORS * FLASH_SECTOR_SIZE);
+}
+
+static bool check_value(const char *key, const void *expected, size_t len) {
+    uint8_t buf[PICO_FLASH_KV_MAX_VALUE_SIZE];
+    int rc = flash_kv_get(&kv, key, buf, sizeof(buf));
+    return rc == (int)len && !memcmp(buf, expected, len);
+}
+
+static bool check_u32(const char *key, uint32_t expected) {
+    return check_value(key, &expected, sizeof(expected));
+}
+
+static int set_u32(const char *key, uint32_t value) {
+    return flash_kv_set(&kv, key, &value, sizeof(value));
+}
+
+// k0-k2 are updated most of the time and k3-k6 only now and then, so garbage collections have records to copy
+static uint power_fail_key(uint n) {
+    return n % 4 ? n % 3 : n % 7;
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t next_rand(void) {
+    rand_state = rand_state * 1664525u + 1013904223u;
+    return rand_state >> 8;
+}
+
+int main() {
+    stdio_init_all();
+    PICOTEST_START();
+
+    PICOTEST_START_SECTION("set, get and delete");
+        erase_store();
+        PICOTEST_CHECK(flash_kv_init(&kv, STORE_OFFSET, NUM_SECTORS) == PICO_OK, "init failed");
+        PICOTEST_CHECK(flash_kv_count(&kv) == 0, "fresh store not empty");
+        PICOTEST_CHECK(flash_kv_set(&kv, "name", "pico", 4) == PICO_OK, "set failed");
+        PICOTEST_CHECK(set_u32("counter", 1) == PICO_OK, "set failed");
+        PICOTEST_CHECK(check_value("name", "pico", 4), "wrong value");
+        PICOTEST_CHECK(set_u32("counter", 2) == PICO_OK, "overwrite failed");
+        PICOTEST_CHECK(check_u32("counter", 2), "wrong overwritten value");
+        PICOTEST_CHECK(flash_kv_count(&kv) == 2, "wrong count");
+        size_t len;
+        const char *p = flash_kv_get_ptr(&kv, "name", &len);
+        PICOTEST_CHECK(p && len == 4 && !memcmp(p, "pico", 4), "get_ptr failed");
+        PICOTEST_CHECK(flash_kv_get_ptr(&kv, "nothing", &len) == NULL, "get_ptr of a missing key");
+        char small[2];
+        PICOTEST_CHECK(flash_kv_get(&kv, "name", small, sizeof(small)) == 4 && small[1] == 'i', "truncated get failed");
+        PICOTEST_CHECK(flash_kv_set(&kv, "empty", NULL, 0) == PICO_OK && check_value("empty", NULL, 0),
+                       "empty value failed");
+        PICOTEST_CHECK(flash_kv_delete(&kv, "empty") == PICO_OK, "delete failed");
+        PICOTEST_CHECK(flash_kv_get(&kv, "empty", small, sizeof(small)) == PICO_ERROR_NO_DATA, "deleted key found");
+        PICOTEST_CHECK(flash_kv_delete(&kv, "empty") == PICO_ERROR_NO_DATA, "deleted twice");
+        PICOTEST_CHECK(flash_kv_count(&kv) == 2, "wrong count after delete");
+        // an unchanged value is not written again
+        flash_kv_stats_t before, after;
+        flash_kv_get_stats(&kv, &before);
+        PICOTEST_CHECK(set_u32("counter", 2) == PICO_OK, "set failed");
+        flash_kv_get_stats(&kv, &after);
+        PICOTEST_CHECK(after.pages_programmed == before.pages_programmed, "unchanged value was written");
+        PICOTEST_CHECK(flash_kv_set(&kv, "", "x", 1) == PICO_ERROR_INVALID_ARG, "empty key accepted");
+        static uint8_t big[PICO_FLASH_KV_MAX_VALUE_SIZE + 1];
+        PICOTEST_CHECK(flash_kv_set(&kv, "big", big, sizeof(big)) == PICO_ERROR_INVALID_ARG, "oversize value accepted");
+        PICOTEST_CHECK(flash_kv_init(&kv, STORE_OFFSET + 1, NUM_SECTORS) == PICO_ERROR_INVALID_ARG,
+                       "unaligned store accepted");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("reload");
+        PICOTEST_CHECK(flash_kv_init(&kv, STORE_OFFSET, NUM_SECTORS) == PICO_OK, "init failed");
+        PICOTEST_CHECK(flash_kv_count(&kv) == 2, "wrong count after reload");
+        PICOTEST_CHECK(check_value("name", "pico", 4) && check_u32("counter", 2), "wrong values after reload");
+        PICOTEST_CHECK(flash_kv_get_ptr(&kv, "empty", &(size_t){0}) == NULL, "deleted key back after reload");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("garbage collection and wear levelling");
+        erase_store();
+        flash_host_reset_stats();
+        flash_kv_init(&kv, STORE_OFFSET, NUM_SECTORS);
+        // cold keys written once, hot keys updated many times
+        bool ok = true;
+        for (uint i = 0; i < 20; i++) {
+            char key[16];
+            snprintf(key, sizeof(key), "cold%u", i);
+            ok &= set_u32(key, i * 1000) == PICO_OK;
+        }
+        uint32_t hot[8] = {0};
+        bool temp_set = false;
+        for (uint n = 0; n < 20000; n++) {
+            uint i = next_rand() % count_of(hot);
+            char key[16];
+            snprintf(key, sizeof(key), "hot%u", i);
+            hot[i] = n;
+            uint32_t value[8] = {n, n, n, n, n, n, n, n};
+            ok &= flash_kv_set(&kv, key, value, sizeof(value)) == PICO_OK;
+            // deletes of some short lived keys
+            if (n % 97 == 0) {
+                ok &= set_u32("temp", n) == PICO_OK;
+                temp_set = true;
+            } else if (n % 97 == 50) {
+                ok &= flash_kv_delete(&kv, "temp") == PICO_OK;
+                temp_set = false;
+            }
+        }
+        PICOTEST_CHECK(ok, "set failed");
+        flash_kv_stats_t stats;
+        flash_kv_get_stats(&kv, &stats);
+        PICOTEST_CHECK(stats.gc_count > 0, "no garbage collection");
+        printf("  %"PRIu32" sectors collected, erase counts %"PRIu32"..%"PRIu32"\n", stats.gc_count,
+               stats.min_erase_count, stats.max_erase_count);
+        PICOTEST_CHECK(stats.max_erase_count - stats.min_erase_count <= PICO_FLASH_KV_WEAR_LEVEL_THRESHOLD + 1,
+                       "wear not levelled");
+        for (uint pass = 0; pass < 2; pass++) {
+            ok = flash_kv_count(&kv) == 20 + count_of(hot) + temp_set;
+            for (uint i = 0; i < 20; i++) {
+                char key[16];
+                snprintf(key, sizeof(key), "cold%u", i);
+                ok &= check_u32(key, i * 1000);
+            }
+            for (uint i = 0; i < count_of(hot); i++) {
+                char key[16];
+                snprintf(key, sizeof(key), "hot%u", i);
+                uint32_t value[8] = {hot[i], hot[i], hot[i], hot[i], hot[i], hot[i], hot[i], hot[i]};
+                ok &= check_value(key, value, sizeof(value));
+            }
+            PICOTEST_CHECK(ok, pass ? "wrong values after reload" : "wrong values");
+            flash_kv_init(&kv, STORE_OFFSET, NUM_SECTORS);
+        }
+        // the emulated flash agrees with the store's own erase counts
+        uint32_t max_erases = 0;
+        for (uint s = 0; s < NUM_SECTORS; s++) {
+            max_erases = MAX(max_erases, flash_host_get_sector_erase_count(STORE_OFFSET / FLASH_SECTOR_SIZE + s));
+        }
+        PICOTEST_CHECK(max_erases == stats.max_erase_count, "erase counts differ");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("full store");
+        erase_store();
+        flash_kv_init(&kv, STORE_OFFSET, 2);
+        static uint8_t value[PICO_FLASH_KV_MAX_VALUE_SIZE];
+        int rc = PICO_OK;
+        uint n;
+        for (n = 0; n < 10 && rc == PICO_OK; n++) {
+            char key[16];
+            snprintf(key, sizeof(key), "v%u", n);
+            rc = flash_kv_set(&kv, key, value, sizeof(value));
+        }
+        PICOTEST_CHECK(rc == PICO_ERROR_INSUFFICIENT_RESOURCES && n == 4, "store did not fill as expected");
+        // existing values can still be deleted, making space again
+        PICOTEST_CHECK(flash_kv_delete(&kv, "v0") == PICO_OK, "delete in full store failed");
+        PICOTEST_CHECK(flash_kv_set(&kv, "v9", value, sizeof(value)) == PICO_OK, "set after delete failed");
+        PICOTEST_CHECK(flash_kv_count(&kv) == 3, "wrong count");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("power failure");
+        // lose power at every point of a sequence of updates which runs until the store has been garbage collected
+        // twice: afterwards each key must have its value from before the update in progress, or after it, and the
+        // store must still have a spare sector, so further updates can be made
+        bool ok = true;
+        uint fail_points = 0, gc_fail_points = 0;
+        static uint8_t value[200];
+        for (int32_t fail_after = 0; ok; fail_after++) {
+            erase_store();
+            flash_kv_init(&kv, STORE_OFFSET, 3);
+            flash_host_set_power_fail_after(fail_after);
+            // update n sets key power_fail_key(n) to a value full of n, except that every 11th deletes it instead (0 if
+            // unset)
+            uint8_t state[7] = {0};
+            uint done = 0;
+            flash_kv_stats_t before, after;
+            for (uint n = 1; !flash_host_is_power_failed(); n++) {
+                flash_kv_get_stats(&kv, &before);
+                if (before.gc_count >= 2) break;
+                char key[8];
+                snprintf(key, sizeof(key), "k%u", power_fail_key(n));
+                if (n % 11) {
+                    memset(value, (int)n, sizeof(value));
+                    flash_kv_set(&kv, key, value, sizeof(value));
+                } else {
+                    flash_kv_delete(&kv, key);
+                }
+                if (!flash_host_is_power_failed()) {
+                    state[power_fail_key(n)] = (uint8_t)(n % 11 ? n : 0);
+                    done = n;
+                }
+            }
+            bool failed = flash_host_is_power_failed();
+            // (not counting a failure on the first copy of a collection)
+            flash_kv_get_stats(&kv, &after);
+            if (failed && after.records_copied != before.records_copied) gc_fail_points++;
+            flash_host_set_power_fail_after(-1);
+            ok &= flash_kv_init(&kv, STORE_OFFSET, 3) == PICO_OK;
+            uint next = done + 1;
+            for (uint i = 0; i < 7; i++) {
+                char key[8];
+                snprintf(key, sizeof(key), "k%u", i);
+                size_t len = 0;
+                const uint8_t *v = flash_kv_get_ptr(&kv, key, &len);
+                uint k = v ? v[0] : 0;
+                bool in_progress = failed && power_fail_key(next) == i && k == (next % 11 ? next : 0);
+                ok &= k == state[i] || in_progress;
+                if (v) {
+                    memset(value, (int)k, sizeof(value));
+                    ok &= len == sizeof(value) && !memcmp(v, value, sizeof(value));
+                }
+            }
+            // and the store still works, through further garbage collections
+            for (uint n = 0; n < 100; n++) {
+                char key[8];
+                snprintf(key, sizeof(key), "k%u", n % 7);
+                memset(value, (int)n, sizeof(value));
+                ok &= flash_kv_set(&kv, key, value, sizeof(value)) == PICO_OK && check_value(key, value, sizeof(value));
+            }
+            if (!ok) printf("  failed with power lost after %d operations\n", (int)fail_after);
+            if (!failed) break;
+            fail_points++;
+        }
+        printf("  recovered from power failure at %u points, %u during garbage collection\n", fail_points,
+               gc_fail_points);
+        PICOTEST_CHECK(ok, "bad state after power failure");
+        PICOTEST_CHECK(gc_fail_points, "no power failure during garbage collection");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("benchmark");
+        erase_store();
+        flash_host_reset_stats();
+        flash_kv_init(&kv, STORE_OFFSET, NUM_SECTORS);
+        char keys[64][16];
+        for (uint i = 0; i < count_of(keys); i++) snprintf(keys[i], sizeof(keys[i]), "key%u", i);
+        uint8_t value[16];
+        for (uint n = 0; n < 10000; n++) {
+            memset(value, (int)n, sizeof(value));
+            flash_kv_set(&kv, keys[next_rand() % count_of(keys)], value, sizeof(value));
+        }
+        flash_kv_stats_t stats;
+        flash_kv_get_stats(&kv, &stats);
+        flash_host_stats_t flash_stats;
+        flash_host_get_stats(&flash_stats);
+        uint64_t flash_bytes = flash_stats.pages_programmed * FLASH_PAGE_SIZE;
+        printf("  10000 updates of 16 byte values: %"PRIu32" user bytes, %"PRIu32" record bytes, "
+               "%"PRIu64" pages programmed, %"PRIu64" sectors erased\n",
+               stats.user_bytes_written, stats.bytes_appended, flash_stats.pages_programmed, flash_stats.sectors_erased);
+        // the page programs include the separate programming of each record's commit word
+        printf("  write amplification: %.2f (record bytes), %.2f (page bytes); %.1f updates per sector erase\n",
+               (double)stats.bytes_appended / stats.user_bytes_written, (double)flash_bytes / stats.user_bytes_written,
+               10000.0 / (double)flash_stats.sectors_erased);
+        PICOTEST_CHECK(flash_stats.sectors_erased == stats.sectors_erased, "erase counts differ");
+        uint64_t t0 = time_us_64();
+        uint found = 0;
+        for (uint n = 0; n < 1000000; n++) {
+            size_t len;
+            found += flash_kv_get_ptr(&kv, keys[n % count_of(keys)], &len) != NULL;
+        }
+        uint64_t t1 = time_us_64();
+        printf("  lookup: %.1f ns\n", (double)(t1 - t0) * 1000.0 / 1000000);
+        PICOTEST_CHECK(found == 1000000, "lookup failed");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
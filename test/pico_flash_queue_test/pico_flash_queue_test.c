@@ -0,0 +1,184 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+#include "pico/flash_queue.h"
+#include "hardware/flash.h"
+
+PICOTEST_MODULE_NAME("FLASH_QUEUE", "flash write coalescing queue");
+
+#define CALL_US 50
+#define PAGE_PROGRAM_US 400
+#define SECTOR_ERASE_US 45000
+
+#define AREA_OFFSET (PICO_FLASH_SIZE_BYTES - 4 * FLASH_SECTOR_SIZE)
+#define AREA_SIZE (2 * FLASH_SECTOR_SIZE)
+
+static flash_queue_t q;
+// what the area should contain
+static uint8_t expected[AREA_SIZE];
+
+static bool check_flash(void) {
+    return !memcmp(flash_host_get_contents() + AREA_OFFSET, expected, AREA_SIZE);
+}
+
+static bool check_read(void) {
+    static uint8_t buf[AREA_SIZE];
+    flash_queue_read(&q, AREA_OFFSET, buf, AREA_SIZE);
+    return !memcmp(buf, expected, AREA_SIZE);
+}
+
+static int queue_write(uint32_t offs, const void *data, size_t count) {
+    int rc = flash_queue_write(&q, AREA_OFFSET + offs, data, count);
+    if (rc == PICO_OK) {
+        for (size_t i = 0; i < count; i++) expected[offs + i] &= ((const uint8_t *)data)[i];
+    }
+    return rc;
+}
+
+int main() {
+    PICOTEST_START();
+    flash_host_set_timing(CALL_US, PAGE_PROGRAM_US, SECTOR_ERASE_US);
+    flash_range_erase(AREA_OFFSET, AREA_SIZE);
+    memset(expected, 0xff, sizeof(expected));
+    flash_host_reset_stats();
+
+    flash_queue_config_t config = flash_queue_get_default_config();
+    config.call_us = CALL_US;
+    config.page_program_us = PAGE_PROGRAM_US;
+    config.sector_erase_us = SECTOR_ERASE_US;
+    flash_queue_init(&q, &config);
+
+    PICOTEST_START_SECTION("argument checks");
+        uint8_t b = 0;
+        PICOTEST_CHECK(flash_queue_write(&q, PICO_FLASH_SIZE_BYTES - 1, &b, 2) == PICO_ERROR_INVALID_ARG, "write past the end");
+        PICOTEST_CHECK(flash_queue_erase(&q, AREA_OFFSET + 1, FLASH_SECTOR_SIZE) == PICO_ERROR_INVALID_ARG, "unaligned erase");
+        PICOTEST_CHECK(flash_queue_erase(&q, AREA_OFFSET, FLASH_PAGE_SIZE) == PICO_ERROR_INVALID_ARG, "partial sector erase");
+        PICOTEST_CHECK(flash_queue_is_empty(&q), "queue not empty");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("small writes coalesce");
+        // a log of 16 byte records, written one at a time across four pages
+        for (uint i = 0; i < 4 * FLASH_PAGE_SIZE / 16; i++) {
+            uint8_t rec[16];
+            for (uint j = 0; j < sizeof(rec); j++) rec[j] = (uint8_t)(i * 7 + j);
+            PICOTEST_CHECK(queue_write(i * 16, rec, sizeof(rec)) == PICO_OK, "write failed");
+        }
+        // overlapping and unaligned writes, straddling a page boundary
+        static const uint8_t pattern[] = {0x0f, 0x3c, 0x00, 0x81, 0x7e, 0x55, 0xaa, 0x11, 0x22};
+        PICOTEST_CHECK(queue_write(FLASH_PAGE_SIZE - 4, pattern, sizeof(pattern)) == PICO_OK, "write failed");
+        PICOTEST_CHECK(queue_write(FLASH_PAGE_SIZE - 2, pattern, sizeof(pattern)) == PICO_OK, "write failed");
+        PICOTEST_CHECK(q.page_count == 4, "expected four pending pages");
+        PICOTEST_CHECK(check_read(), "queued read mismatch");
+        flash_queue_flush(&q);
+        PICOTEST_CHECK(flash_queue_is_empty(&q), "queue not empty");
+        PICOTEST_CHECK(check_flash(), "flash mismatch");
+        flash_host_stats_t fs;
+        flash_host_get_stats(&fs);
+        PICOTEST_CHECK(fs.pages_programmed == 4, "each page should be programmed once");
+        flash_queue_stats_t s;
+        flash_queue_get_stats(&q, &s);
+        PICOTEST_CHECK(s.slices == 1, "the four adjacent pages should be programmed together");
+        PICOTEST_CHECK(s.pages_programmed == 4 && s.writes == 66, "unexpected stats");
+        PICOTEST_CHECK(s.max_blackout_us == CALL_US + 4 * PAGE_PROGRAM_US, "unexpected blackout");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("erase discards queued writes");
+        uint8_t data[32];
+        memset(data, 0x5a, sizeof(data));
+        PICOTEST_CHECK(queue_write(FLASH_SECTOR_SIZE + 100, data, sizeof(data)) == PICO_OK, "write failed");
+        PICOTEST_CHECK(flash_queue_erase(&q, AREA_OFFSET, FLASH_SECTOR_SIZE) == PICO_OK, "erase failed");
+        memset(expected, 0xff, FLASH_SECTOR_SIZE);
+        PICOTEST_CHECK(q.page_count == 1, "only the page in the other sector should remain");
+        // a write after the erase must survive it
+        memset(data, 0xa5, sizeof(data));
+        PICOTEST_CHECK(queue_write(200, data, sizeof(data)) == PICO_OK, "write failed");
+        PICOTEST_CHECK(check_read(), "queued read mismatch");
+        flash_queue_flush(&q);
+        PICOTEST_CHECK(check_flash(), "flash mismatch");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("full queue");
+        flash_queue_init(&q, &config);
+        uint8_t data[1] = {0};
+        for (uint i = 0; i < PICO_FLASH_QUEUE_MAX_PAGES; i++) {
+            PICOTEST_CHECK(queue_write(i * FLASH_PAGE_SIZE + 1, data, 1) == PICO_OK, "write failed");
+        }
+        // a write to a page already queued still fits; one needing a new page does not, and queues nothing
+        PICOTEST_CHECK(queue_write(0, data, 1) == PICO_OK, "write failed");
+        static uint8_t big[2 * FLASH_PAGE_SIZE];
+        PICOTEST_CHECK(queue_write((PICO_FLASH_QUEUE_MAX_PAGES - 1) * FLASH_PAGE_SIZE, big, sizeof(big)) == PICO_ERROR_INSUFFICIENT_RESOURCES, "expected full");
+        PICOTEST_CHECK(check_read(), "queued read mismatch");
+        flash_queue_flush(&q);
+        PICOTEST_CHECK(check_flash(), "flash mismatch");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("budgeted runs bound the blackout");
+        config.max_slice_us = 2000;
+        flash_queue_init(&q, &config);
+        PICOTEST_CHECK(flash_queue_erase(&q, AREA_OFFSET, AREA_SIZE) == PICO_OK, "erase failed");
+        memset(expected, 0xff, sizeof(expected));
+        static uint8_t data[PICO_FLASH_QUEUE_MAX_PAGES * FLASH_PAGE_SIZE];
+        for (uint i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(i ^ (i >> 8));
+        PICOTEST_CHECK(queue_write(FLASH_SECTOR_SIZE, data, sizeof(data)) == PICO_OK, "write failed");
+        // nothing fits in a tiny budget
+        PICOTEST_CHECK(!flash_queue_run(&q, 100), "should not have finished");
+        flash_queue_stats_t s;
+        flash_queue_get_stats(&q, &s);
+        PICOTEST_CHECK(!s.slices, "nothing should have run");
+        // the erases each exceed the slice limit, so go one at a time; the pages four at a time
+        uint runs = 0;
+        while (!flash_queue_run(&q, 50000)) runs++;
+        flash_queue_get_stats(&q, &s);
+        PICOTEST_CHECK(s.sectors_erased == 2 && s.slices == 2 + PICO_FLASH_QUEUE_MAX_PAGES / 4, "unexpected slices");
+        PICOTEST_CHECK(s.max_blackout_us == CALL_US + SECTOR_ERASE_US, "unexpected blackout");
+        PICOTEST_CHECK(check_flash(), "flash mismatch");
+        printf("%u runs, %"PRIu32" slices\n", runs + 1, s.slices);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("time saved");
+        // a naive baseline: each small write programmed as it happens
+        flash_range_erase(AREA_OFFSET, AREA_SIZE);
+        uint64_t t0 = time_us_64();
+        uint32_t naive_max = 0;
+        for (uint i = 0; i < AREA_SIZE / 64; i++) {
+            uint8_t page[FLASH_PAGE_SIZE];
+            memset(page, 0xff, sizeof(page));
+            memset(page + (i * 64) % FLASH_PAGE_SIZE, (uint8_t)i, 64);
+            uint64_t t = time_us_64();
+            flash_range_program(AREA_OFFSET + (i * 64 & ~(FLASH_PAGE_SIZE - 1)), page, FLASH_PAGE_SIZE);
+            naive_max = MAX(naive_max, (uint32_t)(time_us_64() - t));
+        }
+        uint64_t naive_us = time_us_64() - t0;
+
+        flash_range_erase(AREA_OFFSET, AREA_SIZE);
+        memset(expected, 0xff, sizeof(expected));
+        flash_queue_init(&q, &config);
+        for (uint i = 0; i < AREA_SIZE / 64; i++) {
+            uint8_t rec[64];
+            memset(rec, (uint8_t)i, sizeof(rec));
+            if (queue_write(i * 64, rec, sizeof(rec)) == PICO_ERROR_INSUFFICIENT_RESOURCES) {
+                flash_queue_flush(&q);
+                PICOTEST_CHECK(queue_write(i * 64, rec, sizeof(rec)) == PICO_OK, "write failed");
+            }
+        }
+        flash_queue_flush(&q);
+        PICOTEST_CHECK(check_flash(), "flash mismatch");
+        flash_queue_stats_t s;
+        flash_queue_get_stats(&q, &s);
+        PICOTEST_CHECK(s.max_blackout_us <= config.max_slice_us, "blackout exceeds the slice limit");
+        PICOTEST_CHECK(s.program_us < naive_us, "queueing should take less time");
+        PICOTEST_CHECK(s.blackout_us_saved == naive_us - s.program_us, "saved estimate should match the baseline");
+        printf("naive: %"PRIu64"us in %u calls (max %"PRIu32"us), queued: %"PRIu64"us in %"PRIu32" slices (max %"PRIu32"us), estimated saving %"PRIu64"us\n",
+               naive_us, AREA_SIZE / 64, naive_max, s.program_us, s.slices, s.max_blackout_us, s.blackout_us_saved);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
@@ -0,0 +1,186 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+#include "pico/i2c_slave.h"
+
+PICOTEST_MODULE_NAME("I2C_SLAVE", "I2C slave buffered mode test");
+
+#define SLAVE_ADDR 0x17
+#define slave_i2c i2c0
+#define master_i2c i2c1
+
+static uint8_t regs[256];
+
+static uint transfer_count;
+static i2c_slave_event_t last_event;
+static uint last_offset, last_length;
+
+static void transfer_handler(__unused i2c_inst_t *i2c, i2c_slave_event_t event, uint offset, uint length) {
+    transfer_count++;
+    last_event = event;
+    last_offset = offset;
+    last_length = length;
+}
+
+// the per byte equivalent, as in the slave_mem_i2c example
+static struct {
+    uint8_t addr;
+    bool addr_written;
+} legacy;
+
+static void legacy_handler(i2c_inst_t *i2c, i2c_slave_event_t event) {
+    switch (event) {
+        case I2C_SLAVE_RECEIVE:
+            if (!legacy.addr_written) {
+                legacy.addr = i2c_read_byte_raw(i2c);
+                legacy.addr_written = true;
+            } else {
+                regs[legacy.addr++] = i2c_read_byte_raw(i2c);
+            }
+            break;
+        case I2C_SLAVE_REQUEST:
+            i2c_write_byte_raw(i2c, regs[legacy.addr++]);
+            break;
+        case I2C_SLAVE_FINISH:
+            legacy.addr_written = false;
+            break;
+    }
+}
+
+static void init_buffered(void) {
+    i2c_slave_buffers_t buffers = {
+            .rx_buf = regs,
+            .rx_size = sizeof(regs),
+            .tx_buf = regs,
+            .tx_size = sizeof(regs),
+            .offset_bytes = 1,
+    };
+    i2c_slave_init_buffered(slave_i2c, SLAVE_ADDR, &buffers, transfer_handler);
+}
+
+static bool check_transfer(i2c_slave_event_t event, uint offset, uint length) {
+    bool ok = transfer_count == 1 && last_event == event && last_offset == offset && last_length == length;
+    if (!ok) {
+        printf("%u transfers, last %d offset %u length %u\n", transfer_count, last_event, last_offset, last_length);
+    }
+    transfer_count = 0;
+    return ok;
+}
+
+static uint32_t read_block(uint8_t offset, uint8_t *dst, size_t len) {
+    uint32_t irqs = i2c_host_get_irq_count(slave_i2c);
+    i2c_write_blocking(master_i2c, SLAVE_ADDR, &offset, 1, true);
+    int rc = i2c_read_blocking(master_i2c, SLAVE_ADDR, dst, len, false);
+    return rc == (int)len ? i2c_host_get_irq_count(slave_i2c) - irqs : 0;
+}
+
+int main() {
+    setup_default_uart();
+    PICOTEST_START();
+
+    i2c_init(slave_i2c, 100 * 1000);
+    i2c_init(master_i2c, 100 * 1000);
+    init_buffered();
+
+    uint8_t buf[257];
+    uint8_t data[256];
+
+    PICOTEST_START_SECTION("a write is stored at the offset");
+        buf[0] = 0x10;
+        for (uint i = 0; i < 32; i++) buf[1 + i] = (uint8_t)(i + 1);
+        uint32_t irqs = i2c_host_get_irq_count(slave_i2c);
+        PICOTEST_CHECK(i2c_write_blocking(master_i2c, SLAVE_ADDR, buf, 33, false) == 33, "write failed");
+        irqs = i2c_host_get_irq_count(slave_i2c) - irqs;
+        PICOTEST_CHECK(!memcmp(regs + 0x10, buf + 1, 32), "wrong data");
+        PICOTEST_CHECK(check_transfer(I2C_SLAVE_RECEIVE, 0x10, 32), "expected a single callback");
+        PICOTEST_CHECK(irqs < 8, "expected the FIFO to be drained at the threshold");
+        uint8_t byte = 0;
+        PICOTEST_CHECK(i2c_write_blocking(master_i2c, SLAVE_ADDR + 1, &byte, 1, false) == PICO_ERROR_GENERIC,
+                       "no slave should have that address");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("a read returns data from the offset");
+        PICOTEST_CHECK(read_block(0x10, data, 32), "read failed");
+        PICOTEST_CHECK(!memcmp(data, buf + 1, 32), "wrong data");
+        // only the bytes read count, not those prefetched into the Tx FIFO; setting the offset isn't reported
+        PICOTEST_CHECK(check_transfer(I2C_SLAVE_REQUEST, 0x10, 32), "expected a single callback");
+        // the next read carries on from there (after the stale Tx data is flushed)
+        PICOTEST_CHECK(i2c_read_blocking(master_i2c, SLAVE_ADDR, data, 4, false) == 4, "read failed");
+        PICOTEST_CHECK(!memcmp(data, regs + 0x30, 4), "wrong data");
+        PICOTEST_CHECK(check_transfer(I2C_SLAVE_REQUEST, 0x30, 4), "expected a single callback");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("offsets wrap around the window");
+        const uint8_t wrap[] = {0xfc, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6};
+        PICOTEST_CHECK(i2c_write_blocking(master_i2c, SLAVE_ADDR, wrap, sizeof(wrap), false) == sizeof(wrap),
+                       "write failed");
+        PICOTEST_CHECK(regs[0xfc] == 0xa1 && regs[0xff] == 0xa4 && regs[0] == 0xa5 && regs[1] == 0xa6, "wrong data");
+        PICOTEST_CHECK(check_transfer(I2C_SLAVE_RECEIVE, 0xfc, 6), "expected a single callback");
+        PICOTEST_CHECK(read_block(0xfe, data, 4), "read failed");
+        PICOTEST_CHECK(data[0] == 0xa3 && data[1] == 0xa4 && data[2] == 0xa5 && data[3] == 0xa6, "wrong data");
+        PICOTEST_CHECK(check_transfer(I2C_SLAVE_REQUEST, 0xfe, 4), "expected a single callback");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("fewer interrupts than the per byte handler");
+        for (uint i = 0; i < sizeof(regs); i++) regs[i] = (uint8_t)(i * 7);
+        uint32_t buffered_irqs = read_block(0, data, sizeof(data));
+        PICOTEST_CHECK(!memcmp(data, regs, sizeof(regs)), "wrong data");
+        PICOTEST_CHECK(check_transfer(I2C_SLAVE_REQUEST, 0, 256), "expected a single callback");
+        buf[0] = 0;
+        for (uint i = 0; i < 256; i++) buf[1 + i] = (uint8_t)~i;
+        uint32_t buffered_write_irqs = i2c_host_get_irq_count(slave_i2c);
+        PICOTEST_CHECK(i2c_write_blocking(master_i2c, SLAVE_ADDR, buf, 257, false) == 257, "write failed");
+        buffered_write_irqs = i2c_host_get_irq_count(slave_i2c) - buffered_write_irqs;
+        PICOTEST_CHECK(check_transfer(I2C_SLAVE_RECEIVE, 0, 256), "expected a single callback");
+
+        i2c_slave_deinit(slave_i2c);
+        i2c_slave_init(slave_i2c, SLAVE_ADDR, legacy_handler);
+        for (uint i = 0; i < sizeof(regs); i++) regs[i] = (uint8_t)(i * 7);
+        uint32_t legacy_irqs = read_block(0, data, sizeof(data));
+        PICOTEST_CHECK(!memcmp(data, regs, sizeof(regs)), "wrong data");
+        uint32_t legacy_write_irqs = i2c_host_get_irq_count(slave_i2c);
+        PICOTEST_CHECK(i2c_write_blocking(master_i2c, SLAVE_ADDR, buf, 257, false) == 257, "write failed");
+        legacy_write_irqs = i2c_host_get_irq_count(slave_i2c) - legacy_write_irqs;
+        PICOTEST_CHECK(!memcmp(regs, buf + 1, 256), "wrong data");
+        PICOTEST_CHECK(!transfer_count, "the buffered handler shouldn't be called");
+
+        printf("256 byte read: %"PRIu32" IRQs buffered, %"PRIu32" per byte\n", buffered_irqs, legacy_irqs);
+        printf("256 byte write: %"PRIu32" IRQs buffered, %"PRIu32" per byte\n", buffered_write_irqs, legacy_write_irqs);
+        PICOTEST_CHECK(buffered_irqs && buffered_irqs * 8 < legacy_irqs, "expected far fewer read IRQs");
+        PICOTEST_CHECK(buffered_write_irqs * 8 < legacy_write_irqs, "expected far fewer write IRQs");
+        i2c_slave_deinit(slave_i2c);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("two byte offsets");
+        memset(regs, 0, sizeof(regs));
+        i2c_slave_buffers_t buffers = {
+                .rx_buf = regs,
+                .rx_size = 128,
+                .tx_buf = regs + 128,
+                .tx_size = 128,
+                .offset_bytes = 2,
+        };
+        i2c_slave_init_buffered(slave_i2c, SLAVE_ADDR, &buffers, transfer_handler);
+        const uint8_t wr[] = {0x01, 0x05, 0x55, 0x66};
+        PICOTEST_CHECK(i2c_write_blocking(master_i2c, SLAVE_ADDR, wr, sizeof(wr), false) == sizeof(wr),
+                       "write failed");
+        // 0x105 wraps to 5 in the 128 byte receive window
+        PICOTEST_CHECK(regs[5] == 0x55 && regs[6] == 0x66, "wrong data");
+        PICOTEST_CHECK(check_transfer(I2C_SLAVE_RECEIVE, 5, 2), "expected a single callback");
+        regs[128 + 7] = 0x77;
+        PICOTEST_CHECK(i2c_read_blocking(master_i2c, SLAVE_ADDR, data, 1, false) == 1, "read failed");
+        PICOTEST_CHECK(data[0] == 0x77, "reads should follow on from the write, in the transmit window");
+        PICOTEST_CHECK(check_transfer(I2C_SLAVE_REQUEST, 7, 1), "expected a single callback");
+        i2c_slave_deinit(slave_i2c);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
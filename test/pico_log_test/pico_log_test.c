@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "pico/log.h"
+#include "pico/test.h"
+
+PICOTEST_MODULE_NAME("LOG", "binary log test and cost comparison with snprintf");
+
+#define NUM_TIMED_CALLS 10000u
+
+extern const uint8_t __start_pico_log_sites[];
+
+static char text[4096];
+static uint text_len;
+static uint8_t binary[4096];
+static uint binary_len;
+static uint output_calls;
+
+static void text_output(const void *data, uint len, void *param) {
+    (void)param;
+    if (text_len + len < sizeof(text)) {
+        memcpy(text + text_len, data, len);
+        text_len += len;
+        text[text_len] = 0;
+    }
+    output_calls++;
+}
+
+static void binary_output(const void *data, uint len, void *param) {
+    (void)param;
+    if (binary_len + len <= sizeof(binary)) {
+        memcpy(binary + binary_len, data, len);
+        binary_len += len;
+    }
+    output_calls++;
+}
+
+static void reset_output(void) {
+    text_len = 0;
+    text[0] = 0;
+    binary_len = 0;
+    output_calls = 0;
+}
+
+// strip the "[<time>] <core>: " prefix from each line
+static void strip_prefixes(char *s) {
+    char *out = s;
+    while (*s) {
+        char *body = strstr(s, ": ");
+        if (!body) break;
+        s = body + 2;
+        while (*s && *s != '\n') *out++ = *s++;
+        if (*s) *out++ = *s++;
+    }
+    *out = 0;
+}
+
+static void log_sample_messages(void) {
+    int32_t neg = -42;
+    uint64_t big = 0x123456789abcdefull;
+    const char *name = "motor";
+    pico_log("no args");
+    pico_log("int %d unsigned %u hex %08x", neg, 3000000000u, 0xbeefu);
+    pico_log("64 bit %llu %lld", big, (long long)-5);
+    pico_log("float %.3f double %g", 1.5f, 2.25e10);
+    pico_log("string '%s' '%-7s|' char %c %%", name, name, 'x');
+    pico_log("long string %s", "abcdefghijklmnopqrstuvwxyz0123456789");
+}
+
+static const char *expected_messages =
+        "no args\n"
+        "int -42 unsigned 3000000000 hex 0000beef\n"
+        "64 bit 81985529216486895 -5\n"
+        "float 1.500 double 2.25e+10\n"
+        "string 'motor' 'motor  |' char x %\n";
+
+int main() {
+    stdio_init_all();
+    PICOTEST_START();
+
+    PICOTEST_START_SECTION("text drain");
+        reset_output();
+        log_sample_messages();
+        uint n = pico_log_drain_text(text_output, NULL);
+        PICOTEST_CHECK(n == 6, "wrong number of records drained");
+        PICOTEST_CHECK(output_calls == 6, "expected one output call per record");
+        PICOTEST_CHECK(text[0] == '[', "missing timestamp");
+        strip_prefixes(text);
+        char expected[512];
+        snprintf(expected, sizeof(expected), "%slong string %.*s\n", expected_messages, PICO_LOG_MAX_STRING_LENGTH,
+                 "abcdefghijklmnopqrstuvwxyz0123456789");
+        PICOTEST_CHECK(!strcmp(text, expected), "text output mismatch");
+        if (strcmp(text, expected)) printf("got:\n%sexpected:\n%s", text, expected);
+        PICOTEST_CHECK(pico_log_drain_text(text_output, NULL) == 0, "buffer should be empty");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("binary drain decodes to the same text");
+        reset_output();
+        log_sample_messages();
+        uint n = pico_log_drain_binary(binary_output, NULL);
+        PICOTEST_CHECK(n == 6, "wrong number of records drained");
+        // decode as the host tool would, with the sites from our own image
+        char decoded[1024];
+        uint decoded_len = 0;
+        uint64_t last_time = 0;
+        for (uint pos = 0; pos + PICO_LOG_FRAME_HEADER_SIZE + PICO_LOG_RECORD_HEADER_SIZE <= binary_len;) {
+            PICOTEST_CHECK_AND_ABORT(binary[pos] == PICO_LOG_FRAME_SYNC0 && binary[pos + 1] == PICO_LOG_FRAME_SYNC1, "bad frame sync");
+            const uint8_t *record = binary + pos + PICO_LOG_FRAME_HEADER_SIZE;
+            uint len = pico_log_get_le(record, 2);
+            const pico_log_site_t *site = (const pico_log_site_t *)(__start_pico_log_sites + pico_log_get_le(record + 2, 4));
+            PICOTEST_CHECK(pico_log_record_time_us(record) >= last_time, "records out of order");
+            last_time = pico_log_record_time_us(record);
+            int l = pico_log_format_line(decoded + decoded_len, sizeof(decoded) - decoded_len, binary[pos + 2], site, record, len);
+            PICOTEST_CHECK_AND_ABORT(l > 0, "failed to decode record");
+            decoded_len += (uint)l;
+            pos += PICO_LOG_FRAME_HEADER_SIZE + len;
+        }
+        strip_prefixes(decoded);
+        PICOTEST_CHECK(!strncmp(decoded, expected_messages, strlen(expected_messages)), "decoded output mismatch");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("full buffer drops records");
+        reset_output();
+        uint32_t dropped = pico_log_get_dropped(get_core_num());
+        uint logged = 0;
+        for (uint i = 0; i < PICO_LOG_BUFFER_SIZE; i++) {
+            pico_log("fill %u", i);
+            logged++;
+        }
+        // each record is 18 bytes
+        uint fit = PICO_LOG_BUFFER_SIZE / 18;
+        PICOTEST_CHECK(pico_log_get_dropped(get_core_num()) - dropped == logged - fit, "wrong dropped count");
+        PICOTEST_CHECK(pico_log_drain_text(text_output, NULL) == fit, "wrong number of records kept");
+        PICOTEST_CHECK(strstr(text, "fill 0\n") && !strstr(text, "fill 900\n"), "expected the oldest records to be kept");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("cost per call");
+        char line[128];
+        uint32_t checksum = 0;
+        absolute_time_t t0 = get_absolute_time();
+        for (uint32_t i = 0; i < NUM_TIMED_CALLS; i++) {
+            checksum += (uint32_t)snprintf(line, sizeof(line), "loop %"PRIu32" error %d output %f", i, (int)(i % 13) - 6, i * 0.25);
+        }
+        int64_t printf_us = absolute_time_diff_us(t0, get_absolute_time());
+        uint drained = 0;
+        t0 = get_absolute_time();
+        for (uint32_t i = 0; i < NUM_TIMED_CALLS; i++) {
+            pico_log("loop %"PRIu32" error %d output %f", i, (int)(i % 13) - 6, i * 0.25);
+            // drain regularly so nothing is dropped; the (unformatted) drain is included in the timing
+            if ((i & 31) == 31) {
+                drained += pico_log_drain_binary(binary_output, NULL);
+                binary_len = 0;
+            }
+        }
+        int64_t log_us = absolute_time_diff_us(t0, get_absolute_time());
+        drained += pico_log_drain_binary(binary_output, NULL);
+        PICOTEST_CHECK(drained == NUM_TIMED_CALLS, "records lost");
+        printf("%u calls: snprintf %"PRId64"us (checksum %"PRIu32"), pico_log + binary drain %"PRId64"us\n",
+               NUM_TIMED_CALLS, printf_us, checksum, log_us);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
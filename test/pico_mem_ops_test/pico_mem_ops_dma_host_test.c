@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+#include "hardware/dma.h"
+
+PICOTEST_MODULE_NAME("MEM_OPS_DMA", "dma mem_ops implementation on the emulated DMA");
+
+// There are no memcpy/memset wrappers on the host, so the test calls those of the dma implementation directly, and
+// stands in for the bootrom routines they fall back to
+
+void *__mem_ops_dma_memcpy(void *dest, const void *src, size_t n);
+void *__mem_ops_dma_memset(void *dest, int c, size_t n);
+
+static uint bootrom_memcpy_count;
+static uint bootrom_memset_count;
+
+static void *bootrom_memcpy(void *dest, const void *src, size_t n) {
+    bootrom_memcpy_count++;
+    return memcpy(dest, src, n);
+}
+
+static void *bootrom_memset(void *dest, int c, size_t n) {
+    bootrom_memset_count++;
+    return memset(dest, c, n);
+}
+
+void *aeabi_mem_funcs[] = {(void *)bootrom_memset, (void *)bootrom_memcpy,
+                           (void *)bootrom_memset, (void *)bootrom_memcpy};
+
+// which core the calls appear to come from
+static uint test_core_num;
+
+uint get_core_num() {
+    return test_core_num;
+}
+
+// a copy made by "another task" which preempts the caller while it waits for the DMA
+static bool preempt_pending;
+static uint8_t preempt_src[1000];
+static uint8_t preempt_dst[1000];
+
+void tight_loop_contents() {
+    if (preempt_pending) {
+        preempt_pending = false;
+        __mem_ops_dma_memcpy(preempt_dst, preempt_src, sizeof(preempt_dst));
+    }
+}
+
+#define BUF_SIZE 1000u
+
+static uint8_t src[BUF_SIZE];
+static uint8_t dst[BUF_SIZE];
+
+static void reset_buffers(void) {
+    for (uint i = 0; i < BUF_SIZE; i++) src[i] = (uint8_t)(i * 7 + 1);
+    memset(dst, 0, BUF_SIZE);
+    bootrom_memcpy_count = bootrom_memset_count = 0;
+    for (uint c = 0; c < NUM_DMA_CHANNELS; c++) dma_host_reset_channel_stats(c);
+}
+
+// the channel which made any transfers since reset_buffers(), or -1
+static int active_channel(void) {
+    int channel = -1;
+    for (uint c = 0; c < NUM_DMA_CHANNELS; c++) {
+        dma_host_channel_stats_t stats;
+        dma_host_get_channel_stats(c, &stats);
+        if (stats.transfers) {
+            if (channel >= 0) return -2;
+            channel = (int)c;
+        }
+    }
+    return channel;
+}
+
+int main() {
+    stdio_init_all();
+    PICOTEST_START();
+
+    PICOTEST_START_SECTION("copies and fills use the core's DMA channel");
+        reset_buffers();
+        PICOTEST_CHECK(__mem_ops_dma_memcpy(dst + 1, src + 3, 997) == dst + 1, "memcpy return value");
+        PICOTEST_CHECK(!memcmp(dst + 1, src + 3, 997) && !dst[0] && !dst[998], "memcpy mismatch");
+        int channel = active_channel();
+        PICOTEST_CHECK(channel >= 0 && !bootrom_memcpy_count, "memcpy not done by a single DMA channel");
+        PICOTEST_CHECK(dma_channel_is_claimed((uint)channel), "channel not kept claimed");
+
+        reset_buffers();
+        PICOTEST_CHECK(__mem_ops_dma_memset(dst + 2, 0x15a, 995) == dst + 2, "memset return value");
+        bool match = !dst[0] && !dst[1] && !dst[997];
+        for (uint i = 2; i < 997; i++) match &= dst[i] == 0x5a;
+        PICOTEST_CHECK(match, "memset mismatch");
+        PICOTEST_CHECK(active_channel() == channel && !bootrom_memset_count, "memset not done by the same channel");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("a call while the channel is in use falls back to the bootrom");
+        reset_buffers();
+        for (uint i = 0; i < sizeof(preempt_src); i++) preempt_src[i] = (uint8_t)~i;
+        memset(preempt_dst, 0, sizeof(preempt_dst));
+        preempt_pending = true;
+        __mem_ops_dma_memcpy(dst, src, BUF_SIZE);
+        PICOTEST_CHECK(!preempt_pending, "the preempting copy did not run during the transfer");
+        PICOTEST_CHECK(bootrom_memcpy_count == 1, "the preempting copy did not use the bootrom");
+        PICOTEST_CHECK(!memcmp(preempt_dst, preempt_src, sizeof(preempt_dst)), "preempting copy mismatch");
+        PICOTEST_CHECK(!memcmp(dst, src, BUF_SIZE), "preempted copy corrupted");
+
+        // and the channel is free again afterwards
+        reset_buffers();
+        __mem_ops_dma_memcpy(dst, src, BUF_SIZE);
+        PICOTEST_CHECK(!bootrom_memcpy_count && !memcmp(dst, src, BUF_SIZE), "channel not released");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("each core has its own channel");
+        reset_buffers();
+        __mem_ops_dma_memcpy(dst, src, BUF_SIZE);
+        int core0_channel = active_channel();
+        reset_buffers();
+        test_core_num = 1;
+        __mem_ops_dma_memcpy(dst, src, BUF_SIZE);
+        int core1_channel = active_channel();
+        test_core_num = 0;
+        PICOTEST_CHECK(!memcmp(dst, src, BUF_SIZE) && !bootrom_memcpy_count, "core 1 copy not done by DMA");
+        PICOTEST_CHECK(core0_channel >= 0 && core1_channel >= 0 && core0_channel != core1_channel,
+                       "the cores share a channel");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+#include "pico/mem_ops_async.h"
+#include "hardware/dma.h"
+#if PICO_NO_HARDWARE
+#include "hardware/pio.h" // for the emulated cycle count
+#endif
+
+PICOTEST_MODULE_NAME("MEM_OPS", "DMA backed memory operations");
+
+#define BUF_SIZE 1040u
+#define GUARD 0xa5u
+
+static uint8_t src[BUF_SIZE];
+static uint8_t dst[BUF_SIZE];
+static uint8_t expected[BUF_SIZE];
+
+static const size_t sizes[] = {0, 1, 3, 4, 5, 31, 64, 257, 1000};
+
+static void reset_buffers(void) {
+    for (uint i = 0; i < BUF_SIZE; i++) src[i] = (uint8_t)(i * 7 + 1);
+    memset(dst, GUARD, BUF_SIZE);
+    memset(expected, GUARD, BUF_SIZE);
+}
+
+static uint callback_count;
+static void *callback_param;
+
+static void count_callback(void *param) {
+    callback_count++;
+    callback_param = param;
+}
+
+int main() {
+    stdio_init_all();
+    PICOTEST_START();
+
+    PICOTEST_START_SECTION("memcpy_async alignments and sizes");
+        bool ok = true;
+        for (uint d = 0; d < 4; d++) {
+            for (uint s = 0; s < 4; s++) {
+                for (uint i = 0; i < count_of(sizes); i++) {
+                    size_t n = sizes[i];
+                    reset_buffers();
+                    // the reference copy is made byte by byte, so it is independent of the memcpy implementation
+                    for (size_t j = 0; j < n; j++) expected[d + j] = src[s + j];
+                    mem_async_op_t op;
+                    memcpy_async(&op, dst + d, src + s, n, NULL, NULL);
+                    mem_async_wait(&op);
+                    if (memcmp(dst, expected, BUF_SIZE) != 0) {
+                        printf("  mismatch: dest offset %u, source offset %u, size %u\n", d, s, (uint)n);
+                        ok = false;
+                    }
+                }
+            }
+        }
+        PICOTEST_CHECK(ok, "memcpy_async mismatch");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("memset_async alignments and sizes");
+        bool ok = true;
+        for (uint d = 0; d < 4; d++) {
+            for (uint i = 0; i < count_of(sizes); i++) {
+                size_t n = sizes[i];
+                reset_buffers();
+                for (size_t j = 0; j < n; j++) expected[d + j] = 0x3c;
+                mem_async_op_t op;
+                memset_async(&op, dst + d, 0x123c, n, NULL, NULL);
+                mem_async_wait(&op);
+                if (memcmp(dst, expected, BUF_SIZE) != 0) {
+                    printf("  mismatch: dest offset %u, size %u\n", d, (uint)n);
+                    ok = false;
+                }
+            }
+        }
+        PICOTEST_CHECK(ok, "memset_async mismatch");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("callbacks and channel release");
+        reset_buffers();
+        callback_count = 0;
+        mem_async_op_t op;
+        bool started = memcpy_async(&op, dst, src, 1000, count_callback, &op);
+        PICOTEST_CHECK(started, "copy not started on a DMA channel");
+        mem_async_wait(&op);
+        PICOTEST_CHECK(callback_count == 1 && callback_param == &op, "callback not called once");
+        PICOTEST_CHECK(!memcmp(dst, src, 1000), "copy mismatch");
+        PICOTEST_CHECK(mem_async_is_done(&op) && callback_count == 1, "callback called again");
+        // the channel is released on completion, so every channel can be claimed again
+        int channels[NUM_DMA_CHANNELS];
+        uint claimed = 0;
+        for (int c; (c = dma_claim_unused_channel(false)) >= 0;) channels[claimed++] = c;
+        PICOTEST_CHECK(claimed == NUM_DMA_CHANNELS, "DMA channel not released");
+        // with no channel free, the operation is done synchronously
+        reset_buffers();
+        callback_count = 0;
+        started = memset_async(&op, dst, 7, 500, count_callback, NULL);
+        PICOTEST_CHECK(!started && mem_async_is_done(&op), "operation not done synchronously");
+        PICOTEST_CHECK(callback_count == 1, "synchronous callback not called");
+        bool match = true;
+        for (uint i = 0; i < 500; i++) match &= dst[i] == 7;
+        PICOTEST_CHECK(match && dst[500] == GUARD, "synchronous memset mismatch");
+        for (uint i = 0; i < claimed; i++) dma_channel_unclaim((uint)channels[i]);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("concurrent operations");
+        reset_buffers();
+        mem_async_op_t ops[4];
+        for (uint i = 0; i < 4; i++) {
+            if (i & 1) {
+                memset_async(&ops[i], dst + i * 256, (int)i, 256, NULL, NULL);
+            } else {
+                memcpy_async(&ops[i], dst + i * 256, src + i * 256, 256, NULL, NULL);
+            }
+        }
+        for (uint i = 0; i < 4; i++) mem_async_wait(&ops[i]);
+        bool match = true;
+        for (uint i = 0; i < 1024; i++) match &= dst[i] == (((i / 256) & 1) ? (uint8_t)(i / 256) : src[i]);
+        PICOTEST_CHECK(match, "concurrent operations mismatch");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("benchmark");
+        // on the device the DMA moves a word per cycle and leaves the CPU free; on the host its speed is
+        // that of the emulation, so only the emulated cycle count is meaningful
+        for (uint i = 0; i < count_of(sizes); i++) {
+            size_t n = sizes[i];
+            if (n < 64) continue;
+            uint64_t t0 = time_us_64();
+            for (uint r = 0; r < 100; r++) memcpy(dst, src, n);
+            uint64_t t1 = time_us_64();
+            mem_async_op_t op;
+            for (uint r = 0; r < 100; r++) {
+                memcpy_async(&op, dst, src, n, NULL, NULL);
+                mem_async_wait(&op);
+            }
+            uint64_t t2 = time_us_64();
+            printf("  %4u bytes: memcpy %u us, memcpy_async %u us (x100)\n", (uint)n, (uint)(t1 - t0),
+                   (uint)(t2 - t1));
+        }
+#if PICO_NO_HARDWARE
+        uint64_t c0 = pio_host_get_cycle_count();
+        mem_async_op_t op;
+        memcpy_async(&op, dst, src, 1000, NULL, NULL);
+        mem_async_wait(&op);
+        uint64_t cycles = pio_host_get_cycle_count() - c0;
+        printf("  1000 byte word aligned memcpy_async: %u emulated DMA cycles\n", (uint)cycles);
+        PICOTEST_CHECK(cycles >= 250 && cycles < 260, "unexpected DMA cycle count");
+#endif
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
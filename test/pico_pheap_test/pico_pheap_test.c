@@ -0,0 +1,153 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+#include "pico/util/pheap.h"
+PICOTEST_MODULE_NAME("pico_pheap_test", "pheap test");
+
+#if PICO_ON_DEVICE
+#define MAX_NODES 4000
+#else
+#define MAX_NODES 60000
+#endif
+
+static uint64_t keys[MAX_NODES + 1];
+static pheap_node_id_t ids[MAX_NODES];
+
+#if !PICO_PHEAP_INLINE_KEY
+static bool key_comparator(__unused void *user_data, pheap_node_id_t a, pheap_node_id_t b) {
+    return keys[a] < keys[b];
+}
+#endif
+
+static void set_key(pheap_t *heap, pheap_node_id_t id, uint64_t key) {
+    keys[id] = key;
+#if PICO_PHEAP_INLINE_KEY
+    ph_set_key(heap, id, key);
+#else
+    (void)heap;
+#endif
+}
+
+static pheap_t *create_heap(uint max_nodes) {
+#if PICO_PHEAP_INLINE_KEY
+    return ph_create(max_nodes, NULL, NULL);
+#else
+    return ph_create(max_nodes, key_comparator, NULL);
+#endif
+}
+
+// remove all the nodes, checking they come out in order; returns the number removed
+static uint drain_in_order(pheap_t *heap, bool *in_order) {
+    uint count = 0;
+    uint64_t last = 0;
+    *in_order = true;
+    pheap_node_id_t id;
+    while ((id = ph_peek_head(heap))) {
+        ph_remove_and_free_head(heap);
+        if (keys[id] < last) *in_order = false;
+        last = keys[id];
+        count++;
+    }
+    return count;
+}
+
+int main() {
+    setup_default_uart();
+    srand(5678);
+
+    PICOTEST_START();
+    pheap_t *heap;
+    bool in_order;
+
+    PICOTEST_START_SECTION("Random insert and remove");
+    heap = create_heap(MAX_NODES);
+    for (uint i = 0; i < MAX_NODES; i++) {
+        pheap_node_id_t id = ph_new_node(heap);
+        PICOTEST_CHECK_AND_ABORT(id, "failed to allocate node");
+        set_key(heap, id, (uint64_t)rand());
+        ph_insert_node(heap, id);
+    }
+    PICOTEST_CHECK(!ph_new_node(heap), "heap should be full");
+    // remove a third of them from the middle of the heap
+    uint removed = 0;
+    for (pheap_node_id_t id = 1; id <= MAX_NODES; id += 3) {
+        PICOTEST_CHECK(ph_remove_and_free_node(heap, id), "failed to remove node");
+        removed++;
+    }
+    PICOTEST_CHECK(drain_in_order(heap, &in_order) == MAX_NODES - removed, "wrong number of nodes in heap");
+    PICOTEST_CHECK(in_order, "nodes removed out of order");
+    ph_destroy(heap);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("Long sibling list");
+    // inserting in ascending order leaves every node as a child of the root, so the first removal
+    // has to merge a sibling list as long as the heap (which would need very deep recursion if not iterative)
+    heap = create_heap(MAX_NODES);
+    for (uint i = 0; i < MAX_NODES; i++) {
+        pheap_node_id_t id = ph_new_node(heap);
+        set_key(heap, id, i);
+        ph_insert_node(heap, id);
+    }
+    PICOTEST_CHECK(drain_in_order(heap, &in_order) == MAX_NODES, "wrong number of nodes in heap");
+    PICOTEST_CHECK(in_order, "nodes removed out of order");
+    ph_destroy(heap);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("Batch insert");
+    heap = create_heap(MAX_NODES);
+    uint count = 0;
+    // interleave some single inserts with batches of varying sizes
+    while (count < MAX_NODES) {
+        uint batch = 1 + (uint)rand() % 100;
+        batch = MIN(MAX_NODES - count, batch);
+        for (uint i = 0; i < batch; i++) {
+            ids[i] = ph_new_node(heap);
+            set_key(heap, ids[i], (uint64_t)rand());
+        }
+        pheap_node_id_t head = ph_insert_batch(heap, ids, batch);
+        PICOTEST_CHECK(head == ph_peek_head(heap), "wrong head returned");
+        for (uint i = 0; i < batch; i++) {
+            PICOTEST_CHECK(ph_contains_node(heap, ids[i]), "batch node not in heap");
+            PICOTEST_CHECK(keys[head] <= keys[ids[i]], "batch node before head");
+        }
+        count += batch;
+    }
+    PICOTEST_CHECK(drain_in_order(heap, &in_order) == MAX_NODES, "wrong number of nodes in heap");
+    PICOTEST_CHECK(in_order, "nodes removed out of order");
+    ph_destroy(heap);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("Decrease key");
+    heap = create_heap(MAX_NODES);
+    for (uint i = 0; i < MAX_NODES; i++) {
+        pheap_node_id_t id = ph_new_node(heap);
+        set_key(heap, id, 1000000 + (uint64_t)rand());
+        ph_insert_node(heap, id);
+    }
+    // make sure there is some structure to the heap
+    for (uint i = 0; i < MAX_NODES / 10; i++) {
+        pheap_node_id_t id = ph_remove_head(heap, false);
+        ph_insert_node(heap, id);
+    }
+    for (uint i = 0; i < MAX_NODES / 2; i++) {
+        pheap_node_id_t id = (pheap_node_id_t)(1 + (uint)rand() % MAX_NODES);
+        uint64_t delta = (uint)rand() % 1000000;
+        set_key(heap, id, keys[id] - MIN(keys[id], delta));
+        pheap_node_id_t head = ph_decrease_key(heap, id);
+        PICOTEST_CHECK(head == ph_peek_head(heap), "wrong head returned");
+        PICOTEST_CHECK(keys[head] <= keys[id], "decreased node before head");
+    }
+    PICOTEST_CHECK(drain_in_order(heap, &in_order) == MAX_NODES, "wrong number of nodes in heap");
+    PICOTEST_CHECK(in_order, "nodes removed out of order");
+    ph_destroy(heap);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
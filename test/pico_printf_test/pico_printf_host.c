@@ -0,0 +1,9 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// the pico_printf implementation, with its functions renamed so they don't replace those of the host C library
+#define WRAPPER_FUNC(x) pico_##x
+#include "printf.c"
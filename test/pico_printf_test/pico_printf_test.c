@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+
+PICOTEST_MODULE_NAME("PRINTF", "pico_printf comparison with the host C library");
+
+// from pico_printf_host.c
+int pico_snprintf(char *buffer, size_t count, const char *format, ...);
+
+#define NUM_RANDOM_TESTS 200000u
+#define NUM_TIMED_CALLS 200000u
+#define MAX_REPORTED_MISMATCHES 10u
+
+static uint64_t rand_state = 0x853c49e6748fea9bull;
+
+static uint64_t rand64(void) {
+    // xorshift64*
+    rand_state ^= rand_state >> 12;
+    rand_state ^= rand_state << 25;
+    rand_state ^= rand_state >> 27;
+    return rand_state * 0x2545f4914f6cdd1dull;
+}
+
+static uint rand_below(uint n) {
+    return (uint)(rand64() % n);
+}
+
+static uint mismatches;
+
+// glibc drops the trailing zeros required by "%#g" when rounding carries into the exponent, e.g. printing 999999.5 as
+// "1.e+06" rather than "1.00000e+06"
+static bool is_glibc_hash_g_bug(const char *format, const char *expected, const char *actual) {
+    if (!strchr(format, '#') || !strpbrk(format, "gG")) return false;
+    // the padding differs too, as the lengths differ
+    while (*expected == ' ') expected++;
+    while (*actual == ' ') actual++;
+    const char *e = strpbrk(expected, "eE");
+    const char *a = strpbrk(actual, "eE");
+    if (!e || !a || e[-1] != '.' || strcmp(e, a)) return false;
+    for (const char *p = actual + (e - expected); p < a; p++) {
+        if (*p != '0') return false;
+    }
+    return !strncmp(expected, actual, (size_t)(e - expected));
+}
+
+static void check_output(const char *format, const char *expected, int expected_rc, const char *actual, int actual_rc) {
+    if (strcmp(expected, actual) || expected_rc != actual_rc) {
+        if (mismatches++ < MAX_REPORTED_MISMATCHES) {
+            printf("  mismatch for \"%s\": libc \"%s\" (%d), pico \"%s\" (%d)\n", format, expected, expected_rc, actual, actual_rc);
+        }
+    }
+}
+
+// formats a value with both implementations, both into a buffer and truncated
+#define COMPARE(format, value) ({ \
+    __typeof__(value) _value = (value); \
+    char expected[512], actual[512]; \
+    int expected_rc = snprintf(expected, sizeof(expected), format, _value); \
+    int actual_rc = pico_snprintf(actual, sizeof(actual), format, _value); \
+    if (!is_glibc_hash_g_bug(format, expected, actual)) { \
+        check_output(format, expected, expected_rc, actual, actual_rc); \
+        expected_rc = snprintf(expected, 6, format, _value); \
+        actual_rc = pico_snprintf(actual, 6, format, _value); \
+        check_output(format, expected, expected_rc, actual, actual_rc); \
+    } \
+})
+
+static void random_spec(char *format, const char *length, char conversion, uint max_width, uint max_precision) {
+    char *p = format;
+    *p++ = '%';
+    static const char flags[] = "-+ #0";
+    for (uint i = 0; i < 5; i++) {
+        if (!rand_below(4)) *p++ = flags[i];
+    }
+    if (rand_below(2)) p += sprintf(p, "%u", rand_below(max_width + 1));
+    if (rand_below(2)) p += sprintf(p, ".%u", rand_below(max_precision + 1));
+    p += sprintf(p, "%s%c", length, conversion);
+}
+
+static double random_double(void) {
+    union {
+        uint64_t u;
+        double d;
+    } v;
+    switch (rand_below(4)) {
+        case 0:
+            // anything, including subnormals, infinities and NaNs
+            v.u = rand64();
+            return v.d;
+        case 1:
+            // a "nice" decimal number, which will often be on a rounding boundary
+            return (double)(int64_t)(rand64() % 2000001u - 1000000) / pow(10, rand_below(8));
+        case 2:
+            // exactly representable halves
+            return (double)rand_below(1000u) + 0.5;
+        default:
+            // a number of moderate magnitude
+            return ldexp((double)(rand64() >> 11), (int)rand_below(140) - 120) * (rand_below(2) ? 1 : -1);
+    }
+}
+
+static const char *const int_formats[] = {
+        "%d", "%i", "%u", "%x", "%X", "%o", "%5d", "%-5d|", "%05d", "%+d", "% d", "%.0d", "%.3d", "%8.3d", "%-8.3d|",
+        "%#x", "%#X", "%#o", "%#.3o", "%#.0o", "%#08x", "%#.4x", "%08.3d", "%+.0d", "%hd", "%hhd", "%hu", "%hhx",
+};
+
+static const int int_values[] = {0, 1, -1, 7, 8, 42, -42, 99, 100, -100, 12345, 65535, 65536, 0x7fffffff, -0x7fffffff - 1};
+
+static const char *const double_formats[] = {
+        "%f", "%F", "%e", "%E", "%g", "%G", "%.0f", "%.1f", "%.2f", "%.10f", "%.17f", "%.30f", "%.0e", "%.3e", "%.17e",
+        "%.25e", "%.0g", "%.1g", "%.3g", "%.17g", "%#g", "%#.0f", "%#.0e", "%12.4f", "%-12.4f|", "%012.4f", "%+f",
+        "% f", "%+012.3e", "%20g", "%-20g|", "%010f", "%.100f",
+};
+
+static const double double_values[] = {
+        0.0, -0.0, 1.0, -1.0, 0.5, 1.5, 2.5, 0.125, 0.1, 0.2, 0.3, 1.0 / 3, 2.0 / 3, 9.5, 9.95, 9.995, 99.5, 0.05,
+        0.0001, 0.00001, 123456.0, 999999.5, 1234567.0, 1e9, 1e10, 123456789012345678.0, 1e21, 1e100, 1e300,
+        1.7976931348623157e308, 2.2250738585072014e-308, 4.9406564584124654e-324, 1e-5, 1e-300, 3.14159265358979,
+        -2.718281828459045, 18446744073709551616.0, 18446744073709549568.0, 0.000123456789, INFINITY, -INFINITY, NAN,
+};
+
+static const char *const timed_formats[] = {
+        "%d", "%u %u %u", "%08x", "%lld", "%f", "%.3f", "%e", "%g", "temperature %d.%02d C, status ok\n",
+};
+
+static int64_t time_format(const char *format, bool pico) {
+    char buf[128];
+    uint32_t checksum = 0;
+    absolute_time_t t0 = get_absolute_time();
+    for (uint32_t i = 0; i < NUM_TIMED_CALLS; i++) {
+        // pass plenty of arguments of each type; formats only use those they need
+        bool is_float = strpbrk(format, "feg") != NULL;
+        bool is_ll = strstr(format, "ll") != NULL;
+        int rc;
+        if (is_float) {
+            double d = (double)(i * 7919u % 1000003u) / 128.0;
+            rc = pico ? pico_snprintf(buf, sizeof(buf), format, d) : snprintf(buf, sizeof(buf), format, d);
+        } else if (is_ll) {
+            long long v = (long long)i * 0x12345679ll;
+            rc = pico ? pico_snprintf(buf, sizeof(buf), format, v) : snprintf(buf, sizeof(buf), format, v);
+        } else {
+            uint v = i * 2654435761u;
+            rc = pico ? pico_snprintf(buf, sizeof(buf), format, v, v >> 8, v % 100u) : snprintf(buf, sizeof(buf), format, v, v >> 8, v % 100u);
+        }
+        checksum += (uint32_t)rc + (uint8_t)buf[0];
+    }
+    int64_t us = absolute_time_diff_us(t0, get_absolute_time());
+    // make sure the calls are not optimized away
+    if (!checksum) printf("!");
+    return us;
+}
+
+int main() {
+    stdio_init_all();
+    PICOTEST_START();
+
+    PICOTEST_START_SECTION("integers match libc");
+        mismatches = 0;
+        for (uint f = 0; f < count_of(int_formats); f++) {
+            for (uint v = 0; v < count_of(int_values); v++) {
+                COMPARE(int_formats[f], int_values[v]);
+            }
+        }
+        COMPARE("%llu", 18446744073709551615ull);
+        COMPARE("%lld", (long long)INT64_MIN);
+        COMPARE("%llx", 0x0123456789abcdefull);
+        COMPARE("%llo", 01777777777777777777777ull);
+        COMPARE("%020llu", 12345678901234567890ull);
+        COMPARE("%40d", 12345);
+        COMPARE("%040d", -12345);
+        for (uint i = 0; i < NUM_RANDOM_TESTS; i++) {
+            static const char conversions[] = "diuxXo";
+            static const char *const lengths[] = {"", "l", "ll", "h", "hh"};
+            char format[32];
+            const char *length = lengths[rand_below(count_of(lengths))];
+            random_spec(format, length, conversions[rand_below(6)], 30, 25);
+            uint64_t value = rand64() >> rand_below(64);
+            if (length[0] == 'l') {
+                COMPARE(format, (long long)value);
+            } else {
+                COMPARE(format, (int)value);
+            }
+        }
+        printf("  %u mismatches\n", mismatches);
+        PICOTEST_CHECK(!mismatches, "integer output differs from libc");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("floating point matches libc");
+        mismatches = 0;
+        for (uint f = 0; f < count_of(double_formats); f++) {
+            for (uint v = 0; v < count_of(double_values); v++) {
+                COMPARE(double_formats[f], double_values[v]);
+                COMPARE(double_formats[f], -double_values[v]);
+            }
+        }
+        COMPARE("%f", 1e308);
+        COMPARE("%.0f", 1.7976931348623157e308);
+        COMPARE("%.1074f", 4.9406564584124654e-324);
+        COMPARE("%.760e", 4.9406564584124654e-324);
+        for (uint i = 0; i < NUM_RANDOM_TESTS; i++) {
+            static const char conversions[] = "fFeEgG";
+            char format[32];
+            random_spec(format, "", conversions[rand_below(6)], 40, 40);
+            COMPARE(format, random_double());
+        }
+        printf("  %u mismatches\n", mismatches);
+        PICOTEST_CHECK(!mismatches, "floating point output differs from libc");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("speed compared with libc");
+        for (uint f = 0; f < count_of(timed_formats); f++) {
+            int64_t libc_us = time_format(timed_formats[f], false);
+            int64_t pico_us = time_format(timed_formats[f], true);
+            char name[48];
+            snprintf(name, sizeof(name), "\"%s\"", timed_formats[f]);
+            for (char *p = name; *p; p++) if (*p == '\n') *p = ' ';
+            printf("  %-40s libc %5"PRId64"ns pico %5"PRId64"ns per call\n", name,
+                   libc_us * 1000 / NUM_TIMED_CALLS, pico_us * 1000 / NUM_TIMED_CALLS);
+        }
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
@@ -0,0 +1,271 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "pico/util/queue.h"
+#include "pico/util/spsc_queue.h"
+#include "pico/multicore.h"
+#include "pico/test.h"
+
+PICOTEST_MODULE_NAME("QUEUE", "queue test and throughput benchmark");
+
+#if PICO_ON_DEVICE
+#define NUM_TRANSFERS 200000u
+#else
+#define NUM_TRANSFERS 1000000u
+#endif
+#define QUEUE_LENGTH 64
+#define BATCH_SIZE 16
+
+typedef struct {
+    uint32_t seq;
+    uint32_t payload;
+} element_t;
+
+static queue_t locked_queue;
+static spsc_queue_t spsc_queue;
+static volatile uint32_t consumer_errors;
+
+static void locked_consumer(void) {
+    element_t e;
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < NUM_TRANSFERS; i++) {
+        queue_remove_blocking(&locked_queue, &e);
+        if (e.seq != i || e.payload != ~i) errors++;
+    }
+    consumer_errors = errors;
+}
+
+static void locked_batch_consumer(void) {
+    element_t e[BATCH_SIZE];
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < NUM_TRANSFERS; i += BATCH_SIZE) {
+        queue_remove_n_blocking(&locked_queue, e, BATCH_SIZE);
+        for (uint32_t j = 0; j < BATCH_SIZE; j++) {
+            if (e[j].seq != i + j || e[j].payload != ~(i + j)) errors++;
+        }
+    }
+    consumer_errors = errors;
+}
+
+#define PACKET_SIZE 256
+#define NUM_PACKETS (NUM_TRANSFERS / 16)
+
+static inline uint8_t packet_byte(uint32_t packet, uint32_t offset) {
+    return (uint8_t)(packet * 7u + offset);
+}
+
+static void zero_copy_consumer(void) {
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < NUM_PACKETS; ) {
+        const void *ptr;
+        uint n = queue_try_peek_span(&locked_queue, &ptr, 8);
+        if (!n) {
+            ptr = queue_peek_ptr_blocking(&locked_queue);
+            n = 1;
+        }
+        const uint8_t *p = (const uint8_t *)ptr;
+        for (uint j = 0; j < n; j++, i++) {
+            for (uint32_t k = 0; k < PACKET_SIZE; k++) {
+                if (*p++ != packet_byte(i, k)) errors++;
+            }
+        }
+        queue_release_n(&locked_queue, n);
+    }
+    consumer_errors = errors;
+}
+
+static void spsc_consumer(void) {
+    element_t e;
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < NUM_TRANSFERS; i++) {
+        spsc_queue_remove_blocking(&spsc_queue, &e);
+        if (e.seq != i || e.payload != ~i) errors++;
+    }
+    consumer_errors = errors;
+}
+
+static void (*volatile core1_consumer)(void);
+
+static void core1_consumer_entry(void) {
+    core1_consumer();
+    multicore_fifo_push_blocking(consumer_errors);
+}
+
+static void run_consumer(void (*consumer)(void)) {
+    core1_consumer = consumer;
+    multicore_reset_core1();
+    multicore_launch_core1(core1_consumer_entry);
+}
+
+static void wait_consumer(void) {
+    consumer_errors = multicore_fifo_pop_blocking();
+}
+
+static void report(const char *name, uint64_t elapsed_us) {
+    printf("%-12s %8"PRIu64" us, %6"PRIu64" ns/element\n", name, elapsed_us,
+           elapsed_us ? (elapsed_us * 1000u) / NUM_TRANSFERS : 0);
+}
+
+int main() {
+    stdio_init_all();
+
+    PICOTEST_START();
+
+    PICOTEST_START_SECTION("spsc_queue single threaded");
+        spsc_queue_init(&spsc_queue, sizeof(element_t), 3);
+        element_t e = {0, 0};
+        PICOTEST_CHECK(spsc_queue_is_empty(&spsc_queue), "new queue not empty");
+        PICOTEST_CHECK(!spsc_queue_try_remove(&spsc_queue, &e), "removed from empty queue");
+        for (uint32_t i = 0; i < 3; i++) {
+            e.seq = i;
+            PICOTEST_CHECK(spsc_queue_try_add(&spsc_queue, &e), "failed to add to non-full queue");
+        }
+        PICOTEST_CHECK(spsc_queue_is_full(&spsc_queue), "queue not full");
+        PICOTEST_CHECK(!spsc_queue_try_add(&spsc_queue, &e), "added to full queue");
+        PICOTEST_CHECK(spsc_queue_get_level(&spsc_queue) == 3, "wrong level");
+#if PICO_QUEUE_MAX_LEVEL
+        PICOTEST_CHECK(spsc_queue_get_max_level(&spsc_queue) == 3, "wrong max level");
+#endif
+        PICOTEST_CHECK(spsc_queue_try_peek(&spsc_queue, &e) && e.seq == 0, "wrong peeked value");
+        for (uint32_t i = 0; i < 3; i++) {
+            PICOTEST_CHECK(spsc_queue_try_remove(&spsc_queue, &e) && e.seq == i, "wrong removed value");
+        }
+        PICOTEST_CHECK(spsc_queue_is_empty(&spsc_queue), "queue not empty");
+        spsc_queue_free(&spsc_queue);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("queue_t cross thread throughput");
+        queue_init(&locked_queue, sizeof(element_t), QUEUE_LENGTH);
+        uint64_t start = time_us_64();
+        run_consumer(locked_consumer);
+        for (uint32_t i = 0; i < NUM_TRANSFERS; i++) {
+            element_t e = {i, ~i};
+            queue_add_blocking(&locked_queue, &e);
+        }
+        wait_consumer();
+        report("queue_t", time_us_64() - start);
+        PICOTEST_CHECK(!consumer_errors, "queue_t delivered out of order or corrupted data");
+        queue_free(&locked_queue);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("queue_t batch single threaded");
+        queue_init(&locked_queue, sizeof(element_t), 5);
+        element_t in[5], out[5];
+        for (uint32_t i = 0; i < 5; i++) {
+            in[i].seq = i;
+            in[i].payload = ~i;
+        }
+        // move the pointers part way round so that batches straddle the wrap point
+        PICOTEST_CHECK(queue_try_add_n(&locked_queue, in, 3) == 3, "failed to add batch");
+        PICOTEST_CHECK(queue_try_remove_n(&locked_queue, out, 3) == 3, "failed to remove batch");
+        PICOTEST_CHECK(queue_try_add_n(&locked_queue, in, 5) == 5, "failed to add wrapping batch");
+        PICOTEST_CHECK(queue_try_add_n(&locked_queue, in, 1) == 0, "added to full queue");
+        PICOTEST_CHECK(queue_try_remove_n(&locked_queue, out, 2) == 2, "failed to remove partial batch");
+        PICOTEST_CHECK(out[0].seq == 0 && out[1].seq == 1, "wrong values in partial batch");
+        PICOTEST_CHECK(queue_try_add_n(&locked_queue, in, 5) == 2, "wrong count added to nearly full queue");
+        PICOTEST_CHECK(queue_try_remove_n(&locked_queue, out, 5) == 5, "failed to remove wrapping batch");
+        PICOTEST_CHECK(out[0].seq == 2 && out[2].seq == 4 && out[3].seq == 0 && out[4].seq == 1, "wrong values in wrapping batch");
+        PICOTEST_CHECK(out[4].payload == ~1u, "wrong payload in wrapping batch");
+        PICOTEST_CHECK(queue_try_remove_n(&locked_queue, out, 5) == 0, "removed from empty queue");
+        queue_free(&locked_queue);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("queue_t batch cross thread throughput");
+        queue_init(&locked_queue, sizeof(element_t), QUEUE_LENGTH);
+        uint64_t start = time_us_64();
+        run_consumer(locked_batch_consumer);
+        element_t e[BATCH_SIZE];
+        for (uint32_t i = 0; i < NUM_TRANSFERS; i += BATCH_SIZE) {
+            for (uint32_t j = 0; j < BATCH_SIZE; j++) {
+                e[j].seq = i + j;
+                e[j].payload = ~(i + j);
+            }
+            queue_add_n_blocking(&locked_queue, e, BATCH_SIZE);
+        }
+        wait_consumer();
+        report("queue_t x16", time_us_64() - start);
+        PICOTEST_CHECK(!consumer_errors, "queue_t batch delivered out of order or corrupted data");
+        queue_free(&locked_queue);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("queue_t zero copy single threaded");
+        queue_init(&locked_queue, sizeof(uint32_t), 4);
+        void *wptr;
+        const void *rptr;
+        PICOTEST_CHECK(!queue_try_peek_ptr(&locked_queue), "peeked empty queue");
+        PICOTEST_CHECK(queue_try_reserve_span(&locked_queue, &wptr, 3) == 3, "failed to reserve span");
+        for (uint32_t i = 0; i < 3; i++) ((uint32_t *)wptr)[i] = i;
+        PICOTEST_CHECK(queue_is_empty(&locked_queue), "reserved entries visible before commit");
+        queue_commit_n(&locked_queue, 3);
+        PICOTEST_CHECK(queue_get_level(&locked_queue) == 3, "wrong level after commit");
+        PICOTEST_CHECK(queue_try_peek_span(&locked_queue, &rptr, 4) == 3, "failed to peek span");
+        PICOTEST_CHECK(((const uint32_t *)rptr)[2] == 2, "wrong peeked value");
+        queue_release_n(&locked_queue, 2);
+        // 1 entry left at index 2; free space is indexes 3,4 then 0 (wrapped), so only 2 are contiguous
+        PICOTEST_CHECK(queue_try_reserve_span(&locked_queue, &wptr, 4) == 2, "reserved span across wrap");
+        ((uint32_t *)wptr)[0] = 3;
+        ((uint32_t *)wptr)[1] = 4;
+        queue_commit_n(&locked_queue, 2);
+        uint32_t *slot = (uint32_t *)queue_try_reserve(&locked_queue);
+        PICOTEST_CHECK(slot == (uint32_t *)locked_queue.data, "reservation did not wrap to start of storage");
+        *slot = 5;
+        queue_commit(&locked_queue);
+        PICOTEST_CHECK(!queue_try_reserve(&locked_queue), "reserved in full queue");
+        for (uint32_t i = 2; i < 6; i++) {
+            const uint32_t *v = (const uint32_t *)queue_try_peek_ptr(&locked_queue);
+            PICOTEST_CHECK(v && *v == i, "wrong value peeked in place");
+            queue_release(&locked_queue);
+        }
+        PICOTEST_CHECK(queue_is_empty(&locked_queue), "queue not empty");
+        queue_free(&locked_queue);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("queue_t zero copy cross thread");
+        queue_init(&locked_queue, PACKET_SIZE, 16);
+        uint64_t start = time_us_64();
+        run_consumer(zero_copy_consumer);
+        for (uint32_t i = 0; i < NUM_PACKETS; ) {
+            void *ptr;
+            uint n = queue_try_reserve_span(&locked_queue, &ptr, 4);
+            if (!n) {
+                ptr = queue_reserve_blocking(&locked_queue);
+                n = 1;
+            }
+            n = MIN(n, NUM_PACKETS - i);
+            uint8_t *p = (uint8_t *)ptr;
+            for (uint j = 0; j < n; j++) {
+                for (uint32_t k = 0; k < PACKET_SIZE; k++) {
+                    *p++ = packet_byte(i + j, k);
+                }
+            }
+            queue_commit_n(&locked_queue, n);
+            i += n;
+        }
+        wait_consumer();
+        printf("%-12s %8"PRIu64" us for %u %u byte packets\n", "zero copy", time_us_64() - start, NUM_PACKETS, PACKET_SIZE);
+        PICOTEST_CHECK(!consumer_errors, "zero copy packets delivered out of order or corrupted");
+        queue_free(&locked_queue);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("spsc_queue_t cross thread throughput");
+        spsc_queue_init(&spsc_queue, sizeof(element_t), QUEUE_LENGTH);
+        uint64_t start = time_us_64();
+        run_consumer(spsc_consumer);
+        for (uint32_t i = 0; i < NUM_TRANSFERS; i++) {
+            element_t e = {i, ~i};
+            spsc_queue_add_blocking(&spsc_queue, &e);
+        }
+        wait_consumer();
+        report("spsc_queue_t", time_us_64() - start);
+        PICOTEST_CHECK(!consumer_errors, "spsc_queue_t delivered out of order or corrupted data");
+        spsc_queue_free(&spsc_queue);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
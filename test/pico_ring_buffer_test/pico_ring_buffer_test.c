@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "pico/util/ring_buffer.h"
+#include "pico/multicore.h"
+#include "pico/test.h"
+
+PICOTEST_MODULE_NAME("RING_BUFFER", "ring buffer test and asynchronous output throughput benchmark");
+
+// The benchmark compares writing log lines synchronously to a slow output (as stdio does by default) with
+// writing them to a ring buffer which is drained to the same output by the other core (as stdio does with
+// asynchronous output enabled, see stdio_async_output_enable)
+
+#if PICO_ON_DEVICE
+#define NUM_LINES 2000u
+#else
+#define NUM_LINES 20000u
+#endif
+#define RING_SIZE 4096u
+// simulated output speed; a real 115200 baud UART is ~87us per byte
+#define SINK_NS_PER_BYTE 250u
+#define SINK_NS_PER_CALL 2000u
+
+static ring_buffer_t ring;
+static uint8_t ring_storage[RING_SIZE];
+static volatile bool producer_done;
+static volatile uint32_t sink_bytes;
+static volatile uint32_t sink_calls;
+static volatile uint32_t sink_checksum;
+
+static void sink_out_chars(const uint8_t *buf, uint len) {
+    uint32_t sum = sink_checksum;
+    for (uint i = 0; i < len; i++) sum = sum * 31u + buf[i];
+    sink_checksum = sum;
+    sink_bytes += len;
+    sink_calls++;
+    busy_wait_us((SINK_NS_PER_CALL + len * SINK_NS_PER_BYTE) / 1000u);
+}
+
+static uint format_line(char *buf, uint size, uint32_t i) {
+    return (uint)snprintf(buf, size, "[%8"PRIu32"] sensor %u reading %"PRIu32" status ok\n", i, (uint)(i % 7u), i * 37u);
+}
+
+static void drain_consumer(void) {
+    do {
+        const uint8_t *data;
+        uint n = ring_buffer_peek_contiguous(&ring, &data);
+        if (n) {
+            sink_out_chars(data, n);
+            ring_buffer_consume(&ring, n);
+        } else if (producer_done) {
+            if (ring_buffer_is_empty(&ring)) break;
+        } else {
+            tight_loop_contents();
+        }
+    } while (true);
+}
+
+static void core1_entry(void) {
+    drain_consumer();
+    multicore_fifo_push_blocking(0);
+}
+
+static void reset_sink(void) {
+    sink_bytes = sink_calls = sink_checksum = 0;
+}
+
+int main() {
+    stdio_init_all();
+
+    PICOTEST_START();
+
+    PICOTEST_START_SECTION("ring buffer single threaded");
+        static uint8_t storage[8];
+        uint8_t out[8];
+        const uint8_t *p;
+        ring_buffer_init(&ring, storage, sizeof(storage));
+        PICOTEST_CHECK(ring_buffer_is_empty(&ring), "new ring buffer not empty");
+        PICOTEST_CHECK(ring_buffer_get_free(&ring) == 8, "wrong free space");
+        PICOTEST_CHECK(!ring_buffer_try_read(&ring, out, 8), "read from empty ring buffer");
+        PICOTEST_CHECK(!ring_buffer_peek_contiguous(&ring, &p), "peeked empty ring buffer");
+        PICOTEST_CHECK(ring_buffer_try_write(&ring, "abcdef", 6) == 6, "failed to write");
+        PICOTEST_CHECK(ring_buffer_try_read(&ring, out, 4) == 4 && !memcmp(out, "abcd", 4), "wrong bytes read");
+        // 2 bytes left at offset 4; a write of 7 only has room for 6, and wraps
+        PICOTEST_CHECK(ring_buffer_try_write(&ring, "0123456", 7) == 6, "wrong count written to nearly full ring buffer");
+        PICOTEST_CHECK(ring_buffer_get_level(&ring) == 8 && !ring_buffer_get_free(&ring), "ring buffer not full");
+        PICOTEST_CHECK(!ring_buffer_try_write(&ring, "x", 1), "wrote to full ring buffer");
+        PICOTEST_CHECK(ring_buffer_peek_contiguous(&ring, &p) == 4 && !memcmp(p, "ef01", 4), "wrong contiguous run before wrap");
+        ring_buffer_consume(&ring, 3);
+        PICOTEST_CHECK(ring_buffer_try_read(&ring, out, 8) == 5 && !memcmp(out, "12345", 5), "wrong bytes read across wrap");
+        PICOTEST_CHECK(ring_buffer_is_empty(&ring), "ring buffer not empty");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("static initializer");
+        static uint8_t static_storage[16];
+        static ring_buffer_t static_ring = RING_BUFFER_STATIC_INIT(static_storage, sizeof(static_storage));
+        ring_buffer_t initialized;
+        ring_buffer_init(&initialized, static_storage, sizeof(static_storage));
+        PICOTEST_CHECK(static_ring.data == initialized.data && static_ring.mask == initialized.mask &&
+                       static_ring.wptr == initialized.wptr && static_ring.rptr == initialized.rptr,
+                       "differs from ring_buffer_init");
+        PICOTEST_CHECK(ring_buffer_try_write(&static_ring, "abc", 3) == 3 && ring_buffer_get_free(&static_ring) == 13,
+                       "statically initialized ring buffer not usable");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("synchronous output");
+        char line[80];
+        reset_sink();
+        uint64_t start = time_us_64();
+        for (uint32_t i = 0; i < NUM_LINES; i++) {
+            uint len = format_line(line, sizeof(line), i);
+            sink_out_chars((const uint8_t *)line, len);
+        }
+        uint64_t elapsed = time_us_64() - start;
+        printf("%-12s caller %8"PRIu64" us (%5"PRIu64" ns/line), %"PRIu32" bytes in %"PRIu32" output calls\n", "sync", elapsed,
+               elapsed * 1000u / NUM_LINES, sink_bytes, sink_calls);
+    PICOTEST_END_SECTION();
+
+    static uint32_t sync_checksum, sync_bytes;
+    sync_checksum = sink_checksum;
+    sync_bytes = sink_bytes;
+
+    PICOTEST_START_SECTION("asynchronous output, block when full");
+        char line[80];
+        reset_sink();
+        ring_buffer_init(&ring, ring_storage, sizeof(ring_storage));
+        producer_done = false;
+        multicore_reset_core1();
+        multicore_launch_core1(core1_entry);
+        uint64_t start = time_us_64();
+        for (uint32_t i = 0; i < NUM_LINES; i++) {
+            uint len = format_line(line, sizeof(line), i);
+            ring_buffer_write_blocking(&ring, line, len);
+        }
+        uint64_t elapsed = time_us_64() - start;
+        producer_done = true;
+        multicore_fifo_pop_blocking();
+        uint64_t drained = time_us_64() - start;
+        printf("%-12s caller %8"PRIu64" us (%5"PRIu64" ns/line), drained after %"PRIu64" us, %"PRIu32" bytes in %"PRIu32" output calls\n", "async block",
+               elapsed, elapsed * 1000u / NUM_LINES, drained, sink_bytes, sink_calls);
+        PICOTEST_CHECK(sink_bytes == sync_bytes && sink_checksum == sync_checksum, "asynchronous output differs from synchronous output");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("asynchronous output, drop when full");
+        char line[80];
+        reset_sink();
+        ring_buffer_init(&ring, ring_storage, sizeof(ring_storage));
+        producer_done = false;
+        uint32_t dropped = 0;
+        multicore_reset_core1();
+        multicore_launch_core1(core1_entry);
+        uint64_t start = time_us_64();
+        for (uint32_t i = 0; i < NUM_LINES; i++) {
+            uint len = format_line(line, sizeof(line), i);
+            dropped += len - ring_buffer_try_write(&ring, line, len);
+        }
+        uint64_t elapsed = time_us_64() - start;
+        producer_done = true;
+        multicore_fifo_pop_blocking();
+        printf("%-12s caller %8"PRIu64" us (%5"PRIu64" ns/line), %"PRIu32" bytes output, %"PRIu32" dropped\n", "async drop",
+               elapsed, elapsed * 1000u / NUM_LINES, sink_bytes, dropped);
+        PICOTEST_CHECK(sink_bytes + dropped == sync_bytes, "bytes lost other than those dropped");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
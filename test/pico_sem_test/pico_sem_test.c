@@ -5,13 +5,40 @@
  */
 
 #include <stdio.h>
+#include <inttypes.h>
 
 #include "pico/sem.h"
+#include "pico/mutex.h"
+#include "pico/multicore.h"
 #include "pico/test.h"
 #include "pico/stdio.h"
+#include "pico/time.h"
 
 PICOTEST_MODULE_NAME("SEM", "semaphore test");
 
+#define NUM_ITERATIONS 100000u
+
+static mutex_t counter_mutex;
+static volatile uint32_t counter;
+static semaphore_t ping, pong;
+
+static void core1_mutex_contention(void) {
+    for (uint32_t i = 0; i < NUM_ITERATIONS; i++) {
+        mutex_enter_blocking(&counter_mutex);
+        counter = counter + 1;
+        mutex_exit(&counter_mutex);
+    }
+    multicore_fifo_push_blocking(0);
+}
+
+static void core1_ping_pong(void) {
+    for (uint32_t i = 0; i < NUM_ITERATIONS; i++) {
+        sem_acquire_blocking(&ping);
+        sem_release(&pong);
+    }
+    multicore_fifo_push_blocking(0);
+}
+
 int main() {
     semaphore_t sem;
 
@@ -25,5 +52,37 @@ int main() {
         PICOTEST_CHECK(!sem_try_acquire(&sem), "success with no permits");
     PICOTEST_END_SECTION();
 
+    PICOTEST_START_SECTION("mutex contention across cores");
+        mutex_init(&counter_mutex);
+        counter = 0;
+        uint64_t start = time_us_64();
+        multicore_reset_core1();
+        multicore_launch_core1(core1_mutex_contention);
+        for (uint32_t i = 0; i < NUM_ITERATIONS; i++) {
+            mutex_enter_blocking(&counter_mutex);
+            counter = counter + 1;
+            mutex_exit(&counter_mutex);
+        }
+        multicore_fifo_pop_blocking();
+        printf("mutex: %"PRIu64" us for %u contended enter/exit pairs per core\n", time_us_64() - start, NUM_ITERATIONS);
+        PICOTEST_CHECK(counter == 2 * NUM_ITERATIONS, "mutex did not provide mutual exclusion");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("semaphore ping pong across cores");
+        sem_init(&ping, 0, 1);
+        sem_init(&pong, 0, 1);
+        uint64_t start = time_us_64();
+        multicore_reset_core1();
+        multicore_launch_core1(core1_ping_pong);
+        bool ok = true;
+        for (uint32_t i = 0; i < NUM_ITERATIONS && ok; i++) {
+            sem_release(&ping);
+            ok = sem_acquire_timeout_ms(&pong, 1000);
+        }
+        PICOTEST_CHECK(ok, "timed out waiting for pong");
+        multicore_fifo_pop_blocking();
+        printf("semaphore: %"PRIu64" us for %u round trips\n", time_us_64() - start, NUM_ITERATIONS);
+    PICOTEST_END_SECTION();
+
     PICOTEST_END_TEST();
 }
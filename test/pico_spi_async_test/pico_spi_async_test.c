@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+#include "pico/spi_async.h"
+#include "hardware/pio.h"
+
+PICOTEST_MODULE_NAME("SPI_ASYNC", "asynchronous SPI transfer test");
+
+#define CS_A 5
+#define CS_B 6
+#define CS_MASK ((1u << CS_A) | (1u << CS_B))
+
+#define NUM_TRANSFERS 8
+#define TRANSFER_LEN 64
+
+static spi_async_t engine;
+
+static uint8_t tx_data[NUM_TRANSFERS][TRANSFER_LEN];
+static uint8_t rx_data[NUM_TRANSFERS][TRANSFER_LEN];
+static spi_async_transfer_t transfers[NUM_TRANSFERS];
+
+static uint completed[NUM_TRANSFERS * 2];
+static uint completed_count;
+
+static void on_complete(spi_async_transfer_t *t) {
+    if (completed_count < count_of(completed)) completed[completed_count++] = (uint)(uintptr_t)t->user_data;
+}
+
+// a device which returns each frame inverted, and checks it is the only one selected
+static uint32_t peer_cs;
+static uint peer_frames, peer_bad_cs;
+
+static uint16_t inverting_peer(__unused spi_inst_t *spi, uint16_t tx_frame) {
+    peer_frames++;
+    if ((gpio_get_all() & CS_MASK) != (CS_MASK & ~(1u << peer_cs))) peer_bad_cs++;
+    return (uint16_t)~tx_frame;
+}
+
+// submits another transfer from its callback
+static spi_async_transfer_t follow_on;
+static void submit_follow_on(spi_async_transfer_t *t) {
+    on_complete(t);
+    spi_async_submit(&engine, &follow_on);
+}
+
+int main() {
+    setup_default_uart();
+    PICOTEST_START();
+
+    // 4 system clocks per bit, so 32 per byte
+    uint baud = spi_init(spi0, 125 * 1000 * 1000 / 4);
+    spi_async_init(&engine, spi0);
+    gpio_init_mask(CS_MASK);
+    gpio_set_dir_out_masked(CS_MASK);
+    gpio_put_masked(CS_MASK, CS_MASK);
+    for (uint i = 0; i < NUM_TRANSFERS; i++) {
+        for (uint j = 0; j < TRANSFER_LEN; j++) tx_data[i][j] = (uint8_t)(i * 31 + j * 7);
+    }
+
+    PICOTEST_START_SECTION("a transfer is looped back");
+        PICOTEST_CHECK(spi_async_is_idle(&engine), "should be idle");
+        spi_async_transfer_init(&transfers[0], tx_data[0], rx_data[0], TRANSFER_LEN, CS_A, on_complete, (void *)0);
+        spi_async_submit(&engine, &transfers[0]);
+        PICOTEST_CHECK(!spi_async_is_idle(&engine), "should be busy");
+        PICOTEST_CHECK(!gpio_get(CS_A), "chip select should be asserted");
+        spi_async_transfer_wait(&engine, &transfers[0]);
+        PICOTEST_CHECK(!memcmp(rx_data[0], tx_data[0], TRANSFER_LEN), "wrong data");
+        PICOTEST_CHECK(gpio_get(CS_A), "chip select should be deasserted");
+        PICOTEST_CHECK(completed_count == 1 && completed[0] == 0, "callback not called");
+        PICOTEST_CHECK(spi_async_is_idle(&engine), "should be idle");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("queued transfers run in order, each with its chip select");
+        spi_host_set_peer(spi0, inverting_peer);
+        memset(rx_data, 0, sizeof(rx_data));
+        completed_count = 0;
+        peer_frames = 0;
+        for (uint i = 0; i < NUM_TRANSFERS; i++) {
+            spi_async_transfer_init(&transfers[i], tx_data[i], rx_data[i], TRANSFER_LEN, (i & 1) ? CS_B : CS_A,
+                                    on_complete, (void *)(uintptr_t)i);
+        }
+        peer_cs = CS_A;
+        spi_async_submit(&engine, &transfers[0]);
+        for (uint i = 1; i < NUM_TRANSFERS; i++) spi_async_submit(&engine, &transfers[i]);
+        // the peer checks the chip select of the transfer in progress
+        for (uint i = 0; i < NUM_TRANSFERS; i++) {
+            peer_cs = (i & 1) ? CS_B : CS_A;
+            spi_async_transfer_wait(&engine, &transfers[i]);
+        }
+        PICOTEST_CHECK(spi_async_is_idle(&engine), "should be idle");
+        PICOTEST_CHECK(peer_frames == NUM_TRANSFERS * TRANSFER_LEN && !peer_bad_cs, "wrong chip select");
+        bool ok = completed_count == NUM_TRANSFERS;
+        for (uint i = 0; i < NUM_TRANSFERS && ok; i++) {
+            ok = completed[i] == i;
+            for (uint j = 0; j < TRANSFER_LEN && ok; j++) ok = rx_data[i][j] == (uint8_t)~tx_data[i][j];
+        }
+        PICOTEST_CHECK(ok, "wrong data or order");
+        spi_host_set_peer(spi0, NULL);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("transfers without buffers, and submitted by callbacks");
+        completed_count = 0;
+        uint8_t rx[4];
+        spi_async_transfer_init(&transfers[0], tx_data[0], NULL, TRANSFER_LEN, -1, submit_follow_on, (void *)0);
+        spi_async_transfer_init(&follow_on, NULL, rx, sizeof(rx), CS_B, on_complete, (void *)1);
+        follow_on.tx_fill = 0xa5;
+        spi_async_submit(&engine, &transfers[0]);
+        spi_async_wait_idle(&engine);
+        PICOTEST_CHECK(completed_count == 2 && completed[0] == 0 && completed[1] == 1, "both should complete");
+        PICOTEST_CHECK(rx[0] == 0xa5 && rx[3] == 0xa5, "expected the fill value");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("back to back transfers keep the SPI busy");
+        uint64_t frames0, busy0, frames1, busy1;
+        spi_host_get_stats(spi0, &frames0, &busy0);
+        uint64_t start = pio_host_get_cycle_count();
+        for (uint i = 0; i < NUM_TRANSFERS; i++) {
+            spi_async_transfer_init(&transfers[i], tx_data[i], rx_data[i], TRANSFER_LEN, CS_A, NULL, NULL);
+            spi_async_submit(&engine, &transfers[i]);
+        }
+        spi_async_wait_idle(&engine);
+        uint64_t elapsed = pio_host_get_cycle_count() - start;
+        spi_host_get_stats(spi0, &frames1, &busy1);
+        uint64_t busy = busy1 - busy0;
+        PICOTEST_CHECK(frames1 - frames0 == NUM_TRANSFERS * TRANSFER_LEN, "wrong frame count");
+        printf("%d x %d bytes at %u baud: SPI busy for %"PRIu64" of %"PRIu64" cycles\n", NUM_TRANSFERS,
+               TRANSFER_LEN, baud, busy, elapsed);
+        PICOTEST_CHECK(busy * 100 > elapsed * 95, "expected the SPI to be busy at least 95% of the time");
+    PICOTEST_END_SECTION();
+
+    spi_async_deinit(&engine);
+    spi_deinit(spi0);
+    PICOTEST_END_TEST();
+}
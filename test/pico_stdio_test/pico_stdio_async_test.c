@@ -0,0 +1,310 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// the pico_stdio and pico_printf implementations are included directly (as in pico_stdio_host_test), with the
+// functions renamed so they don't replace those of the host C library or the host pico_stdio
+#define WRAPPER_FUNC(x) pico_##x
+#define getchar_timeout_us pico_getchar_timeout_us
+// the device pico/stdio.h has the same include guard as the host one, so must be included first to take its place
+#include "pico_stdio/include/pico/stdio.h"
+#ifndef __printflike
+#define __printflike(a, b) __attribute__((format(printf, a, b)))
+#endif
+#include "printf.c"
+#include "stdio.c"
+
+#include <inttypes.h>
+#include "pico/multicore.h"
+#include "pico/test.h"
+
+PICOTEST_MODULE_NAME("pico_stdio_async_test", "pico_stdio asynchronous output test and throughput benchmark");
+
+static_assert(PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE == 256, "");
+
+#define CAPTURE_SIZE 1048576u
+#define NUM_LINES 5000u
+// simulated output speed; a real 115200 baud UART is ~87us per byte
+#define SLOW_NS_PER_BYTE 250u
+#define SLOW_NS_PER_CALL 2000u
+
+typedef struct {
+    char buf[CAPTURE_SIZE];
+    uint len;
+    uint calls;
+    uint flushes;
+    bool slow;
+} capture_t;
+
+static capture_t capture_a, capture_b;
+
+static void capture(capture_t *c, const char *buf, int len) {
+    hard_assert(c->len + (uint)len <= CAPTURE_SIZE);
+    memcpy(c->buf + c->len, buf, (uint)len);
+    c->len += (uint)len;
+    c->calls++;
+}
+
+// spin, as sleeping on the host takes much longer than the output times being simulated
+static void slow_output(uint len) {
+    uint64_t until = time_us_64() + (SLOW_NS_PER_CALL + len * SLOW_NS_PER_BYTE) / 1000u;
+    while (time_us_64() < until);
+}
+
+static void capture_reset(void) {
+    capture_a.len = capture_a.calls = capture_a.flushes = 0;
+    capture_b.len = capture_b.calls = capture_b.flushes = 0;
+}
+
+static bool captured(const capture_t *c, const char *expected) {
+    return c->len == strlen(expected) && !memcmp(c->buf, expected, c->len);
+}
+
+static void a_out_chars(const char *buf, int len) {
+    capture(&capture_a, buf, len);
+    if (capture_a.slow) slow_output((uint)len);
+}
+
+// a line and its translated line ending go out in a single call
+static void a_out_chars_gather(const stdio_span_t *spans, uint count) {
+    uint len = 0;
+    for (uint i = 0; i < count; i++) {
+        capture(&capture_a, spans[i].buf, spans[i].len);
+        len += (uint)spans[i].len;
+    }
+    capture_a.calls -= count - 1;
+    if (capture_a.slow) slow_output(len);
+}
+
+static void a_out_flush(void) {
+    capture_a.flushes++;
+}
+
+static void b_out_chars(const char *buf, int len) {
+    capture(&capture_b, buf, len);
+}
+
+static stdio_driver_t driver_a = {
+    .out_chars = a_out_chars,
+    .out_chars_gather = a_out_chars_gather,
+    .out_flush = a_out_flush,
+    .crlf_enabled = true,
+};
+
+static stdio_driver_t driver_b = {
+    .out_chars = b_out_chars,
+    .crlf_enabled = true,
+};
+
+static volatile uint drain_requests;
+
+// drains only when the test says so
+static void count_drain_request(__unused void *param) {
+    drain_requests++;
+}
+
+static volatile bool core1_drain_requested;
+static volatile bool core1_stop;
+
+static void core1_drain_request(__unused void *param) {
+    core1_drain_requested = true;
+}
+
+static void core1_entry(void) {
+    while (!core1_stop) {
+        if (core1_drain_requested) {
+            core1_drain_requested = false;
+            stdio_async_output_drain();
+        } else {
+            tight_loop_contents();
+        }
+    }
+    multicore_fifo_push_blocking(0);
+}
+
+// pico_printf calls the host C library's vprintf
+static int __printflike(1, 2) test_printf(const char *format, ...) {
+    va_list va;
+    va_start(va, format);
+    int ret = pico_vprintf(format, va);
+    va_end(va);
+    return ret;
+}
+
+// 300 bytes of distinct characters, with no newlines
+static char pattern[301];
+
+static void write_pattern(void) {
+    test_printf("%.100s", pattern);
+    pico_putchar(pattern[100]);
+    _write(STDIO_HANDLE_STDOUT, pattern + 101, 199);
+}
+
+static int format_line(char *buf, uint size, uint32_t i) {
+    return snprintf(buf, size, "[%8"PRIu32"] sensor %u reading %"PRIu32" status ok\n", i, (uint)(i % 7u), i * 37u);
+}
+
+static uint64_t print_lines(void) {
+    uint64_t start = time_us_64();
+    for (uint32_t i = 0; i < NUM_LINES; i++) {
+        test_printf("[%8"PRIu32"] sensor %u reading %"PRIu32" status ok\n", i, (uint)(i % 7u), i * 37u);
+    }
+    return time_us_64() - start;
+}
+
+int main() {
+    PICOTEST_START();
+
+    for (uint i = 0; i < 300; i++) pattern[i] = (char)('!' + i % 90u);
+    stdio_set_driver_enabled(&driver_a, true);
+
+    PICOTEST_START_SECTION("drop when full");
+        capture_reset();
+        drain_requests = 0;
+        PICOTEST_CHECK(stdio_async_output_enable(STDIO_ASYNC_OVERFLOW_DROP, count_drain_request, NULL), "failed to enable");
+        write_pattern();
+        PICOTEST_CHECK(!capture_a.len, "output should be buffered until drained");
+        PICOTEST_CHECK(drain_requests == 1, "expected a single drain request");
+        PICOTEST_CHECK(stdio_async_output_get_dropped_bytes() == 300 - PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE, "wrong dropped count");
+        stdio_async_output_drain();
+        PICOTEST_CHECK(capture_a.len == PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE &&
+                       !memcmp(capture_a.buf, pattern, PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE), "the oldest output should be kept");
+        PICOTEST_CHECK(capture_a.flushes == 1, "the drain should flush the drivers");
+        pico_puts("more");
+        PICOTEST_CHECK(drain_requests == 2, "output after a drain should request another");
+        stdio_async_output_disable();
+        PICOTEST_CHECK(capture_a.len == PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE + 6, "disable should drain the output");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("overwrite when full");
+        capture_reset();
+        PICOTEST_CHECK(stdio_async_output_enable(STDIO_ASYNC_OVERFLOW_OVERWRITE, count_drain_request, NULL), "failed to enable");
+        write_pattern();
+        PICOTEST_CHECK(stdio_async_output_get_dropped_bytes() == 300 - PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE, "wrong dropped count");
+        stdio_async_output_drain();
+        PICOTEST_CHECK(capture_a.len == PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE &&
+                       !memcmp(capture_a.buf, pattern + 300 - PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE,
+                               PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE), "the most recent output should be kept");
+        // a single write larger than the whole buffer keeps its end
+        capture_reset();
+        _write(STDIO_HANDLE_STDOUT, pattern, 300);
+        stdio_async_output_drain();
+        PICOTEST_CHECK(capture_a.len == PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE &&
+                       !memcmp(capture_a.buf, pattern + 300 - PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE,
+                               PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE), "the end of a long write should be kept");
+        PICOTEST_CHECK(stdio_async_output_get_dropped_bytes() == 2 * (300 - PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE), "wrong dropped count");
+        stdio_async_output_disable();
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("block when full");
+        capture_reset();
+        PICOTEST_CHECK(stdio_async_output_enable(STDIO_ASYNC_OVERFLOW_BLOCK, count_drain_request, NULL), "failed to enable");
+        // nothing else drains, so the writer makes room itself
+        write_pattern();
+        write_pattern();
+        PICOTEST_CHECK(capture_a.len >= 600 - PICO_STDIO_ASYNC_OUTPUT_BUFFER_SIZE, "writer should have drained to make room");
+        PICOTEST_CHECK(!stdio_async_output_get_dropped_bytes(), "nothing should be dropped");
+        stdio_flush();
+        PICOTEST_CHECK(capture_a.len == 600 && !memcmp(capture_a.buf, pattern, 300) && !memcmp(capture_a.buf + 300, pattern, 300),
+                       "output lost or reordered");
+        stdio_async_output_disable();
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("CR/LF translation, flush and raw output");
+        capture_reset();
+        PICOTEST_CHECK(stdio_async_output_enable(STDIO_ASYNC_OVERFLOW_DROP, count_drain_request, NULL), "failed to enable");
+        test_printf("one\n");
+        pico_puts("two");
+        PICOTEST_CHECK(!capture_a.len, "output should be buffered until drained");
+        stdio_flush();
+        PICOTEST_CHECK(captured(&capture_a, "one\r\ntwo\r\n"), "stdio_flush should drain the translated output");
+        PICOTEST_CHECK(capture_a.flushes == 1, "stdio_flush should flush the drivers once");
+        test_printf("three\n");
+        puts_raw("four");
+        PICOTEST_CHECK(captured(&capture_a, "one\r\ntwo\r\nthree\r\nfour\n"), "raw output should follow the buffered output");
+        stdio_async_output_disable();
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("driver filter applies when output is written");
+        capture_reset();
+        stdio_set_driver_enabled(&driver_b, true);
+        PICOTEST_CHECK(stdio_async_output_enable(STDIO_ASYNC_OVERFLOW_DROP, count_drain_request, NULL), "failed to enable");
+        test_printf("1");
+        stdio_filter_driver(&driver_a);
+        test_printf("a");
+        stdio_filter_driver(&driver_b);
+        test_printf("b");
+        stdio_filter_driver(NULL);
+        test_printf("2");
+        stdio_async_output_drain();
+        PICOTEST_CHECK(captured(&capture_a, "1a2"), "wrong output to the first driver");
+        PICOTEST_CHECK(captured(&capture_b, "1b2"), "wrong output to the second driver");
+        stdio_async_output_disable();
+        stdio_set_driver_enabled(&driver_b, false);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("drain from a user IRQ");
+        capture_reset();
+        PICOTEST_CHECK(stdio_async_output_enable(STDIO_ASYNC_OVERFLOW_BLOCK, NULL, NULL), "failed to enable");
+        uint irq = async_out.irq_num;
+        PICOTEST_CHECK(user_irq_is_claimed(irq), "the IRQ should be claimed");
+        // on the host a pended IRQ is handled straight away
+        test_printf("hello %d\n", 42);
+        PICOTEST_CHECK(captured(&capture_a, "hello 42\r\n"), "the IRQ should have drained the output");
+        stdio_async_output_disable();
+        PICOTEST_CHECK(!user_irq_is_claimed(irq), "the IRQ should be released");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("throughput to a slow driver, drained by core 1");
+        // reference output
+        static char expected[CAPTURE_SIZE];
+        uint expected_len = 0;
+        for (uint32_t i = 0; i < NUM_LINES; i++) {
+            char line[80];
+            int n = format_line(line, sizeof(line), i);
+            line[n - 1] = '\r';
+            line[n] = '\n';
+            memcpy(expected + expected_len, line, (uint)n + 1);
+            expected_len += (uint)n + 1;
+        }
+        capture_reset();
+        capture_a.slow = true;
+        uint64_t sync_us = print_lines();
+        PICOTEST_CHECK(capture_a.len == expected_len && !memcmp(capture_a.buf, expected, expected_len), "wrong synchronous output");
+        printf("  sync         %8"PRIu64" us (%5"PRIu64" ns/line), %u output calls\n", sync_us,
+               sync_us * 1000u / NUM_LINES, capture_a.calls);
+
+        for (int mode = STDIO_ASYNC_OVERFLOW_DROP; mode <= STDIO_ASYNC_OVERFLOW_OVERWRITE; mode++) {
+            static const char *const names[] = {"drop", "block", "overwrite"};
+            capture_reset();
+            core1_stop = core1_drain_requested = false;
+            multicore_reset_core1();
+            multicore_launch_core1(core1_entry);
+            PICOTEST_CHECK(stdio_async_output_enable((stdio_async_overflow_t)mode, core1_drain_request, NULL), "failed to enable");
+            uint64_t start = time_us_64();
+            uint64_t async_us = print_lines();
+            stdio_flush();
+            uint64_t drained_us = time_us_64() - start;
+            core1_stop = true;
+            multicore_fifo_pop_blocking();
+            uint32_t dropped = stdio_async_output_get_dropped_bytes();
+            stdio_async_output_disable();
+            printf("  async %-9s %8"PRIu64" us (%5"PRIu64" ns/line), drained after %"PRIu64" us, %u output calls, "
+                   "%"PRIu32" bytes dropped\n", names[mode], async_us, async_us * 1000u / NUM_LINES, drained_us,
+                   capture_a.calls, dropped);
+            if (mode == STDIO_ASYNC_OVERFLOW_BLOCK) {
+                PICOTEST_CHECK(!dropped && capture_a.len == expected_len && !memcmp(capture_a.buf, expected, expected_len),
+                               "asynchronous output differs from synchronous output");
+            } else {
+                // CR/LF translation adds a byte per line (as long as each line is output whole)
+                PICOTEST_CHECK(capture_a.len + dropped <= expected_len && capture_a.len + dropped + NUM_LINES >= expected_len,
+                               "bytes lost other than those dropped");
+            }
+        }
+        capture_a.slow = false;
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// the pico_stdio and pico_printf implementations are included directly (so the tests can use their internals), with
+// the functions renamed so they don't replace those of the host C library or the host pico_stdio
+#define WRAPPER_FUNC(x) pico_##x
+#define getchar_timeout_us pico_getchar_timeout_us
+// the device pico/stdio.h has the same include guard as the host one, so must be included first to take its place
+#include "pico_stdio/include/pico/stdio.h"
+#ifndef __printflike
+#define __printflike(a, b) __attribute__((format(printf, a, b)))
+#endif
+#include "printf.c"
+#include "stdio.c"
+
+#include <inttypes.h>
+#include "pico/test.h"
+
+PICOTEST_MODULE_NAME("pico_stdio_host_test", "pico_stdio output path test harness");
+
+#define CAPTURE_SIZE 65536u
+#define NUM_RANDOM_WRITES 20000u
+#define NUM_TIMED_CALLS 200000u
+
+typedef struct {
+    char buf[CAPTURE_SIZE];
+    uint len;
+    uint calls;
+} capture_t;
+
+static capture_t plain_capture, gather_capture, reference_capture;
+
+static void capture(capture_t *c, const char *buf, int len) {
+    if (c->len + (uint)len > CAPTURE_SIZE) c->len = 0;
+    memcpy(c->buf + c->len, buf, (uint)len);
+    c->len += (uint)len;
+    c->calls++;
+}
+
+static void capture_reset(void) {
+    plain_capture.len = plain_capture.calls = 0;
+    gather_capture.len = gather_capture.calls = 0;
+    reference_capture.len = reference_capture.calls = 0;
+}
+
+static void plain_out_chars(const char *buf, int len) {
+    capture(&plain_capture, buf, len);
+}
+
+static void gather_out_chars(const char *buf, int len) {
+    capture(&gather_capture, buf, len);
+}
+
+static void gather_out_chars_gather(const stdio_span_t *spans, uint count) {
+    for (uint i = 0; i < count; i++) {
+        capture(&gather_capture, spans[i].buf, spans[i].len);
+    }
+    // count a gather as a single call
+    gather_capture.calls -= count - 1;
+}
+
+static void reference_out_chars(const char *buf, int len) {
+    capture(&reference_capture, buf, len);
+}
+
+static stdio_driver_t plain_driver = {
+    .out_chars = plain_out_chars,
+    .crlf_enabled = true,
+};
+
+static stdio_driver_t gather_driver = {
+    .out_chars = gather_out_chars,
+    .out_chars_gather = gather_out_chars_gather,
+    .crlf_enabled = true,
+};
+
+static stdio_driver_t reference_driver = {
+    .out_chars = reference_out_chars,
+    .crlf_enabled = true,
+};
+
+// the original character at a time CR/LF translation
+static void reference_out_chars_crlf(stdio_driver_t *driver, const char *s, int len) {
+    int first_of_chunk = 0;
+    static const char crlf_str[] = {'\r', '\n'};
+    for (int i = 0; i < len; i++) {
+        bool prev_char_was_cr = i > 0 ? s[i - 1] == '\r' : driver->last_ended_with_cr;
+        if (s[i] == '\n' && !prev_char_was_cr) {
+            if (i > first_of_chunk) {
+                driver->out_chars(&s[first_of_chunk], i - first_of_chunk);
+            }
+            driver->out_chars(crlf_str, 2);
+            first_of_chunk = i + 1;
+        }
+    }
+    if (first_of_chunk < len) {
+        driver->out_chars(&s[first_of_chunk], len - first_of_chunk);
+    }
+    if (len > 0) {
+        driver->last_ended_with_cr = s[len - 1] == '\r';
+    }
+}
+
+// the original character at a time printf output
+static void reference_buffered_printer(char c, void *arg) {
+    stdio_stack_buffer_t *buffer = (stdio_stack_buffer_t *)arg;
+    if (buffer->used == PICO_STDIO_STACK_BUFFER_SIZE) {
+        reference_out_chars_crlf(&reference_driver, buffer->buf, buffer->used);
+        buffer->used = 0;
+    }
+    buffer->buf[buffer->used++] = c;
+}
+
+static int __printflike(1, 2) reference_printf(const char *format, ...) {
+    stdio_stack_buffer_t buffer;
+    buffer.used = 0;
+    va_list va;
+    va_start(va, format);
+    int ret = vfctprintf(reference_buffered_printer, &buffer, format, va);
+    va_end(va);
+    reference_out_chars_crlf(&reference_driver, buffer.buf, buffer.used);
+    return ret;
+}
+
+static int __printflike(1, 2) span_printf(const char *format, ...) {
+    va_list va;
+    va_start(va, format);
+    int ret = pico_vprintf(format, va);
+    va_end(va);
+    return ret;
+}
+
+static uint32_t rand_state = 0x2545f491u;
+
+static uint32_t rand32(void) {
+    // xorshift32
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static bool captures_match(void) {
+    return plain_capture.len == reference_capture.len && gather_capture.len == reference_capture.len &&
+           !memcmp(plain_capture.buf, reference_capture.buf, reference_capture.len) &&
+           !memcmp(gather_capture.buf, reference_capture.buf, reference_capture.len);
+}
+
+#define PRINT_ALL(...) ({ \
+    capture_reset(); \
+    int _rc = span_printf(__VA_ARGS__); \
+    int _expected_rc = reference_printf(__VA_ARGS__); \
+    _rc == _expected_rc && captures_match(); \
+})
+
+int main() {
+    PICOTEST_START();
+
+    PICOTEST_START_SECTION("newline search");
+        // try every alignment and position within and around a word
+        char s[64];
+        bool ok = true;
+        for (int from = 0; from < 16; from++) {
+            for (int len = from; len < 48; len++) {
+                for (int nl = -1; nl < len; nl++) {
+                    memset(s, 'x', sizeof(s));
+                    if (nl >= 0) s[nl] = '\n';
+                    s[len] = '\n';
+                    int expected = nl >= from ? nl : len;
+                    if (stdio_find_newline(s, from, len) != expected) ok = false;
+                }
+            }
+        }
+        PICOTEST_CHECK(ok, "stdio_find_newline returned the wrong index");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("CR/LF translation matches the original");
+        capture_reset();
+        static char data[512];
+        for (uint i = 0; i < NUM_RANDOM_WRITES; i++) {
+            int len = (int)(rand32() % sizeof(data));
+            // mostly text, with plenty of newlines and carriage returns
+            for (int j = 0; j < len; j++) {
+                uint r = rand32() % 32u;
+                data[j] = r == 0 ? '\n' : r == 1 ? '\r' : (char)('a' + r);
+            }
+            // include short writes, which may continue a "\r\n" from the previous one
+            if (rand32() & 1) len %= 3;
+            if (plain_capture.len + (uint)len * 2u > CAPTURE_SIZE) {
+                if (!captures_match()) break;
+                capture_reset();
+            }
+            stdio_out_chars_crlf(&plain_driver, data, len);
+            stdio_out_chars_crlf(&gather_driver, data, len);
+            reference_out_chars_crlf(&reference_driver, data, len);
+        }
+        PICOTEST_CHECK(captures_match(), "CR/LF translated output differs");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("printf output matches the original");
+        stdio_set_driver_enabled(&plain_driver, true);
+        stdio_set_driver_enabled(&gather_driver, true);
+        PICOTEST_CHECK(PRINT_ALL("hello world\n"), "output differs");
+        PICOTEST_CHECK(PRINT_ALL("%d %5s|%-5s|%c\r\n%%\n", -123, "ab", "cd", 'e'), "output differs");
+        PICOTEST_CHECK(PRINT_ALL("%08.3f %e %g\n\n", 3.14159, 1e-10, 123456789.0), "output differs");
+        PICOTEST_CHECK(PRINT_ALL("%200s|%-300d|\n", "padding", 42), "output differs");
+        static char long_line[1000];
+        memset(long_line, '-', sizeof(long_line) - 2);
+        long_line[500] = '\n';
+        long_line[sizeof(long_line) - 2] = '\n';
+        PICOTEST_CHECK(PRINT_ALL("%s", long_line), "output differs");
+        PICOTEST_CHECK(PRINT_ALL(long_line), "output differs");
+        stdio_set_driver_enabled(&plain_driver, false);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("speed compared with the original");
+        static const char *const lines[] = {
+            "sensor %d: temperature %d.%02d C, humidity %u%%, status %s\n",
+            "a longer log message without any arguments at all, of the kind typically used for tracing\n",
+        };
+        for (uint l = 0; l < count_of(lines); l++) {
+            capture_reset();
+            absolute_time_t t0 = get_absolute_time();
+            for (uint i = 0; i < NUM_TIMED_CALLS; i++) {
+                reference_printf(lines[l], (int)(i & 7), (int)(i % 40), (int)(i % 100), i % 101, "ok");
+            }
+            int64_t reference_us = absolute_time_diff_us(t0, get_absolute_time());
+            t0 = get_absolute_time();
+            for (uint i = 0; i < NUM_TIMED_CALLS; i++) {
+                span_printf(lines[l], (int)(i & 7), (int)(i % 40), (int)(i % 100), i % 101, "ok");
+            }
+            int64_t span_us = absolute_time_diff_us(t0, get_absolute_time());
+            printf("  line %u: original %4"PRId64"ns, spans %4"PRId64"ns per printf; %u vs %u driver calls\n", l,
+                   reference_us * 1000 / NUM_TIMED_CALLS, span_us * 1000 / NUM_TIMED_CALLS,
+                   reference_capture.calls, gather_capture.calls);
+        }
+        capture_reset();
+        static char text[4096];
+        for (uint i = 0; i < sizeof(text); i++) text[i] = (i % 80u) == 79u ? '\n' : (char)('a' + i % 26u);
+        absolute_time_t t0 = get_absolute_time();
+        for (uint i = 0; i < NUM_TIMED_CALLS / 100; i++) {
+            reference_out_chars_crlf(&reference_driver, text, sizeof(text));
+            reference_capture.len = 0;
+        }
+        int64_t reference_us = absolute_time_diff_us(t0, get_absolute_time());
+        t0 = get_absolute_time();
+        for (uint i = 0; i < NUM_TIMED_CALLS / 100; i++) {
+            stdio_out_chars_crlf(&gather_driver, text, sizeof(text));
+            gather_capture.len = 0;
+        }
+        int64_t span_us = absolute_time_diff_us(t0, get_absolute_time());
+        printf("  CR/LF translation: original %4"PRId64"ns, word at a time with gather %4"PRId64"ns per KB\n",
+               reference_us * 1000 / (NUM_TIMED_CALLS / 100) / 4, span_us * 1000 / (NUM_TIMED_CALLS / 100) / 4);
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
@@ -0,0 +1,244 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+PICOTEST_MODULE_NAME("pico_alarm_pool_benchmark", "alarm pool pheap vs timer wheel benchmark");
+
+// Compares the default (pairing heap) alarm pool with a timer wheel alarm pool, timing
+// add, cancel, and dispatch of a large number of alarms, and measuring the IRQs saved by alarm slack
+
+#if PICO_ON_DEVICE
+#define MAX_ALARMS 1000
+#else
+#define MAX_ALARMS 10000
+#endif
+static_assert(MAX_ALARMS <= PICO_PHEAP_MAX_ENTRIES, "");
+
+static const uint alarm_counts[] = {100, 1000, 10000};
+
+static alarm_id_t alarm_ids[MAX_ALARMS];
+static uint64_t targets[MAX_ALARMS];
+static uint order[MAX_ALARMS];
+
+static volatile uint fired_count;
+static volatile uint64_t first_fired_us, last_fired_us;
+static volatile bool fired_out_of_order;
+static volatile bool fired_early;
+static uint64_t last_target_fired;
+
+typedef alarm_pool_t *(*pool_create_fn)(uint max_timers);
+
+static const struct {
+    const char *name;
+    pool_create_fn create;
+} engines[] = {
+        {"pheap", alarm_pool_create_with_unused_hardware_alarm},
+        {"timer wheel", alarm_pool_create_timer_wheel_with_unused_hardware_alarm},
+};
+
+static int64_t fire_callback(__unused alarm_id_t id, void *user_data) {
+    uint64_t now = time_us_64();
+    uint64_t target = targets[(uintptr_t)user_data];
+    if (!fired_count) first_fired_us = now;
+    last_fired_us = now;
+    if (target < last_target_fired) fired_out_of_order = true;
+    if (now < target) fired_early = true;
+    last_target_fired = target;
+    fired_count++;
+    return 0;
+}
+
+static void shuffle(uint *values, uint count) {
+    for (uint i = 0; i < count; i++) values[i] = i;
+    for (uint i = count - 1; i > 0; i--) {
+        uint j = (uint)rand() % (i + 1);
+        uint tmp = values[i];
+        values[i] = values[j];
+        values[j] = tmp;
+    }
+}
+
+static void reset_fired(void) {
+    fired_count = 0;
+    fired_out_of_order = fired_early = false;
+    last_target_fired = 0;
+}
+
+static bool wait_for_fired(uint count, uint32_t timeout_ms) {
+    absolute_time_t timeout = make_timeout_time_ms(timeout_ms);
+    while (fired_count < count && !time_reached(timeout)) {
+        sleep_ms(1);
+    }
+    return fired_count == count;
+}
+
+// a fixed rate repeating alarm for the coalescing test
+#define NUM_PERIODIC_ALARMS 200
+#define PERIODIC_TEST_US 300000
+#define PERIODIC_SLACK_US 2000
+
+static struct periodic_alarm {
+    alarm_id_t id;
+    uint64_t target;
+    uint32_t period;
+} periodic_alarms[NUM_PERIODIC_ALARMS];
+
+static volatile uint periodic_fired_count;
+static volatile bool periodic_fired_early;
+
+static int64_t periodic_callback(__unused alarm_id_t id, void *user_data) {
+    struct periodic_alarm *alarm = (struct periodic_alarm *)user_data;
+    if (time_us_64() < alarm->target) periodic_fired_early = true;
+    alarm->target += alarm->period;
+    periodic_fired_count++;
+    return -(int64_t)alarm->period;
+}
+
+static inline uint32_t ns_per_op(uint64_t elapsed_us, uint count) {
+    return (uint32_t)((elapsed_us * 1000) / count);
+}
+
+int main() {
+    setup_default_uart();
+    alarm_pool_init_default();
+    srand(1234);
+
+    PICOTEST_START();
+
+    PICOTEST_START_SECTION("Alarms fire in order");
+    for (uint e = 0; e < count_of(engines); e++) {
+        alarm_pool_t *pool = engines[e].create(MAX_ALARMS);
+        PICOTEST_CHECK_AND_ABORT(pool, "failed to create alarm pool");
+        reset_fired();
+        // spread the targets over 250ms, so the timer wheel needs to cascade alarms from the upper levels
+        uint64_t base = time_us_64() + 50000;
+        uint count = MIN(MAX_ALARMS, 1000);
+        for (uint i = 0; i < count; i++) {
+            targets[i] = base + (uint)rand() % 250000;
+            absolute_time_t t;
+            update_us_since_boot(&t, targets[i]);
+            alarm_ids[i] = alarm_pool_add_alarm_at(pool, t, fire_callback, (void *)(uintptr_t)i, true);
+            PICOTEST_CHECK_AND_ABORT(alarm_ids[i] > 0, "failed to add alarm");
+        }
+        // cancel every third alarm
+        uint cancelled = 0;
+        for (uint i = 0; i < count; i += 3) {
+            PICOTEST_CHECK(alarm_pool_cancel_alarm(pool, alarm_ids[i]), "failed to cancel alarm");
+            PICOTEST_CHECK(!alarm_pool_cancel_alarm(pool, alarm_ids[i]), "cancelled alarm twice");
+            cancelled++;
+        }
+        PICOTEST_CHECK(wait_for_fired(count - cancelled, 2000), "not all alarms fired");
+        sleep_ms(10);
+        PICOTEST_CHECK(fired_count == count - cancelled, "cancelled alarms fired");
+        PICOTEST_CHECK(!fired_out_of_order, "alarms fired out of order");
+        PICOTEST_CHECK(!fired_early, "alarms fired early");
+        alarm_pool_destroy(pool);
+    }
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("Coalesced alarms");
+    // lots of repeating alarms with similar periods; with slack they should share IRQs
+    for (uint e = 0; e < count_of(engines); e++) {
+        uint32_t exact_irqs = 0;
+        for (uint32_t slack_us = 0; slack_us <= PERIODIC_SLACK_US; slack_us += PERIODIC_SLACK_US) {
+            alarm_pool_t *pool = engines[e].create(NUM_PERIODIC_ALARMS);
+            PICOTEST_CHECK_AND_ABORT(pool, "failed to create alarm pool");
+#if PICO_HOST_TIMER_ALARM_THREAD
+            uint32_t irqs = hardware_alarm_get_irq_count(alarm_pool_hardware_alarm_num(pool));
+#endif
+            periodic_fired_count = 0;
+            periodic_fired_early = false;
+            uint64_t base = time_us_64() + 1000;
+            for (uint i = 0; i < NUM_PERIODIC_ALARMS; i++) {
+                struct periodic_alarm *alarm = &periodic_alarms[i];
+                alarm->period = 10000 + i * 7;
+                alarm->target = base + (uint)rand() % alarm->period;
+                absolute_time_t t;
+                update_us_since_boot(&t, alarm->target);
+                alarm->id = alarm_pool_add_alarm_at_with_slack(pool, t, slack_us, periodic_callback, alarm, true);
+                PICOTEST_CHECK_AND_ABORT(alarm->id > 0, "failed to add alarm");
+            }
+            sleep_us(PERIODIC_TEST_US);
+            for (uint i = 0; i < NUM_PERIODIC_ALARMS; i++) {
+                PICOTEST_CHECK(alarm_pool_cancel_alarm(pool, periodic_alarms[i].id), "failed to cancel alarm");
+            }
+            PICOTEST_CHECK(!periodic_fired_early, "alarm fired before its target");
+#if PICO_HOST_TIMER_ALARM_THREAD
+            irqs = hardware_alarm_get_irq_count(alarm_pool_hardware_alarm_num(pool)) - irqs;
+            printf("%-12s slack %4"PRIu32"us: %u callbacks, %"PRIu32" IRQs", engines[e].name, slack_us,
+                   periodic_fired_count, irqs);
+            if (!slack_us) {
+                exact_irqs = irqs;
+                printf("\n");
+            } else {
+                printf(" (%"PRId32" IRQs saved)\n", (int32_t)(exact_irqs - irqs));
+                PICOTEST_CHECK(irqs < exact_irqs, "slack should reduce the number of IRQs");
+            }
+#else
+            (void)exact_irqs;
+            printf("%-12s slack %4"PRIu32"us: %u callbacks\n", engines[e].name, slack_us, periodic_fired_count);
+#endif
+            alarm_pool_destroy(pool);
+        }
+    }
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("Benchmark");
+    printf("%-12s %6s %10s %10s %10s\n", "engine", "alarms", "add ns", "cancel ns", "fire ns");
+    for (uint n = 0; n < count_of(alarm_counts); n++) {
+        uint count = alarm_counts[n];
+        if (count > MAX_ALARMS) break;
+        for (uint e = 0; e < count_of(engines); e++) {
+            alarm_pool_t *pool = engines[e].create(count);
+            PICOTEST_CHECK_AND_ABORT(pool, "failed to create alarm pool");
+
+            // add alarms at random times well into the future, then cancel them in a different random order
+            uint64_t base = time_us_64() + 10000000;
+            for (uint i = 0; i < count; i++) {
+                targets[i] = base + (uint)rand() % 1000000;
+            }
+            uint64_t t0 = time_us_64();
+            for (uint i = 0; i < count; i++) {
+                absolute_time_t t;
+                update_us_since_boot(&t, targets[i]);
+                alarm_ids[i] = alarm_pool_add_alarm_at(pool, t, fire_callback, (void *)(uintptr_t)i, true);
+            }
+            uint64_t t1 = time_us_64();
+            shuffle(order, count);
+            uint64_t t2 = time_us_64();
+            uint cancelled = 0;
+            for (uint i = 0; i < count; i++) {
+                cancelled += alarm_pool_cancel_alarm(pool, alarm_ids[order[i]]);
+            }
+            uint64_t t3 = time_us_64();
+            PICOTEST_CHECK(cancelled == count, "failed to cancel all alarms");
+
+            // dispatch: all alarms due at the same time, so the time between the first and last callbacks
+            // is the per alarm cost of the IRQ handler
+            reset_fired();
+            base = time_us_64() + 100000;
+            absolute_time_t t;
+            update_us_since_boot(&t, base);
+            for (uint i = 0; i < count; i++) {
+                targets[i] = base;
+                alarm_ids[i] = alarm_pool_add_alarm_at(pool, t, fire_callback, (void *)(uintptr_t)i, true);
+            }
+            PICOTEST_CHECK(wait_for_fired(count, 5000), "not all alarms fired");
+
+            printf("%-12s %6u %10"PRIu32" %10"PRIu32" %10"PRIu32"\n", engines[e].name, count,
+                   ns_per_op(t1 - t0, count), ns_per_op(t3 - t2, count),
+                   ns_per_op(last_fired_us - first_fired_us, count));
+            alarm_pool_destroy(pool);
+        }
+    }
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
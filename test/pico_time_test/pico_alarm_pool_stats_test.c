@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "pico/test.h"
+PICOTEST_MODULE_NAME("pico_alarm_pool_stats_test", "alarm pool statistics test");
+
+static_assert(PICO_TIME_ALARM_POOL_STATS, "");
+
+#define NUM_ALARMS 50
+#define NUM_REPEATS 5
+#define SLOW_CALLBACK_US 300
+
+static volatile uint fired_count;
+
+static int64_t slow_callback(__unused alarm_id_t id, __unused void *user_data) {
+    busy_wait_us(SLOW_CALLBACK_US);
+    fired_count++;
+    return 0;
+}
+
+static int64_t repeating_callback(__unused alarm_id_t id, void *user_data) {
+    uint *count = (uint *)user_data;
+    fired_count++;
+    return ++(*count) < NUM_REPEATS ? -5000 : 0;
+}
+
+static int64_t counting_callback(__unused alarm_id_t id, __unused void *user_data) {
+    fired_count++;
+    return 0;
+}
+
+// add two past alarms from the pool's own IRQ handler, so the first is still pending when the second goes in
+// behind it
+static int64_t add_past_alarms_callback(__unused alarm_id_t id, void *user_data) {
+    alarm_pool_t *pool = (alarm_pool_t *)user_data;
+    alarm_pool_add_alarm_at_force_in_context(pool, from_us_since_boot(1), counting_callback, NULL);
+    alarm_pool_add_alarm_at(pool, from_us_since_boot(2), counting_callback, NULL, true);
+    fired_count++;
+    return 0;
+}
+
+static uint histogram_total(const uint32_t *histogram) {
+    uint total = 0;
+    for (uint i = 0; i < PICO_TIME_ALARM_POOL_STATS_HISTOGRAM_BUCKETS; i++) total += histogram[i];
+    return total;
+}
+
+// the number of entries in buckets for times >= us
+static uint histogram_at_least(const uint32_t *histogram, uint32_t us) {
+    uint total = 0;
+    for (uint i = 1; i < PICO_TIME_ALARM_POOL_STATS_HISTOGRAM_BUCKETS; i++) {
+        if ((1ull << (i - 1)) >= us) total += histogram[i];
+    }
+    return total;
+}
+
+static bool wait_for_fired(uint count) {
+    absolute_time_t timeout = make_timeout_time_ms(2000);
+    while (fired_count < count && !time_reached(timeout)) {
+        sleep_ms(1);
+    }
+    return fired_count == count;
+}
+
+int main() {
+    setup_default_uart();
+    alarm_pool_init_default();
+
+    PICOTEST_START();
+    alarm_pool_t *pool = alarm_pool_create_with_unused_hardware_alarm(NUM_ALARMS);
+    alarm_pool_stats_t stats;
+
+    PICOTEST_START_SECTION("Pending and latency");
+    fired_count = 0;
+    alarm_id_t ids[NUM_ALARMS];
+    for (uint i = 0; i < NUM_ALARMS; i++) {
+        ids[i] = alarm_pool_add_alarm_in_ms(pool, 50 + i, slow_callback, NULL, false);
+        PICOTEST_CHECK_AND_ABORT(ids[i] > 0, "failed to add alarm");
+    }
+    alarm_pool_get_stats(pool, &stats);
+    PICOTEST_CHECK(stats.pending == NUM_ALARMS && stats.peak_pending == NUM_ALARMS, "wrong pending count");
+    for (uint i = 0; i < NUM_ALARMS; i += 5) {
+        alarm_pool_cancel_alarm(pool, ids[i]);
+    }
+    alarm_pool_get_stats(pool, &stats);
+    PICOTEST_CHECK(stats.pending == NUM_ALARMS - NUM_ALARMS / 5, "cancelled alarms should not be pending");
+    PICOTEST_CHECK(stats.peak_pending == NUM_ALARMS, "wrong peak pending count");
+    PICOTEST_CHECK(wait_for_fired(NUM_ALARMS - NUM_ALARMS / 5), "not all alarms fired");
+    alarm_pool_get_stats(pool, &stats);
+    alarm_pool_print_stats(pool);
+    PICOTEST_CHECK(!stats.pending, "no alarms should be pending");
+    PICOTEST_CHECK(stats.fired == NUM_ALARMS - NUM_ALARMS / 5, "wrong fired count");
+    PICOTEST_CHECK(histogram_total(stats.fire_latency_histogram) == stats.fired, "latency histogram should count every callback");
+    PICOTEST_CHECK(histogram_total(stats.callback_time_histogram) == stats.fired, "callback histogram should count every callback");
+    PICOTEST_CHECK(histogram_at_least(stats.callback_time_histogram, SLOW_CALLBACK_US / 2) == stats.fired,
+                   "callback times should reflect the slow callback");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("Missed and rescheduled");
+    alarm_pool_reset_stats(pool);
+    alarm_pool_get_stats(pool, &stats);
+    PICOTEST_CHECK(!stats.fired && !stats.peak_pending, "stats should have been reset");
+    PICOTEST_CHECK(!alarm_pool_add_alarm_at(pool, nil_time, slow_callback, NULL, false), "alarm in the past should not be added");
+    fired_count = 0;
+    uint repeat_count = 0;
+    PICOTEST_CHECK(alarm_pool_add_alarm_in_ms(pool, 5, repeating_callback, &repeat_count, false) > 0, "failed to add alarm");
+    PICOTEST_CHECK(wait_for_fired(NUM_REPEATS), "repeating alarm did not fire");
+    sleep_ms(10);
+    alarm_pool_get_stats(pool, &stats);
+    alarm_pool_print_stats(pool);
+    PICOTEST_CHECK(stats.missed == 1, "wrong missed count");
+    PICOTEST_CHECK(stats.rescheduled == NUM_REPEATS - 1, "wrong rescheduled count");
+    PICOTEST_CHECK(stats.fired == NUM_REPEATS, "wrong fired count");
+    PICOTEST_CHECK(!stats.pending && stats.peak_pending == 1, "wrong pending count");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("Missed behind an earlier alarm");
+    alarm_pool_reset_stats(pool);
+    fired_count = 0;
+    PICOTEST_CHECK(alarm_pool_add_alarm_in_ms(pool, 5, add_past_alarms_callback, pool, false) > 0, "failed to add alarm");
+    PICOTEST_CHECK(wait_for_fired(3), "past alarms did not fire");
+    sleep_ms(10);
+    alarm_pool_get_stats(pool, &stats);
+    PICOTEST_CHECK(stats.missed == 2, "both past alarms should count as missed");
+    PICOTEST_CHECK(stats.fired == 3, "wrong fired count");
+    PICOTEST_CHECK(!stats.pending && stats.peak_pending == 2, "wrong pending count");
+    PICOTEST_END_SECTION();
+
+    alarm_pool_destroy(pool);
+    PICOTEST_END_TEST();
+}
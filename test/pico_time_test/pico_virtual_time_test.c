@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include "pico/test.h"
+#include "pico/virtual_time.h"
+PICOTEST_MODULE_NAME("pico_virtual_time_test", "host virtual time test");
+
+// a ten minute soak of a simple request/response protocol between the two cores, with a repeating timer running
+// alongside; the whole thing should take well under a second, and be exactly the same every time
+#define SOAK_US (10 * 60 * 1000000ull)
+#define REQUEST_PERIOD_US 97000
+#define RESPONSE_TIMEOUT_US 5000
+#define TIMER_PERIOD_MS 10
+#define STOP_REQUEST 0xffffffffu
+
+typedef struct {
+    uint64_t start_us;
+    uint32_t hash;
+    uint responses;
+    uint timeouts;
+    uint timer_ticks;
+} soak_result_t;
+
+static soak_result_t soak;
+
+static void record(uint32_t type, uint32_t value) {
+    // FNV-1a over the event and when it happened
+    uint32_t words[3] = {type, value, (uint32_t)(time_us_64() - soak.start_us)};
+    for (uint i = 0; i < count_of(words); i++) {
+        for (uint b = 0; b < 32; b += 8) {
+            soak.hash = (soak.hash ^ ((words[i] >> b) & 0xffu)) * 16777619u;
+        }
+    }
+}
+
+static void core1_responder(void) {
+    while (true) {
+        uint32_t request = multicore_fifo_pop_blocking();
+        if (request == STOP_REQUEST) break;
+        // take a variable amount of time to respond, and ignore every tenth request altogether
+        sleep_us(200 + (request * 37) % 1000);
+        if (request % 10 != 9) multicore_fifo_push_blocking(request + 1);
+    }
+}
+
+static bool soak_timer_callback(__unused repeating_timer_t *rt) {
+    record(3, ++soak.timer_ticks);
+    return true;
+}
+
+static void run_soak(soak_result_t *result) {
+    soak = (soak_result_t){.start_us = time_us_64(), .hash = 2166136261u};
+    multicore_launch_core1(core1_responder);
+    repeating_timer_t timer;
+    add_repeating_timer_ms(-TIMER_PERIOD_MS, soak_timer_callback, NULL, &timer);
+    absolute_time_t next_request = get_absolute_time();
+    for (uint32_t request = 0; time_us_64() - soak.start_us < SOAK_US; request++) {
+        multicore_fifo_push_blocking(request);
+        uint32_t response;
+        if (multicore_fifo_pop_timeout_us(RESPONSE_TIMEOUT_US, &response)) {
+            record(1, response);
+            if (response == request + 1) soak.responses++;
+        } else {
+            record(2, request);
+            soak.timeouts++;
+        }
+        next_request = delayed_by_us(next_request, REQUEST_PERIOD_US);
+        sleep_until(next_request);
+    }
+    cancel_repeating_timer(&timer);
+    multicore_fifo_push_blocking(STOP_REQUEST);
+    multicore_reset_core1();
+    *result = soak;
+}
+
+static uint64_t real_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * (uint64_t) 1000000 + ts.tv_nsec / 1000;
+}
+
+static volatile uint64_t alarm_fired_us;
+
+static int64_t alarm_callback(__unused alarm_id_t id, __unused void *user_data) {
+    alarm_fired_us = time_us_64();
+    return 0;
+}
+
+int main() {
+    setup_default_uart();
+    alarm_pool_init_default();
+
+    PICOTEST_START();
+
+    PICOTEST_START_SECTION("Time only passes when blocked");
+    uint64_t t0 = time_us_64();
+    volatile uint32_t sum = 0;
+    for (uint i = 0; i < 10000000; i++) sum += i;
+    PICOTEST_CHECK(time_us_64() == t0, "time passed while computing");
+    sleep_us(1234);
+    PICOTEST_CHECK(time_us_64() == t0 + 1234, "sleep_us was not exact");
+    busy_wait_ms(3);
+    PICOTEST_CHECK(time_us_64() == t0 + 4234, "busy_wait_ms was not exact");
+    alarm_fired_us = 0;
+    absolute_time_t alarm_time = make_timeout_time_us(777);
+    PICOTEST_CHECK(add_alarm_at(alarm_time, alarm_callback, NULL, false) > 0, "failed to add alarm");
+    while (!alarm_fired_us) __wfe();
+    PICOTEST_CHECK(alarm_fired_us == to_us_since_boot(alarm_time), "alarm did not fire exactly on time");
+    absolute_time_t poll_time = make_timeout_time_ms(250);
+    while (!time_reached(poll_time)) tight_loop_contents();
+    PICOTEST_CHECK(time_us_64() == to_us_since_boot(poll_time), "polling overshot the time");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("Soak is fast and reproducible");
+    soak_result_t results[2];
+    for (uint run = 0; run < count_of(results); run++) {
+        uint64_t real_start_us = real_time_us();
+        uint64_t virtual_start_us = time_us_64();
+        run_soak(&results[run]);
+        uint64_t real_us = real_time_us() - real_start_us;
+        uint64_t virtual_us = time_us_64() - virtual_start_us;
+        printf("run %u: %"PRIu64"s of virtual time in %"PRIu64"ms: %u responses, %u timeouts, %u timer ticks, hash %08"PRIx32"\n",
+               run, virtual_us / 1000000, real_us / 1000, results[run].responses, results[run].timeouts,
+               results[run].timer_ticks, results[run].hash);
+        PICOTEST_CHECK(virtual_us >= SOAK_US, "soak did not run for long enough");
+        PICOTEST_CHECK(real_us < virtual_us / 100, "soak was too slow");
+        PICOTEST_CHECK(results[run].responses && results[run].timeouts == (results[run].responses + results[run].timeouts) / 10,
+                       "wrong number of responses and timeouts");
+        PICOTEST_CHECK(results[run].timer_ticks >= SOAK_US / (TIMER_PERIOD_MS * 1000), "repeating timer did not keep up");
+    }
+    PICOTEST_CHECK(results[0].hash == results[1].hash, "soak runs differed");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
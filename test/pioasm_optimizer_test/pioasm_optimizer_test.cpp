@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "pio_assembler.h"
+#include "pio_disassembler.h"
+#include "pio_optimizer.h"
+#include "pico/test.h"
+
+PICOTEST_MODULE_NAME("pioasm_optimizer_test", "pioasm optimizer golden output test");
+
+// Runs the optimizer over each program in optimizer.pio and compares the results (the report, .wrap_target, .wrap,
+// public labels and the disassembled instructions) with optimizer.golden. To update the golden file after an
+// intended change, run with -u
+
+struct capture_output : public output_format {
+    compiled_source source;
+
+    capture_output() : output_format("optimizer_test") {}
+
+    std::string get_description() override {
+        return "Captures the assembled programs";
+    }
+
+    int output(std::string destination, std::vector<std::string> output_options,
+               const compiled_source &_source) override {
+        source = _source;
+        return 0;
+    }
+};
+
+static std::string describe(const compiled_source::program &program) {
+    std::stringstream ss;
+    ss << ".wrap_target " << program.wrap_target << ", .wrap " << program.wrap << "\n";
+    for (const auto &s : program.symbols) {
+        if (s.is_label) ss << "public " << s.name << ": " << s.value << "\n";
+    }
+    uint sideset_bits = (uint) program.sideset_bits_including_opt.get();
+    for (size_t i = 0; i < program.instructions.size(); i++) {
+        std::string inst = disassemble((uint16_t) program.instructions[i], sideset_bits, program.sideset_opt);
+        inst.erase(inst.find_last_not_of(' ') + 1);
+        ss << "    " << i << ": " << inst << "\n";
+    }
+    return ss.str();
+}
+
+static const compiled_source::program *find_program(const compiled_source &source, const std::string &name) {
+    for (const auto &p : source.programs) {
+        if (p.name == name) return &p;
+    }
+    return nullptr;
+}
+
+int main(int argc, char **argv) {
+    PICOTEST_START();
+    bool update = argc > 1 && argv[1] == std::string("-u");
+
+    auto capture = std::make_shared<capture_output>();
+    pio_assembler pioasm;
+    PICOTEST_CHECK_AND_ABORT(!pioasm.generate(capture, PIOASM_OPTIMIZER_TEST_DIR "/optimizer.pio", "-", {}),
+                             "failed to assemble optimizer.pio");
+    const compiled_source &source = capture->source;
+
+    PICOTEST_START_SECTION("optimized programs match the golden output");
+        std::stringstream actual;
+        for (const auto &original : source.programs) {
+            compiled_source::program program = original;
+            std::string report;
+            bool ok = optimize_program(program, report);
+            actual << report << "\n" << describe(program) << "\n";
+            PICOTEST_CHECK(ok, "the optimizer failed its own equivalence check");
+            PICOTEST_CHECK(programs_cycle_equivalent(original, program), "optimized program not cycle equivalent");
+        }
+        const char *golden_filename = PIOASM_OPTIMIZER_TEST_DIR "/optimizer.golden";
+        if (update) {
+            std::ofstream(golden_filename) << actual.str();
+        }
+        std::ifstream golden_file(golden_filename);
+        std::stringstream golden;
+        golden << golden_file.rdbuf();
+        if (golden.str() != actual.str()) {
+            std::cout << "expected:\n" << golden.str() << "actual:\n" << actual.str();
+        }
+        PICOTEST_CHECK(golden.str() == actual.str(), "output differs from optimizer.golden");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_START_SECTION("equivalence check rejects changes in timing or behaviour");
+        const compiled_source::program *trailing = find_program(source, "trailing_jmp");
+        PICOTEST_CHECK_AND_ABORT(trailing, "trailing_jmp program missing");
+        compiled_source::program optimized = *trailing;
+        std::string report;
+        optimize_program(optimized, report);
+        PICOTEST_CHECK(programs_cycle_equivalent(*trailing, optimized), "optimized program should be equivalent");
+        PICOTEST_CHECK(programs_cycle_equivalent(*trailing, *trailing), "a program should be equivalent to itself");
+
+        // the jmp's cycle dropped rather than moved into a delay
+        compiled_source::program dropped_cycle = optimized;
+        dropped_cycle.instructions[dropped_cycle.wrap] &= ~(0x1fu << 8u);
+        PICOTEST_CHECK(!programs_cycle_equivalent(*trailing, dropped_cycle), "missing cycle not detected");
+
+        // wrapping to the wrong instruction
+        compiled_source::program wrong_wrap = optimized;
+        wrong_wrap.wrap_target = wrong_wrap.wrap;
+        PICOTEST_CHECK(!programs_cycle_equivalent(*trailing, wrong_wrap), "wrong .wrap_target not detected");
+
+        // a different instruction
+        compiled_source::program changed = optimized;
+        changed.instructions[0] ^= 1u; // set x, 3 -> set x, 2
+        PICOTEST_CHECK(!programs_cycle_equivalent(*trailing, changed), "changed instruction not detected");
+
+        // a nop removed without moving its cycle into a delay
+        const compiled_source::program *nops = find_program(source, "nop_merge");
+        PICOTEST_CHECK_AND_ABORT(nops, "nop_merge program missing");
+        compiled_source::program removed_nop = *nops;
+        removed_nop.instructions.erase(removed_nop.instructions.begin() + 1);
+        removed_nop.wrap--;
+        PICOTEST_CHECK(!programs_cycle_equivalent(*nops, removed_nop), "removed nop not detected");
+
+        // a public label moved
+        const compiled_source::program *labelled = find_program(source, "public_label");
+        PICOTEST_CHECK_AND_ABORT(labelled && !labelled->symbols.empty(), "public_label program missing");
+        compiled_source::program moved_label = *labelled;
+        for (auto &s : moved_label.symbols) {
+            if (s.is_label) s.value++;
+        }
+        PICOTEST_CHECK(!programs_cycle_equivalent(*labelled, moved_label), "moved public label not detected");
+    PICOTEST_END_SECTION();
+
+    PICOTEST_END_TEST();
+}
@@ -17,6 +17,10 @@
 
 #define PT_LOAD 0x00000001u
 
+#define SHT_NOBITS 0x00000008u
+
+#define SHF_ALLOC 0x00000002u
+
 #pragma pack(push, 1)
 struct elf_header {
     uint32_t    magic;
@@ -55,6 +59,19 @@ struct elf32_ph_entry {
     uint32_t flags;
     uint32_t align;
 };
+
+struct elf32_sh_entry {
+    uint32_t name;
+    uint32_t type;
+    uint32_t flags;
+    uint32_t addr;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t link;
+    uint32_t info;
+    uint32_t addralign;
+    uint32_t entsize;
+};
 #pragma pack(pop)
 
 #endif
\ No newline at end of file
@@ -8,9 +8,14 @@
 #include <map>
 #include <set>
 #include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
 #include <cstring>
 #include <cstdarg>
+#include <cstdlib>
 #include <algorithm>
+#include <sys/stat.h>
 #include "boot/uf2.h"
 #include "elf.h"
 
@@ -24,7 +29,8 @@ typedef unsigned int uint;
 
 #define FLASH_SECTOR_ERASE_SIZE 4096u
 
-static char error_msg[512];
+// inputs may be converted in parallel, each on its own thread
+static thread_local char error_msg[512];
 static bool verbose;
 
 static int fail(int code, const char *format, ...) {
@@ -93,14 +99,43 @@ struct page_fragment {
 };
 
 static int usage() {
-    fprintf(stderr, "Usage: elf2uf2 (-v) <input ELF file> <output UF2 file>\n");
+    fprintf(stderr, "Usage: elf2uf2 (-v) (-f <family id>) (-d <baseline ELF or UF2 file> (-p)) <input ELF file> <output UF2 file>\n");
+    fprintf(stderr, "       elf2uf2 (-v) (-j <jobs>) -b ((-f <family id>) <input ELF file>)...\n");
+    fprintf(stderr, "       elf2uf2 (-v) (-j <jobs>) -c <output UF2 file> ((-f <family id>) <input ELF file>)...\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -v  verbose output (which also means inputs are converted one at a time)\n");
+    fprintf(stderr, "  -f  UF2 family ID for the following input file(s) (default 0x%08x for RP2040)\n", RP2040_FAMILY_ID);
+    fprintf(stderr, "  -d  output a delta UF2 file, with only the flash sectors which differ from those of the baseline, and\n");
+    fprintf(stderr, "      report the changes to each section\n");
+    fprintf(stderr, "  -p  include only the changed pages, rather than whole sectors, in a delta UF2 file. Note this is only\n");
+    fprintf(stderr, "      for loaders which preserve the rest of the sector; the RP2040 bootrom does not\n");
+    fprintf(stderr, "  -j  maximum number of input files converted in parallel (default is the number of CPUs)\n");
+    fprintf(stderr, "  -b  batch mode; convert each input file to a UF2 file of the same name with a .uf2 extension\n");
+    fprintf(stderr, "  -c  combine the images for all the input files (which must have different family IDs) into a single\n");
+    fprintf(stderr, "      multi-family UF2 file\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "An output file of - means stdout\n");
     return ERROR_ARGS;
 }
 
-static int read_and_check_elf32_header(FILE *in, elf32_header& eh_out) {
-    if (1 != fread(&eh_out, sizeof(eh_out), 1, in)) {
+// the whole file is read with a single read, and pages are then copied straight from memory
+static int read_file(FILE *in, std::vector<uint8_t>& data) {
+    long size;
+    if (fseek(in, 0, SEEK_END) || (size = ftell(in)) < 0 || fseek(in, 0, SEEK_SET)) {
+        return fail_read_error();
+    }
+    data.resize((size_t)size);
+    if (size && 1 != fread(data.data(), (size_t)size, 1, in)) {
+        return fail_read_error();
+    }
+    return 0;
+}
+
+static int read_and_check_elf32_header(const std::vector<uint8_t>& in, elf32_header& eh_out) {
+    if (in.size() < sizeof(eh_out)) {
         return fail(ERROR_READ_FAILED, "Unable to read ELF header");
     }
+    memcpy(&eh_out, in.data(), sizeof(eh_out));
     if (eh_out.common.magic != ELF_MAGIC) {
         return fail(ERROR_FORMAT, "Not an ELF file");
     }
@@ -142,18 +177,16 @@ int check_address_range(const address_ranges& valid_ranges, uint32_t addr, uint3
     return fail(ERROR_INCOMPATIBLE, "Memory segment %08x->%08x is outside of valid address range for device", addr, addr+size);
 }
 
-int read_elf32_ph_entries(FILE *in, const elf32_header &eh, std::vector<elf32_ph_entry>& entries) {
+int read_elf32_ph_entries(const std::vector<uint8_t>& in, const elf32_header &eh, std::vector<elf32_ph_entry>& entries) {
     if (eh.ph_entry_size != sizeof(elf32_ph_entry)) {
         return fail(ERROR_FORMAT, "Invalid ELF32 program header");
     }
     if (eh.ph_num) {
         entries.resize(eh.ph_num);
-        if (fseek(in, eh.ph_offset, SEEK_SET)) {
-            return fail_read_error();
-        }
-        if (eh.ph_num != fread(&entries[0], sizeof(struct elf32_ph_entry), eh.ph_num, in)) {
+        if ((uint64_t)eh.ph_offset + eh.ph_num * sizeof(struct elf32_ph_entry) > in.size()) {
             return fail_read_error();
         }
+        memcpy(&entries[0], in.data() + eh.ph_offset, eh.ph_num * sizeof(struct elf32_ph_entry));
     }
     return 0;
 }
@@ -206,16 +239,14 @@ int check_elf32_ph_entries(const std::vector<elf32_ph_entry>& entries, const add
     return 0;
 }
 
-int realize_page(FILE *in, const std::vector<page_fragment> &fragments, uint8_t *buf, uint buf_len) {
+int realize_page(const std::vector<uint8_t>& in, const std::vector<page_fragment> &fragments, uint8_t *buf, uint buf_len) {
     assert(buf_len >= PAGE_SIZE);
     for(auto& frag : fragments) {
         assert(frag.page_offset >= 0 && frag.page_offset < PAGE_SIZE && frag.page_offset + frag.bytes <= PAGE_SIZE);
-        if (fseek(in, frag.file_offset, SEEK_SET)) {
-            return fail_read_error();
-        }
-        if (1 != fread(buf + frag.page_offset, frag.bytes, 1, in)) {
+        if ((uint64_t)frag.file_offset + frag.bytes > in.size()) {
             return fail_read_error();
         }
+        memcpy(buf + frag.page_offset, in.data() + frag.file_offset, frag.bytes);
     }
     return 0;
 }
@@ -268,7 +299,8 @@ static int determine_binary_type(const elf32_header &eh, const std::vector<elf32
     return fail(ERROR_INCOMPATIBLE, "entry point is not in mapped part of file");
 }
 
-int elf2uf2(FILE *in, FILE *out) {
+// convert the ELF file contents to the UF2 file contents
+int elf2uf2(const std::vector<uint8_t>& in, uint32_t family_id, std::vector<uint8_t>& out) {
     elf32_header eh;
     std::map<uint32_t, std::vector<page_fragment>> pages;
     int rc = read_and_check_elf32_header(in, eh);
@@ -353,15 +385,18 @@ int elf2uf2(FILE *in, FILE *out) {
             }
         }
     }
-    uf2_block block;
-    block.magic_start0 = UF2_MAGIC_START0;
-    block.magic_start1 = UF2_MAGIC_START1;
-    block.flags = UF2_FLAG_FAMILY_ID_PRESENT;
-    block.payload_size = PAGE_SIZE;
-    block.num_blocks = (uint32_t)pages.size();
-    block.file_size = RP2040_FAMILY_ID;
-    block.magic_end = UF2_MAGIC_END;
+    // the blocks are built in place in the output, which is then written all at once
+    out.resize(pages.size() * sizeof(uf2_block));
+    uf2_block *blocks = reinterpret_cast<uf2_block *>(out.data());
     for(auto& page_entry : pages) {
+        uf2_block &block = blocks[page_num];
+        block.magic_start0 = UF2_MAGIC_START0;
+        block.magic_start1 = UF2_MAGIC_START1;
+        block.flags = UF2_FLAG_FAMILY_ID_PRESENT;
+        block.payload_size = PAGE_SIZE;
+        block.num_blocks = (uint32_t)pages.size();
+        block.file_size = family_id;
+        block.magic_end = UF2_MAGIC_END;
         block.target_addr = page_entry.first;
         block.block_no = page_num++;
         if (verbose) {
@@ -371,41 +406,343 @@ int elf2uf2(FILE *in, FILE *out) {
         memset(block.data, 0, sizeof(block.data));
         rc = realize_page(in, page_entry.second, block.data, sizeof(block.data));
         if (rc) return rc;
-        if (1 != fwrite(&block, sizeof(uf2_block), 1, out)) {
-            return fail_write_error();
+    }
+    return 0;
+}
+
+static int write_file(const char *filename, const std::vector<uint8_t>& data) {
+    bool is_stdout = !strcmp(filename, "-");
+    FILE *out = is_stdout ? stdout : fopen(filename, "wb");
+    if (!out) {
+        return fail(ERROR_ARGS, "Can't open output file '%s'", filename);
+    }
+    bool ok = data.empty() || 1 == fwrite(data.data(), data.size(), 1, out);
+    ok &= !(is_stdout ? fflush(out) : fclose(out));
+    if (!ok) {
+        // don't leave a partial output file behind, but leave devices alone
+        struct stat st;
+        if (!is_stdout && !stat(filename, &st) && (st.st_mode & S_IFMT) == S_IFREG) {
+            remove(filename);
+        }
+        return fail_write_error();
+    }
+    return 0;
+}
+
+// UF2 blocks for one family, by target address
+typedef std::map<uint32_t, const uf2_block *> uf2_page_map;
+
+static int index_uf2_pages(const std::vector<uint8_t>& uf2, uint32_t family_id, uf2_page_map& pages) {
+    if (uf2.size() % sizeof(uf2_block)) {
+        return fail(ERROR_FORMAT, "UF2 file size is not a multiple of %u bytes", (uint)sizeof(uf2_block));
+    }
+    const uf2_block *blocks = reinterpret_cast<const uf2_block *>(uf2.data());
+    for (size_t i = 0; i < uf2.size() / sizeof(uf2_block); i++) {
+        const uf2_block &block = blocks[i];
+        if (block.magic_start0 != UF2_MAGIC_START0 || block.magic_start1 != UF2_MAGIC_START1 ||
+            block.magic_end != UF2_MAGIC_END) {
+            return fail(ERROR_FORMAT, "Invalid UF2 block %u", (uint)i);
+        }
+        if (block.flags & UF2_FLAG_NOT_MAIN_FLASH) continue;
+        if ((block.flags & UF2_FLAG_FAMILY_ID_PRESENT) && block.file_size != family_id) continue;
+        if (block.payload_size != PAGE_SIZE || (block.target_addr & (PAGE_SIZE - 1))) {
+            return fail(ERROR_INCOMPATIBLE, "UF2 block %u is not a single %u byte page", (uint)i, PAGE_SIZE);
+        }
+        pages[block.target_addr] = &block;
+    }
+    return 0;
+}
+
+// a baseline may be either an ELF file (which is converted as usual) or a UF2 file
+static int read_baseline(const char *filename, uint32_t family_id, std::vector<uint8_t>& uf2) {
+    FILE *in = fopen(filename, "rb");
+    if (!in) {
+        return fail(ERROR_ARGS, "Can't open baseline file '%s'", filename);
+    }
+    std::vector<uint8_t> data;
+    int rc = read_file(in, data);
+    fclose(in);
+    if (rc) return rc;
+    uint32_t magic = 0;
+    if (data.size() >= sizeof(magic)) memcpy(&magic, data.data(), sizeof(magic));
+    if (magic == ELF_MAGIC) {
+        return elf2uf2(data, family_id, uf2);
+    }
+    uf2 = std::move(data);
+    return 0;
+}
+
+static bool is_page_changed(const uf2_block *block, const uf2_page_map& baseline) {
+    auto it = baseline.find(block->target_addr);
+    return it == baseline.end() || memcmp(it->second->data, block->data, PAGE_SIZE);
+}
+
+// print how much of each loaded ELF section differs from the baseline
+static void print_section_report(FILE *report, const std::vector<uint8_t>& elf, const uf2_page_map& pages,
+                                 const uf2_page_map& baseline) {
+    elf32_header eh;
+    std::vector<elf32_ph_entry> entries;
+    if (read_and_check_elf32_header(elf, eh) || read_elf32_ph_entries(elf, eh, entries)) return;
+    if (eh.sh_entry_size != sizeof(elf32_sh_entry) || eh.sh_str_index >= eh.sh_num ||
+        (uint64_t)eh.sh_offset + eh.sh_num * sizeof(elf32_sh_entry) > elf.size()) {
+        return;
+    }
+    std::vector<elf32_sh_entry> sections(eh.sh_num);
+    memcpy(&sections[0], elf.data() + eh.sh_offset, eh.sh_num * sizeof(elf32_sh_entry));
+    const elf32_sh_entry &strtab = sections[eh.sh_str_index];
+    fprintf(report, "  %-24s %-8s %8s %13s %13s\n", "section", "address", "size", "changed bytes", "changed pages");
+    for (const auto &section : sections) {
+        if (!(section.flags & SHF_ALLOC) || section.type == SHT_NOBITS || !section.size) continue;
+        // find the load address of the section from the segment which contains it
+        uint32_t addr = 0;
+        bool loaded = false;
+        for (const auto &entry : entries) {
+            if (entry.type == PT_LOAD && section.offset >= entry.offset &&
+                (uint64_t)section.offset + section.size <= (uint64_t)entry.offset + entry.filez) {
+                addr = entry.paddr + section.offset - entry.offset;
+                loaded = true;
+                break;
+            }
+        }
+        if (!loaded) continue;
+        uint changed_bytes = 0;
+        std::set<uint32_t> changed_pages;
+        for (uint32_t a = addr; a < addr + section.size; a++) {
+            uint32_t page = a & ~(PAGE_SIZE - 1);
+            auto it = pages.find(page);
+            if (it == pages.end()) continue; // e.g. ignored RAM contents
+            auto base = baseline.find(page);
+            if (base == baseline.end() || base->second->data[a - page] != it->second->data[a - page]) {
+                changed_bytes++;
+                changed_pages.insert(page);
+            }
+        }
+        uint64_t name = (uint64_t)strtab.offset + section.name;
+        std::string section_name;
+        while (name < elf.size() && elf[name] && section_name.size() < 64) section_name += (char)elf[name++];
+        fprintf(report, "  %-24s %08x %8u %13u %13u\n", section_name.c_str(), addr, section.size, changed_bytes,
+                (uint)changed_pages.size());
+    }
+}
+
+// reduce the UF2 to just the pages which differ from the baseline or (unless page_granularity) to the whole flash
+// erase sectors containing them. The RP2040 bootrom erases a sector when it writes the first page it is sent in
+// that sector, so for it every page of the sector is needed (in the same order, per the padding in elf2uf2)
+static int make_delta(std::vector<uint8_t>& uf2, uint32_t family_id, const uf2_page_map& baseline,
+                      bool page_granularity, const std::vector<uint8_t>& elf, FILE *report) {
+    uf2_page_map pages;
+    int rc = index_uf2_pages(uf2, family_id, pages);
+    if (rc) return rc;
+    std::set<uint32_t> changed_pages, changed_sectors, sectors;
+    for (const auto &page : pages) {
+        if (page.first < FLASH_START || page.first >= FLASH_END) {
+            return fail(ERROR_INCOMPATIBLE, "Delta UF2 files are only supported for FLASH binaries");
+        }
+        sectors.insert(page.first / FLASH_SECTOR_ERASE_SIZE);
+        if (is_page_changed(page.second, baseline)) {
+            changed_pages.insert(page.first);
+            changed_sectors.insert(page.first / FLASH_SECTOR_ERASE_SIZE);
+        }
+    }
+    std::vector<uint8_t> delta;
+    for (const auto &page : pages) {
+        if (page_granularity ? changed_pages.count(page.first) : changed_sectors.count(page.first / FLASH_SECTOR_ERASE_SIZE)) {
+            const uint8_t *block = reinterpret_cast<const uint8_t *>(page.second);
+            delta.insert(delta.end(), block, block + sizeof(uf2_block));
         }
     }
+    uint32_t num_blocks = (uint32_t)(delta.size() / sizeof(uf2_block));
+    uf2_block *blocks = reinterpret_cast<uf2_block *>(delta.data());
+    for (uint32_t i = 0; i < num_blocks; i++) {
+        blocks[i].block_no = i;
+        blocks[i].num_blocks = num_blocks;
+    }
+    fprintf(report, "%u of %u pages differ from the baseline (in %u of %u sectors); the delta has %u of %u blocks (%u%%)\n",
+            (uint)changed_pages.size(), (uint)pages.size(), (uint)changed_sectors.size(), (uint)sectors.size(),
+            num_blocks, (uint)pages.size(), (uint)(num_blocks * 100ull / pages.size()));
+    print_section_report(report, elf, pages, baseline);
+    uf2 = std::move(delta);
     return 0;
 }
 
+struct conversion {
+    conversion(const char *in_filename, uint32_t family_id) : in_filename(in_filename), family_id(family_id) {}
+    std::string in_filename;
+    std::string out_filename; // empty if the output is not written by itself
+    uint32_t family_id;
+    std::vector<uint8_t> uf2;
+    const uf2_page_map *baseline = nullptr; // make a delta against this if set
+    bool page_granularity = false;
+    FILE *report = stdout;
+    int rc = 0;
+    std::string error;
+};
+
+static void convert(conversion &c) {
+    FILE *in = fopen(c.in_filename.c_str(), "rb");
+    if (!in) {
+        c.rc = fail(ERROR_ARGS, "Can't open input file '%s'", c.in_filename.c_str());
+    } else {
+        std::vector<uint8_t> elf;
+        c.rc = read_file(in, elf);
+        fclose(in);
+        if (!c.rc) {
+            c.rc = elf2uf2(elf, c.family_id, c.uf2);
+        }
+        if (!c.rc && c.baseline) {
+            c.rc = make_delta(c.uf2, c.family_id, *c.baseline, c.page_granularity, elf, c.report);
+        }
+        if (!c.rc && !c.out_filename.empty()) {
+            c.rc = write_file(c.out_filename.c_str(), c.uf2);
+            c.uf2.clear();
+            c.uf2.shrink_to_fit();
+        }
+    }
+    if (c.rc) c.error = error_msg;
+}
+
+// each input is converted (by a single thread, as converting a page is just a copy) in parallel with the others
+static void convert_all(std::vector<conversion>& conversions, uint jobs) {
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i; (i = next++) < conversions.size();) {
+            convert(conversions[i]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint i = 1; i < jobs && i < conversions.size(); i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+static bool parse_uint(const char *s, uint32_t &value) {
+    char *end;
+    unsigned long v = strtoul(s, &end, 0);
+    if (!*s || *end || v > UINT32_MAX) return false;
+    value = (uint32_t)v;
+    return true;
+}
+
 int main(int argc, char **argv) {
-    int arg = 1;
-    if (arg < argc && !strcmp(argv[arg], "-v")) {
-        verbose = true;
-        arg++;
+    bool batch = false;
+    const char *combined_filename = nullptr;
+    const char *baseline_filename = nullptr;
+    bool page_granularity = false;
+    uint32_t family_id = RP2040_FAMILY_ID;
+    uint32_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<conversion> conversions;
+    int last_positional_arg = 0;
+    for (int arg = 1; arg < argc; arg++) {
+        if (!strcmp(argv[arg], "-v")) {
+            verbose = true;
+        } else if (!strcmp(argv[arg], "-b")) {
+            batch = true;
+        } else if (!strcmp(argv[arg], "-c") && arg + 1 < argc) {
+            combined_filename = argv[++arg];
+        } else if (!strcmp(argv[arg], "-d") && arg + 1 < argc) {
+            baseline_filename = argv[++arg];
+        } else if (!strcmp(argv[arg], "-p")) {
+            page_granularity = true;
+        } else if (!strcmp(argv[arg], "-f") && arg + 1 < argc) {
+            if (!parse_uint(argv[++arg], family_id)) return usage();
+        } else if (!strcmp(argv[arg], "-j") && arg + 1 < argc) {
+            if (!parse_uint(argv[++arg], jobs) || !jobs) return usage();
+        } else if (argv[arg][0] == '-' && argv[arg][1]) {
+            return usage();
+        } else {
+            conversions.emplace_back(argv[arg], family_id);
+            last_positional_arg = arg;
+        }
     }
-    if (argc < arg + 2) {
+    if (batch && combined_filename) {
         return usage();
     }
-    const char *in_filename = argv[arg++];
-    FILE *in = fopen(in_filename, "rb");
-    if (!in) {
-        fprintf(stderr, "Can't open input file '%s'\n", in_filename);
-        return ERROR_ARGS;
+    const char *out_filename = nullptr;
+    if (!batch && !combined_filename) {
+        // the output file must come last, so an option can't be mistaken for it
+        if (conversions.size() != 2 || last_positional_arg != argc - 1) {
+            return usage();
+        }
+        // a family ID given between the input and output files applies to the input
+        conversions.front().family_id = conversions.back().family_id;
+        out_filename = argv[last_positional_arg];
+        conversions.pop_back();
     }
-    const char *out_filename = argv[arg++];
-    FILE *out = fopen(out_filename, "wb");
-    if (!out) {
-        fprintf(stderr, "Can't open output file '%s'\n", out_filename);
-        return ERROR_ARGS;
+    if ((page_granularity && !baseline_filename) || (baseline_filename && !out_filename)) {
+        return usage();
+    }
+    if (conversions.empty()) {
+        return usage();
+    }
+    if (verbose) {
+        // keep the output of each conversion together
+        jobs = 1;
+    }
+    for (auto &c : conversions) {
+        if (batch) {
+            std::string name = c.in_filename;
+            size_t dot = name.find_last_of('.');
+            if (dot != std::string::npos && name.find_first_of("/\\", dot) == std::string::npos) {
+                name.resize(dot);
+            }
+            c.out_filename = name + ".uf2";
+        } else if (out_filename) {
+            c.out_filename = out_filename;
+        }
+    }
+    if (combined_filename) {
+        std::set<uint32_t> family_ids;
+        for (const auto &c : conversions) {
+            if (!family_ids.insert(c.family_id).second) {
+                fprintf(stderr, "ERROR: The images in a combined UF2 file must have different family IDs (0x%08x is repeated)\n", c.family_id);
+                return ERROR_ARGS;
+            }
+        }
     }
 
-    int rc = elf2uf2(in, out);
-    fclose(in);
-    fclose(out);
-    if (rc) {
-        remove(out_filename);
-        if (error_msg[0]) {
+    std::vector<uint8_t> baseline_uf2;
+    uf2_page_map baseline;
+    if (baseline_filename) {
+        conversion &c = conversions[0];
+        int rc = read_baseline(baseline_filename, c.family_id, baseline_uf2);
+        if (!rc) rc = index_uf2_pages(baseline_uf2, c.family_id, baseline);
+        if (rc) {
+            fprintf(stderr, "ERROR: %s: %s\n", baseline_filename, error_msg);
+            return rc;
+        }
+        c.baseline = &baseline;
+        c.page_granularity = page_granularity;
+        // keep the report out of the way of the output
+        if (!strcmp(out_filename, "-")) c.report = stderr;
+    }
+
+    convert_all(conversions, jobs);
+
+    int rc = 0;
+    for (const auto &c : conversions) {
+        if (c.rc) {
+            if (!c.error.empty()) {
+                if (out_filename) {
+                    fprintf(stderr, "ERROR: %s\n", c.error.c_str());
+                } else {
+                    fprintf(stderr, "ERROR: %s: %s\n", c.in_filename.c_str(), c.error.c_str());
+                }
+            }
+            if (!rc) rc = c.rc;
+        }
+    }
+    if (!rc && combined_filename) {
+        // each image keeps its own block numbering, which is how multi-family UF2 files are laid out
+        std::vector<uint8_t> combined;
+        for (const auto &c : conversions) {
+            combined.insert(combined.end(), c.uf2.begin(), c.uf2.end());
+        }
+        rc = write_file(combined_filename, combined);
+        if (rc) {
             fprintf(stderr, "ERROR: %s\n", error_msg);
         }
     }
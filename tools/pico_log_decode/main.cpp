@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Decodes a binary pico_log stream (as output by pico_log_drain_binary) to text, using the format strings from the
+// pico_log_sites section of the ELF file of the binary which produced it.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdarg>
+#include <vector>
+#include "pico/log_format.h"
+
+typedef unsigned int uint;
+
+#define ERROR_ARGS -1
+#define ERROR_FORMAT -2
+#define ERROR_READ_FAILED -4
+
+#define ELF_MAGIC 0x464c457fu
+
+// largest record we will accept when resynchronizing with a stream
+#define MAX_RECORD_SIZE 4096u
+
+static char error_msg[512];
+static bool verbose;
+
+static int fail(int code, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error_msg, sizeof(error_msg), format, args);
+    va_end(args);
+    return code;
+}
+
+static int usage() {
+    fprintf(stderr, "Usage: pico_log_decode (-v) <ELF file> (<binary log file>)\n");
+    fprintf(stderr, "       the binary log is read from stdin if no file is given\n");
+    return ERROR_ARGS;
+}
+
+static uint64_t get_le(const std::vector<uint8_t> &data, size_t offset, uint bytes) {
+    uint64_t v = 0;
+    for (uint i = bytes; i--;) v = (v << 8) | data[offset + i];
+    return v;
+}
+
+// find the pico_log_sites section in a little-endian ELF32 (device) or ELF64 (host build) file
+static int read_sites_section(FILE *in, std::vector<uint8_t> &sites) {
+    std::vector<uint8_t> elf;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) elf.insert(elf.end(), buf, buf + n);
+    if (ferror(in)) return fail(ERROR_READ_FAILED, "Failed to read ELF file");
+    if (elf.size() < 64 || get_le(elf, 0, 4) != ELF_MAGIC) return fail(ERROR_FORMAT, "Not an ELF file");
+    bool is64 = elf[4] == 2;
+    if (elf[5] != 1) return fail(ERROR_FORMAT, "Require little-endian ELF");
+    uint64_t sh_offset = is64 ? get_le(elf, 0x28, 8) : get_le(elf, 0x20, 4);
+    uint sh_entry_size = (uint)get_le(elf, is64 ? 0x3a : 0x2e, 2);
+    uint sh_num = (uint)get_le(elf, is64 ? 0x3c : 0x30, 2);
+    uint sh_str_index = (uint)get_le(elf, is64 ? 0x3e : 0x32, 2);
+    if (sh_str_index >= sh_num || sh_offset + (uint64_t)sh_num * sh_entry_size > elf.size()) {
+        return fail(ERROR_FORMAT, "Invalid ELF section headers");
+    }
+    auto section_offset = [&](uint i) { size_t h = sh_offset + i * sh_entry_size; return is64 ? get_le(elf, h + 0x18, 8) : get_le(elf, h + 0x10, 4); };
+    auto section_size = [&](uint i) { size_t h = sh_offset + i * sh_entry_size; return is64 ? get_le(elf, h + 0x20, 8) : get_le(elf, h + 0x14, 4); };
+    uint64_t strtab = section_offset(sh_str_index);
+    for (uint i = 0; i < sh_num; i++) {
+        uint64_t name = strtab + get_le(elf, sh_offset + i * sh_entry_size, 4);
+        if (name >= elf.size()) continue;
+        if (!strncmp((const char *)&elf[name], PICO_LOG_SITES_SECTION_NAME, elf.size() - name)) {
+            uint64_t offset = section_offset(i), size = section_size(i);
+            if (offset + size > elf.size()) return fail(ERROR_FORMAT, "Invalid ELF section");
+            sites.assign(elf.begin() + (long)offset, elf.begin() + (long)(offset + size));
+            // make sure a corrupt record cannot take us off the end of the last format string
+            sites.push_back(0);
+            if (verbose) printf("Found %s section of %u bytes\n", PICO_LOG_SITES_SECTION_NAME, (uint)size);
+            return 0;
+        }
+    }
+    return fail(ERROR_FORMAT, "ELF file has no %s section; was pico_log used?", PICO_LOG_SITES_SECTION_NAME);
+}
+
+static int decode(FILE *in, const std::vector<uint8_t> &sites) {
+    std::vector<uint8_t> stream;
+    uint8_t buf[4096];
+    size_t n;
+    uint records = 0, skipped = 0;
+    char line[1024];
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        stream.insert(stream.end(), buf, buf + n);
+        size_t pos = 0;
+        while (pos + PICO_LOG_FRAME_HEADER_SIZE + PICO_LOG_RECORD_HEADER_SIZE <= stream.size()) {
+            const uint8_t *frame = &stream[pos];
+            const uint8_t *record = frame + PICO_LOG_FRAME_HEADER_SIZE;
+            uint len = pico_log_get_le(record, 2);
+            uint32_t site_offset = pico_log_get_le(record + 2, 4);
+            bool plausible = frame[0] == PICO_LOG_FRAME_SYNC0 && frame[1] == PICO_LOG_FRAME_SYNC1 &&
+                    len >= PICO_LOG_RECORD_HEADER_SIZE && len <= MAX_RECORD_SIZE &&
+                    site_offset + sizeof(pico_log_site_t) < sites.size();
+            if (plausible && pos + PICO_LOG_FRAME_HEADER_SIZE + len > stream.size()) break; // need more data
+            int l = -1;
+            if (plausible) {
+                const pico_log_site_t *site = (const pico_log_site_t *)&sites[site_offset];
+                l = pico_log_format_line(line, sizeof(line), frame[2], site, record, len);
+            }
+            if (l < 0) {
+                // not a valid record (e.g. we started mid-stream, or bytes were lost); resynchronize
+                skipped++;
+                pos++;
+                continue;
+            }
+            fwrite(line, 1, (size_t)l, stdout);
+            records++;
+            pos += PICO_LOG_FRAME_HEADER_SIZE + len;
+        }
+        stream.erase(stream.begin(), stream.begin() + (long)pos);
+    }
+    if (verbose) printf("Decoded %u records, skipped %u bytes\n", records, skipped + (uint)stream.size());
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int arg = 1;
+    if (arg < argc && !strcmp(argv[arg], "-v")) {
+        verbose = true;
+        arg++;
+    }
+    if (argc < arg + 1 || argc > arg + 2) {
+        return usage();
+    }
+    const char *elf_filename = argv[arg++];
+    FILE *elf = fopen(elf_filename, "rb");
+    if (!elf) {
+        fprintf(stderr, "Can't open ELF file '%s'\n", elf_filename);
+        return ERROR_ARGS;
+    }
+    std::vector<uint8_t> sites;
+    int rc = read_sites_section(elf, sites);
+    fclose(elf);
+    if (!rc) {
+        FILE *in = stdin;
+        if (arg < argc) {
+            in = fopen(argv[arg], "rb");
+            if (!in) {
+                fprintf(stderr, "Can't open log file '%s'\n", argv[arg]);
+                return ERROR_ARGS;
+            }
+        }
+        rc = decode(in, sites);
+        if (in != stdin) fclose(in);
+    }
+    if (rc && error_msg[0]) {
+        fprintf(stderr, "ERROR: %s\n", error_msg);
+    }
+    return rc;
+}
@@ -70,7 +70,7 @@ struct c_sdk_output : public output_format {
 
         fprintf(out, "#pragma once\n");
         fprintf(out, "\n");
-        fprintf(out, "#if !PICO_NO_HARDWARE\n");
+        fprintf(out, "#if !PICO_NO_HARDWARE || PICO_PIO_EMULATION\n");
         fprintf(out, "#include \"hardware/pio.h\"\n");
         fprintf(out, "#endif\n");
         fprintf(out, "\n");
@@ -103,7 +103,7 @@ struct c_sdk_output : public output_format {
             fprintf(out, "};\n");
             fprintf(out, "\n");
 
-            fprintf(out, "#if !PICO_NO_HARDWARE\n");
+            fprintf(out, "#if !PICO_NO_HARDWARE || PICO_PIO_EMULATION\n");
             fprintf(out, "static const struct pio_program %sprogram = {\n", prefix.c_str());
             fprintf(out, "    .instructions = %sprogram_instructions,\n", prefix.c_str());
             fprintf(out, "    .length = %d,\n", (int) program.instructions.size());
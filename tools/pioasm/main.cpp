@@ -23,6 +23,8 @@ void usage() {
         std::cerr << "                               " << f->get_description() << std::endl;
     }
     std::cerr << "  -p <output_param>    add a parameter to be passed to the output format generator" << std::endl;
+    std::cerr << "  -O                   optimize programs by folding nops and trailing jmps into delays/.wrap and removing\n";
+    std::cerr << "                       unreachable instructions, without changing their timing\n";
     std::cerr << "  -?, --help           print this help and exit\n";
 }
 
@@ -50,6 +52,8 @@ int main(int argc, char *argv[]) {
                 std::cerr << "error: -p requires parameter value" << std::endl;
                 res = 1;
             }
+        } else if (argv[i] == std::string("-O")) {
+            pioasm.optimize = true;
         } else if (argv[i] == std::string("-?") || argv[i] == std::string("--help")) {
             usage();
             return 1;
@@ -7,6 +7,7 @@
 #include <cstdio>
 #include <iterator>
 #include "pio_assembler.h"
+#include "pio_optimizer.h"
 #include "parser.hpp"
 
 #ifdef _MSC_VER
@@ -374,6 +375,12 @@ int pio_assembler::write_output() {
         });
         cprogram.lang_opts = program.lang_opts;
         cprogram.symbols = public_symbols(program);
+        if (optimize) {
+            std::string report;
+            bool ok = optimize_program(cprogram, report);
+            // don't mix the report into the output
+            (dest == "-" ? std::cerr : std::cout) << (ok ? "" : "warning: ") << report << std::endl;
+        }
     }
     if (programs.empty()) {
         std::cout << "warning: input contained no programs" << std::endl;
@@ -35,6 +35,8 @@ public:
     // name of the output file or "-" for stdout
     std::string dest;
     std::vector<std::string> options;
+    // whether to run the optimizer over each program before output
+    bool optimize = false;
 
     int write_output();
 
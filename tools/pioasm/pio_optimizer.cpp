@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include "pio_optimizer.h"
+
+// The optimizer works on the encoded instructions, so labels, expressions and .word instructions have all been
+// resolved already. It only ever removes instructions whose cycles can be moved into the delay of a neighbour (or
+// which can never execute), so the optimized program takes exactly the same number of cycles between every pair of
+// instructions with an effect. Programs which write the PC (or exec instructions) are left alone, as their control
+// flow can't be known.
+//
+// Public labels are entry points (the SDK may start a state machine at, or exec a jmp to, any of them), so are
+// preserved and renumbered along with the jmp targets, .wrap and .wrap_target.
+
+namespace {
+
+const uint MAJOR_JMP = 0;
+const uint MAJOR_OUT = 3;
+const uint MAJOR_MOV = 5;
+const uint COND_ALWAYS = 0;
+const uint OUT_DEST_PC = 5;
+const uint OUT_DEST_EXEC = 7;
+const uint MOV_DEST_EXEC = 4;
+const uint MOV_DEST_PC = 5;
+const uint NOP_ENCODING = 0xa042; // mov y, y
+
+struct optimizer {
+    compiled_source::program &program;
+    uint delay_bits;
+    uint sideset_bits;
+
+    explicit optimizer(compiled_source::program &program) : program(program) {
+        sideset_bits = (uint) program.sideset_bits_including_opt.get();
+        delay_bits = 5 - sideset_bits;
+    }
+
+    static uint major(uint inst) { return inst >> 13u; }
+    static uint arg1(uint inst) { return (inst >> 5u) & 7u; }
+    static uint jmp_target(uint inst) { return inst & 0x1fu; }
+
+    static bool is_jmp(uint inst) { return major(inst) == MAJOR_JMP; }
+    static bool is_jmp_always(uint inst) { return is_jmp(inst) && arg1(inst) == COND_ALWAYS; }
+
+    uint delay_mask() const { return ((1u << delay_bits) - 1u) << 8u; }
+    uint delay_max() const { return (1u << delay_bits) - 1u; }
+    uint delay(uint inst) const { return (inst & delay_mask()) >> 8u; }
+    uint with_delay(uint inst, uint d) const { return (inst & ~delay_mask()) | (d << 8u); }
+    bool is_nop(uint inst) const { return (inst & ~(0x1fu << 8u)) == NOP_ENCODING; }
+
+    // the side-set field (including any optional enable bit), or -1 if the instruction doesn't side-set
+    int sideset(uint inst) const {
+        if (!sideset_bits) return -1;
+        uint field = ((inst >> 8u) & 0x1fu) >> delay_bits;
+        if (program.sideset_opt && !(field & (1u << (sideset_bits - 1u)))) return -1;
+        return (int) field;
+    }
+
+    static bool writes_pc(uint inst) {
+        return (major(inst) == MAJOR_OUT && (arg1(inst) == OUT_DEST_PC || arg1(inst) == OUT_DEST_EXEC)) ||
+               (major(inst) == MAJOR_MOV && (arg1(inst) == MOV_DEST_PC || arg1(inst) == MOV_DEST_EXEC));
+    }
+
+    // whether extra cycles can be added to the delay of the instruction (jmp delays also apply to the taken path)
+    static bool can_carry_delay(uint inst) {
+        return !is_jmp(inst) && !writes_pc(inst);
+    }
+
+    // the instruction executed after i if it doesn't jump, or -1 if that is outside the program
+    int next(const std::vector<uint> &insts, int wrap, int wrap_target, int i) const {
+        if (i == wrap) return wrap_target;
+        return i + 1 < (int) insts.size() ? i + 1 : -1;
+    }
+
+    std::vector<int> successors(const std::vector<uint> &insts, int wrap, int wrap_target, int i) const {
+        uint inst = insts[i];
+        if (is_jmp_always(inst)) return {(int) jmp_target(inst)};
+        int n = next(insts, wrap, wrap_target, i);
+        if (is_jmp(inst)) return {(int) jmp_target(inst), n};
+        return {n};
+    }
+
+    std::vector<int> entries() const {
+        std::vector<int> rc = {0};
+        for (const auto &s : program.symbols) {
+            if (s.is_label) rc.push_back(s.value);
+        }
+        return rc;
+    }
+
+    bool is_entry_or_target(int i) const {
+        if (i == program.wrap_target) return true;
+        for (int e : entries()) {
+            if (e == i) return true;
+        }
+        for (uint inst : program.instructions) {
+            if (is_jmp(inst) && (int) jmp_target(inst) == i) return true;
+        }
+        return false;
+    }
+
+    // remove the instructions not marked as kept, renumbering everything which refers to an instruction
+    void remove(const std::vector<bool> &keep) {
+        // labels may also refer to the end of the program
+        std::vector<int> new_index(keep.size() + 1);
+        std::vector<uint> insts;
+        for (size_t i = 0; i < keep.size(); i++) {
+            new_index[i] = (int) insts.size();
+            if (keep[i]) insts.push_back(program.instructions[i]);
+        }
+        new_index[keep.size()] = (int) insts.size();
+        for (uint &inst : insts) {
+            if (is_jmp(inst)) inst = (inst & ~0x1fu) | (uint) new_index[jmp_target(inst)];
+        }
+        // a removed .wrap instruction hands over to the preceding one
+        int w = program.wrap;
+        while (w > 0 && !keep[w]) w--;
+        program.wrap = new_index[w];
+        program.wrap_target = new_index[program.wrap_target];
+        for (auto &s : program.symbols) {
+            if (s.is_label) s.value = new_index[s.value];
+        }
+        program.instructions = insts;
+    }
+
+    // remove instructions which can't be reached from any entry point. The .wrap instruction is only reached by
+    // executing into it; if it can't be, the reachable instruction before it must be an unconditional jmp, which
+    // becomes the new .wrap (see remove), leaving a trailing jmp for remove_trailing_jmp
+    int remove_unreachable() {
+        auto &insts = program.instructions;
+        std::vector<bool> reached(insts.size());
+        std::vector<int> pending = entries();
+        // keep .wrap_target, so it stays well defined
+        pending.push_back(program.wrap_target);
+        while (!pending.empty()) {
+            int i = pending.back();
+            pending.pop_back();
+            if (i < 0 || i >= (int) insts.size() || reached[i]) continue;
+            reached[i] = true;
+            for (int s : successors(insts, program.wrap, program.wrap_target, i)) pending.push_back(s);
+        }
+        int removed = (int) std::count(reached.begin(), reached.end(), false);
+        if (removed) remove(reached);
+        return removed;
+    }
+
+    // fold a nop into the delay of the instruction before it
+    bool merge_nop() {
+        auto &insts = program.instructions;
+        for (int i = 0; i + 1 < (int) insts.size(); i++) {
+            int j = i + 1;
+            if (next(insts, program.wrap, program.wrap_target, i) != j) continue;
+            if (!is_nop(insts[j]) || !can_carry_delay(insts[i]) || is_entry_or_target(j)) continue;
+            if (sideset(insts[j]) >= 0 && sideset(insts[j]) != sideset(insts[i])) continue;
+            uint d = delay(insts[i]) + 1 + delay(insts[j]);
+            if (d > delay_max()) continue;
+            insts[i] = with_delay(insts[i], d);
+            std::vector<bool> keep(insts.size(), true);
+            keep[j] = false;
+            remove(keep);
+            return true;
+        }
+        return false;
+    }
+
+    // replace an unconditional jmp at the .wrap with wrapping from the instruction before it
+    bool remove_trailing_jmp() {
+        auto &insts = program.instructions;
+        int w = program.wrap;
+        int p = w - 1;
+        if (p < 0 || !is_jmp_always(insts[w]) || !can_carry_delay(insts[p]) || is_entry_or_target(w)) return false;
+        if (sideset(insts[w]) >= 0 && sideset(insts[w]) != sideset(insts[p])) return false;
+        uint d = delay(insts[p]) + 1 + delay(insts[w]);
+        if (d > delay_max()) return false;
+        int target = (int) jmp_target(insts[w]);
+        insts[p] = with_delay(insts[p], d);
+        program.wrap_target = target;
+        std::vector<bool> keep(insts.size(), true);
+        keep[w] = false;
+        remove(keep);
+        program.wrap = p;
+        return true;
+    }
+};
+
+// A summary of a program's timing: each instruction which has an effect, with the (effective) instruction(s)
+// which follow it, and the number of cycles until they do. nops, and unconditional jmps, which don't change the
+// side-set pins are only a means of taking time or getting somewhere, so are folded into those cycle counts.
+struct timing_graph {
+    static const int EXIT = -1;
+    static const int IDLE = -2; // loops forever without doing anything
+
+    struct edge {
+        int to;
+        uint cycles;
+    };
+
+    const optimizer &opt;
+    const std::vector<uint> &insts;
+    int wrap, wrap_target;
+
+    timing_graph(const optimizer &opt, const compiled_source::program &program) : opt(opt),
+        insts(program.instructions), wrap(program.wrap), wrap_target(program.wrap_target) {}
+
+    bool is_transparent(int i, int chain_sideset) const {
+        uint inst = insts[i];
+        if (!opt.is_nop(inst) && !optimizer::is_jmp_always(inst)) return false;
+        int s = opt.sideset(inst);
+        return s < 0 || s == chain_sideset;
+    }
+
+    // from instruction i, skip over transparent instructions to the next effective one
+    edge follow(int i, uint cycles, int chain_sideset) const {
+        for (size_t steps = 0; i >= 0 && i < (int) insts.size(); steps++) {
+            if (steps > insts.size()) return {IDLE, 0};
+            if (!is_transparent(i, chain_sideset)) return {i, cycles};
+            cycles += 1 + opt.delay(insts[i]);
+            i = opt.successors(insts, wrap, wrap_target, i)[0];
+        }
+        return {EXIT, cycles};
+    }
+
+    std::vector<edge> edges(int i) const {
+        std::vector<edge> rc;
+        for (int s : opt.successors(insts, wrap, wrap_target, i)) {
+            rc.push_back(s < 0 ? edge{EXIT, 0} : follow(s, 1 + opt.delay(insts[i]), opt.sideset(insts[i])));
+        }
+        return rc;
+    }
+
+    // the instruction without its delay and jmp target, which are accounted for by the edges
+    uint effect(int i) const {
+        uint inst = insts[i] & ~opt.delay_mask();
+        return optimizer::is_jmp(inst) ? inst & ~0x1fu : inst;
+    }
+};
+
+}
+
+bool programs_cycle_equivalent(const compiled_source::program &a, const compiled_source::program &b) {
+    compiled_source::program copy = a;
+    optimizer opt(copy);
+    timing_graph ga(opt, a), gb(opt, b);
+    std::vector<std::pair<timing_graph::edge, timing_graph::edge>> pending;
+    pending.emplace_back(ga.follow(0, 0, -1), gb.follow(0, 0, -1));
+    for (size_t i = 0; i < a.symbols.size(); i++) {
+        if (a.symbols[i].is_label) {
+            pending.emplace_back(ga.follow(a.symbols[i].value, 0, -1), gb.follow(b.symbols[i].value, 0, -1));
+        }
+    }
+    std::map<int, int> mapping;
+    while (!pending.empty()) {
+        auto ea = pending.back().first;
+        auto eb = pending.back().second;
+        pending.pop_back();
+        if (ea.cycles != eb.cycles) return false;
+        if (ea.to < 0 || eb.to < 0) {
+            if (ea.to != eb.to) return false;
+            continue;
+        }
+        auto m = mapping.find(ea.to);
+        if (m != mapping.end()) {
+            if (m->second != eb.to) return false;
+            continue;
+        }
+        mapping[ea.to] = eb.to;
+        if (ga.effect(ea.to) != gb.effect(eb.to)) return false;
+        auto edges_a = ga.edges(ea.to);
+        auto edges_b = gb.edges(eb.to);
+        if (edges_a.size() != edges_b.size()) return false;
+        for (size_t i = 0; i < edges_a.size(); i++) {
+            pending.emplace_back(edges_a[i], edges_b[i]);
+        }
+    }
+    return true;
+}
+
+bool optimize_program(compiled_source::program &program, std::string &report) {
+    std::stringstream ss;
+    ss << "program '" << program.name << "': ";
+    size_t before = program.instructions.size();
+    if (!before) {
+        ss << "no instructions";
+        report = ss.str();
+        return true;
+    }
+    if (std::any_of(program.instructions.begin(), program.instructions.end(), optimizer::writes_pc)) {
+        ss << before << " instructions; not optimized as it writes the PC or executes instructions";
+        report = ss.str();
+        return true;
+    }
+    compiled_source::program original = program;
+    optimizer opt(program);
+    int unreachable = 0, merged = 0, trailing = 0;
+    bool changed;
+    do {
+        changed = false;
+        int n = opt.remove_unreachable();
+        unreachable += n;
+        while (opt.merge_nop()) {
+            merged++;
+            changed = true;
+        }
+        if (opt.remove_trailing_jmp()) {
+            trailing++;
+            changed = true;
+        }
+        changed |= n != 0;
+    } while (changed);
+    ss << before << " -> " << program.instructions.size() << " instructions (" << unreachable << " unreachable removed, "
+       << merged << " nop(s) merged into delays, " << trailing << " trailing jmp(s) replaced by .wrap)";
+    bool ok = programs_cycle_equivalent(original, program);
+    if (ok) {
+        ss << "; cycle equivalence verified";
+    } else {
+        program = original;
+        ss << "; FAILED cycle equivalence check, so left unoptimized";
+    }
+    report = ss.str();
+    return ok;
+}
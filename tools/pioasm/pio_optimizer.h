@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PIO_OPTIMIZER_H
+#define _PIO_OPTIMIZER_H
+
+#include <string>
+#include "output_format.h"
+
+// Reduce the number of instructions in an assembled program without changing its timing. Returns false (leaving the
+// program unchanged) if the optimized program could not be verified as cycle equivalent to the original. In either
+// case report is set to a one line summary of what was done.
+bool optimize_program(compiled_source::program &program, std::string &report);
+
+// Check that two versions of a program (sharing side-set configuration and public labels) execute the same effective
+// instructions with the same timing from every entry point; this is how optimize_program verifies its result.
+bool programs_cycle_equivalent(const compiled_source::program &a, const compiled_source::program &b);
+
+#endif
@@ -0,0 +1,600 @@
+/*
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "pio_assembler.h"
+#include "pio_disassembler.h"
+#include "pio_sim.h"
+
+// Runs the programs from a .pio file on a simulated PIO block as directed by a script, reporting FIFO/stall
+// statistics and optionally writing a VCD file of the pins and state machine state on every cycle.
+
+#define DEFAULT_CLOCK_MHZ 125.0
+
+static const char *const stall_names[PIO_SIM_STALL_COUNT] = {"", "tx_empty", "rx_full", "wait", "irq"};
+
+void usage() {
+    std::cerr << "usage: piosim <options> <input> <script>\n\n";
+    std::cerr << "Simulate the PIO program(s) in a .pio file, cycle by cycle, as directed by a script.\n";
+    std::cerr << "   <input>             the .pio input filename\n";
+    std::cerr << "   <script>            the script filename, containing one command per line ('#' starts a comment):\n";
+    std::cerr << "       load <program> [<offset>]          load a program into instruction memory (default offset 0)\n";
+    std::cerr << "       config <sm> <program> [<key>=<value>...]\n";
+    std::cerr << "                                          initialize a state machine to run a loaded program, using its\n";
+    std::cerr << "                                          .wrap and .side_set settings. keys are clkdiv=<float>,\n";
+    std::cerr << "                                          out=<base>[:<count>], set=<base>[:<count>], sideset=<base>,\n";
+    std::cerr << "                                          in=<base>, jmp_pin=<pin>, in_shift=left|right,\n";
+    std::cerr << "                                          out_shift=left|right, autopush=<threshold>,\n";
+    std::cerr << "                                          autopull=<threshold>, push_threshold=<n>, pull_threshold=<n>,\n";
+    std::cerr << "                                          join=tx|rx, status=tx|rx:<n> and start=<label or offset>\n";
+    std::cerr << "       enable <sm>...                     enable state machines (together)\n";
+    std::cerr << "       disable <sm>...                    disable state machines\n";
+    std::cerr << "       pin <pin> 0|1                      drive an input pin\n";
+    std::cerr << "       sync_bypass <pin>...               bypass the input synchronizers for pins\n";
+    std::cerr << "       put <sm> <value>...                queue words for the TX FIFO (written as space allows)\n";
+    std::cerr << "       drain <sm> on|off                  whether the RX FIFO is read as soon as data arrives (default on)\n";
+    std::cerr << "       exec <sm> <encoding>               execute an instruction on a state machine\n";
+    std::cerr << "       run <cycles>                       run for a number of system clock cycles\n";
+    std::cerr << "       expect <sm> <value>...             check the next words read from the RX FIFO\n";
+    std::cerr << "\n";
+    std::cerr << "options:\n";
+    std::cerr << "  -v <vcd_file>        write a VCD file of the pins and state machine state\n";
+    std::cerr << "  -f <mhz>             system clock frequency for the VCD timescale (default " << DEFAULT_CLOCK_MHZ << ")\n";
+    std::cerr << "  -t                   trace every instruction issued to stdout\n";
+    std::cerr << "  -?, --help           print this help and exit\n";
+}
+
+struct capture_output : public output_format {
+    compiled_source source;
+
+    capture_output() : output_format("piosim") {}
+
+    std::string get_description() override {
+        return "Captures the assembled programs for simulation";
+    }
+
+    int output(std::string, std::vector<std::string>,
+               const compiled_source &_source) override {
+        source = _source;
+        return 0;
+    }
+};
+
+struct vcd_writer {
+    FILE *out = nullptr;
+    uint64_t period_ps = 0;
+    struct signal {
+        std::string id;
+        uint width;
+        uint64_t value;
+        bool written;
+    };
+    std::vector<signal> signals;
+    std::stringstream defs;
+
+    uint add(const std::string &name, uint width) {
+        uint index = (uint) signals.size();
+        std::string id;
+        // identifiers are made of printable characters
+        uint n = index;
+        do {
+            id += (char) ('!' + n % 94);
+            n /= 94;
+        } while (n);
+        signals.push_back({id, width, 0, false});
+        defs << "$var wire " << width << " " << id << " " << name << " $end\n";
+        return index;
+    }
+
+    void scope(const std::string &name) {
+        defs << "$scope module " << name << " $end\n";
+    }
+
+    void upscope() {
+        defs << "$upscope $end\n";
+    }
+
+    void begin() {
+        fprintf(out, "$timescale 1 ps $end\n%s$enddefinitions $end\n", defs.str().c_str());
+    }
+
+    void set(uint index, uint64_t value) {
+        auto &s = signals[index];
+        if (s.written && s.value == value) return;
+        s.value = value;
+        s.written = true;
+        if (s.width == 1) {
+            fprintf(out, "%d%s\n", (int) (value & 1), s.id.c_str());
+        } else {
+            std::string bits;
+            for (uint i = s.width; i--;) bits += (value >> i) & 1 ? '1' : '0';
+            fprintf(out, "b%s %s\n", bits.c_str(), s.id.c_str());
+        }
+    }
+
+    void time(uint64_t cycle) {
+        fprintf(out, "#%" PRIu64 "\n", cycle * period_ps);
+    }
+};
+
+struct simulation {
+    pio_sim_t pio;
+    compiled_source source;
+    std::map<std::string, uint> program_offsets;
+    std::deque<uint32_t> tx_queue[PIO_SIM_NUM_STATE_MACHINES];
+    uint64_t tx_queue_full_cycles[PIO_SIM_NUM_STATE_MACHINES] = {};
+    bool drain[PIO_SIM_NUM_STATE_MACHINES] = {true, true, true, true};
+    std::vector<std::pair<uint64_t, uint32_t>> received[PIO_SIM_NUM_STATE_MACHINES];
+    size_t expect_pos[PIO_SIM_NUM_STATE_MACHINES] = {};
+    const compiled_source::program *sm_program[PIO_SIM_NUM_STATE_MACHINES] = {};
+    uint32_t used_pins = 0;
+    bool trace = false;
+    vcd_writer vcd;
+    std::vector<uint> pin_signals;
+    std::vector<uint> sm_signals[PIO_SIM_NUM_STATE_MACHINES];
+    uint irq_signals = 0;
+    bool vcd_started = false;
+    int failures = 0;
+
+    simulation() {
+        pio_sim_init(&pio);
+    }
+
+    const compiled_source::program *find_program(const std::string &name) {
+        for (const auto &p : source.programs) {
+            if (p.name == name) return &p;
+        }
+        return nullptr;
+    }
+
+    // the signals are chosen from the pins and state machines configured before the first run
+    void start_vcd() {
+        vcd_started = true;
+        vcd.scope("pio");
+        for (uint pin = 0; pin < PIO_SIM_NUM_PINS; pin++) {
+            pin_signals.push_back(used_pins & (1u << pin) ? vcd.add("gpio" + std::to_string(pin), 1) : ~0u);
+        }
+        for (uint sm = 0; sm < PIO_SIM_NUM_STATE_MACHINES; sm++) {
+            if (!sm_program[sm]) continue;
+            vcd.scope("sm" + std::to_string(sm));
+            sm_signals[sm].push_back(vcd.add("pc", 5));
+            sm_signals[sm].push_back(vcd.add("stalled", 1));
+            sm_signals[sm].push_back(vcd.add("tx_level", 4));
+            sm_signals[sm].push_back(vcd.add("rx_level", 4));
+            sm_signals[sm].push_back(vcd.add("x", 32));
+            sm_signals[sm].push_back(vcd.add("y", 32));
+            vcd.upscope();
+        }
+        vcd.scope("irq");
+        irq_signals = (uint) vcd.signals.size();
+        for (uint i = 0; i < 8; i++) vcd.add("irq" + std::to_string(i), 1);
+        vcd.upscope();
+        vcd.upscope();
+        vcd.begin();
+        vcd.time(0);
+        fprintf(vcd.out, "$dumpvars\n");
+        dump_vcd();
+        fprintf(vcd.out, "$end\n");
+    }
+
+    void dump_vcd() {
+        uint32_t pins = pio_sim_get_pins(&pio);
+        for (uint pin = 0; pin < PIO_SIM_NUM_PINS; pin++) {
+            if (pin_signals[pin] != ~0u) vcd.set(pin_signals[pin], (pins >> pin) & 1u);
+        }
+        for (uint sm = 0; sm < PIO_SIM_NUM_STATE_MACHINES; sm++) {
+            if (sm_signals[sm].empty()) continue;
+            const pio_sim_sm_t &s = pio.sm[sm];
+            const auto &sig = sm_signals[sm];
+            vcd.set(sig[0], s.pc);
+            vcd.set(sig[1], s.stall != PIO_SIM_STALL_NONE);
+            vcd.set(sig[2], s.tx.level);
+            vcd.set(sig[3], s.rx.level);
+            vcd.set(sig[4], s.x);
+            vcd.set(sig[5], s.y);
+        }
+        for (uint i = 0; i < 8; i++) vcd.set(irq_signals + i, (pio.irq >> i) & 1u);
+    }
+
+    void step() {
+        for (uint sm = 0; sm < PIO_SIM_NUM_STATE_MACHINES; sm++) {
+            if (!tx_queue[sm].empty()) {
+                if (pio_sim_sm_put(&pio, sm, tx_queue[sm].front())) {
+                    tx_queue[sm].pop_front();
+                } else {
+                    tx_queue_full_cycles[sm]++;
+                }
+            }
+        }
+        uint8_t pc[PIO_SIM_NUM_STATE_MACHINES];
+        uint16_t instr[PIO_SIM_NUM_STATE_MACHINES];
+        uint64_t issued[PIO_SIM_NUM_STATE_MACHINES];
+        if (trace) {
+            for (uint sm = 0; sm < PIO_SIM_NUM_STATE_MACHINES; sm++) {
+                const pio_sim_sm_t &s = pio.sm[sm];
+                pc[sm] = s.pc;
+                instr[sm] = s.exec_pending ? s.exec_instr : pio.instr_mem[s.pc];
+                issued[sm] = issued_count(sm);
+            }
+        }
+        pio_sim_step(&pio);
+        if (trace) {
+            for (uint sm = 0; sm < PIO_SIM_NUM_STATE_MACHINES; sm++) {
+                if (issued_count(sm) == issued[sm]) continue;
+                const pio_sim_sm_t &s = pio.sm[sm];
+                std::string text = disassemble(instr[sm], s.config.sideset_count, s.config.sideset_opt);
+                printf("%10" PRIu64 " sm%u %2u: %-40s%s%s\n", pio.cycle - 1, sm, pc[sm], text.c_str(),
+                       s.stall ? "stalled " : "", stall_names[s.stall]);
+            }
+        }
+        for (uint sm = 0; sm < PIO_SIM_NUM_STATE_MACHINES; sm++) {
+            uint32_t data;
+            if (drain[sm] && pio_sim_sm_get(&pio, sm, &data)) {
+                received[sm].emplace_back(pio.cycle, data);
+            }
+        }
+        if (vcd.out) {
+            vcd.time(pio.cycle);
+            dump_vcd();
+        }
+    }
+
+    uint64_t issued_count(uint sm) {
+        const pio_sim_sm_stats_t &stats = pio.sm[sm].stats;
+        uint64_t n = stats.instructions;
+        for (uint i = 0; i < PIO_SIM_STALL_COUNT; i++) n += stats.stall_cycles[i];
+        return n;
+    }
+
+    void report() {
+        printf("%" PRIu64 " cycles\n", pio.cycle);
+        for (uint sm = 0; sm < PIO_SIM_NUM_STATE_MACHINES; sm++) {
+            if (!sm_program[sm]) continue;
+            const pio_sim_sm_stats_t &stats = pio.sm[sm].stats;
+            printf("sm%u (%s):\n", sm, sm_program[sm]->name.c_str());
+            double ticks = stats.ticks ? (double) stats.ticks : 1.0;
+            printf("  ticks %" PRIu64 ", instructions %" PRIu64 ", delay cycles %" PRIu64 " (%.1f%%)\n", stats.ticks,
+                   stats.instructions, stats.delay_cycles, 100.0 * (double) stats.delay_cycles / ticks);
+            for (uint i = 1; i < PIO_SIM_STALL_COUNT; i++) {
+                printf("  stalled %-9s %10" PRIu64 " ticks (%.1f%%)\n", stall_names[i], stats.stall_cycles[i],
+                       100.0 * (double) stats.stall_cycles[i] / ticks);
+            }
+            double cycles = pio.cycle ? (double) pio.cycle : 1.0;
+            printf("  TX: %" PRIu64 " words pulled (%.4f per cycle), min level %u, %" PRIu64 " underruns, host waited %" PRIu64 " cycles for space, %zu still queued\n",
+                   stats.words_pulled, (double) stats.words_pulled / cycles, stats.tx_min_level, stats.tx_underruns,
+                   tx_queue_full_cycles[sm], tx_queue[sm].size());
+            printf("  RX: %" PRIu64 " words pushed (%.4f per cycle), max level %u, %" PRIu64 " overruns",
+                   stats.words_pushed, (double) stats.words_pushed / cycles, stats.rx_max_level, stats.rx_overruns);
+            if (received[sm].size() > 1) {
+                printf(", mean interval between reads %.1f cycles",
+                       (double) (received[sm].back().first - received[sm].front().first) / (double) (received[sm].size() - 1));
+            }
+            printf("\n");
+        }
+    }
+
+    bool parse_uint(const std::string &s, uint32_t &value) {
+        if (s.empty()) return false;
+        char *end;
+        unsigned long long v = strtoull(s.c_str(), &end, 0);
+        if (*end || v > 0xffffffffull) return false;
+        value = (uint32_t) v;
+        return true;
+    }
+
+    bool parse_sm(const std::string &s, uint &sm) {
+        uint32_t v;
+        if (!parse_uint(s, v) || v >= PIO_SIM_NUM_STATE_MACHINES) return false;
+        sm = v;
+        return true;
+    }
+
+    bool parse_pin(const std::string &s, uint &pin) {
+        uint32_t v;
+        if (!parse_uint(s, v) || v >= PIO_SIM_NUM_PINS) return false;
+        pin = v;
+        used_pins |= 1u << pin;
+        return true;
+    }
+
+    // parse <base>[:<count>]
+    bool parse_pins(const std::string &s, uint8_t &base, uint8_t &count) {
+        auto colon = s.find(':');
+        uint pin;
+        if (!parse_pin(s.substr(0, colon), pin)) return false;
+        base = (uint8_t) pin;
+        if (colon != std::string::npos) {
+            uint32_t v;
+            if (!parse_uint(s.substr(colon + 1), v) || v > 32) return false;
+            count = (uint8_t) v;
+        }
+        for (uint i = 0; i < count; i++) used_pins |= 1u << ((base + i) % PIO_SIM_NUM_PINS);
+        return true;
+    }
+
+    bool parse_threshold(const std::string &s, uint8_t &threshold) {
+        uint32_t v;
+        if (!parse_uint(s, v) || v < 1 || v > 32) return false;
+        threshold = (uint8_t) v;
+        return true;
+    }
+
+    bool configure(uint sm, const compiled_source::program &program, const std::vector<std::string> &args, std::string &error) {
+        uint offset = program_offsets[program.name];
+        pio_sim_sm_config_t c = pio_sim_get_default_sm_config();
+        c.wrap_target = (uint8_t) (offset + program.wrap_target);
+        c.wrap = (uint8_t) (offset + program.wrap);
+        c.sideset_count = (uint8_t) program.sideset_bits_including_opt.get();
+        c.sideset_opt = program.sideset_opt;
+        c.sideset_pindirs = program.sideset_pindirs;
+        uint start = offset;
+        for (const auto &arg : args) {
+            auto eq = arg.find('=');
+            std::string key = arg.substr(0, eq);
+            std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+            uint pin = 0;
+            bool ok = true;
+            if (key == "clkdiv") {
+                double div = atof(value.c_str());
+                ok = div >= 1.0 && div <= 65536.0;
+                uint32_t fixed = (uint32_t) (div * 256.0 + 0.5);
+                c.clkdiv_int = (uint16_t) (fixed >> 8u);
+                c.clkdiv_frac = (uint8_t) fixed;
+            } else if (key == "out") {
+                ok = parse_pins(value, c.out_base, c.out_count);
+            } else if (key == "set") {
+                ok = parse_pins(value, c.set_base, c.set_count);
+            } else if (key == "sideset") {
+                uint8_t count = (uint8_t) (c.sideset_count - (c.sideset_opt ? 1 : 0));
+                ok = parse_pins(value, c.sideset_base, count);
+            } else if (key == "in") {
+                ok = parse_pin(value, pin);
+                c.in_base = (uint8_t) pin;
+            } else if (key == "jmp_pin") {
+                ok = parse_pin(value, pin);
+                c.jmp_pin = (uint8_t) pin;
+            } else if (key == "in_shift" || key == "out_shift") {
+                ok = value == "left" || value == "right";
+                (key == "in_shift" ? c.in_shift_right : c.out_shift_right) = value == "right";
+            } else if (key == "autopush") {
+                ok = parse_threshold(value, c.push_threshold);
+                c.autopush = true;
+            } else if (key == "autopull") {
+                ok = parse_threshold(value, c.pull_threshold);
+                c.autopull = true;
+            } else if (key == "push_threshold") {
+                ok = parse_threshold(value, c.push_threshold);
+            } else if (key == "pull_threshold") {
+                ok = parse_threshold(value, c.pull_threshold);
+            } else if (key == "join") {
+                ok = value == "tx" || value == "rx";
+                c.fifo_join = value == "tx" ? PIO_SIM_FIFO_JOIN_TX : PIO_SIM_FIFO_JOIN_RX;
+            } else if (key == "status") {
+                auto colon = value.find(':');
+                uint32_t n = 0;
+                ok = colon != std::string::npos && parse_uint(value.substr(colon + 1), n) && n < 32;
+                c.mov_status_rx = value.substr(0, colon) == "rx";
+                c.mov_status_n = (uint8_t) n;
+            } else if (key == "start") {
+                uint32_t v;
+                ok = false;
+                for (const auto &s : program.symbols) {
+                    if (s.is_label && s.name == value) {
+                        start = offset + s.value;
+                        ok = true;
+                    }
+                }
+                if (!ok && parse_uint(value, v) && v < program.instructions.size()) {
+                    start = offset + v;
+                    ok = true;
+                }
+            } else {
+                error = "unknown config key '" + key + "'";
+                return false;
+            }
+            if (!ok) {
+                error = "invalid value for " + key + ": '" + value + "'";
+                return false;
+            }
+        }
+        pio_sim_sm_init(&pio, sm, start, &c);
+        sm_program[sm] = &program;
+        return true;
+    }
+
+    bool command(const std::vector<std::string> &words, std::string &error) {
+        const std::string &cmd = words[0];
+        size_t n = words.size();
+        uint sm;
+        if (cmd == "load" && (n == 2 || n == 3)) {
+            const auto *program = find_program(words[1]);
+            uint32_t offset = 0;
+            if (!program) {
+                error = "unknown program '" + words[1] + "'";
+                return false;
+            }
+            if (program->origin.get() >= 0) offset = (uint32_t) program->origin.get();
+            if ((n == 3 && !parse_uint(words[2], offset)) || offset + program->instructions.size() > PIO_SIM_INSTRUCTION_COUNT) {
+                error = "invalid offset";
+                return false;
+            }
+            std::vector<uint16_t> instructions(program->instructions.begin(), program->instructions.end());
+            pio_sim_load_program(&pio, instructions.data(), (uint) instructions.size(), offset);
+            program_offsets[program->name] = offset;
+            return true;
+        }
+        if (cmd == "config" && n >= 3) {
+            if (!parse_sm(words[1], sm)) return false;
+            if (!program_offsets.count(words[2])) {
+                error = "program '" + words[2] + "' has not been loaded";
+                return false;
+            }
+            return configure(sm, *find_program(words[2]), std::vector<std::string>(words.begin() + 3, words.end()), error);
+        }
+        if ((cmd == "enable" || cmd == "disable") && n >= 2) {
+            uint32_t mask = 0;
+            for (size_t i = 1; i < n; i++) {
+                if (!parse_sm(words[i], sm)) return false;
+                mask |= 1u << sm;
+            }
+            pio_sim_sm_set_enabled_mask(&pio, mask, cmd == "enable");
+            return true;
+        }
+        if (cmd == "pin" && n == 3) {
+            uint pin;
+            if (!parse_pin(words[1], pin) || (words[2] != "0" && words[2] != "1")) return false;
+            pio_sim_set_gpio_in(&pio, (pio.gpio_in & ~(1u << pin)) | ((words[2] == "1") << pin));
+            return true;
+        }
+        if (cmd == "sync_bypass" && n >= 2) {
+            for (size_t i = 1; i < n; i++) {
+                uint pin;
+                if (!parse_pin(words[i], pin)) return false;
+                pio.input_sync_bypass |= 1u << pin;
+            }
+            return true;
+        }
+        if ((cmd == "put" || cmd == "expect") && n >= 3) {
+            if (!parse_sm(words[1], sm)) return false;
+            for (size_t i = 2; i < n; i++) {
+                uint32_t value;
+                if (!parse_uint(words[i], value)) return false;
+                if (cmd == "put") {
+                    tx_queue[sm].push_back(value);
+                } else if (expect_pos[sm] >= received[sm].size()) {
+                    std::cerr << "FAIL: expected 0x" << std::hex << value << std::dec << " from sm" << sm << " but nothing was received\n";
+                    failures++;
+                } else {
+                    uint32_t actual = received[sm][expect_pos[sm]++].second;
+                    if (actual != value) {
+                        std::cerr << "FAIL: expected 0x" << std::hex << value << " from sm" << sm << " but received 0x" << actual << std::dec << "\n";
+                        failures++;
+                    }
+                }
+            }
+            return true;
+        }
+        if (cmd == "drain" && n == 3) {
+            if (!parse_sm(words[1], sm) || (words[2] != "on" && words[2] != "off")) return false;
+            drain[sm] = words[2] == "on";
+            return true;
+        }
+        if (cmd == "exec" && n == 3) {
+            uint32_t instr;
+            if (!parse_sm(words[1], sm) || !parse_uint(words[2], instr) || instr > 0xffff) return false;
+            pio_sim_sm_exec(&pio, sm, (uint16_t) instr);
+            return true;
+        }
+        if (cmd == "run" && n == 2) {
+            uint32_t cycles;
+            if (!parse_uint(words[1], cycles)) return false;
+            if (vcd.out && !vcd_started) start_vcd();
+            for (uint32_t i = 0; i < cycles; i++) step();
+            return true;
+        }
+        error = "unknown command";
+        return false;
+    }
+};
+
+static int run_script(simulation &sim, const char *script) {
+    std::ifstream in(script);
+    if (!in) {
+        std::cerr << "error: can't open script file '" << script << "'\n";
+        return 1;
+    }
+    std::string line;
+    for (int line_number = 1; std::getline(in, line); line_number++) {
+        auto hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        std::istringstream ss(line);
+        std::vector<std::string> words;
+        std::string word;
+        while (ss >> word) words.push_back(word);
+        if (words.empty()) continue;
+        std::string error = "invalid arguments";
+        if (!sim.command(words, error)) {
+            std::cerr << script << ":" << line_number << ": error: " << error << " for '" << words[0] << "'\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int res = 0;
+    const char *vcd_filename = nullptr;
+    double mhz = DEFAULT_CLOCK_MHZ;
+    bool trace = false;
+    int i = 1;
+    for (; !res && i < argc; i++) {
+        if (argv[i][0] != '-') break;
+        if (argv[i] == std::string("-v")) {
+            if (++i < argc) {
+                vcd_filename = argv[i];
+            } else {
+                std::cerr << "error: -v requires a filename" << std::endl;
+                res = 1;
+            }
+        } else if (argv[i] == std::string("-f")) {
+            if (++i < argc && atof(argv[i]) > 0) {
+                mhz = atof(argv[i]);
+            } else {
+                std::cerr << "error: -f requires a frequency in MHz" << std::endl;
+                res = 1;
+            }
+        } else if (argv[i] == std::string("-t")) {
+            trace = true;
+        } else if (argv[i] == std::string("-?") || argv[i] == std::string("--help")) {
+            usage();
+            return 1;
+        } else {
+            std::cerr << "error: unknown option " << argv[i] << std::endl;
+            res = 1;
+        }
+    }
+    if (!res && argc - i != 2) {
+        std::cerr << "error: expected input and script filenames\n";
+        res = 1;
+    }
+    if (res) {
+        std::cerr << std::endl;
+        usage();
+        return res;
+    }
+    const char *input = argv[i];
+    const char *script = argv[i + 1];
+
+    auto capture = std::make_shared<capture_output>();
+    pio_assembler pioasm;
+    if (pioasm.generate(capture, input, "-", {})) return 1;
+
+    simulation sim;
+    sim.source = capture->source;
+    sim.trace = trace;
+    if (vcd_filename) {
+        sim.vcd.out = fopen(vcd_filename, "w");
+        if (!sim.vcd.out) {
+            std::cerr << "error: can't open VCD file '" << vcd_filename << "'\n";
+            return 1;
+        }
+        sim.vcd.period_ps = (uint64_t) (1e6 / mhz + 0.5);
+    }
+    res = run_script(sim, script);
+    if (sim.vcd.out) fclose(sim.vcd.out);
+    if (res) return res;
+    sim.report();
+    if (sim.failures) {
+        std::cerr << sim.failures << " expectation(s) failed\n";
+        return 1;
+    }
+    return 0;
+}